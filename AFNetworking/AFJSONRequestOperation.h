@@ -50,6 +50,26 @@
  Options for reading the response JSON data and creating the Foundation objects. For possible values, see the `NSJSONSerialization` documentation section "NSJSONReadingOptions".
  */
 @property (nonatomic, assign) NSJSONReadingOptions JSONReadingOptions;
+
+/**
+ Whether `responseJSON` is parsed straight from `responseData` when the response is UTF-8, instead of first being decoded into `responseString` and re-encoded. The data is validated as UTF-8 in place, and only responses in other encodings, or that `NSJSONSerialization` rejects while containing Unicode escapes, go through an intermediate string. `YES` by default.
+ */
+@property (nonatomic, assign) BOOL parsesResponseDataInPlace;
+
+/**
+ Parses JSON from response data without copying it when the data is valid UTF-8.
+
+ @param data The response data.
+ @param stringEncoding The text encoding of the response.
+ @param options Options for `NSJSONSerialization`.
+ @param error Set to the parsing error, if any.
+
+ @return The JSON object, or `nil` if the data is empty, a single space, or cannot be parsed.
+ */
++ (id)JSONObjectWithResponseData:(NSData *)data
+                  stringEncoding:(NSStringEncoding)stringEncoding
+                         options:(NSJSONReadingOptions)options
+                           error:(NSError * __autoreleasing *)error;
  
 ///----------------------------------
 /// @name Creating Request Operations
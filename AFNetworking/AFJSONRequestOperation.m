@@ -32,6 +32,107 @@ static dispatch_queue_t json_request_operation_processing_queue() {
     return af_json_request_operation_processing_queue;
 }
 
+static NSError * AFJSONStringDecodingError(NSString *string) {
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+    [userInfo setValue:@"Operation responseData failed decoding as a UTF-8 string" forKey:NSLocalizedDescriptionKey];
+    [userInfo setValue:[NSString stringWithFormat:@"Could not decode string: %@", string] forKey:NSLocalizedFailureReasonErrorKey];
+    return [[NSError alloc] initWithDomain:AFNetworkingErrorDomain code:NSURLErrorCannotDecodeContentData userInfo:userInfo];
+}
+
+// Validates UTF-8 without allocating, rejecting overlong forms, surrogates, and code points above U+10FFFF.
+static BOOL AFJSONIsValidUTF8(const uint8_t *bytes, NSUInteger length) {
+    NSUInteger i = 0;
+    while (i < length) {
+        // Skip runs of ASCII eight bytes at a time.
+        while (i + 8 <= length) {
+            uint64_t word;
+            memcpy(&word, bytes + i, sizeof(word));
+            if (word & 0x8080808080808080ULL) {
+                break;
+            }
+            i += 8;
+        }
+        if (i >= length) {
+            break;
+        }
+
+        uint8_t c = bytes[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+
+        NSUInteger count;
+        uint8_t min = 0x80, max = 0xBF;
+        if (c >= 0xC2 && c <= 0xDF) {
+            count = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            count = 2;
+            if (c == 0xE0) {
+                min = 0xA0;
+            } else if (c == 0xED) {
+                max = 0x9F;
+            }
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            count = 3;
+            if (c == 0xF0) {
+                min = 0x90;
+            } else if (c == 0xF4) {
+                max = 0x8F;
+            }
+        } else {
+            return NO;
+        }
+
+        if (i + count >= length) {
+            return NO;
+        }
+        if (bytes[i + 1] < min || bytes[i + 1] > max) {
+            return NO;
+        }
+        for (NSUInteger j = 2; j <= count; j++) {
+            if ((bytes[i + j] & 0xC0) != 0x80) {
+                return NO;
+            }
+        }
+        i += count + 1;
+    }
+
+    return YES;
+}
+
+static BOOL AFJSONContainsUnicodeEscape(const uint8_t *bytes, NSUInteger length) {
+    const uint8_t *end = bytes + length;
+    const uint8_t *p = bytes;
+    while ((p = memchr(p, '\\', (size_t)(end - p))) && p + 1 < end) {
+        if (p[1] == 'u') {
+            return YES;
+        }
+        // Skip the escaped character, which may itself be a backslash.
+        p += 2;
+    }
+
+    return NO;
+}
+
+// Decodes the data into a string and re-encodes it as UTF-8 before parsing, as earlier versions always did.
+static id AFJSONObjectWithTranscodedData(NSData *data, NSStringEncoding stringEncoding, NSJSONReadingOptions options, NSError * __autoreleasing *error) {
+    NSString *string = [[NSString alloc] initWithData:data encoding:stringEncoding];
+    if ([string isEqualToString:@" "]) {
+        return nil;
+    }
+
+    NSData *UTF8Data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    if (!UTF8Data) {
+        if (error) {
+            *error = AFJSONStringDecodingError(string);
+        }
+        return nil;
+    }
+
+    return [NSJSONSerialization JSONObjectWithData:UTF8Data options:options error:error];
+}
+
 @interface AFJSONRequestOperation ()
 @property (readwrite, nonatomic, strong) id responseJSON;
 @property (readwrite, nonatomic, strong) NSError *JSONError;
@@ -42,6 +143,7 @@ static dispatch_queue_t json_request_operation_processing_queue() {
 @synthesize responseJSON = _responseJSON;
 @synthesize JSONReadingOptions = _JSONReadingOptions;
 @synthesize JSONError = _JSONError;
+@synthesize parsesResponseDataInPlace = _parsesResponseDataInPlace;
 @dynamic lock;
 
 + (instancetype)JSONRequestOperationWithRequest:(NSURLRequest *)urlRequest
@@ -63,35 +165,100 @@ static dispatch_queue_t json_request_operation_processing_queue() {
 }
 
 
+- (id)initWithRequest:(NSURLRequest *)urlRequest {
+    self = [super initWithRequest:urlRequest];
+    if (!self) {
+        return nil;
+    }
+
+    self.parsesResponseDataInPlace = YES;
+
+    return self;
+}
+
 - (id)responseJSON {
+    // The lock only guards the result: parsing a large response must not block other threads that take the lock, such as one cancelling the operation.
     [self.lock lock];
-    if (!_responseJSON && [self.responseData length] > 0 && [self isFinished] && !self.JSONError) {
-        NSError *error = nil;
+    BOOL needsParsing = !_responseJSON && [self.responseData length] > 0 && [self isFinished] && !self.JSONError;
+    [self.lock unlock];
 
-        // Workaround for behavior of Rails to return a single space for `head :ok` (a workaround for a bug in Safari), which is not interpreted as valid input by NSJSONSerialization.
-        // See https://github.com/rails/rails/issues/1742
-        if (self.responseString && ![self.responseString isEqualToString:@" "]) {
-            // Workaround for a bug in NSJSONSerialization when Unicode character escape codes are used instead of the actual character
-            // See http://stackoverflow.com/a/12843465/157142
-            NSData *data = [self.responseString dataUsingEncoding:NSUTF8StringEncoding];
-
-            if (data) {
-                self.responseJSON = [NSJSONSerialization JSONObjectWithData:data options:self.JSONReadingOptions error:&error];
-            } else {
-                NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
-                [userInfo setValue:@"Operation responseData failed decoding as a UTF-8 string" forKey:NSLocalizedDescriptionKey];
-                [userInfo setValue:[NSString stringWithFormat:@"Could not decode string: %@", self.responseString] forKey:NSLocalizedFailureReasonErrorKey];
-                error = [[NSError alloc] initWithDomain:AFNetworkingErrorDomain code:NSURLErrorCannotDecodeContentData userInfo:userInfo];
-            }
+    if (needsParsing) {
+        NSError *error = nil;
+        id JSON = nil;
+        if (self.parsesResponseDataInPlace) {
+            JSON = [[self class] JSONObjectWithResponseData:self.responseData stringEncoding:self.responseStringEncoding options:self.JSONReadingOptions error:&error];
+        } else {
+            JSON = [self JSONObjectFromResponseString:&error];
         }
 
-        self.JSONError = error;
+        [self.lock lock];
+        if (!_responseJSON && !self.JSONError) {
+            self.responseJSON = JSON;
+            self.JSONError = error;
+        }
+        [self.lock unlock];
     }
-    [self.lock unlock];
 
     return _responseJSON;
 }
 
+- (id)JSONObjectFromResponseString:(NSError * __autoreleasing *)error {
+    // Workaround for behavior of Rails to return a single space for `head :ok` (a workaround for a bug in Safari), which is not interpreted as valid input by NSJSONSerialization.
+    // See https://github.com/rails/rails/issues/1742
+    if (self.responseString && ![self.responseString isEqualToString:@" "]) {
+        // Workaround for a bug in NSJSONSerialization when Unicode character escape codes are used instead of the actual character
+        // See http://stackoverflow.com/a/12843465/157142
+        NSData *data = [self.responseString dataUsingEncoding:NSUTF8StringEncoding];
+
+        if (data) {
+            return [NSJSONSerialization JSONObjectWithData:data options:self.JSONReadingOptions error:error];
+        } else if (error) {
+            *error = AFJSONStringDecodingError(self.responseString);
+        }
+    }
+
+    return nil;
+}
+
++ (id)JSONObjectWithResponseData:(NSData *)data
+                  stringEncoding:(NSStringEncoding)stringEncoding
+                         options:(NSJSONReadingOptions)options
+                           error:(NSError * __autoreleasing *)error
+{
+    const uint8_t *bytes = (const uint8_t *)[data bytes];
+    NSUInteger length = [data length];
+
+    // Workaround for behavior of Rails to return a single space for `head :ok`. See above.
+    if (length == 0 || (length == 1 && bytes[0] == ' ')) {
+        return nil;
+    }
+
+    BOOL isUTF8 = (stringEncoding == NSUTF8StringEncoding || stringEncoding == NSASCIIStringEncoding) && AFJSONIsValidUTF8(bytes, length);
+    if (!isUTF8) {
+        return AFJSONObjectWithTranscodedData(data, stringEncoding, options, error);
+    }
+
+    NSData *JSONData = data;
+    if (length >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+        // Skip the byte order mark, as decoding into a string would, without copying the rest.
+        JSONData = [NSData dataWithBytesNoCopy:(void *)(bytes + 3) length:length - 3 freeWhenDone:NO];
+    }
+
+    NSError *parseError = nil;
+    id JSON = [NSJSONSerialization JSONObjectWithData:JSONData options:options error:&parseError];
+    if (!JSON && AFJSONContainsUnicodeEscape(bytes, length)) {
+        // Workaround for a bug in NSJSONSerialization when Unicode character escape codes are used instead of the actual character, only taken when the direct parse failed.
+        // See http://stackoverflow.com/a/12843465/157142
+        return AFJSONObjectWithTranscodedData(data, stringEncoding, options, error);
+    }
+
+    if (!JSON && error) {
+        *error = parseError;
+    }
+
+    return JSON;
+}
+
 - (NSError *)error {
     if (_JSONError) {
         return _JSONError;
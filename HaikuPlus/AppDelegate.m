@@ -19,6 +19,10 @@
 // to explore this application.
 #define HP_USE_SIMULATED_SERVER 0
 
+// Number of generated haikus the simulated server adds to its feed. Use a large value to measure
+// time-to-first-row and memory with a large feed.
+#define HP_SIMULATED_SYNTHETIC_HAIKU_COUNT 0
+
 #import "AppDelegate.h"
 
 #import <GoogleOpenSource/GoogleOpenSource.h>
@@ -26,7 +30,10 @@
 #import "HomeViewController.h"
 #import "HPCommunicator.h"
 #import "HPConstants.h"
+#import "HPFeedCache.h"
 #import "HPFloatingUI.h"
+#import "HPImagePipeline.h"
+#import "HPWriteJournal.h"
 #import "SimulatedHPNetworkClient.h"
 
 @implementation AppDelegate
@@ -39,7 +46,10 @@
   // If you cannot run a Haiku+ server, you can use the simulated network class in order to
   // explore this application.
 #if HP_USE_SIMULATED_SERVER
-  HPNetworkClient *network = [[SimulatedHPNetworkClient alloc] initWithBaseURL:baseURL];
+  SimulatedHPNetworkClient *simulatedNetwork =
+      [[SimulatedHPNetworkClient alloc] initWithBaseURL:baseURL];
+  simulatedNetwork.syntheticHaikuCount = HP_SIMULATED_SYNTHETIC_HAIKU_COUNT;
+  HPNetworkClient *network = simulatedNetwork;
 #else
   HPNetworkClient *network = [[HPNetworkClient alloc] initWithBaseURL:baseURL];
 #endif
@@ -60,6 +70,11 @@
   // The communicator handles all communication with the Haiku+ API, including sign-in.
   _communicator = [[HPCommunicator alloc] init];
   _communicator.networkClient = network;
+  _communicator.feedCache = [[HPFeedCache alloc] initWithDirectory:[HPFeedCache defaultDirectory]];
+  _communicator.imagePipeline =
+      [[HPImagePipeline alloc] initWithDirectory:[HPImagePipeline defaultDirectory]];
+  _communicator.writeJournal =
+      [[HPWriteJournal alloc] initWithDirectory:[HPWriteJournal defaultDirectory]];
   _communicator.gppSignIn = gppSignIn;
   gppSignIn.delegate = _communicator;
   [gppSignIn trySilentAuthentication];
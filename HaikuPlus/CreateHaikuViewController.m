@@ -73,11 +73,43 @@
   haikuToUpload.line_two = _lineTwo.text;
   haikuToUpload.line_three = _lineThree.text;
   [_floatingUI addLoadingSpinner];
+  // Only read and written on the main queue.
+  __block BOOL isSpinning = YES;
+  __block BOOL isWaitingForNetwork = NO;
   [_communicator createHaiku:haikuToUpload
-                  completion:^(HPHaiku *haiku, NSError *error) {
-                      [_floatingUI removeLoadingSpinner];
-                      [self didCreateHaiku:haiku error:error];
-                  }];
+                      status:^(HPWriteEntry *entry, HPWriteStatus status, HPHaiku *haiku,
+                               NSError *error) {
+      BOOL isFinished = status == HPWriteStatusSucceeded || status == HPWriteStatusFailed;
+      BOOL isOffline = status == HPWriteStatusPending && error;
+      if (!isFinished && !isOffline) {
+        return;
+      }
+      if (isSpinning) {
+        isSpinning = NO;
+        [_floatingUI removeLoadingSpinner];
+      }
+      if (isOffline) {
+        if (!isWaitingForNetwork) {
+          isWaitingForNetwork = YES;
+          [self didSaveHaikuOffline];
+        }
+      } else if (isWaitingForNetwork) {
+        // The user has moved on, so do not navigate.
+        NSString *message = error ? @"Could not post a saved haiku." : @"Posted a saved haiku!";
+        [_floatingUI showToast:message];
+      } else {
+        [self didCreateHaiku:haiku error:error];
+      }
+  }];
+}
+
+/**
+ * Let the user move on while the haiku waits in the write journal for the network.
+ */
+- (void)didSaveHaikuOffline {
+  [self clearForm];
+  [_floatingUI showToast:@"Haiku saved. It will be posted when you are back online."];
+  [self.navigationController popToRootViewControllerAnimated:YES];
 }
 
 /**
@@ -0,0 +1,143 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * States of a circuit breaker.
+ */
+typedef NS_ENUM(NSInteger, HPCircuitState) {
+  // Requests are sent, and their outcomes are recorded.
+  HPCircuitStateClosed,
+  // Requests fail fast without being sent, until |openDuration| has passed.
+  HPCircuitStateOpen,
+  // One probe request is sent. Its outcome closes or opens the circuit again.
+  HPCircuitStateHalfOpen
+};
+
+/**
+ * Stops requests to one API endpoint while it is failing or slow, so that screens fail fast
+ * instead of waiting for timeouts, and the server gets room to recover. The circuit opens when the
+ * rate of failed or slow requests among recent requests reaches a threshold. After |openDuration|
+ * a single probe is let through: if it succeeds the circuit closes, otherwise it opens again.
+ *
+ * The breaker also derives the timeout of requests from the latencies of recent successful
+ * requests, so that a request to a healthy endpoint does not wait much longer than usual.
+ *
+ * The breaker is safe to use from any thread.
+ */
+@interface HPCircuitBreaker : NSObject
+
+/**
+ * Number of recent outcomes the failure and slow rates are computed from. Defaults to 20.
+ */
+@property(nonatomic) NSUInteger windowSize;
+
+/**
+ * Number of outcomes that must be recorded before the circuit can open. Defaults to 10.
+ */
+@property(nonatomic) NSUInteger minimumRequestCount;
+
+/**
+ * Rate of failed requests, from 0 to 1, at which the circuit opens. Defaults to 0.5.
+ */
+@property(nonatomic) double failureRateThreshold;
+
+/**
+ * Rate of slow requests, from 0 to 1, at which the circuit opens. Defaults to 0.8.
+ */
+@property(nonatomic) double slowRateThreshold;
+
+/**
+ * Latency above which a request counts as slow. Defaults to 5 seconds.
+ */
+@property(nonatomic) NSTimeInterval slowRequestDuration;
+
+/**
+ * Time the circuit stays open before a probe is sent. Defaults to 10 seconds.
+ */
+@property(nonatomic) NSTimeInterval openDuration;
+
+/**
+ * Percentile of recent successful latencies the timeout is derived from, from 0 to 1. Defaults to
+ * 0.99.
+ */
+@property(nonatomic) double timeoutPercentile;
+
+/**
+ * Factor applied to the latency percentile to get the timeout. Defaults to 3.
+ */
+@property(nonatomic) double timeoutMultiplier;
+
+/**
+ * Bounds of the derived timeout. The maximum is also the timeout until enough latencies have been
+ * recorded. Default to 2 and 15 seconds.
+ */
+@property(nonatomic) NSTimeInterval minimumTimeout;
+@property(nonatomic) NSTimeInterval maximumTimeout;
+
+/**
+ * Current state. An open circuit whose |openDuration| has passed reports HPCircuitStateOpen until
+ * the next request is allowed as a probe.
+ */
+@property(nonatomic, readonly) HPCircuitState state;
+
+/**
+ * Number of times the circuit opened.
+ */
+@property(nonatomic, readonly) NSUInteger openCount;
+
+/**
+ * Number of requests refused while the circuit was open.
+ */
+@property(nonatomic, readonly) NSUInteger rejectedCount;
+
+/**
+ * Asks whether a request may be sent. When this returns YES, the outcome of the request must be
+ * reported with one of the record methods.
+ *
+ * @return YES if the circuit is closed, or if the request is the probe of a half-open circuit.
+ */
+- (BOOL)allowRequest;
+
+/**
+ * Records a request that succeeded, or that failed for a reason unrelated to the health of the
+ * endpoint, such as a client error.
+ *
+ * @param latency Time from sending the request to its response.
+ */
+- (void)recordSuccessWithLatency:(NSTimeInterval)latency;
+
+/**
+ * Records a request that failed because of the endpoint or the network.
+ *
+ * @param latency Time from sending the request to its failure.
+ */
+- (void)recordFailureWithLatency:(NSTimeInterval)latency;
+
+/**
+ * Records a request that was cancelled, and so says nothing about the endpoint.
+ */
+- (void)recordCancellation;
+
+/**
+ * @return Timeout for the next request: a multiple of a percentile of recent successful
+ *     latencies, within the bounds.
+ */
+- (NSTimeInterval)timeoutInterval;
+
+@end
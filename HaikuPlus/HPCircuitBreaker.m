@@ -0,0 +1,201 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPCircuitBreaker.h"
+
+/**
+ * Largest number of outcomes and latencies kept.
+ */
+#define HP_CIRCUIT_BREAKER_CAPACITY 128
+
+/**
+ * Outcome of one request in the window.
+ */
+typedef struct {
+  BOOL isFailure;
+  BOOL isSlow;
+} HPCircuitOutcome;
+
+@implementation HPCircuitBreaker {
+  // Ring buffer of recent outcomes, reset whenever the circuit changes state.
+  HPCircuitOutcome _outcomes[HP_CIRCUIT_BREAKER_CAPACITY];
+  NSUInteger _outcomeCount;
+  NSUInteger _nextOutcomeIndex;
+  // Ring buffer of recent successful latencies.
+  NSTimeInterval _latencies[HP_CIRCUIT_BREAKER_CAPACITY];
+  NSUInteger _latencyCount;
+  NSUInteger _nextLatencyIndex;
+  CFAbsoluteTime _openTime;
+  // YES while the probe of a half-open circuit is running.
+  BOOL _isProbing;
+}
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _windowSize = 20;
+    _minimumRequestCount = 10;
+    _failureRateThreshold = 0.5;
+    _slowRateThreshold = 0.8;
+    _slowRequestDuration = 5;
+    _openDuration = 10;
+    _timeoutPercentile = 0.99;
+    _timeoutMultiplier = 3;
+    _minimumTimeout = 2;
+    _maximumTimeout = 15;
+    _state = HPCircuitStateClosed;
+  }
+  return self;
+}
+
+- (BOOL)allowRequest {
+  @synchronized(self) {
+    switch (_state) {
+      case HPCircuitStateClosed:
+        return YES;
+      case HPCircuitStateOpen:
+        if (CFAbsoluteTimeGetCurrent() - _openTime < _openDuration) {
+          _rejectedCount++;
+          return NO;
+        }
+        _state = HPCircuitStateHalfOpen;
+        _isProbing = YES;
+        return YES;
+      case HPCircuitStateHalfOpen:
+        if (_isProbing) {
+          _rejectedCount++;
+          return NO;
+        }
+        _isProbing = YES;
+        return YES;
+    }
+  }
+  return YES;
+}
+
+- (void)recordSuccessWithLatency:(NSTimeInterval)latency {
+  @synchronized(self) {
+    _latencies[_nextLatencyIndex] = latency;
+    _nextLatencyIndex = (_nextLatencyIndex + 1) % HP_CIRCUIT_BREAKER_CAPACITY;
+    _latencyCount = MIN(_latencyCount + 1, HP_CIRCUIT_BREAKER_CAPACITY);
+    switch (_state) {
+      case HPCircuitStateClosed:
+        [self addOutcome:(HPCircuitOutcome){ NO, latency > _slowRequestDuration }];
+        break;
+      case HPCircuitStateHalfOpen:
+        // The probe succeeded.
+        _state = HPCircuitStateClosed;
+        _isProbing = NO;
+        [self resetOutcomes];
+        break;
+      case HPCircuitStateOpen:
+        // A request sent before the circuit opened.
+        break;
+    }
+  }
+}
+
+- (void)recordFailureWithLatency:(NSTimeInterval)latency {
+  @synchronized(self) {
+    switch (_state) {
+      case HPCircuitStateClosed:
+        [self addOutcome:(HPCircuitOutcome){ YES, latency > _slowRequestDuration }];
+        break;
+      case HPCircuitStateHalfOpen:
+        // The probe failed.
+        _isProbing = NO;
+        [self open];
+        break;
+      case HPCircuitStateOpen:
+        break;
+    }
+  }
+}
+
+- (void)recordCancellation {
+  @synchronized(self) {
+    if (_state == HPCircuitStateHalfOpen) {
+      // Let the next request probe instead.
+      _isProbing = NO;
+    }
+  }
+}
+
+- (NSTimeInterval)timeoutInterval {
+  NSTimeInterval sorted[HP_CIRCUIT_BREAKER_CAPACITY];
+  NSUInteger count;
+  @synchronized(self) {
+    count = _latencyCount;
+    if (count < MIN(_minimumRequestCount, HP_CIRCUIT_BREAKER_CAPACITY) || count == 0) {
+      return _maximumTimeout;
+    }
+    memcpy(sorted, _latencies, count * sizeof(NSTimeInterval));
+  }
+  qsort_b(sorted, count, sizeof(NSTimeInterval), ^int(const void *a, const void *b) {
+      NSTimeInterval x = *(const NSTimeInterval *)a;
+      NSTimeInterval y = *(const NSTimeInterval *)b;
+      return x < y ? -1 : (x > y ? 1 : 0);
+  });
+  double percentile = MAX(MIN(_timeoutPercentile, 1), 0);
+  NSUInteger index = (NSUInteger)ceil(percentile * count);
+  index = index > 0 ? index - 1 : 0;
+  NSTimeInterval timeout = sorted[index] * _timeoutMultiplier;
+  return MAX(MIN(timeout, _maximumTimeout), _minimumTimeout);
+}
+
+#pragma mark - Private methods
+
+/**
+ * Adds an outcome to the window, and opens the circuit if too many recent requests failed or were
+ * slow. Called while holding the lock.
+ */
+- (void)addOutcome:(HPCircuitOutcome)outcome {
+  NSUInteger windowSize = MAX(MIN(_windowSize, HP_CIRCUIT_BREAKER_CAPACITY), 1);
+  _outcomes[_nextOutcomeIndex % windowSize] = outcome;
+  _nextOutcomeIndex = (_nextOutcomeIndex + 1) % windowSize;
+  _outcomeCount = MIN(_outcomeCount + 1, windowSize);
+  if (_outcomeCount < MAX(_minimumRequestCount, 1)) {
+    return;
+  }
+  NSUInteger failureCount = 0;
+  NSUInteger slowCount = 0;
+  for (NSUInteger i = 0; i < _outcomeCount; i++) {
+    failureCount += _outcomes[i].isFailure ? 1 : 0;
+    slowCount += _outcomes[i].isSlow ? 1 : 0;
+  }
+  if (failureCount >= _failureRateThreshold * _outcomeCount ||
+      slowCount >= _slowRateThreshold * _outcomeCount) {
+    [self open];
+  }
+}
+
+/**
+ * Opens the circuit. Called while holding the lock.
+ */
+- (void)open {
+  _state = HPCircuitStateOpen;
+  _openTime = CFAbsoluteTimeGetCurrent();
+  _openCount++;
+  [self resetOutcomes];
+}
+
+- (void)resetOutcomes {
+  _outcomeCount = 0;
+  _nextOutcomeIndex = 0;
+}
+
+@end
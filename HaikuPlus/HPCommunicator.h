@@ -17,9 +17,19 @@
 
 #import <GooglePlus/GooglePlus.h>
 
+@class HPFeedCache;
+@class HPHedgePolicy;
 @class HPHaiku;
+@class HPHaikuPage;
+@class HPImageLoadToken;
+@class HPImagePipeline;
+@class HPMainThreadWatchdog;
 @class HPNetworkClient;
+@class HPRetryPolicy;
+@class HPTraceBuffer;
 @class HPUser;
+@class HPWriteEntry;
+@class HPWriteJournal;
 
 /**
  * Completion block for fetching an array of haikus from the Haiku+ server.
@@ -29,6 +39,30 @@
  */
 typedef void (^HPArrayCompletion)(NSArray *haikus, NSError *error);
 
+/**
+ * Completion block for fetching one page of haikus from the Haiku+ server.
+ *
+ * @param page Page of haiku objects which is nil when an error occurs.
+ * @param error Error from the server which is nil on success.
+ */
+typedef void (^HPPageCompletion)(HPHaikuPage *page, NSError *error);
+
+/**
+ * Block called for each haiku of a streamed feed, as soon as the haiku has arrived.
+ *
+ * @param haiku Haiku object.
+ */
+typedef void (^HPHaikuStreamHandler)(HPHaiku *haiku);
+
+/**
+ * Completion block for streaming a feed of haikus from the Haiku+ server.
+ *
+ * @param haikuCount Number of haikus handed over, including those before an error.
+ * @param nextCursor Cursor for the next page, or nil for the last page or when an error occurs.
+ * @param error Error from the server which is nil on success.
+ */
+typedef void (^HPStreamCompletion)(NSUInteger haikuCount, NSString *nextCursor, NSError *error);
+
 /**
  * Completion block for fetching a haiku from the Haiku+ server.
  *
@@ -61,6 +95,42 @@ typedef void (^HPUserCompletion)(HPUser *user, NSError *error);
  */
 typedef void (^HPErrorCompletion)(NSError *error);
 
+/**
+ * States of a write to the Haiku+ server, such as a vote.
+ */
+typedef NS_ENUM(NSInteger, HPWriteStatus) {
+  // Kept in the write journal until the network is back or the user signs in.
+  HPWriteStatusPending,
+  // Sent to the server.
+  HPWriteStatusSending,
+  // Accepted by the server.
+  HPWriteStatusSucceeded,
+  // Rejected by the server. It is not sent again.
+  HPWriteStatusFailed
+};
+
+/**
+ * Block called on the main queue each time a write changes state.
+ *
+ * @param entry The write.
+ * @param status New state of the write.
+ * @param result Created haiku for a succeeded HPWriteKindCreateHaiku write, otherwise nil.
+ * @param error Error that failed the write, or that sent it back to pending, otherwise nil.
+ */
+typedef void (^HPWriteStatusHandler)(HPWriteEntry *entry, HPWriteStatus status, id result,
+                                     NSError *error);
+
+/**
+ * Block called on the main queue once a request that needs the user's authorization can be sent.
+ *
+ * @param request The authorized request.
+ * @param waitTime Time from asking for authorization to being able to send the request.
+ * @param isSynchronous YES if the current token was applied right away, NO if the request waited
+ *     for a token refresh.
+ */
+typedef void (^HPAuthorizationWaitHandler)(NSURLRequest *request, NSTimeInterval waitTime,
+                                           BOOL isSynchronous);
+
 @protocol HPCommunicatorDelegate <NSObject>
 
 /**
@@ -86,6 +156,12 @@ typedef void (^HPErrorCompletion)(NSError *error);
  * The communicator implements the Haiku+ API for the iOS client.
  * Authentication is managed by this class. Other classes use the methods in this class to
  * authenticate users and make all Haiku+ API calls.
+ *
+ * Identical GET requests made while one is in flight, for the same user, are sent once and the
+ * result is delivered to every caller. The communicator must be used from the main queue.
+ *
+ * Responses are decoded into model objects on a background queue. Completion blocks are called on
+ * the main queue, unless a completion queue is passed to the method.
  */
 @interface HPCommunicator : NSObject<GPPSignInDelegate>
 
@@ -94,6 +170,53 @@ typedef void (^HPErrorCompletion)(NSError *error);
  */
 @property(strong, nonatomic) HPNetworkClient *networkClient;
 
+/**
+ * Optional on-disk store for the first page of each feed. When set, the first page of a feed is
+ * delivered from the snapshot right away and then again with fresh data from the server.
+ */
+@property(strong, nonatomic) HPFeedCache *feedCache;
+
+/**
+ * Loads images through memory and disk caches. By default the communicator creates a pipeline
+ * that caches images in memory only.
+ */
+@property(strong, nonatomic) HPImagePipeline *imagePipeline;
+
+/**
+ * Optional durable journal for votes and new haikus. When set, writes made with the status
+ * methods are stored before they are sent, and writes that fail because the network or the user's
+ * session is missing are sent again, in order, once the network is back or the user signs in.
+ */
+@property(strong, nonatomic) HPWriteJournal *writeJournal;
+
+/**
+ * Decides which failed requests are sent again and sets the timeout and deadline of every call.
+ * Retry statistics are kept by the policy. By default the communicator creates a policy with
+ * default settings. When nil, every request is sent once with the default timeout.
+ */
+@property(strong, nonatomic) HPRetryPolicy *retryPolicy;
+
+/**
+ * Optional policy for hedging reads the user is waiting for, such as the current user and a
+ * single haiku. When set, such a GET request is sent a second time if it is slower than recent
+ * requests, the first response is used and the slower attempt is cancelled. Hedge counters are
+ * kept by the policy. Defaults to nil, which sends every request once.
+ */
+@property(strong, nonatomic) HPHedgePolicy *hedgePolicy;
+
+/**
+ * Optional buffer that receives a trace of every finished request, with the time each request
+ * reached each stage from enqueueing to delivery. Defaults to nil, which turns tracing off.
+ */
+@property(strong, nonatomic) HPTraceBuffer *traceBuffer;
+
+/**
+ * Optional detector of completion blocks that hold the main thread for longer than a frame.
+ * When set, every success, failure, cached page and streamed haiku block run on the main queue is
+ * timed, and its time and stalls are added to the trace record of the call. Defaults to nil.
+ */
+@property(strong, nonatomic) HPMainThreadWatchdog *mainThreadWatchdog;
+
 /**
  * Google+ Sign-In object.
  */
@@ -109,6 +232,44 @@ typedef void (^HPErrorCompletion)(NSError *error);
  */
 @property(weak, nonatomic) id<HPCommunicatorDelegate> delegate;
 
+/**
+ * Number of GET requests that joined an identical request already in flight instead of being
+ * sent. Image fetches are coalesced by the |imagePipeline|.
+ */
+@property(nonatomic, readonly) NSUInteger coalescedRequestCount;
+
+/**
+ * How long before the access token expires the communicator refreshes it in the background, so
+ * that requests never wait for a refresh while the app is active. Defaults to 5 minutes.
+ */
+@property(nonatomic) NSTimeInterval tokenRefreshLeadTime;
+
+/**
+ * Number of requests authorized right away with the current token.
+ */
+@property(nonatomic, readonly) NSUInteger synchronousAuthorizationCount;
+
+/**
+ * Number of requests that had to wait for the token to be refreshed.
+ */
+@property(nonatomic, readonly) NSUInteger deferredAuthorizationCount;
+
+/**
+ * Number of background token refreshes started by the communicator.
+ */
+@property(nonatomic, readonly) NSUInteger tokenRefreshCount;
+
+/**
+ * Total and longest time requests waited for authorization.
+ */
+@property(nonatomic, readonly) NSTimeInterval totalAuthorizationWaitTime;
+@property(nonatomic, readonly) NSTimeInterval maxAuthorizationWaitTime;
+
+/**
+ * Optional block told how long each authorized request waited for authorization.
+ */
+@property(nonatomic, copy) HPAuthorizationWaitHandler authorizationWaitHandler;
+
 /**
  * Sign-in properties.
  */
@@ -133,6 +294,71 @@ typedef void (^HPErrorCompletion)(NSError *error);
  */
 - (void)fetchHaikusFiltered:(BOOL)isFilteringByFriends completion:(HPArrayCompletion)completion;
 
+/**
+ * Fetches a list of haikus from the server, like - (void)fetchHaikusFiltered:completion:.
+ *
+ * @param isFilteringByFriends Specify which haikus to return.
+ * @param completionQueue Queue for the completion block, or NULL for the main queue.
+ * @param completion Block that takes an array of haikus and an error which is nil on success.
+ */
+- (void)fetchHaikusFiltered:(BOOL)isFilteringByFriends
+            completionQueue:(dispatch_queue_t)completionQueue
+                 completion:(HPArrayCompletion)completion;
+
+/**
+ * Fetches haikus from the server and hands over each one as soon as its bytes have arrived, so
+ * that the first rows can be shown before the response is complete. The haikus are not kept by
+ * the communicator, and the response is neither coalesced with identical requests nor stored in
+ * the feed cache. Filtering by friends requires authentication.
+ *
+ * @param isFilteringByFriends Specify which haikus to return.
+ * @param pageSize Maximum number of haikus, or 0 for the whole feed.
+ * @param cursor Opaque cursor from the previous page, or nil for the first page.
+ * @param completionQueue Queue for the haiku and completion blocks, or NULL for the main queue.
+ * @param haikuHandler Block called with each haiku, in feed order.
+ * @param completion Block called after the last haiku, or when an error occurs.
+ */
+- (void)streamHaikusFiltered:(BOOL)isFilteringByFriends
+                    pageSize:(NSUInteger)pageSize
+                      cursor:(NSString *)cursor
+             completionQueue:(dispatch_queue_t)completionQueue
+                       haiku:(HPHaikuStreamHandler)haikuHandler
+                  completion:(HPStreamCompletion)completion;
+
+/**
+ * Fetches one page of haikus from the server. Filtering by friends requires authentication.
+ * Pass a nil cursor for the first page, and the |nextCursor| of the previous page afterwards.
+ *
+ * When a |feedCache| is set, the completion block for the first page can be called twice: first
+ * with a cached page from the last session, and then with the page from the server.
+ *
+ * @param isFilteringByFriends Specify which haikus to return.
+ * @param pageSize Maximum number of haikus in the page.
+ * @param cursor Opaque cursor from the previous page, or nil for the first page.
+ * @param completion Block that takes a page of haikus and an error which is nil on success.
+ */
+- (void)fetchHaikusFiltered:(BOOL)isFilteringByFriends
+                   pageSize:(NSUInteger)pageSize
+                     cursor:(NSString *)cursor
+                 completion:(HPPageCompletion)completion;
+
+/**
+ * Fetches one page of haikus from the server, like
+ * - (void)fetchHaikusFiltered:pageSize:cursor:completion:.
+ *
+ * @param isFilteringByFriends Specify which haikus to return.
+ * @param pageSize Maximum number of haikus in the page.
+ * @param cursor Opaque cursor from the previous page, or nil for the first page.
+ * @param completionQueue Queue for the completion block, or NULL for the main queue. Both the
+ *     cached and the server page are delivered on it.
+ * @param completion Block that takes a page of haikus and an error which is nil on success.
+ */
+- (void)fetchHaikusFiltered:(BOOL)isFilteringByFriends
+                   pageSize:(NSUInteger)pageSize
+                     cursor:(NSString *)cursor
+            completionQueue:(dispatch_queue_t)completionQueue
+                 completion:(HPPageCompletion)completion;
+
 /**
  * Tell the server that the user should be signed out.
  *
@@ -155,6 +381,17 @@ typedef void (^HPErrorCompletion)(NSError *error);
  */
 - (void)fetchHaikuWithID:(NSString *)haikuID completion:(HPHaikuCompletion)completion;
 
+/**
+ * Fetch a single haiku based on the ID.
+ *
+ * @param haikuID The ID of the haiku to fetch.
+ * @param completionQueue Queue for the completion block, or NULL for the main queue.
+ * @param completion Block that takes a haiku and an error which is nil on success.
+ */
+- (void)fetchHaikuWithID:(NSString *)haikuID
+         completionQueue:(dispatch_queue_t)completionQueue
+              completion:(HPHaikuCompletion)completion;
+
 /**
  * Vote for a single haiku based on ID. Requires authentication.
  *
@@ -172,12 +409,73 @@ typedef void (^HPErrorCompletion)(NSError *error);
 - (void)createHaiku:(HPHaiku *)haiku completion:(HPHaikuCompletion)completion;
 
 /**
- * Fetch an image from a URL. This utility method asynchronously fetches an image and returns
- * it in the main execution queue.
+ * Tell the server to create a new haiku. Requires authentication.
+ *
+ * @param haiku The haiku object that should be uploaded to the server.
+ * @param completionQueue Queue for the completion block, or NULL for the main queue.
+ * @param completion Block that takes a haiku and an error which is nil on success.
+ */
+- (void)createHaiku:(HPHaiku *)haiku
+    completionQueue:(dispatch_queue_t)completionQueue
+         completion:(HPHaikuCompletion)completion;
+
+#pragma mark - Journaled writes
+
+/**
+ * Vote for a single haiku based on ID, through the |writeJournal|. Requires authentication.
+ *
+ * The vote is reported pending as soon as it is stored, with an error when it cannot be sent for
+ * now, so the UI never waits for the network. Without a journal, the vote is sent once and fails
+ * when there is no connection.
+ *
+ * @param haikuID The ID of the haiku to vote for.
+ * @param status Block called each time the vote changes state, or nil.
+ * @return The write, whose idempotency key is sent with every attempt.
+ */
+- (HPWriteEntry *)voteForHaikuWithID:(NSString *)haikuID status:(HPWriteStatusHandler)status;
+
+/**
+ * Vote for a haiku optimistically, like - (HPWriteEntry *)voteForHaikuWithID:status:.
+ * kHPConstantsHaikuVotesDidChangeNotification is posted right away, so that every screen shows
+ * the new count without fetching the haiku again. If the server rejects the vote, the
+ * notification is posted again with the opposite change. |haiku| itself is not changed.
+ *
+ * Until the server has confirmed the vote, haikus delivered by other requests also count it.
+ *
+ * @param haiku The haiku to vote for.
+ * @param status Block called each time the vote changes state, or nil.
+ * @return The write, whose idempotency key is sent with every attempt.
+ */
+- (HPWriteEntry *)voteForHaiku:(HPHaiku *)haiku status:(HPWriteStatusHandler)status;
+
+/**
+ * Tell the server to create a new haiku through the |writeJournal|, like
+ * - (HPWriteEntry *)voteForHaikuWithID:status:. Requires authentication.
+ *
+ * @param haiku The haiku object that should be uploaded to the server.
+ * @param status Block called each time the write changes state, or nil.
+ * @return The write, whose idempotency key is sent with every attempt.
+ */
+- (HPWriteEntry *)createHaiku:(HPHaiku *)haiku status:(HPWriteStatusHandler)status;
+
+/**
+ * Sends the writes left in the |writeJournal| one after another, oldest first, reading them in
+ * batches of its |batchSize|. Replay stops at the first write that could not reach the server,
+ * and starts again after a backoff from the |retryPolicy|. Called automatically when the network
+ * client reports that the network is back, when the user signs in and when a write is added.
+ */
+- (void)replayWriteJournal;
+
+/**
+ * Fetch an image from a URL through the |imagePipeline|. The image is returned in the main
+ * execution queue, right away if it is cached in memory. Concurrent fetches of the same URL share
+ * one download. Cancel the returned token when the image is no longer needed, such as when a
+ * table cell is reused; the completion block of a cancelled fetch is not called.
  *
  * @param url The URL of an image.
  * @param completion Block that takes an image and an error which is nil on success.
+ * @return Token that cancels the fetch.
  */
-- (void)fetchImageWithURL:(NSURL *)url completion:(HPImageCompletion)completion;
+- (HPImageLoadToken *)fetchImageWithURL:(NSURL *)url completion:(HPImageCompletion)completion;
 
 @end
@@ -19,13 +19,121 @@
 
 #import <GoogleOpenSource/GoogleOpenSource.h>
 
-#import "AFImageRequestOperation.h"
+#import "HPCircuitBreaker.h"
 #import "HPConstants.h"
+#import "HPFeedCache.h"
+#import "HPHedgePolicy.h"
 #import "HPHaiku.h"
+#import "HPHaikuPage.h"
+#import "HPImagePipeline.h"
+#import "HPMainThreadWatchdog.h"
 #import "HPNetworkClient.h"
+#import "HPRetryPolicy.h"
+#import "HPTraceBuffer.h"
 #import "HPUser.h"
+#import "HPWriteJournal.h"
 
-@implementation HPCommunicator
+/**
+ * Default time before expiry at which the access token is refreshed in the background.
+ */
+static const NSTimeInterval kHPCommunicatorDefaultTokenRefreshLeadTime = 5 * 60;
+
+/**
+ * A token is applied right away only if it stays valid for at least this long, which is also when
+ * GTMOAuth2Authentication itself would refresh it first.
+ */
+static const NSTimeInterval kHPCommunicatorTokenValidityMargin = 60;
+
+/**
+ * Delay before a failed background refresh is tried again.
+ */
+static const NSTimeInterval kHPCommunicatorTokenRefreshRetryDelay = 30;
+
+/**
+ * Completion blocks of a request operation.
+ */
+typedef void (^HPOperationSuccess)(AFHTTPRequestOperation *operation, id decodedObject);
+typedef void (^HPOperationFailure)(AFHTTPRequestOperation *operation, NSError *error);
+
+/**
+ * Completion block of one caller waiting for an in-flight request.
+ */
+typedef void (^HPInFlightCompletion)(id object, NSError *error);
+
+/**
+ * Status handler of a write made in this session, bound to the write.
+ */
+typedef void (^HPWriteStatusReport)(HPWriteStatus status, id result, NSError *error);
+
+/**
+ * State shared by the attempts of a hedged request. Guarded by @synchronized on the call, because
+ * attempts finish on the network client's processing queue.
+ */
+@interface HPHedgedCall : NSObject
+
+@property(nonatomic) CFAbsoluteTime startTime;
+// Operations of the attempts that have not finished.
+@property(nonatomic, strong) NSMutableArray *operations;
+@property(nonatomic) NSUInteger runningCount;
+// YES once an attempt has won.
+@property(nonatomic) BOOL isFinished;
+
+@end
+
+@implementation HPHedgedCall
+
+@end
+
+@implementation HPCommunicator {
+  // Map from in-flight request key to an array of HPInFlightCompletion blocks.
+  NSMutableDictionary *_inFlightCompletions;
+  // Map from idempotency key to the HPWriteStatusReport of a write made in this session.
+  NSMutableDictionary *_writeStatusHandlers;
+  // Idempotency keys of writes the user made in this session that have not been sent yet. Only
+  // they are sent as interactive requests; a replayed backlog must not hold back the feed.
+  NSMutableSet *_newWriteKeys;
+  // YES while a batch of journaled writes is being sent.
+  BOOL _isReplayingWrites;
+  // Number of replays in a row that stopped at a write that could not reach the server, and
+  // whether a replay is scheduled after them.
+  NSUInteger _failedWriteReplayCount;
+  BOOL _isWriteReplayScheduled;
+  // Map from haiku ID to the number of optimistic votes the server has not confirmed yet. Guarded
+  // by @synchronized, because results are delivered on any completion queue.
+  NSMutableDictionary *_unconfirmedVotes;
+  // Incremented each time a background token refresh is scheduled, so that only the latest one
+  // runs.
+  NSUInteger _tokenRefreshGeneration;
+  BOOL _isRefreshingToken;
+}
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _inFlightCompletions = [NSMutableDictionary dictionary];
+    _writeStatusHandlers = [NSMutableDictionary dictionary];
+    _newWriteKeys = [NSMutableSet set];
+    _unconfirmedVotes = [NSMutableDictionary dictionary];
+    _imagePipeline = [[HPImagePipeline alloc] initWithDirectory:nil];
+    _tokenRefreshLeadTime = kHPCommunicatorDefaultTokenRefreshLeadTime;
+    _retryPolicy = [[HPRetryPolicy alloc] init];
+    NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
+    [notificationCenter addObserver:self
+                           selector:@selector(networkReachabilityDidChange:)
+                               name:AFNetworkingReachabilityDidChangeNotification
+                             object:nil];
+    // Scheduled refreshes do not run while the app is suspended.
+    [notificationCenter addObserver:self
+                           selector:@selector(scheduleTokenRefresh)
+                               name:UIApplicationDidBecomeActiveNotification
+                             object:nil];
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
 
 /**
  * Set the User-Agent field in the header for the server to recognize the iOS client.
@@ -34,11 +142,24 @@
   if (_networkClient != network) {
     _networkClient = network;
     [_networkClient setDefaultHeader:@"User-Agent" value:kHPConstantsUserAgent];
+    // Avatar downloads share the scheduler, so that they wait for interactive requests.
+    _imagePipeline.scheduler = _networkClient.scheduler;
   }
 }
 
+- (void)setImagePipeline:(HPImagePipeline *)imagePipeline {
+  _imagePipeline = imagePipeline;
+  _imagePipeline.scheduler = _networkClient.scheduler;
+}
+
+- (void)setWriteJournal:(HPWriteJournal *)writeJournal {
+  _writeJournal = writeJournal;
+  [self replayWriteJournal];
+}
+
 - (void)setAuth:(GTMOAuth2Authentication *)theAuth {
   _auth = theAuth;
+  [self scheduleTokenRefresh];
 }
 
 - (NSError *)authorizationError {
@@ -126,6 +247,9 @@
                      // Inform the delegate that the profile image has been updated.
                      [_delegate didFinishFetchingDisplayImage];
                  }];
+
+    // Writes that waited for the user's session can be sent now.
+    [self replayWriteJournal];
   } else {
     // User could not be signed in on the server due to a bad network connection or invalid access
     // token. For simplicity, we will sign the user out on the device, although a production app
@@ -145,6 +269,9 @@
 - (void)signOutDevice {
   [_gppSignIn signOut];
   [self deleteSessionCookie];
+  // The circles feed is personal, so it must not be shown after the user signs out.
+  [_feedCache removeSnapshotForKey:[self feedSnapshotKeyFiltered:YES]];
+  [_networkClient removeAllValidators];
   _signedInWithServer = NO;
   self.auth = nil;
   self.currentUser = nil;
@@ -165,141 +292,809 @@
   }
 }
 
-#pragma mark - Haiku+ API
+#pragma mark - Requests
 
 /**
- * Fetch current user from Haiku+ API. Requires authenticated session.
+ * Authorizes the request if necessary and enqueues it with the network client. Failed attempts
+ * are retried as the |retryPolicy| allows.
  *
- * @param completion Block that takes a user object and an error which is nil on success.
+ * @param request The request to send to the Haiku+ server.
+ * @param authorize YES if the request must carry the user's authorization.
+ * @param priority Scheduling class of the request.
+ * @param decoder Block that turns the response object into model objects, or nil. It runs on the
+ *     network client's processing queue, and is skipped when a GET request is answered with
+ *     304 Not Modified.
+ * @param completionQueue Queue for the success and failure blocks, or NULL for the main queue.
+ * @param success Block that takes the decoded object, or the response object without a decoder.
+ * @param failure Block that takes an error from authorization or from the server.
  */
-- (void)fetchCurrentUserWithCompletion:(HPUserCompletion)completion {
-  NSMutableURLRequest *request = [_networkClient requestWithMethod:@"GET"
-                                                              path:kHPConstantsUserPath
-                                                        parameters:nil];
-  if (!_auth) {
-    completion(nil, [self authorizationError]);
-    return;
+- (void)enqueueRequest:(NSMutableURLRequest *)request
+             authorize:(BOOL)authorize
+              priority:(HPRequestPriority)priority
+               decoder:(HPResponseDecoder)decoder
+       completionQueue:(dispatch_queue_t)completionQueue
+               success:(void (^)(id decodedObject))success
+               failure:(void (^)(NSError *error))failure {
+  dispatch_queue_t queue = completionQueue ? completionQueue : dispatch_get_main_queue();
+  // Nil unless tracing is on.
+  HPTraceBuffer *traceBuffer = _traceBuffer;
+  HPTraceRecord *traceRecord = [traceBuffer beginRecordWithRequest:request];
+  // Nil unless stall detection is on.
+  HPMainThreadWatchdog *watchdog = _mainThreadWatchdog;
+  NSString *endpoint = [self endpointOfRequest:request traceRecord:traceRecord watchdog:watchdog];
+  HPInFlightCompletion completion = ^(id object, NSError *error) {
+      dispatch_async(queue, ^{
+          [traceRecord markStage:HPTraceStageDelivered];
+          dispatch_block_t deliver = ^{
+              if (error) {
+                failure(error);
+              } else {
+                success(object);
+              }
+          };
+          [self runCompletionBlock:deliver
+                             stage:HPWatchdogStageDelivery
+                          endpoint:endpoint
+                       traceRecord:traceRecord
+                          watchdog:watchdog];
+          traceRecord.error = error;
+          [traceBuffer addRecord:traceRecord];
+      });
+  };
+  NSString *key = nil;
+  if ([[request HTTPMethod] isEqual:@"GET"]) {
+    key = [self inFlightKeyForRequest:request authorize:authorize];
+    if (![self addInFlightCompletion:completion forKey:key]) {
+      traceRecord.coalesced = YES;
+      return;
+    }
   }
-  [_auth authorizeRequest:request completionHandler:^(NSError *error) {
-    if (error != nil) {
-      completion(nil, error);
+  void (^finish)(id, NSError *) = ^(id object, NSError *error) {
+    if (key) {
+      [self finishInFlightRequestForKey:key object:object error:error];
     } else {
-      AFHTTPRequestOperation *op = [_networkClient HTTPRequestOperationWithRequest:request
-          success:^(AFHTTPRequestOperation *operation, id responseObject) {
-              HPUser *user = [[HPUser alloc] initWithAttributes:responseObject];
-              completion(user, nil);
-          }
-          failure:^(AFHTTPRequestOperation *operation, NSError *error) {
-              completion(nil, error);
-          }];
-      [_networkClient enqueueHTTPRequestOperation:op];
+      completion(object, error);
     }
-  }];
+  };
+
+  CFAbsoluteTime deadline = CFAbsoluteTimeGetCurrent() + _retryPolicy.deadline;
+  [self sendRequest:request
+          authorize:authorize
+           priority:priority
+            decoder:decoder
+        traceRecord:traceRecord
+       attemptCount:1
+           deadline:deadline
+             finish:finish];
 }
 
-- (void)fetchHaikusFiltered:(BOOL)isFilteringByFriends
-                 completion:(HPArrayCompletion)completion {
-  NSString *path;
-  if (isFilteringByFriends) {
-    path = [NSString stringWithFormat:@"%@?filter=circles", kHPConstantsHaikusPath];
-    NSMutableURLRequest *request = [_networkClient requestWithMethod:@"GET"
-                                                                path:path
-                                                          parameters:nil];
-    if (!_auth) {
-      completion(nil, [self authorizationError]);
-      return;
-    }
-    [_auth authorizeRequest:request completionHandler:^(NSError *error) {
-      if (error != nil) {
-        completion(nil, error);
-      } else {
-        AFHTTPRequestOperation *op = [_networkClient HTTPRequestOperationWithRequest:request
-            success:^(AFHTTPRequestOperation *operation, id responseObject) {
-                NSArray *haikus = [HPHaiku haikuObjectsWithAttributes:responseObject];
-                completion(haikus, nil);
-            }
-            failure:^(AFHTTPRequestOperation *operation, NSError *error) {
-                completion(nil, error);
-            }];
-        [_networkClient enqueueHTTPRequestOperation:op];
+/**
+ * Makes one attempt at a call, and schedules the next attempt if this one fails and the
+ * |retryPolicy| allows a retry. The request is authorized again for each attempt, because the
+ * token can change in between.
+ *
+ * @param traceRecord Record of the call, or nil.
+ * @param attemptCount Number of this attempt, starting at 1.
+ * @param deadline Absolute time by which the call must have finished.
+ * @param finish Block that takes the decoded object or the error of the call.
+ */
+- (void)sendRequest:(NSMutableURLRequest *)request
+          authorize:(BOOL)authorize
+           priority:(HPRequestPriority)priority
+            decoder:(HPResponseDecoder)decoder
+        traceRecord:(HPTraceRecord *)traceRecord
+       attemptCount:(NSUInteger)attemptCount
+           deadline:(CFAbsoluteTime)deadline
+             finish:(void (^)(id object, NSError *error))finish {
+  HPRetryPolicy *retryPolicy = _retryPolicy;
+  if (retryPolicy) {
+    [request setTimeoutInterval:MIN(retryPolicy.attemptTimeout,
+                                    MAX(deadline - CFAbsoluteTimeGetCurrent(), 1))];
+  }
+  traceRecord.attemptCount = attemptCount;
+  [self authorizeRequest:request authorize:authorize completion:^(NSError *error) {
+      if (error) {
+        finish(nil, error);
+        return;
       }
-    }];
+      [traceRecord markStage:HPTraceStageAuthorized];
+      // Results are handed over on the processing queue, and each waiting caller then gets them
+      // on its own completion queue.
+      HPOperationSuccess success = ^(AFHTTPRequestOperation *operation, id decodedObject) {
+          [retryPolicy recordSuccessAfterAttemptCount:attemptCount];
+          finish(decodedObject, nil);
+      };
+      HPOperationFailure failure = ^(AFHTTPRequestOperation *operation, NSError *error) {
+          NSTimeInterval delay =
+              [retryPolicy delayBeforeRetryingRequest:request
+                                             response:[operation response]
+                                                error:error
+                                         attemptCount:attemptCount
+                                        timeRemaining:deadline - CFAbsoluteTimeGetCurrent()];
+          if (!retryPolicy || delay == kHPRetryPolicyNoRetry) {
+            finish(nil, error);
+            return;
+          }
+          dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                         dispatch_get_main_queue(), ^{
+              [self sendRequest:request
+                      authorize:authorize
+                       priority:priority
+                        decoder:decoder
+                    traceRecord:traceRecord
+                   attemptCount:attemptCount + 1
+                       deadline:deadline
+                         finish:finish];
+          });
+      };
+      // Only reads the user is waiting for are hedged.
+      HPHedgePolicy *hedgePolicy = _hedgePolicy;
+      if (hedgePolicy && priority == HPRequestPriorityInteractive &&
+          [[request HTTPMethod] isEqual:@"GET"]) {
+        [self sendHedgedRequest:request
+                       priority:priority
+                        decoder:decoder
+                    traceRecord:traceRecord
+                    hedgePolicy:hedgePolicy
+                        success:success
+                        failure:failure];
+        return;
+      }
+      AFHTTPRequestOperation *op = [_networkClient HTTPRequestOperationWithRequest:request
+                                                                           decoder:decoder
+                                                                       traceRecord:traceRecord
+                                                                   completionQueue:NULL
+                                                                           success:success
+                                                                           failure:failure];
+      [_networkClient enqueueHTTPRequestOperation:op priority:priority];
+  }];
+}
+
+/**
+ * @return Name of the endpoint of the request if it is traced or watched for stalls, otherwise
+ *     nil. The trace record is given the name.
+ */
+- (NSString *)endpointOfRequest:(NSURLRequest *)request
+                    traceRecord:(HPTraceRecord *)traceRecord
+                       watchdog:(HPMainThreadWatchdog *)watchdog {
+  if (!traceRecord && !watchdog) {
+    return nil;
+  }
+  NSString *endpoint = [_networkClient endpointForPath:[[request URL] path]];
+  traceRecord.endpoint = endpoint;
+  return endpoint;
+}
+
+/**
+ * Runs a completion block on the current queue, timed by the watchdog if there is one.
+ */
+- (void)runCompletionBlock:(dispatch_block_t)block
+                     stage:(HPWatchdogStage)stage
+                  endpoint:(NSString *)endpoint
+               traceRecord:(HPTraceRecord *)traceRecord
+                  watchdog:(HPMainThreadWatchdog *)watchdog {
+  if (watchdog) {
+    [watchdog runBlock:block stage:stage endpoint:endpoint traceRecord:traceRecord];
   } else {
-    path = kHPConstantsHaikusPath;
-    NSMutableURLRequest *request = [_networkClient requestWithMethod:@"GET"
-                                                                path:path
-                                                          parameters:nil];
-    AFHTTPRequestOperation *op = [_networkClient HTTPRequestOperationWithRequest:request
-        success:^(AFHTTPRequestOperation *operation, id responseObject) {
-            NSArray *haikus = [HPHaiku haikuObjectsWithAttributes:responseObject];
-            completion(haikus, nil);
-        }
-        failure:^(AFHTTPRequestOperation *operation, NSError *error) {
-            completion(nil, error);
-        }];
-    [_networkClient enqueueHTTPRequestOperation:op];
+    block();
   }
 }
 
-- (void)signOutWithCompletion:(HPErrorCompletion)completion {
-  NSMutableURLRequest *request = [_networkClient requestWithMethod:@"POST"
-                                                              path:kHPConstantsSignoutPath
-                                                        parameters:nil];
+#pragma mark - Hedged requests
+
+/**
+ * Sends a GET request, and sends it once more if the first attempt has not answered within the
+ * delay of the |hedgePolicy|. The first response wins and the other attempt is cancelled. A
+ * failure only wins once no other attempt is running, so that a hedge can still succeed after
+ * the first attempt fails.
+ *
+ * @param success Block called once with the winning response.
+ * @param failure Block called once if every attempt failed.
+ */
+- (void)sendHedgedRequest:(NSMutableURLRequest *)request
+                 priority:(HPRequestPriority)priority
+                  decoder:(HPResponseDecoder)decoder
+              traceRecord:(HPTraceRecord *)traceRecord
+              hedgePolicy:(HPHedgePolicy *)hedgePolicy
+                  success:(HPOperationSuccess)success
+                  failure:(HPOperationFailure)failure {
+  HPHedgedCall *call = [[HPHedgedCall alloc] init];
+  call.startTime = CFAbsoluteTimeGetCurrent();
+  call.operations = [NSMutableArray array];
+  NSTimeInterval hedgeDelay = [hedgePolicy hedgeDelayForNewRequest];
+  [self sendAttemptOfHedgedCall:call
+                        request:request
+                       priority:priority
+                        decoder:decoder
+                    traceRecord:traceRecord
+                    hedgePolicy:hedgePolicy
+                        isHedge:NO
+                        success:success
+                        failure:failure];
+  if (hedgeDelay < 0) {
+    return;
+  }
+  dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(hedgeDelay * NSEC_PER_SEC)),
+                 dispatch_get_main_queue(), ^{
+      @synchronized(call) {
+        if (call.isFinished) {
+          return;
+        }
+      }
+      // While the breaker is open or probing, the network client would answer a hedge at once
+      // with a stale copy or an error instead of racing the attempt in flight.
+      NSString *endpoint = [_networkClient endpointForPath:[[request URL] path]];
+      HPCircuitBreaker *breaker = [_networkClient circuitBreakerForEndpoint:endpoint];
+      if ([_networkClient isCircuitBreakersEnabled] && breaker &&
+          breaker.state != HPCircuitStateClosed) {
+        return;
+      }
+      if (![hedgePolicy shouldSendHedge]) {
+        return;
+      }
+      [self sendAttemptOfHedgedCall:call
+                            request:request
+                           priority:priority
+                            decoder:decoder
+                        traceRecord:traceRecord
+                        hedgePolicy:hedgePolicy
+                            isHedge:YES
+                            success:success
+                            failure:failure];
+  });
+}
+
+/**
+ * Sends one attempt of a hedged call.
+ *
+ * @param isHedge YES for the second attempt.
+ */
+- (void)sendAttemptOfHedgedCall:(HPHedgedCall *)call
+                        request:(NSMutableURLRequest *)request
+                       priority:(HPRequestPriority)priority
+                        decoder:(HPResponseDecoder)decoder
+                    traceRecord:(HPTraceRecord *)traceRecord
+                    hedgePolicy:(HPHedgePolicy *)hedgePolicy
+                        isHedge:(BOOL)isHedge
+                        success:(HPOperationSuccess)success
+                        failure:(HPOperationFailure)failure {
+  // Count the attempt before creating it, since a request refused by a circuit breaker fails on
+  // the processing queue, possibly before this method returns.
+  @synchronized(call) {
+    call.runningCount++;
+  }
   AFHTTPRequestOperation *op = [_networkClient HTTPRequestOperationWithRequest:request
-      success:^(AFHTTPRequestOperation *operation, id responseObject) {
-          [self signOutDevice];
-          if (completion) {
-            completion(nil);
+      decoder:decoder
+      traceRecord:traceRecord
+      completionQueue:NULL
+      success:^(AFHTTPRequestOperation *operation, id decodedObject) {
+          NSArray *losers = nil;
+          @synchronized(call) {
+            if (call.isFinished) {
+              return;
+            }
+            call.isFinished = YES;
+            losers = [call.operations copy];
+            [call.operations removeAllObjects];
+          }
+          for (AFHTTPRequestOperation *loser in losers) {
+            if (loser != operation) {
+              [loser cancel];
+            }
           }
+          [hedgePolicy recordLatency:CFAbsoluteTimeGetCurrent() - call.startTime hedgeWin:isHedge];
+          success(operation, decodedObject);
       }
       failure:^(AFHTTPRequestOperation *operation, NSError *error) {
-          if (completion) {
-            completion(error);
+          @synchronized(call) {
+            call.runningCount--;
+            if (call.isFinished || call.runningCount > 0) {
+              return;
+            }
+            call.isFinished = YES;
+            [call.operations removeAllObjects];
           }
+          failure(operation, error);
       }];
-  [_networkClient enqueueHTTPRequestOperation:op];
+  @synchronized(call) {
+    if (op) {
+      [call.operations addObject:op];
+    }
+  }
+  [_networkClient enqueueHTTPRequestOperation:op priority:priority];
 }
 
-- (void)disconnectWithCompletion:(HPErrorCompletion)completion {
-  NSMutableURLRequest *request = [_networkClient requestWithMethod:@"POST"
-                                                              path:kHPConstantsDisconnectPath
-                                                        parameters:nil];
+/**
+ * Adds the user's authorization to a request if necessary.
+ *
+ * @param request The request to send to the Haiku+ server.
+ * @param authorize YES if the request must carry the user's authorization.
+ * @param completion Block that takes an error which is nil when the request can be sent.
+ */
+- (void)authorizeRequest:(NSMutableURLRequest *)request
+               authorize:(BOOL)authorize
+              completion:(void (^)(NSError *error))completion {
+  if (!authorize) {
+    completion(nil);
+    return;
+  }
   if (!_auth) {
     completion([self authorizationError]);
     return;
   }
-  [_auth authorizeRequest:request completionHandler:^(NSError *error) {
-    if (error != nil) {
-      completion(error);
-    } else {
-      AFHTTPRequestOperation *op = [_networkClient HTTPRequestOperationWithRequest:request
-          success:^(AFHTTPRequestOperation *operation, id responseObject) {
-              [self signOutDevice];
-              completion(nil);
+  CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+  if ([self isAccessTokenValid] && [_auth authorizeRequest:request]) {
+    // The common case: the token is applied without waiting.
+    _synchronousAuthorizationCount++;
+    [self didAuthorizeRequest:request startTime:startTime synchronously:YES];
+    completion(nil);
+    return;
+  }
+  // GTMOAuth2Authentication refreshes the token first.
+  _deferredAuthorizationCount++;
+  GTMOAuth2Authentication *auth = _auth;
+  [auth authorizeRequest:request completionHandler:^(NSError *error) {
+    if (!error) {
+      [self didAuthorizeRequest:request startTime:startTime synchronously:NO];
+      if (auth == _auth) {
+        [self scheduleTokenRefresh];
+      }
+    }
+    completion(error);
+  }];
+}
+
+/**
+ * Reports how long a request waited for authorization.
+ */
+- (void)didAuthorizeRequest:(NSURLRequest *)request
+                  startTime:(CFAbsoluteTime)startTime
+              synchronously:(BOOL)isSynchronous {
+  NSTimeInterval waitTime = CFAbsoluteTimeGetCurrent() - startTime;
+  _totalAuthorizationWaitTime += waitTime;
+  _maxAuthorizationWaitTime = MAX(_maxAuthorizationWaitTime, waitTime);
+  if (_authorizationWaitHandler) {
+    _authorizationWaitHandler(request, waitTime, isSynchronous);
+  }
+}
+
+#pragma mark - Token refresh
+
+/**
+ * @return YES if the access token stays valid long enough to be applied without a refresh.
+ */
+- (BOOL)isAccessTokenValid {
+  NSDate *expirationDate = [_auth expirationDate];
+  return [_auth accessToken] && expirationDate &&
+      [expirationDate timeIntervalSinceNow] > kHPCommunicatorTokenValidityMargin;
+}
+
+/**
+ * Schedules a background refresh |tokenRefreshLeadTime| before the access token expires,
+ * replacing any refresh scheduled earlier. A token that is already close to expiry is refreshed
+ * right away.
+ */
+- (void)scheduleTokenRefresh {
+  _tokenRefreshGeneration++;
+  NSDate *expirationDate = [_auth expirationDate];
+  if (!expirationDate || ![_auth refreshToken]) {
+    return;
+  }
+  NSTimeInterval delay = MAX([expirationDate timeIntervalSinceNow] - _tokenRefreshLeadTime, 0);
+  [self refreshTokenAfterDelay:delay];
+}
+
+- (void)refreshTokenAfterDelay:(NSTimeInterval)delay {
+  NSUInteger generation = _tokenRefreshGeneration;
+  __weak HPCommunicator *weakSelf = self;
+  dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                 dispatch_get_main_queue(), ^{
+      HPCommunicator *strongSelf = weakSelf;
+      if (strongSelf && generation == strongSelf->_tokenRefreshGeneration) {
+        [strongSelf refreshToken];
+      }
+  });
+}
+
+/**
+ * Fetches a new access token while the current one is still valid, so that requests keep being
+ * authorized right away.
+ */
+- (void)refreshToken {
+  if (_isRefreshingToken || ![_auth refreshToken]) {
+    return;
+  }
+  _isRefreshingToken = YES;
+  _tokenRefreshCount++;
+  [_auth beginTokenFetchWithDelegate:self
+                   didFinishSelector:@selector(auth:finishedRefreshWithFetcher:error:)];
+}
+
+/**
+ * Called by GTMOAuth2Authentication when a background refresh has finished.
+ */
+- (void)auth:(GTMOAuth2Authentication *)auth
+    finishedRefreshWithFetcher:(GTMHTTPFetcher *)fetcher
+                         error:(NSError *)error {
+  _isRefreshingToken = NO;
+  if (auth != _auth) {
+    return;
+  }
+  if (!error) {
+    [self scheduleTokenRefresh];
+  } else if ([self isAccessTokenValid]) {
+    // Requests still get the current token right away, so try again shortly.
+    _tokenRefreshGeneration++;
+    [self refreshTokenAfterDelay:kHPCommunicatorTokenRefreshRetryDelay];
+  }
+  // Otherwise the next request refreshes the token before it is sent.
+}
+
+#pragma mark - Request coalescing
+
+/**
+ * Authorized requests are keyed by user as well, so that a request made for one user never
+ * delivers another user's data.
+ *
+ * @param request The request to send.
+ * @param authorize YES if the request carries the user's authorization.
+ * @return Key that is equal for requests that must return the same result.
+ */
+- (NSString *)inFlightKeyForRequest:(NSURLRequest *)request authorize:(BOOL)authorize {
+  NSString *identity = @"";
+  if (authorize) {
+    identity = [_auth userID] ? [_auth userID] : [NSString stringWithFormat:@"%p", _auth];
+  }
+  return [NSString stringWithFormat:@"%@ %@ %@",
+             [request HTTPMethod], [[request URL] absoluteString], identity];
+}
+
+/**
+ * Registers a caller for the request with the key.
+ *
+ * @param completion Block called when the request finishes.
+ * @param key Key of the request.
+ * @return YES if the caller must send the request, or NO if an identical request is in flight.
+ */
+- (BOOL)addInFlightCompletion:(HPInFlightCompletion)completion forKey:(NSString *)key {
+  @synchronized(_inFlightCompletions) {
+    NSMutableArray *completions = [_inFlightCompletions objectForKey:key];
+    if (completions) {
+      [completions addObject:[completion copy]];
+      _coalescedRequestCount++;
+      return NO;
+    }
+    completions = [NSMutableArray arrayWithObject:[completion copy]];
+    [_inFlightCompletions setObject:completions forKey:key];
+    return YES;
+  }
+}
+
+/**
+ * Delivers the result of a request to every caller waiting for it. This is called on the network
+ * client's processing queue, while callers are added on the main queue.
+ *
+ * @param key Key of the request.
+ * @param object Result of the request, or nil.
+ * @param error Error from the request, or nil on success.
+ */
+- (void)finishInFlightRequestForKey:(NSString *)key object:(id)object error:(NSError *)error {
+  NSArray *completions;
+  @synchronized(_inFlightCompletions) {
+    completions = [_inFlightCompletions objectForKey:key];
+    // Callers that start the same request from a completion block must not join this one.
+    [_inFlightCompletions removeObjectForKey:key];
+  }
+  for (HPInFlightCompletion completion in completions) {
+    completion(object, error);
+  }
+}
+
+#pragma mark - Haiku+ API
+
+/**
+ * Fetch current user from Haiku+ API. Requires authenticated session.
+ *
+ * @param completion Block that takes a user object and an error which is nil on success.
+ */
+- (void)fetchCurrentUserWithCompletion:(HPUserCompletion)completion {
+  NSMutableURLRequest *request = [_networkClient requestWithMethod:@"GET"
+                                                              path:kHPConstantsUserPath
+                                                        parameters:nil];
+  [self enqueueRequest:request
+             authorize:YES
+              priority:HPRequestPriorityInteractive
+               decoder:^id(id responseObject) {
+                   return [[HPUser alloc] initWithAttributes:responseObject];
+               }
+       completionQueue:NULL
+               success:^(HPUser *user) {
+                   completion(user, nil);
+               }
+               failure:^(NSError *error) {
+                   completion(nil, error);
+               }];
+}
+
+- (void)fetchHaikusFiltered:(BOOL)isFilteringByFriends
+                 completion:(HPArrayCompletion)completion {
+  [self fetchHaikusFiltered:isFilteringByFriends completionQueue:NULL completion:completion];
+}
+
+- (void)fetchHaikusFiltered:(BOOL)isFilteringByFriends
+            completionQueue:(dispatch_queue_t)completionQueue
+                 completion:(HPArrayCompletion)completion {
+  NSDictionary *parameters = nil;
+  if (isFilteringByFriends) {
+    parameters = @{ kHPConstantsHaikusFilterParameter : kHPConstantsHaikusFilterCircles };
+  }
+  NSMutableURLRequest *request = [_networkClient requestWithMethod:@"GET"
+                                                              path:kHPConstantsHaikusPath
+                                                        parameters:parameters];
+  [self enqueueRequest:request
+             authorize:isFilteringByFriends
+              priority:HPRequestPriorityVisible
+               decoder:^id(id responseObject) {
+                   return [HPHaiku haikuObjectsWithAttributes:responseObject];
+               }
+       completionQueue:completionQueue
+               success:^(NSArray *haikus) {
+                   completion([self haikusWithUnconfirmedVotes:haikus], nil);
+               }
+               failure:^(NSError *error) {
+                   completion(nil, error);
+               }];
+}
+
+- (void)fetchHaikusFiltered:(BOOL)isFilteringByFriends
+                   pageSize:(NSUInteger)pageSize
+                     cursor:(NSString *)cursor
+                 completion:(HPPageCompletion)completion {
+  [self fetchHaikusFiltered:isFilteringByFriends
+                   pageSize:pageSize
+                     cursor:cursor
+            completionQueue:NULL
+                 completion:completion];
+}
+
+- (void)fetchHaikusFiltered:(BOOL)isFilteringByFriends
+                   pageSize:(NSUInteger)pageSize
+                     cursor:(NSString *)cursor
+            completionQueue:(dispatch_queue_t)completionQueue
+                 completion:(HPPageCompletion)completion {
+  NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+  [parameters setObject:[NSNumber numberWithUnsignedInteger:pageSize]
+                 forKey:kHPConstantsPageSizeParameter];
+  if (cursor) {
+    [parameters setObject:cursor forKey:kHPConstantsPageCursorParameter];
+  }
+  if (isFilteringByFriends) {
+    [parameters setObject:kHPConstantsHaikusFilterCircles
+                   forKey:kHPConstantsHaikusFilterParameter];
+  }
+  NSMutableURLRequest *request = [_networkClient requestWithMethod:@"GET"
+                                                              path:kHPConstantsHaikusPath
+                                                        parameters:parameters];
+
+  // Later pages are requested ahead of scrolling, so they must not delay what is on screen.
+  HPRequestPriority priority = cursor ? HPRequestPriorityPrefetch : HPRequestPriorityVisible;
+  // Only the first page of each feed is kept on disk.
+  NSString *snapshotKey = cursor ? nil : [self feedSnapshotKeyFiltered:isFilteringByFriends];
+  HPFeedCache *feedCache = snapshotKey ? _feedCache : nil;
+  dispatch_queue_t queue = completionQueue ? completionQueue : dispatch_get_main_queue();
+  HPMainThreadWatchdog *watchdog = _mainThreadWatchdog;
+  // Only read and written on |queue|.
+  __block BOOL hasReceivedServerPage = NO;
+  [feedCache readSnapshotForKey:snapshotKey completion:^(id responseObject) {
+      if (!responseObject) {
+        return;
+      }
+      dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+          HPHaikuPage *page = [HPHaikuPage pageWithResponseObject:responseObject];
+          page.cached = YES;
+          dispatch_async(queue, ^{
+              // The snapshot is useless once the server has answered, but it is still shown
+              // after a failed request so that the feed can be read offline.
+              if (page && !hasReceivedServerPage) {
+                dispatch_block_t deliver = ^{
+                    completion([self pageWithUnconfirmedVotes:page], nil);
+                };
+                [self runCompletionBlock:deliver
+                                   stage:HPWatchdogStageCachedDelivery
+                                endpoint:kHPConstantsHaikusEndpoint
+                             traceRecord:nil
+                                watchdog:watchdog];
+              }
+          });
+      });
+  }];
+  [self enqueueRequest:request
+             authorize:isFilteringByFriends
+              priority:priority
+               decoder:^id(id responseObject) {
+                   HPHaikuPage *page = [HPHaikuPage pageWithResponseObject:responseObject];
+                   if (page) {
+                     // A 304 response skips the decoder, and the stored snapshot is then still
+                     // the current one.
+                     [feedCache storeSnapshot:responseObject forKey:snapshotKey];
+                   }
+                   return page;
+               }
+       completionQueue:completionQueue
+               success:^(HPHaikuPage *page) {
+                   hasReceivedServerPage = YES;
+                   completion([self pageWithUnconfirmedVotes:page], nil);
+               }
+               failure:^(NSError *error) {
+                   completion(nil, error);
+               }];
+}
+
+- (void)streamHaikusFiltered:(BOOL)isFilteringByFriends
+                    pageSize:(NSUInteger)pageSize
+                      cursor:(NSString *)cursor
+             completionQueue:(dispatch_queue_t)completionQueue
+                       haiku:(HPHaikuStreamHandler)haikuHandler
+                  completion:(HPStreamCompletion)completion {
+  NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+  if (pageSize > 0) {
+    [parameters setObject:[NSNumber numberWithUnsignedInteger:pageSize]
+                   forKey:kHPConstantsPageSizeParameter];
+  }
+  if (cursor) {
+    [parameters setObject:cursor forKey:kHPConstantsPageCursorParameter];
+  }
+  if (isFilteringByFriends) {
+    [parameters setObject:kHPConstantsHaikusFilterCircles
+                   forKey:kHPConstantsHaikusFilterParameter];
+  }
+  NSMutableURLRequest *request = [_networkClient requestWithMethod:@"GET"
+                                                              path:kHPConstantsHaikusPath
+                                                        parameters:parameters];
+  HPRequestPriority priority = cursor ? HPRequestPriorityPrefetch : HPRequestPriorityVisible;
+  // Streams are not retried, because haikus already delivered would be delivered again.
+  if (_retryPolicy) {
+    [request setTimeoutInterval:_retryPolicy.attemptTimeout];
+  }
+  dispatch_queue_t queue = completionQueue ? completionQueue : dispatch_get_main_queue();
+  HPTraceBuffer *traceBuffer = _traceBuffer;
+  HPTraceRecord *traceRecord = [traceBuffer beginRecordWithRequest:request];
+  traceRecord.attemptCount = 1;
+  HPMainThreadWatchdog *watchdog = _mainThreadWatchdog;
+  NSString *endpoint = [self endpointOfRequest:request traceRecord:traceRecord watchdog:watchdog];
+  // Only read and written on |queue|.
+  __block NSUInteger haikuCount = 0;
+  void (^finish)(NSString *, NSError *) = ^(NSString *nextCursor, NSError *error) {
+      [traceRecord markStage:HPTraceStageDelivered];
+      dispatch_block_t deliver = ^{
+          completion(haikuCount, nextCursor, error);
+      };
+      [self runCompletionBlock:deliver
+                         stage:HPWatchdogStageDelivery
+                      endpoint:endpoint
+                   traceRecord:traceRecord
+                      watchdog:watchdog];
+      traceRecord.error = error;
+      [traceBuffer addRecord:traceRecord];
+  };
+  [self authorizeRequest:request authorize:isFilteringByFriends completion:^(NSError *error) {
+      if (error) {
+        dispatch_async(queue, ^{
+            finish(nil, error);
+        });
+        return;
+      }
+      [traceRecord markStage:HPTraceStageAuthorized];
+      AFHTTPRequestOperation *op = [_networkClient streamingRequestOperationWithRequest:request
+          itemsKey:kHPConstantsPageItemsKey
+          elementDecoder:^id(id attributes) {
+              return [[HPHaiku alloc] initWithAttributes:attributes];
+          }
+          completionQueue:queue
+          element:^(HPHaiku *haiku) {
+              haikuCount++;
+              dispatch_block_t deliver = ^{
+                  haikuHandler([self haikuWithUnconfirmedVotes:haiku]);
+              };
+              [self runCompletionBlock:deliver
+                                 stage:HPWatchdogStageStreamElement
+                              endpoint:endpoint
+                           traceRecord:traceRecord
+                              watchdog:watchdog];
+          }
+          success:^(AFHTTPRequestOperation *operation, id envelope) {
+              // A plain array is a single, final page.
+              NSString *nextCursor = nil;
+              if ([envelope isKindOfClass:[NSDictionary class]]) {
+                nextCursor = [envelope objectForKey:kHPConstantsPageNextCursorKey];
+                if (![nextCursor isKindOfClass:[NSString class]] || [nextCursor length] == 0) {
+                  nextCursor = nil;
+                }
+              }
+              finish(nextCursor, nil);
           }
           failure:^(AFHTTPRequestOperation *operation, NSError *error) {
-              completion(error);
+              finish(nil, error);
           }];
-      [_networkClient enqueueHTTPRequestOperation:op];
-    }
+      [_networkClient enqueueHTTPRequestOperation:op priority:priority];
   }];
 }
 
+/**
+ * @param isFilteringByFriends Which feed the snapshot holds.
+ * @return Key of the on-disk snapshot for the first page of the feed.
+ */
+- (NSString *)feedSnapshotKeyFiltered:(BOOL)isFilteringByFriends {
+  return isFilteringByFriends ? @"haikus-circles" : @"haikus-everyone";
+}
+
+- (void)signOutWithCompletion:(HPErrorCompletion)completion {
+  NSMutableURLRequest *request = [_networkClient requestWithMethod:@"POST"
+                                                              path:kHPConstantsSignoutPath
+                                                        parameters:nil];
+  [self enqueueRequest:request
+             authorize:NO
+              priority:HPRequestPriorityInteractive
+               decoder:nil
+       completionQueue:NULL
+               success:^(id responseObject) {
+                   [self signOutDevice];
+                   [self discardJournaledWrites];
+                   if (completion) {
+                     completion(nil);
+                   }
+               }
+               failure:^(NSError *error) {
+                   if (completion) {
+                     completion(error);
+                   }
+               }];
+}
+
+- (void)disconnectWithCompletion:(HPErrorCompletion)completion {
+  NSMutableURLRequest *request = [_networkClient requestWithMethod:@"POST"
+                                                              path:kHPConstantsDisconnectPath
+                                                        parameters:nil];
+  [self enqueueRequest:request
+             authorize:YES
+              priority:HPRequestPriorityInteractive
+               decoder:nil
+       completionQueue:NULL
+               success:^(id responseObject) {
+                   [self signOutDevice];
+                   [self discardJournaledWrites];
+                   completion(nil);
+               }
+               failure:^(NSError *error) {
+                   completion(error);
+               }];
+}
+
+- (void)fetchHaikuWithID:(NSString *)haikuID
+              completion:(HPHaikuCompletion)completion {
+  [self fetchHaikuWithID:haikuID completionQueue:NULL completion:completion];
+}
+
 - (void)fetchHaikuWithID:(NSString *)haikuID
+         completionQueue:(dispatch_queue_t)completionQueue
               completion:(HPHaikuCompletion)completion {
   NSString *path = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, haikuID];
   NSMutableURLRequest *request = [_networkClient requestWithMethod:@"GET"
                                                               path:path
                                                         parameters:nil];
-  AFHTTPRequestOperation *op = [_networkClient HTTPRequestOperationWithRequest:request
-      success:^(AFHTTPRequestOperation *operation, id responseObject) {
-          HPHaiku *haiku = [[HPHaiku alloc] initWithAttributes:responseObject];
-          completion(haiku, nil);
-      }
-      failure:^(AFHTTPRequestOperation *operation, NSError *error) {
-          completion(nil, error);
-      }];
-  [_networkClient enqueueHTTPRequestOperation:op];
+  [self enqueueRequest:request
+             authorize:NO
+              priority:HPRequestPriorityInteractive
+               decoder:^id(id responseObject) {
+                   return [[HPHaiku alloc] initWithAttributes:responseObject];
+               }
+       completionQueue:completionQueue
+               success:^(HPHaiku *haiku) {
+                   completion([self haikuWithUnconfirmedVotes:haiku], nil);
+               }
+               failure:^(NSError *error) {
+                   completion(nil, error);
+               }];
 }
 
 - (void)voteForHaikuWithID:(NSString *)haikuID
@@ -308,71 +1103,410 @@
   NSMutableURLRequest *request = [_networkClient requestWithMethod:@"POST"
                                                               path:path
                                                         parameters:nil];
-  if (!_auth) {
-    completion([self authorizationError]);
-    return;
-  }
-  [_auth authorizeRequest:request completionHandler:^(NSError *error) {
-    if (error != nil) {
-      completion(error);
-    } else {
-      AFHTTPRequestOperation *op = [_networkClient HTTPRequestOperationWithRequest:request
-          success:^(AFHTTPRequestOperation *operation, id responseObject) {
-              completion(nil);
-          }
-          failure:^(AFHTTPRequestOperation *operation, NSError *error) {
-              completion(error);
-          }];
-      [_networkClient enqueueHTTPRequestOperation:op];
-    }
-  }];
+  [self enqueueRequest:request
+             authorize:YES
+              priority:HPRequestPriorityInteractive
+               decoder:nil
+       completionQueue:NULL
+               success:^(id responseObject) {
+                   completion(nil);
+               }
+               failure:^(NSError *error) {
+                   completion(error);
+               }];
+}
+
+- (void)createHaiku:(HPHaiku *)haiku
+         completion:(HPHaikuCompletion)completion {
+  [self createHaiku:haiku completionQueue:NULL completion:completion];
 }
 
 - (void)createHaiku:(HPHaiku *)haiku
+    completionQueue:(dispatch_queue_t)completionQueue
          completion:(HPHaikuCompletion)completion {
   NSDictionary *haikuAttributes = [haiku attributesDictionary];
 
   NSMutableURLRequest *request = [_networkClient requestWithMethod:@"POST"
                                                               path:kHPConstantsHaikusPath
                                                         parameters:haikuAttributes];
-  if (!_auth) {
-    completion(nil, [self authorizationError]);
+  [self enqueueRequest:request
+             authorize:YES
+              priority:HPRequestPriorityInteractive
+               decoder:^id(id responseObject) {
+                   return [[HPHaiku alloc] initWithAttributes:responseObject];
+               }
+       completionQueue:completionQueue
+               success:^(HPHaiku *createdHaiku) {
+                   completion(createdHaiku, nil);
+               }
+               failure:^(NSError *error) {
+                   completion(nil, error);
+               }];
+}
+
+- (HPImageLoadToken *)fetchImageWithURL:(NSURL *)url completion:(HPImageCompletion)completion {
+  return [_imagePipeline loadImageWithURL:url completion:completion];
+}
+
+#pragma mark - Journaled writes
+
+- (HPWriteEntry *)voteForHaikuWithID:(NSString *)haikuID status:(HPWriteStatusHandler)status {
+  HPWriteEntry *entry = [[HPWriteEntry alloc] initWithKind:HPWriteKindVote
+                                                   haikuID:haikuID
+                                                attributes:nil
+                                                    userID:self.currentUser.identifier];
+  [self addWriteEntry:entry status:status];
+  return entry;
+}
+
+- (HPWriteEntry *)voteForHaiku:(HPHaiku *)haiku status:(HPWriteStatusHandler)status {
+  NSString *haikuID = haiku.identifier;
+  [self addUnconfirmedVotes:1 forHaikuID:haikuID];
+  [self postVotesChange:1 forHaikuID:haikuID];
+  return [self voteForHaikuWithID:haikuID
+                           status:^(HPWriteEntry *entry, HPWriteStatus writeStatus, id result,
+                                    NSError *error) {
+      if (writeStatus == HPWriteStatusSucceeded || writeStatus == HPWriteStatusFailed) {
+        [self addUnconfirmedVotes:-1 forHaikuID:haikuID];
+      }
+      if (writeStatus == HPWriteStatusFailed) {
+        [self postVotesChange:-1 forHaikuID:haikuID];
+      }
+      if (status) {
+        status(entry, writeStatus, result, error);
+      }
+  }];
+}
+
+- (HPWriteEntry *)createHaiku:(HPHaiku *)haiku status:(HPWriteStatusHandler)status {
+  HPWriteEntry *entry = [[HPWriteEntry alloc] initWithKind:HPWriteKindCreateHaiku
+                                                   haikuID:nil
+                                                attributes:[haiku attributesDictionary]
+                                                    userID:self.currentUser.identifier];
+  [self addWriteEntry:entry status:status];
+  return entry;
+}
+
+/**
+ * Stores a write in the journal and sends it in turn, or sends it right away without a journal.
+ *
+ * @param entry The write.
+ * @param status Block called each time the write changes state, or nil.
+ */
+- (void)addWriteEntry:(HPWriteEntry *)entry status:(HPWriteStatusHandler)status {
+  if (status) {
+    HPWriteStatusReport report = ^(HPWriteStatus writeStatus, id result, NSError *error) {
+        status(entry, writeStatus, result, error);
+    };
+    [_writeStatusHandlers setObject:[report copy] forKey:entry.idempotencyKey];
+  }
+  [_newWriteKeys addObject:entry.idempotencyKey];
+  if (!_writeJournal) {
+    [self sendWriteEntry:entry completion:nil];
     return;
   }
-  [_auth authorizeRequest:request completionHandler:^(NSError *error) {
-    if (error != nil) {
-      completion(nil, error);
-    } else {
-      AFHTTPRequestOperation *op = [_networkClient HTTPRequestOperationWithRequest:request
-          success:^(AFHTTPRequestOperation *operation, id responseObject) {
-              HPHaiku *createdHaiku = [[HPHaiku alloc] initWithAttributes:responseObject];
-              completion(createdHaiku, nil);
+  [_writeJournal appendEntry:entry];
+  NSError *error = nil;
+  if ([_networkClient networkReachabilityStatus] == AFNetworkReachabilityStatusNotReachable) {
+    error = [NSError errorWithDomain:NSURLErrorDomain
+                                code:NSURLErrorNotConnectedToInternet
+                            userInfo:nil];
+  }
+  [self reportWriteEntry:entry status:HPWriteStatusPending result:nil error:error];
+  [self replayWriteJournal];
+}
+
+- (void)replayWriteJournal {
+  if (!_writeJournal || _isReplayingWrites ||
+      [_networkClient networkReachabilityStatus] == AFNetworkReachabilityStatusNotReachable) {
+    return;
+  }
+  _isReplayingWrites = YES;
+  HPWriteJournal *journal = _writeJournal;
+  [journal readEntriesWithLimit:MAX(journal.batchSize, 1) completion:^(NSArray *entries) {
+      // Writes of a user who is not signed in yet wait for didReceiveUser:error:.
+      HPWriteEntry *first = [entries firstObject];
+      if (!first || journal != _writeJournal || (first.userID && !self.currentUser)) {
+        _isReplayingWrites = NO;
+        return;
+      }
+      [self sendWriteEntries:entries fromIndex:0 completion:^(BOOL hasReachedServer) {
+          _isReplayingWrites = NO;
+          if (hasReachedServer) {
+            _failedWriteReplayCount = 0;
+            [self replayWriteJournal];
+          } else {
+            [self scheduleWriteJournalReplay];
           }
-          failure:^(AFHTTPRequestOperation *operation, NSError *error) {
-              completion(nil, error);
-          }];
-      [_networkClient enqueueHTTPRequestOperation:op];
-    }
+      }];
   }];
 }
 
-- (void)fetchImageWithURL:(NSURL *)url completion:(HPImageCompletion)completion {
-  void (^success)(NSURLRequest *, NSHTTPURLResponse *, UIImage *);
-  success = ^(NSURLRequest *request, NSHTTPURLResponse *response, UIImage *image) {
-      completion(image, nil);
-  };
-  void (^failure)(NSURLRequest *, NSHTTPURLResponse *, NSError *);
-  failure = ^(NSURLRequest *request, NSHTTPURLResponse *response, NSError *error) {
-      completion(nil, error);
+/**
+ * Sends writes one after another, so that the server receives them in journal order even when
+ * a write is retried, and stops at the first write that could not reach the server. Writes that
+ * another user made are dropped instead of being sent on behalf of the signed-in user.
+ *
+ * @param entries The writes.
+ * @param index Index of the next write to send.
+ * @param completion Block that takes NO if replay stopped at a write that must be sent again.
+ */
+- (void)sendWriteEntries:(NSArray *)entries
+               fromIndex:(NSUInteger)index
+              completion:(void (^)(BOOL hasReachedServer))completion {
+  if (index >= [entries count]) {
+    completion(YES);
+    return;
+  }
+  HPWriteEntry *entry = [entries objectAtIndex:index];
+  NSString *userID = self.currentUser.identifier;
+  if (entry.userID && !userID) {
+    // The user signed out during the replay.
+    completion(NO);
+    return;
+  }
+  if (entry.userID != userID && ![entry.userID isEqual:userID]) {
+    [_writeJournal removeEntry:entry];
+    [self reportWriteEntry:entry
+                    status:HPWriteStatusFailed
+                    result:nil
+                     error:[self authorizationError]];
+    [self sendWriteEntries:entries fromIndex:index + 1 completion:completion];
+    return;
+  }
+  [self sendWriteEntry:entry completion:^(BOOL isFinished) {
+      if (!isFinished) {
+        completion(NO);
+        return;
+      }
+      [self sendWriteEntries:entries fromIndex:index + 1 completion:completion];
+  }];
+}
+
+/**
+ * Replays the journal again after a backoff from the |retryPolicy| that grows with each replay
+ * in a row that could not reach the server. Without this, a write that failed while the device
+ * stayed online, such as on a 503, would wait for a change of reachability or for another write.
+ */
+- (void)scheduleWriteJournalReplay {
+  if (_isWriteReplayScheduled) {
+    return;
+  }
+  _isWriteReplayScheduled = YES;
+  _failedWriteReplayCount++;
+  HPRetryPolicy *retryPolicy = _retryPolicy ? _retryPolicy : [[HPRetryPolicy alloc] init];
+  NSTimeInterval delay = [retryPolicy backoffAfterAttemptCount:_failedWriteReplayCount];
+  dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                 dispatch_get_main_queue(), ^{
+      _isWriteReplayScheduled = NO;
+      [self replayWriteJournal];
+  });
+}
+
+/**
+ * Sends a write with its idempotency key, and removes it from the journal once the server has
+ * accepted or rejected it. The first attempt of a write the user just made is interactive; other
+ * writes are sent along with the visible requests.
+ *
+ * @param entry The write.
+ * @param completion Block that takes NO if the write must be sent again, or nil.
+ */
+- (void)sendWriteEntry:(HPWriteEntry *)entry completion:(void (^)(BOOL isFinished))completion {
+  NSMutableURLRequest *request = nil;
+  HPResponseDecoder decoder = nil;
+  switch (entry.kind) {
+    case HPWriteKindVote: {
+      NSString *path = [NSString stringWithFormat:kHPConstantsHaikuVoteFormatPath, entry.haikuID];
+      request = [_networkClient requestWithMethod:@"POST" path:path parameters:nil];
+      break;
+    }
+    case HPWriteKindCreateHaiku:
+      request = [_networkClient requestWithMethod:@"POST"
+                                             path:kHPConstantsHaikusPath
+                                       parameters:entry.attributes];
+      decoder = ^id(id responseObject) {
+          return [[HPHaiku alloc] initWithAttributes:responseObject];
+      };
+      break;
+  }
+  [request setValue:entry.idempotencyKey forHTTPHeaderField:kHPConstantsIdempotencyKeyHeader];
+  HPRequestPriority priority = HPRequestPriorityVisible;
+  if ([_newWriteKeys containsObject:entry.idempotencyKey]) {
+    [_newWriteKeys removeObject:entry.idempotencyKey];
+    priority = HPRequestPriorityInteractive;
+  }
+  [self reportWriteEntry:entry status:HPWriteStatusSending result:nil error:nil];
+  [self enqueueRequest:request
+             authorize:YES
+              priority:priority
+               decoder:decoder
+       completionQueue:NULL
+               success:^(id result) {
+                   [_writeJournal removeEntry:entry];
+                   [self reportWriteEntry:entry
+                                   status:HPWriteStatusSucceeded
+                                   result:result
+                                    error:nil];
+                   if (completion) {
+                     completion(YES);
+                   }
+               }
+               failure:^(NSError *error) {
+                   if (_writeJournal && [self isTransientWriteError:error]) {
+                     [self reportWriteEntry:entry
+                                     status:HPWriteStatusPending
+                                     result:nil
+                                      error:error];
+                     if (completion) {
+                       completion(NO);
+                     }
+                     return;
+                   }
+                   [_writeJournal removeEntry:entry];
+                   [self reportWriteEntry:entry status:HPWriteStatusFailed result:nil error:error];
+                   if (completion) {
+                     completion(YES);
+                   }
+               }];
+}
+
+/**
+ * @param error Error from authorization or from the server.
+ * @return YES if the write did not reach the server, or the server could not handle it for now,
+ *     so that sending it again later can succeed.
+ */
+- (BOOL)isTransientWriteError:(NSError *)error {
+  if ([[error domain] isEqual:kHPErrorDomain]) {
+    // The user is not signed in yet, or the endpoint is failing.
+    return [error code] == kHPErrorDomainUnauthorized ||
+        [error code] == kHPErrorDomainServiceUnavailable;
+  }
+  return [HPRetryPolicy isTransientError:error response:nil];
+}
+
+/**
+ * Calls the status handler of a write, and forgets it once the write has finished.
+ */
+- (void)reportWriteEntry:(HPWriteEntry *)entry
+                  status:(HPWriteStatus)status
+                  result:(id)result
+                   error:(NSError *)error {
+  NSString *key = entry.idempotencyKey;
+  HPWriteStatusReport report = [_writeStatusHandlers objectForKey:key];
+  if (status == HPWriteStatusSucceeded || status == HPWriteStatusFailed) {
+    [_writeStatusHandlers removeObjectForKey:key];
+  }
+  if (report) {
+    report(status, result, error);
+  }
+}
+
+#pragma mark - Optimistic votes
+
+/**
+ * Tells every screen that the vote count of a haiku changed locally.
+ */
+- (void)postVotesChange:(NSInteger)delta forHaikuID:(NSString *)haikuID {
+  if (!haikuID) {
+    return;
+  }
+  NSDictionary *userInfo = @{
+    kHPConstantsHaikuIDKey : haikuID,
+    kHPConstantsHaikuVotesDeltaKey : @(delta)
   };
+  NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+  [center postNotificationName:kHPConstantsHaikuVotesDidChangeNotification
+                        object:self
+                      userInfo:userInfo];
+}
+
+- (void)addUnconfirmedVotes:(NSInteger)count forHaikuID:(NSString *)haikuID {
+  if (!haikuID) {
+    return;
+  }
+  @synchronized(_unconfirmedVotes) {
+    NSInteger total = [[_unconfirmedVotes objectForKey:haikuID] integerValue] + count;
+    if (total > 0) {
+      [_unconfirmedVotes setObject:@(total) forKey:haikuID];
+    } else {
+      [_unconfirmedVotes removeObjectForKey:haikuID];
+    }
+  }
+}
 
-  NSURLRequest *request = [NSURLRequest requestWithURL:url];
-  AFImageRequestOperation *operation;
-  operation = [AFImageRequestOperation imageRequestOperationWithRequest:request
-                                                   imageProcessingBlock:nil
-                                                                success:success
-                                                                failure:failure];
-  [operation start];
+/**
+ * Counts the votes the server has not confirmed yet in haikus about to be delivered, so that a
+ * response that raced with a vote does not undo it on screen. Decoded haikus may be kept by the
+ * network client and delivered again for a 304 response or while a circuit is open, so each
+ * haiku with unconfirmed votes is replaced by a copy. Can be called on any queue.
+ *
+ * @param haikus Haiku objects as decoded from a response.
+ * @return |haikus|, or a new array when a vote is still unconfirmed.
+ */
+- (NSArray *)haikusWithUnconfirmedVotes:(NSArray *)haikus {
+  @synchronized(_unconfirmedVotes) {
+    if ([_unconfirmedVotes count] == 0 || [haikus count] == 0) {
+      return haikus;
+    }
+    NSMutableArray *counted = nil;
+    for (NSUInteger index = 0; index < [haikus count]; index++) {
+      HPHaiku *haiku = [haikus objectAtIndex:index];
+      NSNumber *count = haiku.identifier ? [_unconfirmedVotes objectForKey:haiku.identifier] : nil;
+      if (!count) {
+        continue;
+      }
+      if (!counted) {
+        counted = [haikus mutableCopy];
+      }
+      [counted replaceObjectAtIndex:index
+                         withObject:[haiku haikuByChangingVotesBy:[count integerValue]]];
+    }
+    return counted ? counted : haikus;
+  }
+}
+
+/**
+ * @param haiku Haiku object as decoded from a response, or nil.
+ * @return |haiku|, or a copy that counts its unconfirmed votes.
+ */
+- (HPHaiku *)haikuWithUnconfirmedVotes:(HPHaiku *)haiku {
+  return haiku ? [[self haikusWithUnconfirmedVotes:@[ haiku ]] firstObject] : nil;
+}
+
+/**
+ * @param page Page as decoded from a response or read from the feed cache, or nil.
+ * @return |page|, or a new page whose haikus count their unconfirmed votes.
+ */
+- (HPHaikuPage *)pageWithUnconfirmedVotes:(HPHaikuPage *)page {
+  NSArray *haikus = [self haikusWithUnconfirmedVotes:page.haikus];
+  if (haikus == page.haikus) {
+    return page;
+  }
+  HPHaikuPage *counted = [[HPHaikuPage alloc] initWithHaikus:haikus nextCursor:page.nextCursor];
+  counted.cached = page.cached;
+  return counted;
+}
+
+/**
+ * Drops the writes waiting in the journal, which must not be sent on behalf of another user.
+ */
+- (void)discardJournaledWrites {
+  [_writeJournal removeAllEntries];
+  [_newWriteKeys removeAllObjects];
+  NSArray *reports = [_writeStatusHandlers allValues];
+  [_writeStatusHandlers removeAllObjects];
+  NSError *error = [self authorizationError];
+  for (HPWriteStatusReport report in reports) {
+    report(HPWriteStatusFailed, nil, error);
+  }
+}
+
+- (void)networkReachabilityDidChange:(NSNotification *)notification {
+  NSNumber *status =
+      [[notification userInfo] objectForKey:AFNetworkingReachabilityNotificationStatusItem];
+  if ([status integerValue] > AFNetworkReachabilityStatusNotReachable) {
+    [self replayWriteJournal];
+  }
 }
 
 @end
@@ -43,14 +43,14 @@ EXTERN NSString * const kHPConstantsUserAgent INITIALIZE_AS(@"Haiku+Client-iOS")
 EXTERN NSString * const kHPConstantsSessionCookieName INITIALIZE_AS(@"HaikuSessionId");
 
 /**
- * NSDateFormatter pattern for dates in API fields.
+ * NSDateFormatter pattern for dates in API fields. HPDateCodec parses and writes this pattern.
  */
 EXTERN NSString * const kHPConstantsAPIDateFormat INITIALIZE_AS(@"yyyy-MM-dd'T'HH:mm:ssZ");
 
 /**
- * NSDateFormatter pattern for dates visible to the user.
+ * NSDateFormatter pattern for dates visible to the user. HPDateCodec writes this pattern.
  */
-EXTERN NSString * const kHPConstantsVisibleDateFormat INITIALIZE_AS(@"YYYY-MM-dd");
+EXTERN NSString * const kHPConstantsVisibleDateFormat INITIALIZE_AS(@"yyyy-MM-dd");
 
 /**
  * API path constants.
@@ -61,9 +61,59 @@ EXTERN NSString * const kHPConstantsDisconnectPath INITIALIZE_AS(@"/api/disconne
 EXTERN NSString * const kHPConstantsHaikusPath INITIALIZE_AS(@"/api/haikus");
 EXTERN NSString * const kHPConstantsHaikuFormatPath INITIALIZE_AS(@"/api/haikus/%@");
 EXTERN NSString * const kHPConstantsHaikuVoteFormatPath INITIALIZE_AS(@"/api/haikus/%@/vote");
+EXTERN NSString * const kHPConstantsHaikusFilterParameter INITIALIZE_AS(@"filter");
+EXTERN NSString * const kHPConstantsHaikusFilterCircles INITIALIZE_AS(@"circles");
 EXTERN NSInteger const kHPConstantsFilterEveryoneIndex INITIALIZE_AS(0);
 EXTERN NSInteger const kHPConstantsFilterFriendsIndex INITIALIZE_AS(1);
 
+/**
+ * Names of the API endpoints that have their own circuit breaker in the HPNetworkClient.
+ */
+EXTERN NSString * const kHPConstantsUserEndpoint INITIALIZE_AS(@"user");
+EXTERN NSString * const kHPConstantsHaikusEndpoint INITIALIZE_AS(@"haikus");
+EXTERN NSString * const kHPConstantsHaikuEndpoint INITIALIZE_AS(@"haiku");
+EXTERN NSString * const kHPConstantsHaikuVoteEndpoint INITIALIZE_AS(@"vote");
+
+/**
+ * Feed pagination constants. A paged request sends the page size and the opaque cursor returned
+ * with the previous page. The server answers with a dictionary containing the page items and the
+ * cursor for the next page, which is missing on the last page.
+ */
+EXTERN NSString * const kHPConstantsPageSizeParameter INITIALIZE_AS(@"limit");
+EXTERN NSString * const kHPConstantsPageCursorParameter INITIALIZE_AS(@"cursor");
+EXTERN NSString * const kHPConstantsPageItemsKey INITIALIZE_AS(@"items");
+EXTERN NSString * const kHPConstantsPageNextCursorKey INITIALIZE_AS(@"next_cursor");
+EXTERN NSUInteger const kHPConstantsHaikusPageSize INITIALIZE_AS(50);
+
+/**
+ * Header carrying the idempotency key of a write, so that the server applies a write sent more
+ * than once only once.
+ */
+EXTERN NSString * const kHPConstantsIdempotencyKeyHeader INITIALIZE_AS(@"Idempotency-Key");
+
+/**
+ * Number of rows before the end of the loaded haikus at which the next page is requested.
+ */
+EXTERN NSUInteger const kHPConstantsHaikusPrefetchDistance INITIALIZE_AS(20);
+
+/**
+ * Largest number of changed rows that a refreshed list of haikus applies as table updates. Larger
+ * changes, such as switching filters, reload the table instead.
+ */
+EXTERN NSUInteger const kHPConstantsHaikusMaxRowUpdates INITIALIZE_AS(100);
+
+/**
+ * Notification posted by the HPCommunicator on the main queue when the vote count of a haiku
+ * changes locally: when a vote is applied before the server confirms it, and when a vote the
+ * server rejected is rolled back. The user info holds the ID of the haiku and the change as an
+ * NSNumber. Haiku objects are never changed, so screens showing the haiku replace it with a copy
+ * that has the new count.
+ */
+EXTERN NSString * const kHPConstantsHaikuVotesDidChangeNotification
+    INITIALIZE_AS(@"HPHaikuVotesDidChangeNotification");
+EXTERN NSString * const kHPConstantsHaikuIDKey INITIALIZE_AS(@"haiku_id");
+EXTERN NSString * const kHPConstantsHaikuVotesDeltaKey INITIALIZE_AS(@"votes_delta");
+
 /**
  * Error constants.
  */
@@ -71,7 +121,9 @@ EXTERN NSString * const kHPErrorDomain
     INITIALIZE_AS(@"com.google.plus.samples.HaikuPlus.HPErrorDomain");
 
 enum {
-  kHPErrorDomainUnauthorized
+  kHPErrorDomainUnauthorized,
+  // The circuit breaker of the endpoint is open, so the request was not sent.
+  kHPErrorDomainServiceUnavailable
 };
 
 EXTERN CGFloat kHPConstantsKeyboardOffset INITIALIZE_AS(-50);
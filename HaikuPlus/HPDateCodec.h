@@ -0,0 +1,59 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Hand-written parser and formatters for the date patterns in HPConstants.h. They replace
+ * NSDateFormatter on the decoding path: they need no formatter object or locale, allocate nothing
+ * but the resulting date or string, and can be called from any thread.
+ *
+ * Parsing accepts kHPConstantsAPIDateFormat ("yyyy-MM-dd'T'HH:mm:ssZ") with a zone of "Z",
+ * "+hhmm", "+hh:mm" or "+hh". Formatting writes the same pattern in UTC with a "+0000" zone.
+ */
+@interface HPDateCodec : NSObject
+
+/**
+ * @param string Timestamp from an API field.
+ * @return The date, or nil if the string is not a valid timestamp.
+ */
++ (NSDate *)dateFromAPIString:(NSString *)string;
+
+/**
+ * @param date Date to send in an API field, or nil.
+ * @return Timestamp in kHPConstantsAPIDateFormat, or nil for a nil date.
+ */
++ (NSString *)APIStringFromDate:(NSDate *)date;
+
+/**
+ * @param date Date to show to the user, or nil.
+ * @return Calendar date in the default time zone in kHPConstantsVisibleDateFormat, or nil for a
+ *     nil date.
+ */
++ (NSString *)visibleStringFromDate:(NSDate *)date;
+
+@end
+
+/**
+ * Parses an API timestamp from ASCII bytes, for callers that have not built an NSString.
+ *
+ * @param bytes Timestamp bytes, not necessarily NUL-terminated.
+ * @param length Number of bytes.
+ * @param interval Set to the number of seconds since 1970 on success.
+ * @return YES if the bytes are a valid timestamp.
+ */
+BOOL HPDateCodecParseAPITimestamp(const char *bytes, size_t length, NSTimeInterval *interval);
@@ -0,0 +1,229 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPDateCodec.h"
+
+/**
+ * Longest timestamp accepted: "yyyy-MM-ddTHH:mm:ss+hh:mm".
+ */
+static const size_t kHPDateCodecMaxLength = 25;
+
+static const int64_t kHPSecondsPerDay = 24 * 60 * 60;
+
+/**
+ * Reads a fixed number of decimal digits.
+ *
+ * @return The value, or -1 if a character is not a digit.
+ */
+static int HPReadDigits(const char *bytes, size_t count) {
+  int value = 0;
+  for (size_t i = 0; i < count; i++) {
+    char c = bytes[i];
+    if (c < '0' || c > '9') {
+      return -1;
+    }
+    value = value * 10 + (c - '0');
+  }
+  return value;
+}
+
+static BOOL HPIsLeapYear(int64_t year) {
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static int HPDaysInMonth(int64_t year, int month) {
+  static const int kDays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  return (month == 2 && HPIsLeapYear(year)) ? 29 : kDays[month - 1];
+}
+
+/**
+ * Converts a proleptic Gregorian date to days since 1970-01-01. See
+ * http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+ */
+static int64_t HPDaysFromCivil(int64_t year, int month, int day) {
+  year -= month <= 2;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int64_t yearOfEra = year - era * 400;
+  int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ * Converts days since 1970-01-01 to a proleptic Gregorian date. See
+ * http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+ */
+static void HPCivilFromDays(int64_t days, int64_t *year, int *month, int *day) {
+  days += 719468;
+  int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  int64_t dayOfEra = days - era * 146097;
+  int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+  *day = (int)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+  *month = (int)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+  *year = yearOfEra + era * 400 + (*month <= 2);
+}
+
+/**
+ * Splits a time interval into a calendar date and a time of day, after adding a zone offset.
+ */
+static void HPBreakDownInterval(NSTimeInterval interval, NSInteger offset, int64_t *year,
+                                int *month, int *day, int *secondOfDay) {
+  int64_t seconds = (int64_t)floor(interval) + offset;
+  int64_t days = seconds / kHPSecondsPerDay;
+  int64_t remainder = seconds % kHPSecondsPerDay;
+  if (remainder < 0) {
+    remainder += kHPSecondsPerDay;
+    days--;
+  }
+  HPCivilFromDays(days, year, month, day);
+  *secondOfDay = (int)remainder;
+}
+
+BOOL HPDateCodecParseAPITimestamp(const char *bytes, size_t length, NSTimeInterval *interval) {
+  // yyyy-MM-ddTHH:mm:ss is 19 bytes, and the shortest zone is "Z".
+  if (!bytes || length < 20 || length > kHPDateCodecMaxLength) {
+    return NO;
+  }
+  if (bytes[4] != '-' || bytes[7] != '-' || bytes[10] != 'T' ||
+      bytes[13] != ':' || bytes[16] != ':') {
+    return NO;
+  }
+  int year = HPReadDigits(bytes, 4);
+  int month = HPReadDigits(bytes + 5, 2);
+  int day = HPReadDigits(bytes + 8, 2);
+  int hour = HPReadDigits(bytes + 11, 2);
+  int minute = HPReadDigits(bytes + 14, 2);
+  int second = HPReadDigits(bytes + 17, 2);
+  if (year < 0 || month < 1 || month > 12 || day < 1 || day > HPDaysInMonth(year, month) ||
+      hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59) {
+    return NO;
+  }
+
+  const char *zone = bytes + 19;
+  size_t zoneLength = length - 19;
+  int offset = 0;
+  if (zoneLength == 1 && zone[0] == 'Z') {
+    offset = 0;
+  } else if (zone[0] == '+' || zone[0] == '-') {
+    int zoneHours = -1;
+    int zoneMinutes = 0;
+    if (zoneLength == 3) {
+      zoneHours = HPReadDigits(zone + 1, 2);
+    } else if (zoneLength == 5) {
+      zoneHours = HPReadDigits(zone + 1, 2);
+      zoneMinutes = HPReadDigits(zone + 3, 2);
+    } else if (zoneLength == 6 && zone[3] == ':') {
+      zoneHours = HPReadDigits(zone + 1, 2);
+      zoneMinutes = HPReadDigits(zone + 4, 2);
+    }
+    if (zoneHours < 0 || zoneHours > 23 || zoneMinutes < 0 || zoneMinutes > 59) {
+      return NO;
+    }
+    offset = (zoneHours * 60 + zoneMinutes) * 60;
+    if (zone[0] == '-') {
+      offset = -offset;
+    }
+  } else {
+    return NO;
+  }
+
+  int64_t days = HPDaysFromCivil(year, month, day);
+  int64_t seconds = days * kHPSecondsPerDay + hour * 3600 + minute * 60 + second - offset;
+  if (interval) {
+    *interval = (NSTimeInterval)seconds;
+  }
+  return YES;
+}
+
+/**
+ * Writes a number as a fixed number of decimal digits.
+ */
+static void HPWriteDigits(char *buffer, int64_t value, int count) {
+  for (int i = count - 1; i >= 0; i--) {
+    buffer[i] = (char)('0' + value % 10);
+    value /= 10;
+  }
+}
+
+@implementation HPDateCodec
+
++ (NSDate *)dateFromAPIString:(NSString *)string {
+  if (![string isKindOfClass:[NSString class]]) {
+    return nil;
+  }
+  // Most strings from NSJSONSerialization expose their bytes directly. Otherwise copy the
+  // characters to the stack.
+  const char *bytes = CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingASCII);
+  char buffer[kHPDateCodecMaxLength + 1];
+  if (!bytes) {
+    if (![string getCString:buffer maxLength:sizeof(buffer) encoding:NSASCIIStringEncoding]) {
+      return nil;
+    }
+    bytes = buffer;
+  }
+  NSTimeInterval interval;
+  if (!HPDateCodecParseAPITimestamp(bytes, strlen(bytes), &interval)) {
+    return nil;
+  }
+  return [NSDate dateWithTimeIntervalSince1970:interval];
+}
+
++ (NSString *)APIStringFromDate:(NSDate *)date {
+  if (!date) {
+    return nil;
+  }
+  int64_t year;
+  int month, day, secondOfDay;
+  HPBreakDownInterval([date timeIntervalSince1970], 0, &year, &month, &day, &secondOfDay);
+  if (year < 0 || year > 9999) {
+    return nil;
+  }
+  char buffer[] = "yyyy-MM-ddTHH:mm:ss+0000";
+  HPWriteDigits(buffer, year, 4);
+  HPWriteDigits(buffer + 5, month, 2);
+  HPWriteDigits(buffer + 8, day, 2);
+  HPWriteDigits(buffer + 11, secondOfDay / 3600, 2);
+  HPWriteDigits(buffer + 14, secondOfDay / 60 % 60, 2);
+  HPWriteDigits(buffer + 17, secondOfDay % 60, 2);
+  return [[NSString alloc] initWithBytes:buffer
+                                  length:sizeof(buffer) - 1
+                                encoding:NSASCIIStringEncoding];
+}
+
++ (NSString *)visibleStringFromDate:(NSDate *)date {
+  if (!date) {
+    return nil;
+  }
+  NSInteger offset = [[NSTimeZone defaultTimeZone] secondsFromGMTForDate:date];
+  int64_t year;
+  int month, day, secondOfDay;
+  HPBreakDownInterval([date timeIntervalSince1970], offset, &year, &month, &day, &secondOfDay);
+  if (year < 0 || year > 9999) {
+    return nil;
+  }
+  char buffer[] = "yyyy-MM-dd";
+  HPWriteDigits(buffer, year, 4);
+  HPWriteDigits(buffer + 5, month, 2);
+  HPWriteDigits(buffer + 8, day, 2);
+  return [[NSString alloc] initWithBytes:buffer
+                                  length:sizeof(buffer) - 1
+                                encoding:NSASCIIStringEncoding];
+}
+
+@end
@@ -0,0 +1,91 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Durable on-disk store for the last feed response received from the Haiku+ server. A snapshot
+ * is kept for each key, such as one for each feed filter, and is delivered to the app right away
+ * on launch while fresh data is fetched from the network.
+ *
+ * Snapshots are stored as the JSON response from the server. All disk access happens on a private
+ * serial queue, and completion blocks are called on the main queue.
+ */
+@interface HPFeedCache : NSObject
+
+/**
+ * Snapshots older than this are treated as misses and deleted. Defaults to one day.
+ */
+@property(nonatomic) NSTimeInterval maxAge;
+
+/**
+ * Maximum number of bytes used by all snapshots. The oldest snapshots are deleted to stay within
+ * the budget, and a snapshot larger than the budget is not stored. Defaults to 1 MB.
+ */
+@property(nonatomic) unsigned long long maxBytes;
+
+/**
+ * Number of reads that returned a snapshot.
+ */
+@property(nonatomic, readonly) NSUInteger hitCount;
+
+/**
+ * Number of reads that did not return a snapshot because it was missing, expired or unreadable.
+ */
+@property(nonatomic, readonly) NSUInteger missCount;
+
+/**
+ * @return Directory for snapshots inside the app's Caches directory.
+ */
++ (NSString *)defaultDirectory;
+
+/**
+ * @param directory Directory where snapshots are stored. It is created if necessary.
+ * @return Feed cache object.
+ */
+- (id)initWithDirectory:(NSString *)directory;
+
+/**
+ * Reads a snapshot in the background.
+ *
+ * @param key Snapshot key.
+ * @param completion Block called on the main queue with the stored response object, or nil on a
+ *     miss.
+ */
+- (void)readSnapshotForKey:(NSString *)key completion:(void (^)(id responseObject))completion;
+
+/**
+ * Replaces the snapshot for a key in the background.
+ *
+ * @param responseObject JSON response object from the server.
+ * @param key Snapshot key.
+ */
+- (void)storeSnapshot:(id)responseObject forKey:(NSString *)key;
+
+/**
+ * Deletes the snapshot for a key, for example when the data should not outlive the session.
+ *
+ * @param key Snapshot key.
+ */
+- (void)removeSnapshotForKey:(NSString *)key;
+
+/**
+ * Deletes all snapshots.
+ */
+- (void)removeAllSnapshots;
+
+@end
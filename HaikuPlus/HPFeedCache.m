@@ -0,0 +1,177 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPFeedCache.h"
+
+/**
+ * Default snapshot limits.
+ */
+static const NSTimeInterval kHPFeedCacheDefaultMaxAge = 24 * 60 * 60;
+static const unsigned long long kHPFeedCacheDefaultMaxBytes = 1024 * 1024;
+
+@implementation HPFeedCache {
+  NSString *_directory;
+  dispatch_queue_t _ioQueue;
+  NSFileManager *_fileManager;
+}
+
++ (NSString *)defaultDirectory {
+  NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+  return [[paths firstObject] stringByAppendingPathComponent:@"HPFeedCache"];
+}
+
+- (id)init {
+  return [self initWithDirectory:[[self class] defaultDirectory]];
+}
+
+- (id)initWithDirectory:(NSString *)directory {
+  self = [super init];
+  if (self) {
+    _directory = [directory copy];
+    _maxAge = kHPFeedCacheDefaultMaxAge;
+    _maxBytes = kHPFeedCacheDefaultMaxBytes;
+    _ioQueue = dispatch_queue_create("com.google.plus.samples.HaikuPlus.HPFeedCache",
+                                     DISPATCH_QUEUE_SERIAL);
+    _fileManager = [[NSFileManager alloc] init];
+    dispatch_async(_ioQueue, ^{
+        [_fileManager createDirectoryAtPath:_directory
+                withIntermediateDirectories:YES
+                                 attributes:nil
+                                      error:NULL];
+    });
+  }
+  return self;
+}
+
+- (NSString *)pathForKey:(NSString *)key {
+  return [_directory stringByAppendingPathComponent:[key stringByAppendingPathExtension:@"json"]];
+}
+
+#pragma mark - Reading
+
+- (void)readSnapshotForKey:(NSString *)key completion:(void (^)(id responseObject))completion {
+  NSString *path = [self pathForKey:key];
+  dispatch_async(_ioQueue, ^{
+      id responseObject = [self snapshotAtPath:path];
+      if (responseObject) {
+        _hitCount++;
+      } else {
+        _missCount++;
+      }
+      dispatch_async(dispatch_get_main_queue(), ^{
+          completion(responseObject);
+      });
+  });
+}
+
+/**
+ * Reads and parses a snapshot. Must be called on the I/O queue.
+ *
+ * @param path Snapshot path.
+ * @return The stored response object, or nil if the snapshot is missing, expired or unreadable.
+ */
+- (id)snapshotAtPath:(NSString *)path {
+  NSDictionary *attributes = [_fileManager attributesOfItemAtPath:path error:NULL];
+  if (!attributes) {
+    return nil;
+  }
+  NSTimeInterval age = -[[attributes fileModificationDate] timeIntervalSinceNow];
+  if (age > _maxAge) {
+    [_fileManager removeItemAtPath:path error:NULL];
+    return nil;
+  }
+  NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:NULL];
+  if (!data) {
+    return nil;
+  }
+  id responseObject = [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL];
+  if (!responseObject) {
+    // A corrupt snapshot would miss on every launch, so remove it.
+    [_fileManager removeItemAtPath:path error:NULL];
+  }
+  return responseObject;
+}
+
+#pragma mark - Writing
+
+- (void)storeSnapshot:(id)responseObject forKey:(NSString *)key {
+  if (!responseObject || ![NSJSONSerialization isValidJSONObject:responseObject]) {
+    return;
+  }
+  NSString *path = [self pathForKey:key];
+  dispatch_async(_ioQueue, ^{
+      NSData *data = [NSJSONSerialization dataWithJSONObject:responseObject options:0 error:NULL];
+      if (!data) {
+        return;
+      }
+      if ([data length] > _maxBytes) {
+        // Keeping an old snapshot would show outdated haikus, so drop it instead.
+        [_fileManager removeItemAtPath:path error:NULL];
+        return;
+      }
+      [_fileManager removeItemAtPath:path error:NULL];
+      [self trimToBytes:_maxBytes - [data length]];
+      [data writeToFile:path atomically:YES];
+  });
+}
+
+/**
+ * Deletes the oldest snapshots until the remaining snapshots fit in |bytes|. Must be called on
+ * the I/O queue.
+ *
+ * @param bytes Number of bytes the remaining snapshots may use.
+ */
+- (void)trimToBytes:(unsigned long long)bytes {
+  NSArray *names = [_fileManager contentsOfDirectoryAtPath:_directory error:NULL];
+  NSMutableArray *snapshots = [NSMutableArray arrayWithCapacity:[names count]];
+  unsigned long long totalBytes = 0;
+  for (NSString *name in names) {
+    NSString *path = [_directory stringByAppendingPathComponent:name];
+    NSDictionary *attributes = [_fileManager attributesOfItemAtPath:path error:NULL];
+    if (attributes) {
+      totalBytes += [attributes fileSize];
+      [snapshots addObject:@{ @"path" : path, @"attributes" : attributes }];
+    }
+  }
+  [snapshots sortUsingComparator:^NSComparisonResult(NSDictionary *a, NSDictionary *b) {
+      NSDate *dateA = [[a objectForKey:@"attributes"] fileModificationDate];
+      NSDate *dateB = [[b objectForKey:@"attributes"] fileModificationDate];
+      return [dateA compare:dateB];
+  }];
+  for (NSDictionary *snapshot in snapshots) {
+    if (totalBytes <= bytes) {
+      break;
+    }
+    [_fileManager removeItemAtPath:[snapshot objectForKey:@"path"] error:NULL];
+    totalBytes -= [[snapshot objectForKey:@"attributes"] fileSize];
+  }
+}
+
+- (void)removeSnapshotForKey:(NSString *)key {
+  NSString *path = [self pathForKey:key];
+  dispatch_async(_ioQueue, ^{
+      [_fileManager removeItemAtPath:path error:NULL];
+  });
+}
+
+- (void)removeAllSnapshots {
+  dispatch_async(_ioQueue, ^{
+      [self trimToBytes:0];
+  });
+}
+
+@end
@@ -42,4 +42,13 @@
  */
 + (NSArray *)haikuObjectsWithAttributes:(NSArray *)array;
 
+/**
+ * Haikus handed out by the HPCommunicator may be shared with the network client's cache, so a
+ * changed vote count is shown by replacing the haiku with a copy instead of changing it.
+ *
+ * @param delta Number of votes to add, or a negative number to remove.
+ * @return New haiku with the same attributes and the changed vote count.
+ */
+- (HPHaiku *)haikuByChangingVotesBy:(NSInteger)delta;
+
 @end
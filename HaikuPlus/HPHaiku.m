@@ -17,9 +17,6 @@
 
 #import "HPHaiku.h"
 
-#import <objc/runtime.h>
-
-#import "HPConstants.h"
 #import "HPUser.h"
 
 @implementation HPHaiku
@@ -34,41 +31,17 @@
   NSMutableArray *mutableArray = [NSMutableArray arrayWithCapacity:[array count]];
   for (NSDictionary *attributes in array) {
     HPHaiku *item = [[HPHaiku alloc] initWithAttributes:attributes];
-    [mutableArray addObject:item];
+    if (item) {
+      [mutableArray addObject:item];
+    }
   }
   return mutableArray;
 }
 
-- (void)setValue:(id)value forKey:(NSString *)key {
-  if ([key isEqual:@"creation_time"]) {
-    // "creation_time" is provided as a string, so we must convert it to an NSDate.
-    // The formatter works for a subset of ISO 8601.
-    NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
-    [dateFormatter setDateFormat:kHPConstantsAPIDateFormat];
-    _creation_time = [dateFormatter dateFromString:value];
-  } else if ([key isEqual:@"author"]) {
-    // "author" is passed as an NSDictionary, so we must construct the HPUser object manually.
-    _author = [[HPUser alloc] initWithAttributes:value];
-  } else {
-    [super setValue:value forKey:key];
-  }
-}
-
-/**
- * Called from - (NSDictionary *)attributesDictionary
- * through [self dictionaryWithValuesForKeys:propertyNames].
- */
-- (id)valueForKey:(NSString *)key {
-  if ([key isEqual:@"creation_time"]) {
-    NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
-    [dateFormatter setDateFormat:kHPConstantsAPIDateFormat];
-    NSString *creation_time = [dateFormatter stringFromDate:_creation_time];
-    return creation_time;
-  } else if ([key isEqual:@"author"]) {
-    return [_author attributesDictionary];
-  } else {
-    return [super valueForKey:key];
-  }
+- (HPHaiku *)haikuByChangingVotesBy:(NSInteger)delta {
+  HPHaiku *haiku = [[HPHaiku alloc] initWithAttributes:[self attributesDictionary]];
+  haiku.votes += delta;
+  return haiku;
 }
 
 @end
@@ -0,0 +1,133 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <UIKit/UIKit.h>
+
+@class HPHaiku;
+
+/**
+ * Frames of the views in a haiku row, in the coordinates of the row's content view.
+ */
+@interface HPHaikuRowLayout : NSObject
+
+@property(nonatomic, readonly) CGRect titleFrame;
+@property(nonatomic, readonly) CGRect lineOneFrame;
+@property(nonatomic, readonly) CGRect lineTwoFrame;
+@property(nonatomic, readonly) CGRect lineThreeFrame;
+@property(nonatomic, readonly) CGRect imageFrame;
+@property(nonatomic, readonly) CGRect authorFrame;
+@property(nonatomic, readonly) CGRect dateFrame;
+@property(nonatomic, readonly) CGRect votesFrame;
+
+/**
+ * Height of the row that fits every view.
+ */
+@property(nonatomic, readonly) CGFloat height;
+
+@end
+
+/**
+ * Measures haiku rows off the main thread and keeps the results so that row heights are lookups.
+ *
+ * Layouts are kept by haiku identifier, so a row height is a dictionary lookup. Each layout also
+ * keeps a hash of the text it was measured for, computed once on the private queue, so that a
+ * precomputation measures a haiku whose title, lines, author or date changed again. Precomputed
+ * layouts are only added when the caller shows the haikus they were measured for, so a shown row
+ * never gets the height of text it does not show yet. Every layout belongs to the current width
+ * and fonts; changing the width discards them.
+ *
+ * The cache must be used from the main queue. Text is measured on a private serial queue.
+ */
+@interface HPHaikuLayoutCache : NSObject
+
+/**
+ * Width of the row's content view. Setting a different width discards every layout and drops
+ * the results of precomputations still running for the old width.
+ */
+@property(nonatomic) CGFloat width;
+
+@property(nonatomic, readonly) UIFont *titleFont;
+@property(nonatomic, readonly) UIFont *lineFont;
+@property(nonatomic, readonly) UIFont *detailFont;
+
+/**
+ * Number of layouts in the cache.
+ */
+@property(nonatomic, readonly) NSUInteger layoutCount;
+
+/**
+ * Number of rows measured on the private queue.
+ */
+@property(nonatomic, readonly) NSUInteger backgroundMeasurementCount;
+
+/**
+ * Number of rows measured on the main queue because their layout was not precomputed.
+ */
+@property(nonatomic, readonly) NSUInteger mainThreadMeasurementCount;
+
+/**
+ * Uses the fonts of the haiku cell in the storyboard.
+ *
+ * @return Layout cache object.
+ */
+- (id)init;
+
+/**
+ * @param titleFont Font of the title label.
+ * @param lineFont Font of the three line labels.
+ * @param detailFont Font of the author, date and votes labels.
+ * @return Layout cache object.
+ */
+- (id)initWithTitleFont:(UIFont *)titleFont
+               lineFont:(UIFont *)lineFont
+             detailFont:(UIFont *)detailFont;
+
+/**
+ * Measures the rows of haikus that have no layout for their current text, on the private queue.
+ * Call it whenever haikus are received, before they are shown, so that changed text replaces the
+ * layout kept for its identifier.
+ *
+ * @param haikus HPHaiku objects that are about to be shown.
+ * @param completion Called on the main queue with the measured layouts, to be passed to
+ *     - (void)addLayouts: in the same main queue step that shows |haikus|.
+ */
+- (void)precomputeLayoutsForHaikus:(NSArray *)haikus
+                        completion:(void (^)(NSDictionary *layouts))completion;
+
+/**
+ * Adds precomputed layouts to the cache, replacing those kept for the same haikus. Layouts that
+ * were measured before the layouts were last discarded, such as for an old width, are dropped.
+ *
+ * @param layouts Layouts passed to the completion block of a precomputation.
+ */
+- (void)addLayouts:(NSDictionary *)layouts;
+
+/**
+ * Layout of a haiku row, looked up by identifier without reading the text. A haiku without a
+ * layout is measured on the calling thread and counted in mainThreadMeasurementCount.
+ *
+ * @param haiku Haiku shown in the row.
+ * @return Layout for the current width.
+ */
+- (HPHaikuRowLayout *)layoutForHaiku:(HPHaiku *)haiku;
+
+/**
+ * Discards every layout and drops the results of precomputations still running.
+ */
+- (void)removeAllLayouts;
+
+@end
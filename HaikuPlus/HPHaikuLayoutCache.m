@@ -0,0 +1,309 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPHaikuLayoutCache.h"
+
+#import "HPDateCodec.h"
+#import "HPHaiku.h"
+#import "HPUser.h"
+
+// Metrics of the haiku cell in the storyboard.
+static const CGFloat kHPHaikuLayoutTopMargin = 28;
+static const CGFloat kHPHaikuLayoutBottomMargin = 20;
+static const CGFloat kHPHaikuLayoutSideMargin = 20;
+static const CGFloat kHPHaikuLayoutTitleSpacing = 8;
+static const CGFloat kHPHaikuLayoutLineSpacing = 4;
+static const CGFloat kHPHaikuLayoutDetailSpacing = 2;
+static const CGFloat kHPHaikuLayoutImageSize = 46;
+
+static const uint64_t kHPHaikuLayoutHashOffsetBasis = 14695981039346656037ULL;
+static const uint64_t kHPHaikuLayoutHashPrime = 1099511628211ULL;
+
+/**
+ * Adds every UTF-16 unit of a string to a 64-bit FNV-1a hash. Unlike -[NSString hash], which
+ * only reads the ends of long strings, every character changes the result.
+ */
+static uint64_t HPHaikuLayoutHashString(uint64_t hash, NSString *string) {
+  unichar buffer[64];
+  NSUInteger length = [string length];
+  for (NSUInteger location = 0; location < length; location += 64) {
+    NSRange range = NSMakeRange(location, MIN((NSUInteger)64, length - location));
+    [string getCharacters:buffer range:range];
+    for (NSUInteger i = 0; i < range.length; i++) {
+      hash = (hash ^ buffer[i]) * kHPHaikuLayoutHashPrime;
+    }
+  }
+  // Separate fields, so that moving text from one field to the next changes the hash, and tell
+  // nil from the empty string.
+  hash = (hash ^ (string ? 0xFFFF : 0xFFFE)) * kHPHaikuLayoutHashPrime;
+  return hash;
+}
+
+/**
+ * @return Height of text wrapped to a width, or 0 for empty text.
+ */
+static CGFloat HPHaikuLayoutTextHeight(NSString *text, UIFont *font, CGFloat width) {
+  if ([text length] == 0) {
+    return 0;
+  }
+  CGRect rect = [text boundingRectWithSize:CGSizeMake(width, CGFLOAT_MAX)
+                                   options:NSStringDrawingUsesLineFragmentOrigin
+                                attributes:@{ NSFontAttributeName : font }
+                                   context:nil];
+  return ceil(CGRectGetHeight(rect));
+}
+
+@interface HPHaikuRowLayout ()
+
+@property(nonatomic) CGRect titleFrame;
+@property(nonatomic) CGRect lineOneFrame;
+@property(nonatomic) CGRect lineTwoFrame;
+@property(nonatomic) CGRect lineThreeFrame;
+@property(nonatomic) CGRect imageFrame;
+@property(nonatomic) CGRect authorFrame;
+@property(nonatomic) CGRect dateFrame;
+@property(nonatomic) CGRect votesFrame;
+@property(nonatomic) CGFloat height;
+// Hash of the text that was measured.
+@property(nonatomic) uint64_t contentHash;
+// Generation of the cache the layout was measured for.
+@property(nonatomic) NSUInteger generation;
+
+@end
+
+@implementation HPHaikuRowLayout
+@end
+
+/**
+ * Text of a haiku row, taken on the main queue so that it can be measured on another one.
+ */
+@interface HPHaikuLayoutContent : NSObject
+
+@property(nonatomic, strong) NSString *identifier;
+@property(nonatomic, strong) NSString *title;
+@property(nonatomic, strong) NSString *lineOne;
+@property(nonatomic, strong) NSString *lineTwo;
+@property(nonatomic, strong) NSString *lineThree;
+@property(nonatomic, strong) NSString *author;
+@property(nonatomic, strong) NSDate *date;
+
+- (id)initWithHaiku:(HPHaiku *)haiku;
+
+- (uint64_t)contentHash;
+
+@end
+
+@implementation HPHaikuLayoutContent
+
+- (id)initWithHaiku:(HPHaiku *)haiku {
+  self = [super init];
+  if (self) {
+    _identifier = haiku.identifier;
+    _title = [haiku.title copy];
+    _lineOne = [haiku.line_one copy];
+    _lineTwo = [haiku.line_two copy];
+    _lineThree = [haiku.line_three copy];
+    _author = [haiku.author.google_display_name copy];
+    _date = haiku.creation_time;
+  }
+  return self;
+}
+
+- (uint64_t)contentHash {
+  uint64_t hash = kHPHaikuLayoutHashOffsetBasis;
+  hash = HPHaikuLayoutHashString(hash, _title);
+  hash = HPHaikuLayoutHashString(hash, _lineOne);
+  hash = HPHaikuLayoutHashString(hash, _lineTwo);
+  hash = HPHaikuLayoutHashString(hash, _lineThree);
+  hash = HPHaikuLayoutHashString(hash, _author);
+  double time = [_date timeIntervalSinceReferenceDate];
+  uint64_t timeBits;
+  memcpy(&timeBits, &time, sizeof(timeBits));
+  return (hash ^ timeBits) * kHPHaikuLayoutHashPrime;
+}
+
+@end
+
+@implementation HPHaikuLayoutCache {
+  dispatch_queue_t _measureQueue;
+  // Map from haiku identifier to the HPHaikuRowLayout of its last measured text.
+  NSMutableDictionary *_layouts;
+  // Incremented whenever the layouts are discarded so that late precomputations are dropped.
+  NSUInteger _generation;
+}
+
+- (id)init {
+  return [self initWithTitleFont:[UIFont systemFontOfSize:36]
+                        lineFont:[UIFont systemFontOfSize:17]
+                      detailFont:[UIFont systemFontOfSize:12]];
+}
+
+- (id)initWithTitleFont:(UIFont *)titleFont
+               lineFont:(UIFont *)lineFont
+             detailFont:(UIFont *)detailFont {
+  self = [super init];
+  if (self) {
+    _titleFont = titleFont;
+    _lineFont = lineFont;
+    _detailFont = detailFont;
+    _layouts = [NSMutableDictionary dictionary];
+    _measureQueue =
+        dispatch_queue_create("com.google.plus.samples.HaikuPlus.HaikuLayout", NULL);
+  }
+  return self;
+}
+
+- (void)setWidth:(CGFloat)width {
+  if (width == _width) {
+    return;
+  }
+  _width = width;
+  [self removeAllLayouts];
+}
+
+- (NSUInteger)layoutCount {
+  return [_layouts count];
+}
+
+- (void)removeAllLayouts {
+  [_layouts removeAllObjects];
+  _generation++;
+}
+
+- (void)precomputeLayoutsForHaikus:(NSArray *)haikus
+                        completion:(void (^)(NSDictionary *layouts))completion {
+  NSMutableArray *contents = [NSMutableArray arrayWithCapacity:[haikus count]];
+  for (HPHaiku *haiku in haikus) {
+    if (haiku.identifier) {
+      [contents addObject:[[HPHaikuLayoutContent alloc] initWithHaiku:haiku]];
+    }
+  }
+  // The private queue reads a copy, so the cache can keep answering lookups meanwhile.
+  NSDictionary *knownLayouts = [_layouts copy];
+  NSUInteger generation = _generation;
+  CGFloat width = _width;
+  dispatch_async(_measureQueue, ^{
+      NSMutableDictionary *measuredLayouts = [NSMutableDictionary dictionary];
+      for (HPHaikuLayoutContent *content in contents) {
+        uint64_t contentHash = [content contentHash];
+        HPHaikuRowLayout *known = [knownLayouts objectForKey:content.identifier];
+        if (known && known.contentHash == contentHash) {
+          continue;
+        }
+        HPHaikuRowLayout *layout = [self layoutForContent:content
+                                              contentHash:contentHash
+                                                    width:width];
+        layout.generation = generation;
+        [measuredLayouts setObject:layout forKey:content.identifier];
+      }
+      dispatch_async(dispatch_get_main_queue(), ^{
+          _backgroundMeasurementCount += [measuredLayouts count];
+          if (completion) {
+            completion(measuredLayouts);
+          }
+      });
+  });
+}
+
+- (HPHaikuRowLayout *)layoutForHaiku:(HPHaiku *)haiku {
+  NSString *identifier = haiku.identifier;
+  HPHaikuRowLayout *layout = identifier ? [_layouts objectForKey:identifier] : nil;
+  if (layout) {
+    return layout;
+  }
+  HPHaikuLayoutContent *content = [[HPHaikuLayoutContent alloc] initWithHaiku:haiku];
+  layout = [self layoutForContent:content contentHash:[content contentHash] width:_width];
+  layout.generation = _generation;
+  _mainThreadMeasurementCount++;
+  if (identifier) {
+    [_layouts setObject:layout forKey:identifier];
+  }
+  return layout;
+}
+
+- (void)addLayouts:(NSDictionary *)layouts {
+  [layouts enumerateKeysAndObjectsUsingBlock:^(NSString *identifier, HPHaikuRowLayout *layout,
+                                               BOOL *stop) {
+      if (layout.generation == _generation) {
+        [_layouts setObject:layout forKey:identifier];
+      }
+  }];
+}
+
+#pragma mark - Private methods
+
+/**
+ * Stacks the title, the three lines, the author image and the details of a haiku from the top
+ * of the row, each centered and wrapped to the width between the side margins.
+ *
+ * @param content Text of the row.
+ * @param contentHash Hash of the text, stored in the layout.
+ * @param width Width of the row's content view.
+ * @return Row layout.
+ */
+- (HPHaikuRowLayout *)layoutForContent:(HPHaikuLayoutContent *)content
+                           contentHash:(uint64_t)contentHash
+                                 width:(CGFloat)width {
+  HPHaikuRowLayout *layout = [[HPHaikuRowLayout alloc] init];
+  layout.contentHash = contentHash;
+  CGFloat textWidth = MAX(width - 2 * kHPHaikuLayoutSideMargin, 1);
+  CGFloat y = kHPHaikuLayoutTopMargin;
+
+  CGFloat height = HPHaikuLayoutTextHeight(content.title, _titleFont, textWidth);
+  layout.titleFrame = CGRectMake(kHPHaikuLayoutSideMargin, y, textWidth, height);
+  y += height + kHPHaikuLayoutTitleSpacing;
+
+  CGRect lineFrames[3];
+  NSString *lines[3] = { content.lineOne, content.lineTwo, content.lineThree };
+  for (int i = 0; i < 3; i++) {
+    height = HPHaikuLayoutTextHeight(lines[i], _lineFont, textWidth);
+    lineFrames[i] = CGRectMake(kHPHaikuLayoutSideMargin, y, textWidth, height);
+    if (height > 0) {
+      y += height + kHPHaikuLayoutLineSpacing;
+    }
+  }
+  layout.lineOneFrame = lineFrames[0];
+  layout.lineTwoFrame = lineFrames[1];
+  layout.lineThreeFrame = lineFrames[2];
+
+  layout.imageFrame = CGRectMake(floor((width - kHPHaikuLayoutImageSize) / 2), y,
+                                 kHPHaikuLayoutImageSize, kHPHaikuLayoutImageSize);
+  y += kHPHaikuLayoutImageSize + kHPHaikuLayoutTitleSpacing;
+
+  // Same text as the labels of the haiku cell.
+  NSString *author = [NSString stringWithFormat:@"By %@", content.author];
+  height = HPHaikuLayoutTextHeight(author, _detailFont, textWidth);
+  layout.authorFrame = CGRectMake(kHPHaikuLayoutSideMargin, y, textWidth, height);
+  y += height + kHPHaikuLayoutDetailSpacing;
+
+  NSString *date = [HPDateCodec visibleStringFromDate:content.date];
+  height = HPHaikuLayoutTextHeight(date, _detailFont, textWidth);
+  layout.dateFrame = CGRectMake(kHPHaikuLayoutSideMargin, y, textWidth, height);
+  if (height > 0) {
+    y += height + kHPHaikuLayoutDetailSpacing;
+  }
+
+  // The vote count changes without a new layout, so its label always has one line.
+  height = ceil(_detailFont.lineHeight);
+  layout.votesFrame = CGRectMake(kHPHaikuLayoutSideMargin, y, textWidth, height);
+  y += height + kHPHaikuLayoutBottomMargin;
+
+  layout.height = ceil(y);
+  return layout;
+}
+
+@end
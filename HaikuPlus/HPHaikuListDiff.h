@@ -0,0 +1,72 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Changes that turn one list of haikus into another, in the form UITableView batch updates take.
+ *
+ * Haikus are matched by identifier. A matched haiku is moved only when it leaves the longest run
+ * of matched haikus that keep their order, so moving one haiku reports one move. A moved haiku
+ * whose shown content changed is reported as a deletion and an insertion, since a table cannot
+ * move and reload the same row in one batch. Haikus without an identifier, and repeats of an
+ * identifier, are never matched.
+ *
+ * Computing a diff takes O(n log n) time and does not touch UIKit, so it can run on any queue.
+ */
+@interface HPHaikuListDiff : NSObject
+
+/**
+ * Indexes in the old list of the haikus to delete.
+ */
+@property(nonatomic, readonly) NSIndexSet *deletedIndexes;
+
+/**
+ * Indexes in the new list of the haikus to insert.
+ */
+@property(nonatomic, readonly) NSIndexSet *insertedIndexes;
+
+/**
+ * Indexes in the old list of the haikus that stay in place but show different content.
+ */
+@property(nonatomic, readonly) NSIndexSet *updatedIndexes;
+
+/**
+ * Number of haikus moved from one index to another.
+ */
+@property(nonatomic, readonly) NSUInteger moveCount;
+
+/**
+ * Number of deleted, inserted, updated and moved haikus.
+ */
+@property(nonatomic, readonly) NSUInteger changeCount;
+
+/**
+ * @param oldHaikus HPHaiku objects shown now.
+ * @param newHaikus HPHaiku objects to show instead.
+ * @return Diff from the old list to the new one.
+ */
++ (HPHaikuListDiff *)diffFromHaikus:(NSArray *)oldHaikus toHaikus:(NSArray *)newHaikus;
+
+/**
+ * Calls a block for every move, in the order of the new list.
+ *
+ * @param block Called with the index of the haiku in the old list and in the new list.
+ */
+- (void)enumerateMovesUsingBlock:(void (^)(NSUInteger fromIndex, NSUInteger toIndex))block;
+
+@end
@@ -0,0 +1,195 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPHaikuListDiff.h"
+
+#import "HPHaiku.h"
+#import "HPUser.h"
+
+typedef struct {
+  NSUInteger fromIndex;
+  NSUInteger toIndex;
+} HPHaikuListMove;
+
+static BOOL HPHaikuListDiffEqualObjects(id object, id otherObject) {
+  return object == otherObject || [object isEqual:otherObject];
+}
+
+/**
+ * @return YES if a row showing one haiku looks the same as a row showing the other.
+ */
+static BOOL HPHaikuListDiffShowsSameContent(HPHaiku *haiku, HPHaiku *otherHaiku) {
+  if (haiku == otherHaiku) {
+    return YES;
+  }
+  return haiku.votes == otherHaiku.votes &&
+      HPHaikuListDiffEqualObjects(haiku.title, otherHaiku.title) &&
+      HPHaikuListDiffEqualObjects(haiku.line_one, otherHaiku.line_one) &&
+      HPHaikuListDiffEqualObjects(haiku.line_two, otherHaiku.line_two) &&
+      HPHaikuListDiffEqualObjects(haiku.line_three, otherHaiku.line_three) &&
+      HPHaikuListDiffEqualObjects(haiku.creation_time, otherHaiku.creation_time) &&
+      HPHaikuListDiffEqualObjects(haiku.author.google_display_name,
+                                  otherHaiku.author.google_display_name) &&
+      HPHaikuListDiffEqualObjects(haiku.author.google_photo_url,
+                                  otherHaiku.author.google_photo_url);
+}
+
+@implementation HPHaikuListDiff {
+  // HPHaikuListMove structs in the order of the new list.
+  NSData *_moves;
+}
+
+- (id)initWithDeletedIndexes:(NSIndexSet *)deletedIndexes
+             insertedIndexes:(NSIndexSet *)insertedIndexes
+              updatedIndexes:(NSIndexSet *)updatedIndexes
+                       moves:(NSData *)moves {
+  self = [super init];
+  if (self) {
+    _deletedIndexes = deletedIndexes;
+    _insertedIndexes = insertedIndexes;
+    _updatedIndexes = updatedIndexes;
+    _moves = moves;
+  }
+  return self;
+}
+
++ (HPHaikuListDiff *)diffFromHaikus:(NSArray *)oldHaikus toHaikus:(NSArray *)newHaikus {
+  NSUInteger oldCount = [oldHaikus count];
+  NSUInteger newCount = [newHaikus count];
+  NSMutableIndexSet *deletedIndexes = [NSMutableIndexSet indexSet];
+  NSMutableIndexSet *insertedIndexes = [NSMutableIndexSet indexSet];
+  NSMutableIndexSet *updatedIndexes = [NSMutableIndexSet indexSet];
+  NSMutableData *moves = [NSMutableData data];
+
+  // Map from identifier to one more than the old index of its first haiku. The values are plain
+  // integers so that large lists do not box a number per haiku.
+  CFMutableDictionaryRef oldIndexes =
+      CFDictionaryCreateMutable(NULL, oldCount, &kCFTypeDictionaryKeyCallBacks, NULL);
+  NSUInteger index = 0;
+  for (HPHaiku *haiku in oldHaikus) {
+    CFStringRef identifier = (__bridge CFStringRef)haiku.identifier;
+    if (identifier && !CFDictionaryContainsKey(oldIndexes, identifier)) {
+      CFDictionarySetValue(oldIndexes, identifier, (const void *)(uintptr_t)(index + 1));
+    }
+    index++;
+  }
+
+  // Match every new haiku to an old one. Matched pairs are listed in the order of the new list.
+  NSUInteger *newIndexOfOld = malloc(sizeof(NSUInteger) * MAX(oldCount, (NSUInteger)1));
+  NSUInteger *matchedOld = malloc(sizeof(NSUInteger) * MAX(newCount, (NSUInteger)1));
+  NSUInteger *matchedNew = malloc(sizeof(NSUInteger) * MAX(newCount, (NSUInteger)1));
+  for (NSUInteger j = 0; j < oldCount; j++) {
+    newIndexOfOld[j] = NSNotFound;
+  }
+  NSUInteger matchCount = 0;
+  index = 0;
+  for (HPHaiku *haiku in newHaikus) {
+    CFStringRef identifier = (__bridge CFStringRef)haiku.identifier;
+    uintptr_t value = identifier ? (uintptr_t)CFDictionaryGetValue(oldIndexes, identifier) : 0;
+    if (value && newIndexOfOld[value - 1] == NSNotFound) {
+      newIndexOfOld[value - 1] = index;
+      matchedOld[matchCount] = value - 1;
+      matchedNew[matchCount] = index;
+      matchCount++;
+    } else {
+      [insertedIndexes addIndex:index];
+    }
+    index++;
+  }
+  CFRelease(oldIndexes);
+  for (NSUInteger j = 0; j < oldCount; j++) {
+    if (newIndexOfOld[j] == NSNotFound) {
+      [deletedIndexes addIndex:j];
+    }
+  }
+
+  // The longest increasing run of old indexes among the matched pairs stays in place; every other
+  // matched haiku moves. |tails[length]| is the pair ending the shortest known run of that length.
+  NSUInteger *tails = malloc(sizeof(NSUInteger) * MAX(matchCount, (NSUInteger)1));
+  NSUInteger *previous = malloc(sizeof(NSUInteger) * MAX(matchCount, (NSUInteger)1));
+  NSUInteger runLength = 0;
+  for (NSUInteger k = 0; k < matchCount; k++) {
+    NSUInteger low = 0;
+    NSUInteger high = runLength;
+    while (low < high) {
+      NSUInteger middle = low + (high - low) / 2;
+      if (matchedOld[tails[middle]] < matchedOld[k]) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    previous[k] = low > 0 ? tails[low - 1] : NSNotFound;
+    tails[low] = k;
+    if (low == runLength) {
+      runLength++;
+    }
+  }
+  BOOL *inPlace = calloc(MAX(matchCount, (NSUInteger)1), sizeof(BOOL));
+  for (NSUInteger k = runLength > 0 ? tails[runLength - 1] : NSNotFound; k != NSNotFound;
+       k = previous[k]) {
+    inPlace[k] = YES;
+  }
+
+  for (NSUInteger k = 0; k < matchCount; k++) {
+    NSUInteger oldIndex = matchedOld[k];
+    NSUInteger newIndex = matchedNew[k];
+    BOOL sameContent = HPHaikuListDiffShowsSameContent([oldHaikus objectAtIndex:oldIndex],
+                                                       [newHaikus objectAtIndex:newIndex]);
+    if (inPlace[k]) {
+      if (!sameContent) {
+        [updatedIndexes addIndex:oldIndex];
+      }
+    } else if (sameContent) {
+      HPHaikuListMove move = { oldIndex, newIndex };
+      [moves appendBytes:&move length:sizeof(move)];
+    } else {
+      [deletedIndexes addIndex:oldIndex];
+      [insertedIndexes addIndex:newIndex];
+    }
+  }
+
+  free(newIndexOfOld);
+  free(matchedOld);
+  free(matchedNew);
+  free(tails);
+  free(previous);
+  free(inPlace);
+  return [[HPHaikuListDiff alloc] initWithDeletedIndexes:deletedIndexes
+                                         insertedIndexes:insertedIndexes
+                                          updatedIndexes:updatedIndexes
+                                                   moves:moves];
+}
+
+- (NSUInteger)moveCount {
+  return [_moves length] / sizeof(HPHaikuListMove);
+}
+
+- (NSUInteger)changeCount {
+  return [_deletedIndexes count] + [_insertedIndexes count] + [_updatedIndexes count] +
+      [self moveCount];
+}
+
+- (void)enumerateMovesUsingBlock:(void (^)(NSUInteger fromIndex, NSUInteger toIndex))block {
+  const HPHaikuListMove *moves = [_moves bytes];
+  NSUInteger moveCount = [self moveCount];
+  for (NSUInteger i = 0; i < moveCount; i++) {
+    block(moves[i].fromIndex, moves[i].toIndex);
+  }
+}
+
+@end
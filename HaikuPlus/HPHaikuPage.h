@@ -0,0 +1,63 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * One page of the haiku feed. Paged responses from the server are dictionaries containing the
+ * page items and an opaque cursor for the next page. Servers that do not support pagination
+ * return a plain array, which is treated as a single, final page.
+ */
+@interface HPHaikuPage : NSObject
+
+/**
+ * Array of HPHaiku objects in this page.
+ */
+@property(nonatomic, strong, readonly) NSArray *haikus;
+
+/**
+ * Cursor to send with the request for the next page, or nil if this is the last page.
+ */
+@property(nonatomic, copy, readonly) NSString *nextCursor;
+
+/**
+ * YES if the page was read from the on-disk feed snapshot rather than received from the server.
+ * A cached first page is always followed by the page from the server.
+ */
+@property(nonatomic, getter=isCached) BOOL cached;
+
+/**
+ * Initialize with haikus that have already been built.
+ *
+ * @param haikus Array of HPHaiku objects.
+ * @param nextCursor Cursor for the next page, or nil if this is the last page.
+ * @return Page object.
+ */
+- (id)initWithHaikus:(NSArray *)haikus nextCursor:(NSString *)nextCursor;
+
+/**
+ * Builds a page from a server response.
+ *
+ * @param responseObject A paged response dictionary or an array of haiku attributes.
+ * @return Page object or nil if the response cannot be read.
+ */
++ (instancetype)pageWithResponseObject:(id)responseObject;
+
+/**
+ * @return YES if there is another page after this one.
+ */
+- (BOOL)hasMorePages;
+
+@end
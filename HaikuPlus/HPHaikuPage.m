@@ -0,0 +1,59 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPHaikuPage.h"
+
+#import "HPConstants.h"
+#import "HPHaiku.h"
+
+@implementation HPHaikuPage
+
+- (id)initWithHaikus:(NSArray *)haikus nextCursor:(NSString *)nextCursor {
+  self = [super init];
+  if (self) {
+    _haikus = haikus ? haikus : @[];
+    _nextCursor = [nextCursor copy];
+  }
+  return self;
+}
+
++ (instancetype)pageWithResponseObject:(id)responseObject {
+  if ([responseObject isKindOfClass:[NSArray class]]) {
+    // The server does not paginate, so the whole feed is a single page.
+    NSArray *haikus = [HPHaiku haikuObjectsWithAttributes:responseObject];
+    return [[self alloc] initWithHaikus:haikus nextCursor:nil];
+  } else if ([responseObject isKindOfClass:[NSDictionary class]]) {
+    NSArray *items = [responseObject objectForKey:kHPConstantsPageItemsKey];
+    id nextCursor = [responseObject objectForKey:kHPConstantsPageNextCursorKey];
+    if (![items isKindOfClass:[NSArray class]]) {
+      return nil;
+    }
+    if (![nextCursor isKindOfClass:[NSString class]] || [nextCursor length] == 0) {
+      // The last page has no cursor, or a JSON null cursor.
+      nextCursor = nil;
+    }
+    NSArray *haikus = [HPHaiku haikuObjectsWithAttributes:items];
+    return [[self alloc] initWithHaikus:haikus nextCursor:nextCursor];
+  }
+  return nil;
+}
+
+- (BOOL)hasMorePages {
+  return _nextCursor != nil;
+}
+
+@end
@@ -0,0 +1,95 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Decides when a slow GET request is hedged: sent a second time while the first attempt is still
+ * running, so that one slow backend does not hold up the response. A request is hedged once it has
+ * been running for longer than a percentile of recent latencies, which adapts the hedge delay to
+ * the current network. The number of hedges is capped at a fraction of requests, so that a slow
+ * server does not get twice the load.
+ *
+ * The policy is safe to use from any thread.
+ */
+@interface HPHedgePolicy : NSObject
+
+/**
+ * Percentile of recent latencies after which a request is hedged, from 0 to 1. Defaults to 0.95,
+ * so that about one request in twenty is hedged.
+ */
+@property(nonatomic) double percentile;
+
+/**
+ * Number of latencies that must be recorded before requests are hedged. Defaults to 20.
+ */
+@property(nonatomic) NSUInteger minimumSampleCount;
+
+/**
+ * Shortest hedge delay, whatever the recent latencies. Defaults to 50 milliseconds.
+ */
+@property(nonatomic) NSTimeInterval minimumDelay;
+
+/**
+ * Largest fraction of requests that may be hedged, from 0 to 1. Defaults to 0.1.
+ */
+@property(nonatomic) double maxHedgeRate;
+
+/**
+ * Number of requests the policy was asked about.
+ */
+@property(nonatomic, readonly) NSUInteger requestCount;
+
+/**
+ * Number of hedges sent.
+ */
+@property(nonatomic, readonly) NSUInteger hedgeCount;
+
+/**
+ * Number of hedges that answered before the first attempt.
+ */
+@property(nonatomic, readonly) NSUInteger hedgeWinCount;
+
+/**
+ * Number of hedges not sent because of |maxHedgeRate|.
+ */
+@property(nonatomic, readonly) NSUInteger throttledHedgeCount;
+
+/**
+ * Called when a request that can be hedged is sent.
+ *
+ * @return Time after which the request is hedged, or a negative value if too few latencies have
+ *     been recorded yet.
+ */
+- (NSTimeInterval)hedgeDelayForNewRequest;
+
+/**
+ * Called when the hedge delay of a request has passed without a response.
+ *
+ * @return YES if a hedge may be sent, in which case it is counted.
+ */
+- (BOOL)shouldSendHedge;
+
+/**
+ * Records the latency of a request, from sending the first attempt to the first response.
+ *
+ * @param latency Latency of the request.
+ * @param isHedgeWin YES if the hedge answered first.
+ */
+- (void)recordLatency:(NSTimeInterval)latency hedgeWin:(BOOL)isHedgeWin;
+
+@end
@@ -0,0 +1,97 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPHedgePolicy.h"
+
+/**
+ * Number of recent latencies the hedge delay is computed from.
+ */
+#define HP_HEDGE_POLICY_SAMPLE_CAPACITY 128
+
+/**
+ * Most hedges that can be sent in a burst after a calm period.
+ */
+static const double kHPHedgePolicyMaxBudget = 2;
+
+@implementation HPHedgePolicy {
+  // Ring buffer of recent latencies.
+  NSTimeInterval _samples[HP_HEDGE_POLICY_SAMPLE_CAPACITY];
+  NSUInteger _sampleCount;
+  NSUInteger _nextSampleIndex;
+  // Hedges that may be sent now. Each request adds |maxHedgeRate| and each hedge takes 1.
+  double _hedgeBudget;
+}
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _percentile = 0.95;
+    _minimumSampleCount = 20;
+    _minimumDelay = 0.05;
+    _maxHedgeRate = 0.1;
+  }
+  return self;
+}
+
+- (NSTimeInterval)hedgeDelayForNewRequest {
+  NSTimeInterval sorted[HP_HEDGE_POLICY_SAMPLE_CAPACITY];
+  NSUInteger count;
+  @synchronized(self) {
+    _requestCount++;
+    _hedgeBudget = MIN(_hedgeBudget + MAX(_maxHedgeRate, 0), kHPHedgePolicyMaxBudget);
+    count = _sampleCount;
+    if (count == 0 || count < _minimumSampleCount) {
+      return -1;
+    }
+    memcpy(sorted, _samples, count * sizeof(NSTimeInterval));
+  }
+  qsort_b(sorted, count, sizeof(NSTimeInterval), ^int(const void *a, const void *b) {
+      NSTimeInterval x = *(const NSTimeInterval *)a;
+      NSTimeInterval y = *(const NSTimeInterval *)b;
+      return x < y ? -1 : (x > y ? 1 : 0);
+  });
+  double percentile = MAX(MIN(_percentile, 1), 0);
+  NSUInteger index = (NSUInteger)ceil(percentile * count);
+  index = index > 0 ? index - 1 : 0;
+  return MAX(sorted[index], _minimumDelay);
+}
+
+- (BOOL)shouldSendHedge {
+  @synchronized(self) {
+    // Allow for rounding, as ten additions of 0.1 fall just short of 1.
+    if (_hedgeBudget < 1 - 1e-9) {
+      _throttledHedgeCount++;
+      return NO;
+    }
+    _hedgeBudget = MAX(_hedgeBudget - 1, 0);
+    _hedgeCount++;
+    return YES;
+  }
+}
+
+- (void)recordLatency:(NSTimeInterval)latency hedgeWin:(BOOL)isHedgeWin {
+  @synchronized(self) {
+    _samples[_nextSampleIndex] = latency;
+    _nextSampleIndex = (_nextSampleIndex + 1) % HP_HEDGE_POLICY_SAMPLE_CAPACITY;
+    _sampleCount = MIN(_sampleCount + 1, HP_HEDGE_POLICY_SAMPLE_CAPACITY);
+    if (isHedgeWin) {
+      _hedgeWinCount++;
+    }
+  }
+}
+
+@end
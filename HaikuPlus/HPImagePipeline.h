@@ -0,0 +1,145 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <UIKit/UIKit.h>
+
+@class HPRequestScheduler;
+
+/**
+ * Handle for one image load. A cancelled load never calls its completion block, so a view that
+ * cancels its previous load before starting a new one only ever shows the latest image.
+ */
+@interface HPImageLoadToken : NSObject
+
+/**
+ * YES once the load has been cancelled.
+ */
+@property(nonatomic, readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ * Stops the load from calling its completion block. When no other load waits for the same URL,
+ * a download that has not started yet is cancelled so that it does not take bandwidth from
+ * images that are still needed. Cancelling a finished load does nothing.
+ */
+- (void)cancel;
+
+@end
+
+/**
+ * Loads remote images, such as author avatars, through two cache tiers before the network.
+ *
+ * Decoded images are kept in a bounded in-memory cache. Downloaded image data is kept on disk
+ * under the SHA-1 hash of its contents, so that URLs serving the same image share one file, with
+ * a small index from each URL to its content hash. Downloads run on a bounded operation queue,
+ * and concurrent loads of the same URL share one download.
+ *
+ * The pipeline must be used from the main queue. Disk access happens on a private serial queue.
+ */
+@interface HPImagePipeline : NSObject
+
+/**
+ * Maximum number of bytes of decoded images kept in memory. Defaults to 8 MB.
+ */
+@property(nonatomic) NSUInteger maxMemoryBytes;
+
+/**
+ * Maximum number of bytes of image data kept on disk. The least recently stored images are
+ * deleted to stay within the budget. Defaults to 20 MB.
+ */
+@property(nonatomic) unsigned long long maxDiskBytes;
+
+/**
+ * Maximum number of concurrent downloads when there is no scheduler. Defaults to 4.
+ */
+@property(nonatomic) NSInteger maxConcurrentDownloads;
+
+/**
+ * Optional scheduler for downloads. When set, downloads are visible-content requests and wait
+ * for interactive requests sharing the scheduler, and the limit of the visible class applies
+ * instead of maxConcurrentDownloads.
+ */
+@property(nonatomic, strong) HPRequestScheduler *scheduler;
+
+/**
+ * Number of loads answered from memory.
+ */
+@property(nonatomic, readonly) NSUInteger memoryHitCount;
+
+/**
+ * Number of loads answered from disk.
+ */
+@property(nonatomic, readonly) NSUInteger diskHitCount;
+
+/**
+ * Number of downloads started because an image was in neither cache.
+ */
+@property(nonatomic, readonly) NSUInteger downloadCount;
+
+/**
+ * Number of loads that joined a load of the same URL already in progress.
+ */
+@property(nonatomic, readonly) NSUInteger coalescedLoadCount;
+
+/**
+ * Number of loads cancelled before they finished.
+ */
+@property(nonatomic, readonly) NSUInteger cancelledLoadCount;
+
+/**
+ * Number of downloads cancelled because every load waiting for them was cancelled.
+ */
+@property(nonatomic, readonly) NSUInteger cancelledDownloadCount;
+
+/**
+ * Fraction of cache lookups answered from memory or disk, between 0 and 1. Loads that joined a
+ * load in progress are not lookups.
+ */
+@property(nonatomic, readonly) double hitRate;
+
+/**
+ * @return Directory for image data inside the app's Caches directory.
+ */
++ (NSString *)defaultDirectory;
+
+/**
+ * @param directory Directory where image data is stored, or nil to keep images in memory only.
+ * @return Image pipeline object.
+ */
+- (id)initWithDirectory:(NSString *)directory;
+
+/**
+ * Loads an image. The completion block is called before this method returns when the image is
+ * in memory, and later on the main queue otherwise.
+ *
+ * @param url The URL of an image.
+ * @param completion Block that takes an image and an error which is nil on success.
+ * @return Token that cancels the load.
+ */
+- (HPImageLoadToken *)loadImageWithURL:(NSURL *)url
+                            completion:(void (^)(UIImage *image, NSError *error))completion;
+
+/**
+ * Empties the in-memory cache, for example on a memory warning.
+ */
+- (void)removeAllMemoryImages;
+
+/**
+ * Empties both caches.
+ */
+- (void)removeAllImages;
+
+@end
@@ -0,0 +1,434 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPImagePipeline.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+#import "AFImageRequestOperation.h"
+#import "HPRequestScheduler.h"
+
+/**
+ * Default pipeline limits.
+ */
+static const NSUInteger kHPImagePipelineDefaultMaxMemoryBytes = 8 * 1024 * 1024;
+static const unsigned long long kHPImagePipelineDefaultMaxDiskBytes = 20 * 1024 * 1024;
+static const NSInteger kHPImagePipelineDefaultMaxConcurrentDownloads = 4;
+
+/**
+ * @param data Bytes to hash.
+ * @return Lowercase hexadecimal SHA-1 digest of the bytes.
+ */
+static NSString *HPSHA1HexString(NSData *data) {
+  unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+  CC_SHA1([data bytes], (CC_LONG)[data length], digest);
+  NSMutableString *hex = [NSMutableString stringWithCapacity:CC_SHA1_DIGEST_LENGTH * 2];
+  for (int i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
+    [hex appendFormat:@"%02x", digest[i]];
+  }
+  return hex;
+}
+
+/**
+ * Decodes image data into a bitmap so that the first display of the image does not decode it on
+ * the main queue.
+ *
+ * @param data Encoded image data.
+ * @param scale Scale factor of the image.
+ * @return Decoded image, or nil if the data is not an image.
+ */
+static UIImage *HPDecodedImageWithData(NSData *data, CGFloat scale) {
+  UIImage *image = [UIImage imageWithData:data scale:scale];
+  CGImageRef imageRef = [image CGImage];
+  if (!imageRef) {
+    return nil;
+  }
+  size_t width = CGImageGetWidth(imageRef);
+  size_t height = CGImageGetHeight(imageRef);
+  CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+  CGContextRef context = CGBitmapContextCreate(NULL, width, height, 8, 0, colorSpace,
+      kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+  CGColorSpaceRelease(colorSpace);
+  if (!context) {
+    return image;
+  }
+  CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+  CGImageRef decodedRef = CGBitmapContextCreateImage(context);
+  CGContextRelease(context);
+  UIImage *decoded = [UIImage imageWithCGImage:decodedRef
+                                         scale:scale
+                                   orientation:[image imageOrientation]];
+  CGImageRelease(decodedRef);
+  return decoded;
+}
+
+/**
+ * @param image Decoded image.
+ * @return Approximate number of bytes the image uses in memory.
+ */
+static NSUInteger HPImageCost(UIImage *image) {
+  CGImageRef imageRef = [image CGImage];
+  return CGImageGetBytesPerRow(imageRef) * CGImageGetHeight(imageRef);
+}
+
+@interface HPImagePipeline ()
+
+/**
+ * Removes a cancelled load from the loads waiting for its URL.
+ *
+ * @param token Token of the cancelled load.
+ */
+- (void)cancelLoadWithToken:(HPImageLoadToken *)token;
+
+@end
+
+@interface HPImageLoadToken ()
+
+@property(nonatomic, weak) HPImagePipeline *pipeline;
+@property(nonatomic, copy) NSString *key;
+// Completion block of a load that has not finished, or nil.
+@property(nonatomic, copy) void (^completion)(UIImage *image, NSError *error);
+
+@end
+
+@implementation HPImageLoadToken
+
+- (void)cancel {
+  if (_cancelled || !_completion) {
+    return;
+  }
+  _cancelled = YES;
+  _completion = nil;
+  [_pipeline cancelLoadWithToken:self];
+}
+
+@end
+
+@implementation HPImagePipeline {
+  NSString *_objectsDirectory;
+  NSString *_urlsDirectory;
+  NSCache *_memoryCache;
+  NSOperationQueue *_downloadQueue;
+  dispatch_queue_t _ioQueue;
+  NSFileManager *_fileManager;
+  CGFloat _scale;
+  // Map from URL string to an array of HPImageLoadToken objects waiting for the image.
+  NSMutableDictionary *_pendingTokens;
+  // Map from URL string to the download operation for the image.
+  NSMutableDictionary *_pendingOperations;
+}
+
++ (NSString *)defaultDirectory {
+  NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+  return [[paths firstObject] stringByAppendingPathComponent:@"HPImagePipeline"];
+}
+
+- (id)init {
+  return [self initWithDirectory:nil];
+}
+
+- (id)initWithDirectory:(NSString *)directory {
+  self = [super init];
+  if (self) {
+    _objectsDirectory = [directory stringByAppendingPathComponent:@"objects"];
+    _urlsDirectory = [directory stringByAppendingPathComponent:@"urls"];
+    _memoryCache = [[NSCache alloc] init];
+    _downloadQueue = [[NSOperationQueue alloc] init];
+    _ioQueue = dispatch_queue_create("com.google.plus.samples.HaikuPlus.HPImagePipeline",
+                                     DISPATCH_QUEUE_SERIAL);
+    _fileManager = [[NSFileManager alloc] init];
+    _scale = [[UIScreen mainScreen] scale];
+    _pendingTokens = [NSMutableDictionary dictionary];
+    _pendingOperations = [NSMutableDictionary dictionary];
+    self.maxMemoryBytes = kHPImagePipelineDefaultMaxMemoryBytes;
+    self.maxDiskBytes = kHPImagePipelineDefaultMaxDiskBytes;
+    self.maxConcurrentDownloads = kHPImagePipelineDefaultMaxConcurrentDownloads;
+    if (directory) {
+      dispatch_async(_ioQueue, ^{
+          for (NSString *path in @[ _objectsDirectory, _urlsDirectory ]) {
+            [_fileManager createDirectoryAtPath:path
+                    withIntermediateDirectories:YES
+                                     attributes:nil
+                                          error:NULL];
+          }
+      });
+    }
+  }
+  return self;
+}
+
+- (void)setMaxMemoryBytes:(NSUInteger)maxMemoryBytes {
+  _maxMemoryBytes = maxMemoryBytes;
+  [_memoryCache setTotalCostLimit:maxMemoryBytes];
+}
+
+- (void)setMaxConcurrentDownloads:(NSInteger)maxConcurrentDownloads {
+  _maxConcurrentDownloads = maxConcurrentDownloads;
+  [_downloadQueue setMaxConcurrentOperationCount:maxConcurrentDownloads];
+}
+
+- (double)hitRate {
+  NSUInteger hitCount = _memoryHitCount + _diskHitCount;
+  NSUInteger loadCount = hitCount + _downloadCount;
+  return loadCount ? (double)hitCount / loadCount : 0;
+}
+
+#pragma mark - Loading
+
+- (HPImageLoadToken *)loadImageWithURL:(NSURL *)url
+                            completion:(void (^)(UIImage *image, NSError *error))completion {
+  HPImageLoadToken *token = [[HPImageLoadToken alloc] init];
+  NSString *key = [url absoluteString];
+  if (!key) {
+    completion(nil, [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadURL userInfo:nil]);
+    return token;
+  }
+  UIImage *image = [_memoryCache objectForKey:key];
+  if (image) {
+    _memoryHitCount++;
+    completion(image, nil);
+    return token;
+  }
+  token.pipeline = self;
+  token.key = key;
+  token.completion = completion;
+  NSMutableArray *tokens = [_pendingTokens objectForKey:key];
+  if (tokens) {
+    _coalescedLoadCount++;
+    [tokens addObject:token];
+    return token;
+  }
+  [_pendingTokens setObject:[NSMutableArray arrayWithObject:token] forKey:key];
+
+  if (!_objectsDirectory) {
+    [self downloadImageWithURL:url];
+    return token;
+  }
+  dispatch_async(_ioQueue, ^{
+      UIImage *diskImage = [self diskImageForKey:key];
+      dispatch_async(dispatch_get_main_queue(), ^{
+          if (diskImage) {
+            _diskHitCount++;
+            [self finishLoadForKey:key image:diskImage error:nil];
+          } else if ([[_pendingTokens objectForKey:key] count] == 0) {
+            // Every load was cancelled during the disk read.
+            [_pendingTokens removeObjectForKey:key];
+          } else {
+            [self downloadImageWithURL:url];
+          }
+      });
+  });
+  return token;
+}
+
+/**
+ * Downloads an image on the download queue, stores its data on disk and decodes it.
+ *
+ * @param url The URL of an image.
+ */
+- (void)downloadImageWithURL:(NSURL *)url {
+  _downloadCount++;
+  NSString *key = [url absoluteString];
+  NSURLRequest *request = [NSURLRequest requestWithURL:url];
+  AFImageRequestOperation *operation = [[AFImageRequestOperation alloc] initWithRequest:request];
+  [operation setImageScale:_scale];
+  [operation setCompletionBlockWithSuccess:^(AFHTTPRequestOperation *operation, id image) {
+      NSData *data = [operation responseData];
+      if (_objectsDirectory && data) {
+        dispatch_async(_ioQueue, ^{
+            [self storeData:data forKey:key];
+        });
+      }
+      // The operation does not inflate its image, so decode the data off the main queue before
+      // the image is cached and first drawn.
+      dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+          UIImage *decodedImage = data ? HPDecodedImageWithData(data, _scale) : nil;
+          dispatch_async(dispatch_get_main_queue(), ^{
+              if ([_pendingOperations objectForKey:key] == operation) {
+                [self finishLoadForKey:key image:decodedImage ? decodedImage : image error:nil];
+              }
+          });
+      });
+  } failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+      // A cancelled download may have been replaced by a new one for the same URL.
+      if ([_pendingOperations objectForKey:key] == operation) {
+        [self finishLoadForKey:key image:nil error:error];
+      }
+  }];
+  [_pendingOperations setObject:operation forKey:key];
+  if (_scheduler) {
+    [_scheduler addOperation:operation priority:HPRequestPriorityVisible];
+  } else {
+    [_downloadQueue addOperation:operation];
+  }
+}
+
+/**
+ * Caches the image in memory and delivers it to every load still waiting for the URL.
+ *
+ * @param key URL string of the image.
+ * @param image The image, or nil on failure.
+ * @param error Error from the download, or nil on success.
+ */
+- (void)finishLoadForKey:(NSString *)key image:(UIImage *)image error:(NSError *)error {
+  if (image) {
+    [_memoryCache setObject:image forKey:key cost:HPImageCost(image)];
+  }
+  NSArray *tokens = [_pendingTokens objectForKey:key];
+  [_pendingTokens removeObjectForKey:key];
+  [_pendingOperations removeObjectForKey:key];
+  for (HPImageLoadToken *token in tokens) {
+    void (^completion)(UIImage *, NSError *) = token.completion;
+    token.completion = nil;
+    if (completion) {
+      completion(image, error);
+    }
+  }
+}
+
+- (void)cancelLoadWithToken:(HPImageLoadToken *)token {
+  NSMutableArray *tokens = [_pendingTokens objectForKey:token.key];
+  [tokens removeObjectIdenticalTo:token];
+  _cancelledLoadCount++;
+  if ([tokens count] > 0) {
+    return;
+  }
+  AFImageRequestOperation *operation = [_pendingOperations objectForKey:token.key];
+  if (operation && ![operation isExecuting]) {
+    // Nobody needs the image any more and the download has not started, so drop it. A download
+    // in progress is left to finish so that the image is cached.
+    [operation cancel];
+    [_pendingOperations removeObjectForKey:token.key];
+    [_pendingTokens removeObjectForKey:token.key];
+    _cancelledDownloadCount++;
+  }
+}
+
+#pragma mark - Disk cache
+
+/**
+ * @param key URL string of the image.
+ * @return Path of the file that holds the content hash of the image data for the URL.
+ */
+- (NSString *)linkPathForKey:(NSString *)key {
+  NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+  return [_urlsDirectory stringByAppendingPathComponent:HPSHA1HexString(keyData)];
+}
+
+/**
+ * Reads and decodes the image stored for a URL. Must be called on the I/O queue.
+ *
+ * @param key URL string of the image.
+ * @return The decoded image, or nil if it is not on disk.
+ */
+- (UIImage *)diskImageForKey:(NSString *)key {
+  NSString *linkPath = [self linkPathForKey:key];
+  NSString *contentHash = [NSString stringWithContentsOfFile:linkPath
+                                                    encoding:NSUTF8StringEncoding
+                                                       error:NULL];
+  if (!contentHash) {
+    return nil;
+  }
+  NSString *objectPath = [_objectsDirectory stringByAppendingPathComponent:contentHash];
+  NSData *data = [NSData dataWithContentsOfFile:objectPath];
+  UIImage *image = data ? HPDecodedImageWithData(data, _scale) : nil;
+  if (!image) {
+    // The data was evicted or is corrupt, so the link is useless.
+    [_fileManager removeItemAtPath:linkPath error:NULL];
+    [_fileManager removeItemAtPath:objectPath error:NULL];
+  }
+  return image;
+}
+
+/**
+ * Stores downloaded image data under its content hash and links the URL to it. Must be called on
+ * the I/O queue.
+ *
+ * @param data Encoded image data.
+ * @param key URL string of the image.
+ */
+- (void)storeData:(NSData *)data forKey:(NSString *)key {
+  if ([data length] > _maxDiskBytes) {
+    return;
+  }
+  NSString *contentHash = HPSHA1HexString(data);
+  NSString *objectPath = [_objectsDirectory stringByAppendingPathComponent:contentHash];
+  if (![_fileManager fileExistsAtPath:objectPath]) {
+    [data writeToFile:objectPath atomically:YES];
+    [self trimToBytes:_maxDiskBytes];
+  }
+  [contentHash writeToFile:[self linkPathForKey:key]
+                atomically:YES
+                  encoding:NSUTF8StringEncoding
+                     error:NULL];
+}
+
+/**
+ * Deletes the least recently stored image data until the rest fits in |bytes|. Links to deleted
+ * data are removed when they are next read. Must be called on the I/O queue.
+ *
+ * @param bytes Number of bytes the remaining image data may use.
+ */
+- (void)trimToBytes:(unsigned long long)bytes {
+  NSArray *names = [_fileManager contentsOfDirectoryAtPath:_objectsDirectory error:NULL];
+  NSMutableArray *objects = [NSMutableArray arrayWithCapacity:[names count]];
+  unsigned long long totalBytes = 0;
+  for (NSString *name in names) {
+    NSString *path = [_objectsDirectory stringByAppendingPathComponent:name];
+    NSDictionary *attributes = [_fileManager attributesOfItemAtPath:path error:NULL];
+    if (attributes) {
+      totalBytes += [attributes fileSize];
+      [objects addObject:@{ @"path" : path, @"attributes" : attributes }];
+    }
+  }
+  if (totalBytes <= bytes) {
+    return;
+  }
+  [objects sortUsingComparator:^NSComparisonResult(NSDictionary *a, NSDictionary *b) {
+      NSDate *dateA = [[a objectForKey:@"attributes"] fileModificationDate];
+      NSDate *dateB = [[b objectForKey:@"attributes"] fileModificationDate];
+      return [dateA compare:dateB];
+  }];
+  for (NSDictionary *object in objects) {
+    if (totalBytes <= bytes) {
+      break;
+    }
+    [_fileManager removeItemAtPath:[object objectForKey:@"path"] error:NULL];
+    totalBytes -= [[object objectForKey:@"attributes"] fileSize];
+  }
+}
+
+- (void)removeAllMemoryImages {
+  [_memoryCache removeAllObjects];
+}
+
+- (void)removeAllImages {
+  [self removeAllMemoryImages];
+  if (!_objectsDirectory) {
+    return;
+  }
+  dispatch_async(_ioQueue, ^{
+      for (NSString *directory in @[ _objectsDirectory, _urlsDirectory ]) {
+        for (NSString *name in [_fileManager contentsOfDirectoryAtPath:directory error:NULL]) {
+          [_fileManager removeItemAtPath:[directory stringByAppendingPathComponent:name]
+                                   error:NULL];
+        }
+      }
+  });
+}
+
+@end
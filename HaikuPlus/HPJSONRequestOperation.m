@@ -0,0 +1,53 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPJSONRequestOperation.h"
+
+@implementation HPJSONRequestOperation {
+  // Set on the network thread once a body byte has arrived.
+  BOOL _hasReceivedData;
+}
+
+- (void)start {
+  [_traceRecord markStage:HPTraceStageConnectionStarted];
+  [super start];
+}
+
+- (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)response {
+  if (_traceRecord && [response isKindOfClass:[NSHTTPURLResponse class]]) {
+    _traceRecord.statusCode = [(NSHTTPURLResponse *)response statusCode];
+  }
+  [super connection:connection didReceiveResponse:response];
+}
+
+- (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data {
+  if (_traceRecord) {
+    if (!_hasReceivedData) {
+      _hasReceivedData = YES;
+      [_traceRecord markStage:HPTraceStageFirstByte];
+    }
+    _traceRecord.responseByteCount += [data length];
+  }
+  [super connection:connection didReceiveData:data];
+}
+
+- (void)connectionDidFinishLoading:(NSURLConnection *)connection {
+  [_traceRecord markStage:HPTraceStageLastByte];
+  [super connectionDidFinishLoading:connection];
+}
+
+@end
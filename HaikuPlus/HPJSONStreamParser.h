@@ -0,0 +1,92 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Incremental JSON parser for feeds. Bytes are appended as they arrive, and each element of the
+ * feed array is handed over as soon as its last byte has been read, so that consumers can start
+ * working before the response is complete. Only the element being read is buffered, so memory use
+ * depends on the size of the largest element rather than on the size of the feed.
+ *
+ * The feed array is either the top-level value, or the member named |itemsKey| of a top-level
+ * object. Everything else in the response is kept and returned by |envelope| once the parser has
+ * finished, with the feed array left empty.
+ *
+ * Elements are split out by a scanner that tracks nesting and strings, and each element is then
+ * parsed with NSJSONSerialization. A parser is not thread-safe; use it from one queue at a time.
+ */
+@interface HPJSONStreamParser : NSObject
+
+/**
+ * Block called with each parsed feed element, on the queue that appends the bytes.
+ */
+@property(nonatomic, copy) void (^elementHandler)(id element);
+
+/**
+ * Number of feed elements handed over so far.
+ */
+@property(nonatomic, readonly) NSUInteger elementCount;
+
+/**
+ * Largest number of bytes buffered for a single element.
+ */
+@property(nonatomic, readonly) NSUInteger maxElementLength;
+
+/**
+ * The top-level value with the feed array emptied, once -finish has succeeded.
+ */
+@property(nonatomic, strong, readonly) id envelope;
+
+/**
+ * Error that stopped the parser, or nil.
+ */
+@property(nonatomic, strong, readonly) NSError *error;
+
+/**
+ * @param itemsKey Name of the feed array member when the top-level value is an object, or nil
+ *     if only a top-level array is streamed.
+ * @return Parser object.
+ */
+- (id)initWithItemsKey:(NSString *)itemsKey;
+
+/**
+ * Reads the next bytes of the response, and hands over every element they complete.
+ *
+ * @param bytes The bytes.
+ * @param length Number of bytes.
+ * @return NO if the bytes are not valid JSON, in which case |error| is set and later bytes are
+ *     ignored.
+ */
+- (BOOL)appendBytes:(const void *)bytes length:(NSUInteger)length;
+
+/**
+ * Reads the next chunk of the response.
+ *
+ * @param data The chunk.
+ * @return NO if the data is not valid JSON.
+ */
+- (BOOL)appendData:(NSData *)data;
+
+/**
+ * Checks that the response is complete and parses the envelope.
+ *
+ * @return NO if the response is truncated or not valid JSON, in which case |error| is set.
+ */
+- (BOOL)finish;
+
+@end
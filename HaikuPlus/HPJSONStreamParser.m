@@ -0,0 +1,334 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPJSONStreamParser.h"
+
+/**
+ * Where the bytes being scanned are kept.
+ */
+typedef NS_ENUM(NSInteger, HPJSONStreamSink) {
+  // Whitespace and separators between feed elements are dropped.
+  HPJSONStreamSinkNone,
+  HPJSONStreamSinkEnvelope,
+  HPJSONStreamSinkElement
+};
+
+/**
+ * What may come next between feed elements.
+ */
+typedef NS_ENUM(NSInteger, HPJSONStreamSeparator) {
+  // After the opening bracket: an element or the closing bracket.
+  HPJSONStreamSeparatorArrayStart,
+  // After an element: a comma or the closing bracket.
+  HPJSONStreamSeparatorAfterElement,
+  // After a comma: an element.
+  HPJSONStreamSeparatorAfterComma
+};
+
+static BOOL HPJSONIsWhitespace(uint8_t c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+@implementation HPJSONStreamParser {
+  NSData *_itemsKeyBytes;
+  NSMutableData *_elementBuffer;
+  NSMutableData *_envelopeBuffer;
+  NSMutableData *_keyBuffer;
+  // Number of open arrays and objects.
+  NSUInteger _depth;
+  // Depth of the feed array while it is being read, or 0.
+  NSUInteger _streamDepth;
+  HPJSONStreamSeparator _separator;
+  BOOL _started;
+  BOOL _finished;
+  BOOL _topLevelIsObject;
+  BOOL _inString;
+  BOOL _escaped;
+  BOOL _inElement;
+  // The element being read is a number or a literal, which ends at the next delimiter.
+  BOOL _elementIsScalar;
+  // The next string in the top-level object is a member name.
+  BOOL _expectingKey;
+  BOOL _readingKey;
+  BOOL _lastKeyIsItemsKey;
+}
+
+- (id)init {
+  return [self initWithItemsKey:nil];
+}
+
+- (id)initWithItemsKey:(NSString *)itemsKey {
+  self = [super init];
+  if (self) {
+    _itemsKeyBytes = [itemsKey dataUsingEncoding:NSUTF8StringEncoding];
+    _elementBuffer = [NSMutableData data];
+    _envelopeBuffer = [NSMutableData data];
+    _keyBuffer = [NSMutableData data];
+  }
+  return self;
+}
+
+- (BOOL)appendData:(NSData *)data {
+  return [self appendBytes:[data bytes] length:[data length]];
+}
+
+- (BOOL)appendBytes:(const void *)bytes length:(NSUInteger)length {
+  if (_error) {
+    return NO;
+  }
+  if (_finished) {
+    return [self failWithDescription:@"Bytes appended after the end of the response"];
+  }
+  const uint8_t *p = bytes;
+  // Consecutive bytes bound for the same sink are copied in one run.
+  NSUInteger runStart = 0;
+  HPJSONStreamSink runSink = HPJSONStreamSinkNone;
+  NSUInteger i = 0;
+  while (i < length) {
+    uint8_t c = p[i];
+    HPJSONStreamSink sink;
+    BOOL completesElement = NO;
+    if (_inElement) {
+      sink = HPJSONStreamSinkElement;
+      if (_inString) {
+        if (_escaped) {
+          _escaped = NO;
+        } else if (c == '\\') {
+          _escaped = YES;
+        } else if (c == '"') {
+          _inString = NO;
+          completesElement = _depth == _streamDepth;
+        }
+      } else if (_elementIsScalar) {
+        if (c == ',' || c == ']' || c == '}' || HPJSONIsWhitespace(c)) {
+          // The delimiter is not part of the element; it is scanned again between elements.
+          [self appendBytes:p + runStart length:i - runStart toSink:runSink];
+          runStart = i;
+          runSink = HPJSONStreamSinkNone;
+          if (![self completeElement]) {
+            return NO;
+          }
+          continue;
+        }
+      } else if (c == '"') {
+        _inString = YES;
+      } else if (c == '{' || c == '[') {
+        _depth++;
+      } else if (c == '}' || c == ']') {
+        _depth--;
+        completesElement = _depth == _streamDepth;
+      }
+    } else if (_streamDepth && _depth == _streamDepth) {
+      // Between feed elements.
+      if (HPJSONIsWhitespace(c)) {
+        sink = HPJSONStreamSinkNone;
+      } else if (c == ',') {
+        if (_separator != HPJSONStreamSeparatorAfterElement) {
+          return [self failWithDescription:@"Unexpected comma in the feed array"];
+        }
+        _separator = HPJSONStreamSeparatorAfterComma;
+        sink = HPJSONStreamSinkNone;
+      } else if (c == ']') {
+        if (_separator == HPJSONStreamSeparatorAfterComma) {
+          return [self failWithDescription:@"Trailing comma in the feed array"];
+        }
+        // The envelope keeps the feed array, empty.
+        _streamDepth = 0;
+        _depth--;
+        sink = HPJSONStreamSinkEnvelope;
+      } else {
+        if (_separator == HPJSONStreamSeparatorAfterElement) {
+          return [self failWithDescription:@"Missing comma in the feed array"];
+        }
+        _separator = HPJSONStreamSeparatorAfterElement;
+        _inElement = YES;
+        sink = HPJSONStreamSinkElement;
+        if (c == '"') {
+          _inString = YES;
+        } else if (c == '{' || c == '[') {
+          _depth++;
+        } else {
+          _elementIsScalar = YES;
+        }
+      }
+    } else {
+      sink = HPJSONStreamSinkEnvelope;
+      if (![self scanEnvelopeByte:c]) {
+        return NO;
+      }
+    }
+
+    if (sink != runSink) {
+      [self appendBytes:p + runStart length:i - runStart toSink:runSink];
+      runStart = i;
+      runSink = sink;
+    }
+    i++;
+    if (completesElement) {
+      [self appendBytes:p + runStart length:i - runStart toSink:runSink];
+      runStart = i;
+      if (![self completeElement]) {
+        return NO;
+      }
+    }
+  }
+  [self appendBytes:p + runStart length:length - runStart toSink:runSink];
+  return YES;
+}
+
+/**
+ * Scans a byte outside the feed array, tracking nesting and the member names of a top-level
+ * object to find where the feed array starts.
+ */
+- (BOOL)scanEnvelopeByte:(uint8_t)c {
+  if (_inString) {
+    if (_escaped) {
+      _escaped = NO;
+    } else if (c == '\\') {
+      _escaped = YES;
+    } else if (c == '"') {
+      _inString = NO;
+      if (_readingKey) {
+        _readingKey = NO;
+        _lastKeyIsItemsKey = [_keyBuffer isEqualToData:_itemsKeyBytes];
+      }
+      return YES;
+    }
+    if (_readingKey) {
+      [_keyBuffer appendBytes:&c length:1];
+    }
+    return YES;
+  }
+  if (HPJSONIsWhitespace(c)) {
+    return YES;
+  }
+  if (_depth == 0) {
+    if (_started) {
+      return [self failWithDescription:@"Unexpected data after the top-level value"];
+    }
+    _started = YES;
+    if (c == '[') {
+      _depth = 1;
+      _streamDepth = 1;
+      _separator = HPJSONStreamSeparatorArrayStart;
+    } else if (c == '{') {
+      _depth = 1;
+      _topLevelIsObject = YES;
+      _expectingKey = YES;
+    } else {
+      return [self failWithDescription:@"The top-level value is not an array or an object"];
+    }
+    return YES;
+  }
+  switch (c) {
+    case '"':
+      _inString = YES;
+      if (_depth == 1 && _topLevelIsObject && _expectingKey) {
+        _readingKey = YES;
+        [_keyBuffer setLength:0];
+      }
+      break;
+    case ':':
+      if (_depth == 1) {
+        _expectingKey = NO;
+      }
+      break;
+    case ',':
+      if (_depth == 1 && _topLevelIsObject) {
+        _expectingKey = YES;
+      }
+      break;
+    case '[':
+      _depth++;
+      if (_depth == 2 && _topLevelIsObject && _lastKeyIsItemsKey) {
+        _streamDepth = 2;
+        _separator = HPJSONStreamSeparatorArrayStart;
+      }
+      break;
+    case '{':
+      _depth++;
+      break;
+    case ']':
+    case '}':
+      _depth--;
+      break;
+  }
+  return YES;
+}
+
+- (void)appendBytes:(const uint8_t *)bytes length:(NSUInteger)length toSink:(HPJSONStreamSink)sink {
+  if (length == 0) {
+    return;
+  }
+  if (sink == HPJSONStreamSinkElement) {
+    [_elementBuffer appendBytes:bytes length:length];
+  } else if (sink == HPJSONStreamSinkEnvelope) {
+    [_envelopeBuffer appendBytes:bytes length:length];
+  }
+}
+
+/**
+ * Parses the buffered element and hands it over. The buffer keeps its capacity for the next one.
+ */
+- (BOOL)completeElement {
+  _inElement = NO;
+  _elementIsScalar = NO;
+  _maxElementLength = MAX(_maxElementLength, [_elementBuffer length]);
+  @autoreleasepool {
+    NSError *error = nil;
+    id element = [NSJSONSerialization JSONObjectWithData:_elementBuffer
+                                                 options:NSJSONReadingAllowFragments
+                                                   error:&error];
+    [_elementBuffer setLength:0];
+    if (!element) {
+      _error = error;
+      return NO;
+    }
+    _elementCount++;
+    if (_elementHandler) {
+      _elementHandler(element);
+    }
+  }
+  return YES;
+}
+
+- (BOOL)finish {
+  if (_error) {
+    return NO;
+  }
+  _finished = YES;
+  if (!_started || _depth != 0 || _inString || _inElement) {
+    return [self failWithDescription:@"The response ended before the top-level value"];
+  }
+  NSError *error = nil;
+  _envelope = [NSJSONSerialization JSONObjectWithData:_envelopeBuffer options:0 error:&error];
+  if (!_envelope) {
+    _error = error;
+    return NO;
+  }
+  return YES;
+}
+
+- (BOOL)failWithDescription:(NSString *)description {
+  // NSJSONSerialization reports invalid JSON with the same error.
+  _error = [NSError errorWithDomain:NSCocoaErrorDomain
+                               code:NSPropertyListReadCorruptError
+                           userInfo:@{ NSLocalizedDescriptionKey : description }];
+  return NO;
+}
+
+@end
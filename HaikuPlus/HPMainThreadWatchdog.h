@@ -0,0 +1,92 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class HPTraceRecord;
+
+/**
+ * Kinds of completion blocks that HPCommunicator hands to the main queue.
+ */
+typedef NS_ENUM(NSInteger, HPWatchdogStage) {
+  // The success or failure block of a request.
+  HPWatchdogStageDelivery,
+  // The block that shows a feed page read from the on-disk snapshot.
+  HPWatchdogStageCachedDelivery,
+  // The block that receives one haiku of a streamed feed.
+  HPWatchdogStageStreamElement
+};
+
+/**
+ * Called on the main thread for each completion block that ran longer than the frame budget.
+ *
+ * @param endpoint Name of the endpoint of the request, or nil.
+ * @param stage Kind of the block.
+ * @param duration Time the block took.
+ */
+typedef void (^HPStallHandler)(NSString *endpoint, HPWatchdogStage stage, NSTimeInterval duration);
+
+/**
+ * Opt-in detector of main-thread stalls caused by network completion blocks. HPCommunicator runs
+ * each block it hands to the main queue through the watchdog, which times it and flags those that
+ * run longer than a frame. The time and stalls of a block are added to the trace record of its
+ * call, so they reach the trace buffer of the communicator if tracing is on. Blocks on other
+ * queues are run without being timed. Use a watchdog from the main thread only.
+ */
+@interface HPMainThreadWatchdog : NSObject
+
+/**
+ * Longest time a block may take before it counts as a stall. Defaults to one frame at 60 Hz.
+ */
+@property(nonatomic) NSTimeInterval frameBudget;
+
+/**
+ * Number of blocks timed, and how many of them were stalls.
+ */
+@property(nonatomic, readonly) NSUInteger blockCount;
+@property(nonatomic, readonly) NSUInteger stallCount;
+
+/**
+ * Duration of the longest stall so far, or 0.
+ */
+@property(nonatomic, readonly) NSTimeInterval longestStallDuration;
+
+/**
+ * Optional block called for every stall, for example to log it or to fail a test.
+ */
+@property(nonatomic, copy) HPStallHandler stallHandler;
+
+/**
+ * @param stage A kind of completion block.
+ * @return Name of the stage as it appears in trace records, such as @"delivery".
+ */
++ (NSString *)nameOfStage:(HPWatchdogStage)stage;
+
+/**
+ * Runs a completion block, timing it if it runs on the main thread.
+ *
+ * @param block The completion block.
+ * @param stage Kind of the block.
+ * @param endpoint Name of the endpoint of the request, or nil.
+ * @param traceRecord Record of the call that receives the time and stalls of the block, or nil.
+ */
+- (void)runBlock:(dispatch_block_t)block
+           stage:(HPWatchdogStage)stage
+        endpoint:(NSString *)endpoint
+     traceRecord:(HPTraceRecord *)traceRecord;
+
+@end
@@ -0,0 +1,72 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPMainThreadWatchdog.h"
+
+#import "HPTraceBuffer.h"
+
+@implementation HPMainThreadWatchdog
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _frameBudget = 1.0 / 60;
+  }
+  return self;
+}
+
++ (NSString *)nameOfStage:(HPWatchdogStage)stage {
+  switch (stage) {
+    case HPWatchdogStageDelivery:
+      return @"delivery";
+    case HPWatchdogStageCachedDelivery:
+      return @"cached_delivery";
+    case HPWatchdogStageStreamElement:
+      return @"stream_element";
+  }
+  return @"unknown";
+}
+
+- (void)runBlock:(dispatch_block_t)block
+           stage:(HPWatchdogStage)stage
+        endpoint:(NSString *)endpoint
+     traceRecord:(HPTraceRecord *)traceRecord {
+  if (![NSThread isMainThread]) {
+    block();
+    return;
+  }
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  block();
+  NSTimeInterval duration = CFAbsoluteTimeGetCurrent() - start;
+  _blockCount++;
+  traceRecord.mainThreadDuration += duration;
+  if (duration <= _frameBudget) {
+    return;
+  }
+  _stallCount++;
+  _longestStallDuration = MAX(_longestStallDuration, duration);
+  traceRecord.stallCount++;
+  if (duration > traceRecord.longestStallDuration) {
+    traceRecord.longestStallDuration = duration;
+    traceRecord.longestStallStage = [HPMainThreadWatchdog nameOfStage:stage];
+  }
+  if (_stallHandler) {
+    _stallHandler(endpoint, stage, duration);
+  }
+}
+
+@end
@@ -16,6 +16,11 @@
  */
 
 #import "AFHTTPClient.h"
+#import "HPRequestScheduler.h"
+
+@class HPCircuitBreaker;
+@class HPJSONStreamParser;
+@class HPTraceRecord;
 
 /**
  * The HPNetworkClient makes network calls to the Haiku+ server.
@@ -24,4 +29,179 @@
  */
 @interface HPNetworkClient : AFHTTPClient
 
+/**
+ * Turns a JSON response object into model objects.
+ */
+typedef id (^HPResponseDecoder)(id responseObject);
+
+/**
+ * Whether GET requests carry the validators (ETag and Last-Modified) of the previous response
+ * for the same URL. When the server answers 304 Not Modified, the model objects decoded from the
+ * previous response are returned again without decoding anything. Defaults to YES.
+ */
+@property(nonatomic, getter=isConditionalRequestsEnabled) BOOL conditionalRequestsEnabled;
+
+/**
+ * Number of GET requests sent with validators.
+ */
+@property(nonatomic, readonly) NSUInteger conditionalRequestCount;
+
+/**
+ * Number of conditional requests answered with 304 Not Modified.
+ */
+@property(nonatomic, readonly) NSUInteger notModifiedCount;
+
+/**
+ * Number of response body bytes that did not have to be downloaded because of 304 responses.
+ */
+@property(nonatomic, readonly) unsigned long long notModifiedBytes;
+
+/**
+ * Time that would have been spent decoding the responses answered with 304 Not Modified.
+ */
+@property(nonatomic, readonly) NSTimeInterval notModifiedDecodeTime;
+
+/**
+ * Whether requests to the user, haikus, haiku and vote endpoints go through a circuit breaker per
+ * endpoint. While the breaker of an endpoint is open, GET requests are answered with the model
+ * objects of the previous response for the URL if there is one, and other requests fail right
+ * away with kHPErrorDomainServiceUnavailable instead of waiting for a timeout. The timeout of
+ * each request is derived from recent latencies of its endpoint. Defaults to YES.
+ */
+@property(nonatomic, getter=isCircuitBreakersEnabled) BOOL circuitBreakersEnabled;
+
+/**
+ * Number of GET requests answered with previous model objects because a circuit was open.
+ */
+@property(nonatomic, readonly) NSUInteger staleResponseCount;
+
+/**
+ * Scheduler that starts enqueued operations by priority class. Operations run on the
+ * operationQueue once the scheduler starts them.
+ */
+@property(nonatomic, strong, readonly) HPRequestScheduler *scheduler;
+
+/**
+ * Creates an operation whose success block receives decoded model objects. The decoder runs on a
+ * serial background processing queue, never on the main queue, so that large responses do not
+ * hold up the UI. GET requests are made conditional when validators are known for the URL.
+ *
+ * @param request The request to send. Conditional headers are added to it.
+ * @param decoder Block that decodes the response object, or nil to pass it through.
+ * @param completionQueue Queue for the success and failure blocks, or NULL to call them on the
+ *     processing queue right after decoding.
+ * @param success Block that takes the operation and the decoded object.
+ * @param failure Block that takes the operation and an error.
+ * @return The operation to enqueue.
+ */
+- (AFHTTPRequestOperation *)HTTPRequestOperationWithRequest:(NSMutableURLRequest *)request
+    decoder:(HPResponseDecoder)decoder
+    completionQueue:(dispatch_queue_t)completionQueue
+    success:(void (^)(AFHTTPRequestOperation *operation, id decodedObject))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure;
+
+/**
+ * Same as HTTPRequestOperationWithRequest:decoder:completionQueue:success:failure:, and stamps the
+ * network, parsing and decoding stages of the request in a trace record.
+ *
+ * @param traceRecord Record to stamp, or nil.
+ */
+- (AFHTTPRequestOperation *)HTTPRequestOperationWithRequest:(NSMutableURLRequest *)request
+    decoder:(HPResponseDecoder)decoder
+    traceRecord:(HPTraceRecord *)traceRecord
+    completionQueue:(dispatch_queue_t)completionQueue
+    success:(void (^)(AFHTTPRequestOperation *operation, id decodedObject))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure;
+
+/**
+ * Creates an operation that decodes the elements of a JSON feed as the response arrives, instead
+ * of waiting for the whole body. Parsing and decoding run on the processing queue, and each
+ * decoded element is handed over in order before the success block is called. Peak memory depends
+ * on the size of one element rather than on the size of the feed. Streamed requests are never
+ * conditional, because the decoded feed is not kept.
+ *
+ * If the request fails after some elements have been handed over, the failure block is called
+ * and the elements already handed over remain valid.
+ *
+ * @param request The request to send.
+ * @param itemsKey Name of the feed array when the response is an object, or nil if only a
+ *     top-level array is streamed.
+ * @param elementDecoder Block that decodes one element, or nil to pass it through. Elements it
+ *     decodes to nil are skipped.
+ * @param completionQueue Queue for the element, success and failure blocks, or NULL to call them
+ *     on the processing queue.
+ * @param element Block that takes one decoded element.
+ * @param success Block that takes the operation and the response with the feed array emptied.
+ * @param failure Block that takes the operation and an error.
+ * @return The operation to enqueue.
+ */
+- (AFHTTPRequestOperation *)streamingRequestOperationWithRequest:(NSMutableURLRequest *)request
+    itemsKey:(NSString *)itemsKey
+    elementDecoder:(HPResponseDecoder)elementDecoder
+    completionQueue:(dispatch_queue_t)completionQueue
+    element:(void (^)(id decodedElement))element
+    success:(void (^)(AFHTTPRequestOperation *operation, id envelope))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure;
+
+/**
+ * Same as streamingRequestOperationWithRequest:itemsKey:elementDecoder:completionQueue:element:
+ * success:failure:, and stamps the network, parsing and decoding stages of the request in a trace
+ * record.
+ *
+ * @param traceRecord Record to stamp, or nil.
+ */
+- (AFHTTPRequestOperation *)streamingRequestOperationWithRequest:(NSMutableURLRequest *)request
+    itemsKey:(NSString *)itemsKey
+    elementDecoder:(HPResponseDecoder)elementDecoder
+    traceRecord:(HPTraceRecord *)traceRecord
+    completionQueue:(dispatch_queue_t)completionQueue
+    element:(void (^)(id decodedElement))element
+    success:(void (^)(AFHTTPRequestOperation *operation, id envelope))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure;
+
+/**
+ * Creates the operation behind streamingRequestOperationWithRequest:. The operation feeds the
+ * body of a successful response to the parser, and calls the success block once the whole body
+ * has been appended. Subclasses that do not use the network override this.
+ *
+ * @param request The request to send.
+ * @param parser Parser for the response body.
+ * @param success Block that takes the operation and the response data, which may be empty.
+ * @param failure Block that takes the operation and an error.
+ * @return The operation to enqueue.
+ */
+- (AFHTTPRequestOperation *)HTTPRequestOperationWithRequest:(NSURLRequest *)request
+    streamParser:(HPJSONStreamParser *)parser
+    success:(void (^)(AFHTTPRequestOperation *operation, id responseObject))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure;
+
+/**
+ * Queues an operation in a priority class of the scheduler. enqueueHTTPRequestOperation: queues
+ * operations as HPRequestPriorityVisible.
+ *
+ * @param operation The operation, or nil to do nothing.
+ * @param priority Class of the operation.
+ */
+- (void)enqueueHTTPRequestOperation:(AFHTTPRequestOperation *)operation
+                           priority:(HPRequestPriority)priority;
+
+/**
+ * @param endpoint One of the endpoint names in HPConstants, such as kHPConstantsHaikuEndpoint.
+ * @return The circuit breaker of the endpoint, to tune it or read its counters, or nil for an
+ *     unknown endpoint.
+ */
+- (HPCircuitBreaker *)circuitBreakerForEndpoint:(NSString *)endpoint;
+
+/**
+ * @param path Path of a request URL.
+ * @return Name of the endpoint the path belongs to, one of the endpoint names in HPConstants, or
+ *     nil.
+ */
+- (NSString *)endpointForPath:(NSString *)path;
+
+/**
+ * Forgets every stored validator and decoded object, for example after the user signs out.
+ */
+- (void)removeAllValidators;
+
 @end
@@ -18,21 +18,474 @@
 #import "HPNetworkClient.h"
 
 #import "AFImageRequestOperation.h"
-#import "AFJSONRequestOperation.h"
+#import "HPCircuitBreaker.h"
+#import "HPConstants.h"
+#import "HPJSONRequestOperation.h"
+#import "HPJSONStreamParser.h"
+#import "HPRetryPolicy.h"
+#import "HPStreamingRequestOperation.h"
+#import "HPTraceBuffer.h"
 
-@implementation HPNetworkClient
+/**
+ * Maximum number of URLs for which validators and decoded objects are kept in memory.
+ */
+static const NSUInteger kHPNetworkClientValidatorCountLimit = 64;
+
+/**
+ * Validators and decoded model objects of the last successful response for a URL.
+ */
+@interface HPValidatedResponse : NSObject
+
+@property(nonatomic, copy) NSString *entityTag;
+@property(nonatomic, copy) NSString *lastModified;
+@property(nonatomic, strong) id decodedObject;
+@property(nonatomic) NSUInteger byteCount;
+@property(nonatomic) NSTimeInterval decodeTime;
+
+@end
+
+@implementation HPValidatedResponse
+
+@end
+
+@implementation HPNetworkClient {
+  NSCache *_validatedResponses;
+  dispatch_queue_t _processingQueue;
+  // Map from endpoint name to its HPCircuitBreaker. Never changed after init.
+  NSDictionary *_circuitBreakers;
+  // Map from operation to the time it was created, replaced by the time the scheduler started it.
+  // Guarded by @synchronized.
+  NSMapTable *_operationStartTimes;
+}
 
 - (id)initWithBaseURL:(NSURL *)url {
   self = [super initWithBaseURL:url];
   if (self) {
-    [self registerHTTPOperationClass:[AFJSONRequestOperation class]];
+    [self registerHTTPOperationClass:[HPJSONRequestOperation class]];
     [self setParameterEncoding:AFJSONParameterEncoding];
 
     // Accept HTTP Header; see http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.1
     [self setDefaultHeader:@"Accept" value:@"application/json"];
+
+    _validatedResponses = [[NSCache alloc] init];
+    [_validatedResponses setCountLimit:kHPNetworkClientValidatorCountLimit];
+    _conditionalRequestsEnabled = YES;
+    _processingQueue = dispatch_queue_create(
+        "com.google.plus.samples.HaikuPlus.HPNetworkClient.processing", DISPATCH_QUEUE_SERIAL);
+    // The scheduler limits concurrency by class, and the operation queue only runs what it starts.
+    _scheduler = [[HPRequestScheduler alloc] initWithExecutionQueue:self.operationQueue];
+    _circuitBreakersEnabled = YES;
+    _circuitBreakers = @{
+      kHPConstantsUserEndpoint : [[HPCircuitBreaker alloc] init],
+      kHPConstantsHaikusEndpoint : [[HPCircuitBreaker alloc] init],
+      kHPConstantsHaikuEndpoint : [[HPCircuitBreaker alloc] init],
+      kHPConstantsHaikuVoteEndpoint : [[HPCircuitBreaker alloc] init]
+    };
+    _operationStartTimes = [NSMapTable weakToStrongObjectsMapTable];
+    __weak HPNetworkClient *weakSelf = self;
+    _scheduler.startHandler = ^(NSOperation *operation) {
+        [weakSelf operationWillStart:operation];
+    };
   }
 
   return self;
 }
 
+#pragma mark - Scheduling
+
+- (void)enqueueHTTPRequestOperation:(AFHTTPRequestOperation *)operation {
+  [self enqueueHTTPRequestOperation:operation priority:HPRequestPriorityVisible];
+}
+
+- (void)enqueueHTTPRequestOperation:(AFHTTPRequestOperation *)operation
+                           priority:(HPRequestPriority)priority {
+  if (!operation) {
+    return;
+  }
+  [_scheduler addOperation:operation priority:priority];
+}
+
+#pragma mark - Conditional requests
+
+- (AFHTTPRequestOperation *)HTTPRequestOperationWithRequest:(NSMutableURLRequest *)request
+    decoder:(HPResponseDecoder)decoder
+    completionQueue:(dispatch_queue_t)completionQueue
+    success:(void (^)(AFHTTPRequestOperation *operation, id decodedObject))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure {
+  return [self HTTPRequestOperationWithRequest:request
+                                       decoder:decoder
+                                   traceRecord:nil
+                               completionQueue:completionQueue
+                                       success:success
+                                       failure:failure];
+}
+
+- (AFHTTPRequestOperation *)HTTPRequestOperationWithRequest:(NSMutableURLRequest *)request
+    decoder:(HPResponseDecoder)decoder
+    traceRecord:(HPTraceRecord *)traceRecord
+    completionQueue:(dispatch_queue_t)completionQueue
+    success:(void (^)(AFHTTPRequestOperation *operation, id decodedObject))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure {
+  BOOL isValidatable = _conditionalRequestsEnabled && [[request HTTPMethod] isEqual:@"GET"];
+  NSString *key = [[request URL] absoluteString];
+  HPValidatedResponse *previous = nil;
+  if (isValidatable && key) {
+    previous = [_validatedResponses objectForKey:key];
+  }
+
+  void (^deliver)(AFHTTPRequestOperation *, id, NSError *) =
+      ^(AFHTTPRequestOperation *operation, id decodedObject, NSError *error) {
+          void (^handler)(void) = ^{
+            if (error) {
+              failure(operation, error);
+            } else {
+              success(operation, decodedObject);
+            }
+          };
+          if (completionQueue) {
+            dispatch_async(completionQueue, handler);
+          } else {
+            handler();
+          }
+      };
+
+  HPCircuitBreaker *breaker = [self circuitBreakerForRequest:request];
+  if (breaker && ![breaker allowRequest]) {
+    // Answer asynchronously, as if the request had been sent.
+    dispatch_async(_processingQueue, ^{
+        if (previous) {
+          _staleResponseCount++;
+          deliver(nil, previous.decodedObject, nil);
+        } else {
+          deliver(nil, nil, [self serviceUnavailableError]);
+        }
+    });
+    return nil;
+  }
+  if (breaker) {
+    [request setTimeoutInterval:MIN([request timeoutInterval], [breaker timeoutInterval])];
+  }
+
+  if (previous) {
+    // See http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.26
+    if (previous.entityTag) {
+      [request setValue:previous.entityTag forHTTPHeaderField:@"If-None-Match"];
+    }
+    if (previous.lastModified) {
+      [request setValue:previous.lastModified forHTTPHeaderField:@"If-Modified-Since"];
+    }
+    // The 304 response must reach this client instead of being answered by the URL cache.
+    [request setCachePolicy:NSURLRequestReloadIgnoringLocalCacheData];
+    _conditionalRequestCount++;
+  }
+
+  AFHTTPRequestOperation *operation = [self HTTPRequestOperationWithRequest:request
+      success:^(AFHTTPRequestOperation *operation, id responseObject) {
+          [self recordOutcomeOfOperation:operation error:nil inCircuitBreaker:breaker];
+          // AFJSONRequestOperation parses the body before calling this block.
+          [self traceRecord:traceRecord reachedStage:HPTraceStageParsed operation:operation];
+          CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+          id decodedObject = decoder ? decoder(responseObject) : responseObject;
+          NSTimeInterval decodeTime = CFAbsoluteTimeGetCurrent() - start;
+          [traceRecord markStage:HPTraceStageDecoded];
+          if (isValidatable && key && decodedObject) {
+            [self storeValidatorsFromOperation:operation
+                                 decodedObject:decodedObject
+                                    decodeTime:decodeTime
+                                        forKey:key];
+          }
+          deliver(operation, decodedObject, nil);
+      }
+      failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+          traceRecord.statusCode = [[operation response] statusCode];
+          if (previous && [[operation response] statusCode] == 304) {
+            [self recordOutcomeOfOperation:operation error:nil inCircuitBreaker:breaker];
+            // Not Modified: the previous model objects are still current.
+            _notModifiedCount++;
+            _notModifiedBytes += previous.byteCount;
+            _notModifiedDecodeTime += previous.decodeTime;
+            deliver(operation, previous.decodedObject, nil);
+          } else {
+            [self recordOutcomeOfOperation:operation error:error inCircuitBreaker:breaker];
+            deliver(operation, nil, error);
+          }
+      }];
+  // AFNetworking calls completion blocks on the main queue by default. Decoding happens in those
+  // blocks, so move them to the processing queue.
+  operation.successCallbackQueue = _processingQueue;
+  operation.failureCallbackQueue = _processingQueue;
+  if (breaker) {
+    [self trackStartOfOperation:operation];
+  }
+  [self setTraceRecord:traceRecord ofOperation:operation];
+  return operation;
+}
+
+/**
+ * Remembers the validators of a successful response along with the objects decoded from it.
+ * Responses without validators are forgotten.
+ */
+- (void)storeValidatorsFromOperation:(AFHTTPRequestOperation *)operation
+                       decodedObject:(id)decodedObject
+                          decodeTime:(NSTimeInterval)decodeTime
+                              forKey:(NSString *)key {
+  NSDictionary *headers = [[operation response] allHeaderFields];
+  NSString *entityTag = [headers objectForKey:@"ETag"];
+  NSString *lastModified = [headers objectForKey:@"Last-Modified"];
+  if (!entityTag && !lastModified) {
+    [_validatedResponses removeObjectForKey:key];
+    return;
+  }
+  HPValidatedResponse *validated = [[HPValidatedResponse alloc] init];
+  validated.entityTag = entityTag;
+  validated.lastModified = lastModified;
+  validated.decodedObject = decodedObject;
+  validated.byteCount = [[operation responseData] length];
+  validated.decodeTime = decodeTime;
+  [_validatedResponses setObject:validated forKey:key];
+}
+
+#pragma mark - Streaming
+
+- (AFHTTPRequestOperation *)streamingRequestOperationWithRequest:(NSMutableURLRequest *)request
+    itemsKey:(NSString *)itemsKey
+    elementDecoder:(HPResponseDecoder)elementDecoder
+    completionQueue:(dispatch_queue_t)completionQueue
+    element:(void (^)(id decodedElement))element
+    success:(void (^)(AFHTTPRequestOperation *operation, id envelope))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure {
+  return [self streamingRequestOperationWithRequest:request
+                                           itemsKey:itemsKey
+                                     elementDecoder:elementDecoder
+                                        traceRecord:nil
+                                    completionQueue:completionQueue
+                                            element:element
+                                            success:success
+                                            failure:failure];
+}
+
+- (AFHTTPRequestOperation *)streamingRequestOperationWithRequest:(NSMutableURLRequest *)request
+    itemsKey:(NSString *)itemsKey
+    elementDecoder:(HPResponseDecoder)elementDecoder
+    traceRecord:(HPTraceRecord *)traceRecord
+    completionQueue:(dispatch_queue_t)completionQueue
+    element:(void (^)(id decodedElement))element
+    success:(void (^)(AFHTTPRequestOperation *operation, id envelope))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure {
+  void (^deliver)(void (^)(void)) = ^(void (^handler)(void)) {
+      if (completionQueue) {
+        dispatch_async(completionQueue, handler);
+      } else {
+        handler();
+      }
+  };
+  HPCircuitBreaker *breaker = [self circuitBreakerForRequest:request];
+  if (breaker && ![breaker allowRequest]) {
+    // A stream has no previous response to fall back on.
+    dispatch_async(_processingQueue, ^{
+        deliver(^{
+            failure(nil, [self serviceUnavailableError]);
+        });
+    });
+    return nil;
+  }
+  if (breaker) {
+    [request setTimeoutInterval:MIN([request timeoutInterval], [breaker timeoutInterval])];
+  }
+  HPJSONStreamParser *parser = [[HPJSONStreamParser alloc] initWithItemsKey:itemsKey];
+  parser.elementHandler = ^(id parsedElement) {
+      id decodedElement = elementDecoder ? elementDecoder(parsedElement) : parsedElement;
+      if (decodedElement) {
+        deliver(^{
+            element(decodedElement);
+        });
+      }
+  };
+  AFHTTPRequestOperation *operation = [self HTTPRequestOperationWithRequest:request
+      streamParser:parser
+      success:^(AFHTTPRequestOperation *operation, id responseObject) {
+          [self recordOutcomeOfOperation:operation error:nil inCircuitBreaker:breaker];
+          // Every chunk has been appended by now, because chunks are parsed on this queue.
+          BOOL isParsed = [parser finish];
+          // Elements are decoded as they are parsed, so both stages end together.
+          [self traceRecord:traceRecord reachedStage:HPTraceStageParsed operation:operation];
+          [traceRecord markStage:HPTraceStageDecoded];
+          if (isParsed) {
+            deliver(^{
+                success(operation, parser.envelope);
+            });
+          } else {
+            deliver(^{
+                failure(operation, parser.error);
+            });
+          }
+      }
+      failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+          [self recordOutcomeOfOperation:operation error:error inCircuitBreaker:breaker];
+          deliver(^{
+              failure(operation, error);
+          });
+      }];
+  if (breaker) {
+    [self trackStartOfOperation:operation];
+  }
+  [self setTraceRecord:traceRecord ofOperation:operation];
+  return operation;
+}
+
+- (AFHTTPRequestOperation *)HTTPRequestOperationWithRequest:(NSURLRequest *)request
+    streamParser:(HPJSONStreamParser *)parser
+    success:(void (^)(AFHTTPRequestOperation *operation, id responseObject))success
+    failure:(void (^)(AFHTTPRequestOperation *operation, NSError *error))failure {
+  HPStreamingRequestOperation *operation =
+      [[HPStreamingRequestOperation alloc] initWithRequest:request];
+  operation.parser = parser;
+  operation.parsingQueue = _processingQueue;
+  [operation setCompletionBlockWithSuccess:success failure:failure];
+  // The same settings AFHTTPClient applies to the operations it creates.
+  operation.credential = self.defaultCredential;
+#ifdef _AFNETWORKING_PIN_SSL_CERTIFICATES_
+  operation.SSLPinningMode = self.defaultSSLPinningMode;
+#endif
+  operation.allowsInvalidSSLCertificate = self.allowsInvalidSSLCertificate;
+  operation.successCallbackQueue = _processingQueue;
+  operation.failureCallbackQueue = _processingQueue;
+  return operation;
+}
+
+- (void)removeAllValidators {
+  [_validatedResponses removeAllObjects];
+}
+
+#pragma mark - Tracing
+
+/**
+ * Lets an operation stamp the network stages of a trace record, if it knows how.
+ */
+- (void)setTraceRecord:(HPTraceRecord *)traceRecord
+           ofOperation:(AFHTTPRequestOperation *)operation {
+  if (traceRecord && [operation conformsToProtocol:@protocol(HPTracedOperation)]) {
+    [(id<HPTracedOperation>)operation setTraceRecord:traceRecord];
+  }
+}
+
+/**
+ * Stamps a stage reached after the response arrived, and fills in what an operation that does
+ * not stamp its own network stages, such as a simulated one, leaves out.
+ */
+- (void)traceRecord:(HPTraceRecord *)traceRecord
+       reachedStage:(HPTraceStage)stage
+          operation:(AFHTTPRequestOperation *)operation {
+  if (!traceRecord) {
+    return;
+  }
+  [traceRecord markStage:stage];
+  if (traceRecord.statusCode == 0) {
+    traceRecord.statusCode = [[operation response] statusCode];
+  }
+  if (traceRecord.responseByteCount == 0) {
+    traceRecord.responseByteCount = [[operation responseData] length];
+  }
+}
+
+#pragma mark - Circuit breakers
+
+- (HPCircuitBreaker *)circuitBreakerForEndpoint:(NSString *)endpoint {
+  return endpoint ? [_circuitBreakers objectForKey:endpoint] : nil;
+}
+
+/**
+ * @param request A request to the Haiku+ server.
+ * @return The circuit breaker of the endpoint of the request, or nil if the request does not go
+ *     through one.
+ */
+- (HPCircuitBreaker *)circuitBreakerForRequest:(NSURLRequest *)request {
+  if (!_circuitBreakersEnabled) {
+    return nil;
+  }
+  return [self circuitBreakerForEndpoint:[self endpointForPath:[[request URL] path]]];
+}
+
+- (NSString *)endpointForPath:(NSString *)path {
+  if ([path isEqual:kHPConstantsUserPath]) {
+    return kHPConstantsUserEndpoint;
+  }
+  if ([path isEqual:kHPConstantsHaikusPath]) {
+    return kHPConstantsHaikusEndpoint;
+  }
+  NSString *prefix = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @""];
+  if (![path hasPrefix:prefix]) {
+    return nil;
+  }
+  NSArray *components = [[path substringFromIndex:[prefix length]] pathComponents];
+  if ([components count] == 1) {
+    return kHPConstantsHaikuEndpoint;
+  }
+  if ([components count] == 2 && [[components lastObject] isEqual:@"vote"]) {
+    return kHPConstantsHaikuVoteEndpoint;
+  }
+  return nil;
+}
+
+/**
+ * Tells the circuit breaker how a request went. Failures that say nothing about the health of
+ * the endpoint, such as 404 Not Found, count as successes.
+ *
+ * @param operation The finished operation.
+ * @param error Error of the operation, or nil if it succeeded.
+ * @param breaker Circuit breaker of the endpoint, or nil.
+ */
+- (void)recordOutcomeOfOperation:(AFHTTPRequestOperation *)operation
+                           error:(NSError *)error
+                inCircuitBreaker:(HPCircuitBreaker *)breaker {
+  if (!breaker || !operation) {
+    return;
+  }
+  NSTimeInterval latency = 0;
+  @synchronized(_operationStartTimes) {
+    NSNumber *startTime = [_operationStartTimes objectForKey:operation];
+    if (startTime) {
+      latency = CFAbsoluteTimeGetCurrent() - [startTime doubleValue];
+      [_operationStartTimes removeObjectForKey:operation];
+    }
+  }
+  if ([[error domain] isEqual:NSURLErrorDomain] && [error code] == NSURLErrorCancelled) {
+    [breaker recordCancellation];
+  } else if (error && [HPRetryPolicy isTransientError:error response:[operation response]]) {
+    [breaker recordFailureWithLatency:latency];
+  } else {
+    [breaker recordSuccessWithLatency:latency];
+  }
+}
+
+/**
+ * Remembers when an operation was created, until the scheduler starts it.
+ */
+- (void)trackStartOfOperation:(AFHTTPRequestOperation *)operation {
+  if (!operation) {
+    return;
+  }
+  @synchronized(_operationStartTimes) {
+    [_operationStartTimes setObject:@(CFAbsoluteTimeGetCurrent()) forKey:operation];
+  }
+}
+
+/**
+ * Called by the scheduler right before an operation starts, so that latencies do not include the
+ * time spent waiting behind more urgent work.
+ */
+- (void)operationWillStart:(NSOperation *)operation {
+  @synchronized(_operationStartTimes) {
+    if ([_operationStartTimes objectForKey:operation]) {
+      [_operationStartTimes setObject:@(CFAbsoluteTimeGetCurrent()) forKey:operation];
+    }
+  }
+}
+
+- (NSError *)serviceUnavailableError {
+  return [NSError errorWithDomain:kHPErrorDomain
+                             code:kHPErrorDomainServiceUnavailable
+                         userInfo:nil];
+}
+
 @end
@@ -19,6 +19,16 @@
  * Each property matches the name of a field in a response from the server.
  * Subclasses can dynamically load data from NSDictionary objects. Key values of "id" will be
  * translated to properties named |identifier| because |id| is a keyword in Objective-C.
+ *
+ * The first time a subclass is used it builds a schema from its declared properties, including
+ * those of its superclasses up to HPObject. The schema holds the key, setter, getter and type
+ * of each property, so decoding and encoding call accessors directly instead of going through
+ * reflection or key-value coding for every object. Values are coerced to the property type:
+ * - NSString properties accept strings, and numbers as their string value.
+ * - Integer, floating-point and BOOL properties accept numbers and numeric strings.
+ * - NSDate properties accept timestamps in kHPConstantsAPIDateFormat.
+ * - HPObject properties accept attribute dictionaries.
+ * NSNull and values of the wrong type clear the property. Keys without a property are ignored.
  */
 @interface HPObject : NSObject
 
@@ -33,7 +43,7 @@
 - (id)initWithAttributes:(NSDictionary *)attributes;
 
 /**
- * @return Dictionary of object attributes.
+ * @return Dictionary of object attributes. Properties without a value are NSNull.
  */
 - (NSDictionary *)attributesDictionary;
 
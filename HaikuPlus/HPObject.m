@@ -16,43 +16,409 @@
  */
 
 #import <objc/runtime.h>
+#import <pthread.h>
 
 #import "HPObject.h"
 
+#import "HPDateCodec.h"
+
+/**
+ * How a property's value is decoded and encoded.
+ */
+typedef NS_ENUM(NSInteger, HPObjectFieldType) {
+  HPObjectFieldTypeObject,
+  HPObjectFieldTypeString,
+  HPObjectFieldTypeNumber,
+  HPObjectFieldTypeDate,
+  HPObjectFieldTypeModel,
+  HPObjectFieldTypeInteger,
+  HPObjectFieldTypeFloat,
+  HPObjectFieldTypeBool
+};
+
+/**
+ * One property of a schema. Object pointers are kept alive by the schema.
+ */
+typedef struct {
+  __unsafe_unretained NSString *key;
+  __unsafe_unretained Class modelClass;
+  HPObjectFieldType type;
+  // Objective-C type encoding of a scalar property, such as 'q' for NSInteger on 64-bit.
+  char encoding;
+  SEL getter;
+  IMP getterIMP;
+  // NULL for readonly properties.
+  SEL setter;
+  IMP setterIMP;
+} HPObjectField;
+
+/**
+ * Accessors of every property of an HPObject subclass, built once per class.
+ */
+@interface HPObjectSchema : NSObject {
+ @public
+  HPObjectField *_fields;
+  NSUInteger _count;
+}
+
+- (id)initWithClass:(Class)cls;
+
+@end
+
+@implementation HPObjectSchema {
+  // Keeps the keys in |_fields| alive.
+  NSMutableArray *_keys;
+}
+
+- (id)initWithClass:(Class)cls {
+  self = [super init];
+  if (self) {
+    _keys = [NSMutableArray array];
+    NSMutableSet *names = [NSMutableSet set];
+    NSMutableData *fields = [NSMutableData data];
+    // Subclasses come first, so a redeclared property uses the subclass accessors.
+    for (Class current = cls; current; current = class_getSuperclass(current)) {
+      unsigned int propertyCount = 0;
+      objc_property_t *properties = class_copyPropertyList(current, &propertyCount);
+      for (unsigned int i = 0; i < propertyCount; i++) {
+        NSString *name = [NSString stringWithUTF8String:property_getName(properties[i])];
+        if ([names containsObject:name]) {
+          continue;
+        }
+        [names addObject:name];
+        HPObjectField field;
+        if ([self getField:&field forProperty:properties[i] name:name inClass:cls]) {
+          [fields appendBytes:&field length:sizeof(field)];
+        }
+      }
+      free(properties);
+      if (current == [HPObject class]) {
+        break;
+      }
+    }
+    _count = [fields length] / sizeof(HPObjectField);
+    _fields = malloc(MAX([fields length], 1));
+    memcpy(_fields, [fields bytes], [fields length]);
+  }
+  return self;
+}
+
+- (void)dealloc {
+  free(_fields);
+}
+
+/**
+ * Fills in a field from a property declaration.
+ *
+ * @return NO if the property cannot be decoded or encoded.
+ */
+- (BOOL)getField:(HPObjectField *)field
+     forProperty:(objc_property_t)property
+            name:(NSString *)name
+         inClass:(Class)cls {
+  memset(field, 0, sizeof(*field));
+  char *typeEncoding = property_copyAttributeValue(property, "T");
+  if (!typeEncoding) {
+    return NO;
+  }
+  BOOL supported = YES;
+  switch (typeEncoding[0]) {
+    case '@': {
+      // Object types are encoded as @"ClassName".
+      Class valueClass = Nil;
+      size_t length = strlen(typeEncoding);
+      if (length > 3) {
+        NSString *className = [[NSString alloc] initWithBytes:typeEncoding + 2
+                                                       length:length - 3
+                                                     encoding:NSUTF8StringEncoding];
+        valueClass = NSClassFromString(className);
+      }
+      if (valueClass && [valueClass isSubclassOfClass:[NSString class]]) {
+        field->type = HPObjectFieldTypeString;
+      } else if (valueClass && [valueClass isSubclassOfClass:[NSNumber class]]) {
+        field->type = HPObjectFieldTypeNumber;
+      } else if (valueClass && [valueClass isSubclassOfClass:[NSDate class]]) {
+        field->type = HPObjectFieldTypeDate;
+      } else if (valueClass && [valueClass isSubclassOfClass:[HPObject class]]) {
+        field->type = HPObjectFieldTypeModel;
+        field->modelClass = valueClass;
+      } else {
+        field->type = HPObjectFieldTypeObject;
+      }
+      break;
+    }
+    case 'c':
+    case 'B':
+      field->type = HPObjectFieldTypeBool;
+      break;
+    case 's':
+    case 'i':
+    case 'l':
+    case 'q':
+    case 'C':
+    case 'S':
+    case 'I':
+    case 'L':
+    case 'Q':
+      field->type = HPObjectFieldTypeInteger;
+      break;
+    case 'f':
+    case 'd':
+      field->type = HPObjectFieldTypeFloat;
+      break;
+    default:
+      supported = NO;
+      break;
+  }
+  field->encoding = typeEncoding[0];
+  free(typeEncoding);
+  if (!supported) {
+    return NO;
+  }
+
+  char *getterName = property_copyAttributeValue(property, "G");
+  field->getter = getterName ? sel_registerName(getterName) : NSSelectorFromString(name);
+  free(getterName);
+  if (![cls instancesRespondToSelector:field->getter]) {
+    return NO;
+  }
+  field->getterIMP = class_getMethodImplementation(cls, field->getter);
+
+  char *readonly = property_copyAttributeValue(property, "R");
+  if (readonly) {
+    free(readonly);
+  } else {
+    char *setterName = property_copyAttributeValue(property, "S");
+    if (setterName) {
+      field->setter = sel_registerName(setterName);
+      free(setterName);
+    } else {
+      NSString *selectorName =
+          [NSString stringWithFormat:@"set%@%@:", [[name substringToIndex:1] uppercaseString],
+                                     [name substringFromIndex:1]];
+      field->setter = NSSelectorFromString(selectorName);
+    }
+    if ([cls instancesRespondToSelector:field->setter]) {
+      field->setterIMP = class_getMethodImplementation(cls, field->setter);
+    } else {
+      field->setter = NULL;
+    }
+  }
+
+  // Properties named "identifier" are designed to be called "id" in an NSDictionary.
+  NSString *key = [name isEqual:@"identifier"] ? @"id" : name;
+  [_keys addObject:key];
+  field->key = key;
+  return YES;
+}
+
+@end
+
+#pragma mark - Accessors
+
+static void HPObjectSetInteger(id object, const HPObjectField *field, long long value) {
+  SEL setter = field->setter;
+  IMP imp = field->setterIMP;
+  switch (field->encoding) {
+    case 's': ((void (*)(id, SEL, short))imp)(object, setter, (short)value); break;
+    case 'i': ((void (*)(id, SEL, int))imp)(object, setter, (int)value); break;
+    case 'l': ((void (*)(id, SEL, long))imp)(object, setter, (long)value); break;
+    case 'q': ((void (*)(id, SEL, long long))imp)(object, setter, value); break;
+    case 'C':
+      ((void (*)(id, SEL, unsigned char))imp)(object, setter, (unsigned char)value);
+      break;
+    case 'S':
+      ((void (*)(id, SEL, unsigned short))imp)(object, setter, (unsigned short)value);
+      break;
+    case 'I':
+      ((void (*)(id, SEL, unsigned int))imp)(object, setter, (unsigned int)value);
+      break;
+    case 'L':
+      ((void (*)(id, SEL, unsigned long))imp)(object, setter, (unsigned long)value);
+      break;
+    case 'Q':
+      ((void (*)(id, SEL, unsigned long long))imp)(object, setter, (unsigned long long)value);
+      break;
+  }
+}
+
+static NSNumber *HPObjectGetInteger(id object, const HPObjectField *field) {
+  SEL getter = field->getter;
+  IMP imp = field->getterIMP;
+  switch (field->encoding) {
+    case 's': return @(((short (*)(id, SEL))imp)(object, getter));
+    case 'i': return @(((int (*)(id, SEL))imp)(object, getter));
+    case 'l': return @(((long (*)(id, SEL))imp)(object, getter));
+    case 'q': return @(((long long (*)(id, SEL))imp)(object, getter));
+    case 'C': return @(((unsigned char (*)(id, SEL))imp)(object, getter));
+    case 'S': return @(((unsigned short (*)(id, SEL))imp)(object, getter));
+    case 'I': return @(((unsigned int (*)(id, SEL))imp)(object, getter));
+    case 'L': return @(((unsigned long (*)(id, SEL))imp)(object, getter));
+    case 'Q': return @(((unsigned long long (*)(id, SEL))imp)(object, getter));
+  }
+  return nil;
+}
+
+/**
+ * Sets one property from a decoded JSON value, coercing it to the property type.
+ */
+static void HPObjectSetValue(id object, const HPObjectField *field, id value) {
+  SEL setter = field->setter;
+  IMP imp = field->setterIMP;
+  BOOL isString = [value isKindOfClass:[NSString class]];
+  BOOL isNumber = !isString && [value isKindOfClass:[NSNumber class]];
+  switch (field->type) {
+    case HPObjectFieldTypeString: {
+      NSString *string = isString ? value : (isNumber ? [value stringValue] : nil);
+      ((void (*)(id, SEL, id))imp)(object, setter, string);
+      break;
+    }
+    case HPObjectFieldTypeNumber: {
+      NSNumber *number = isNumber ? value : (isString ? @([value doubleValue]) : nil);
+      ((void (*)(id, SEL, id))imp)(object, setter, number);
+      break;
+    }
+    case HPObjectFieldTypeDate: {
+      NSDate *date = isString ? [HPDateCodec dateFromAPIString:value] : nil;
+      if (!date && [value isKindOfClass:[NSDate class]]) {
+        date = value;
+      }
+      ((void (*)(id, SEL, id))imp)(object, setter, date);
+      break;
+    }
+    case HPObjectFieldTypeModel: {
+      id model = nil;
+      if ([value isKindOfClass:[NSDictionary class]]) {
+        model = [[field->modelClass alloc] initWithAttributes:value];
+      } else if ([value isKindOfClass:field->modelClass]) {
+        model = value;
+      }
+      ((void (*)(id, SEL, id))imp)(object, setter, model);
+      break;
+    }
+    case HPObjectFieldTypeObject:
+      ((void (*)(id, SEL, id))imp)(object, setter, value == [NSNull null] ? nil : value);
+      break;
+    case HPObjectFieldTypeInteger:
+      // NSString and NSNumber both answer -longLongValue, as key-value coding relies on.
+      HPObjectSetInteger(object, field, (isString || isNumber) ? [value longLongValue] : 0);
+      break;
+    case HPObjectFieldTypeFloat: {
+      double number = (isString || isNumber) ? [value doubleValue] : 0;
+      if (field->encoding == 'f') {
+        ((void (*)(id, SEL, float))imp)(object, setter, (float)number);
+      } else {
+        ((void (*)(id, SEL, double))imp)(object, setter, number);
+      }
+      break;
+    }
+    case HPObjectFieldTypeBool: {
+      BOOL flag = (isString || isNumber) ? [value boolValue] : NO;
+      if (field->encoding == 'B') {
+        ((void (*)(id, SEL, bool))imp)(object, setter, flag);
+      } else {
+        ((void (*)(id, SEL, char))imp)(object, setter, (char)flag);
+      }
+      break;
+    }
+  }
+}
+
+/**
+ * @return One property as a JSON value, or nil if the property has no value.
+ */
+static id HPObjectGetValue(id object, const HPObjectField *field) {
+  SEL getter = field->getter;
+  IMP imp = field->getterIMP;
+  switch (field->type) {
+    case HPObjectFieldTypeString:
+    case HPObjectFieldTypeNumber:
+    case HPObjectFieldTypeObject:
+      return ((id (*)(id, SEL))imp)(object, getter);
+    case HPObjectFieldTypeDate:
+      return [HPDateCodec APIStringFromDate:((id (*)(id, SEL))imp)(object, getter)];
+    case HPObjectFieldTypeModel:
+      return [((id (*)(id, SEL))imp)(object, getter) attributesDictionary];
+    case HPObjectFieldTypeInteger:
+      return HPObjectGetInteger(object, field);
+    case HPObjectFieldTypeFloat:
+      if (field->encoding == 'f') {
+        return @(((float (*)(id, SEL))imp)(object, getter));
+      }
+      return @(((double (*)(id, SEL))imp)(object, getter));
+    case HPObjectFieldTypeBool:
+      if (field->encoding == 'B') {
+        return @(((bool (*)(id, SEL))imp)(object, getter));
+      }
+      return @((BOOL)((char (*)(id, SEL))imp)(object, getter));
+  }
+  return nil;
+}
+
 @implementation HPObject
 
+/**
+ * @return The schema of the receiving class, built on first use. Safe to call from any thread.
+ */
++ (HPObjectSchema *)schema {
+  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  static CFMutableDictionaryRef schemas;
+  pthread_mutex_lock(&mutex);
+  if (!schemas) {
+    schemas = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL,
+                                        &kCFTypeDictionaryValueCallBacks);
+  }
+  HPObjectSchema *schema = (__bridge HPObjectSchema *)CFDictionaryGetValue(
+      schemas, (__bridge const void *)self);
+  pthread_mutex_unlock(&mutex);
+  if (schema) {
+    return schema;
+  }
+  // Built outside the lock because nested model classes build their own schemas. Two threads
+  // may build the same schema; the first one stored wins.
+  schema = [[HPObjectSchema alloc] initWithClass:self];
+  pthread_mutex_lock(&mutex);
+  HPObjectSchema *stored = (__bridge HPObjectSchema *)CFDictionaryGetValue(
+      schemas, (__bridge const void *)self);
+  if (stored) {
+    schema = stored;
+  } else {
+    CFDictionarySetValue(schemas, (__bridge const void *)self, (__bridge const void *)schema);
+  }
+  pthread_mutex_unlock(&mutex);
+  return schema;
+}
+
 - (id)initWithAttributes:(NSDictionary *)attributes {
   self = [super init];
   if (!self) {
     return nil;
   }
-  if (!attributes) {
+  if (![attributes isKindOfClass:[NSDictionary class]]) {
     return nil;
   }
-  // Dynamically sets object properties with attributes.
-  // Will call [self setValue:forUndefinedKey:] for unknown keys.
-  [self setValuesForKeysWithDictionary:attributes];
+  HPObjectSchema *schema = [[self class] schema];
+  for (NSUInteger i = 0; i < schema->_count; i++) {
+    const HPObjectField *field = &schema->_fields[i];
+    if (!field->setter) {
+      continue;
+    }
+    id value = [attributes objectForKey:field->key];
+    if (value) {
+      HPObjectSetValue(self, field, value);
+    }
+  }
   return self;
 }
 
 - (NSDictionary *)attributesDictionary {
-  NSMutableArray *propertyNames = [NSMutableArray array];
-  unsigned int outCount, i;
-  objc_property_t *properties = class_copyPropertyList([self class], &outCount);
-  for (i = 0; i < outCount; i++) {
-    objc_property_t property = properties[i];
-    const char *propName =  property_getName(property);
-    if (propName) {
-      NSString *propertyName = [NSString stringWithUTF8String:propName];
-      if ([propertyName isEqual:@"identifier"]) {
-        // Properties named "identifier" are designed to be called "id" in an NSDictionary.
-        [propertyNames addObject:@"id"];
-      } else {
-        [propertyNames addObject:propertyName];
-      }
-    }
+  HPObjectSchema *schema = [[self class] schema];
+  NSMutableDictionary *attributes = [NSMutableDictionary dictionaryWithCapacity:schema->_count];
+  for (NSUInteger i = 0; i < schema->_count; i++) {
+    const HPObjectField *field = &schema->_fields[i];
+    id value = HPObjectGetValue(self, field);
+    [attributes setObject:(value ? value : [NSNull null]) forKey:field->key];
   }
-  NSDictionary *attributes = [self dictionaryWithValuesForKeys:propertyNames];
   return attributes;
 }
 
@@ -0,0 +1,132 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Priority classes of requests, from most to least urgent.
+ */
+typedef NS_ENUM(NSInteger, HPRequestPriority) {
+  // Work the user is waiting for, such as a vote, a new haiku or opening a haiku.
+  HPRequestPriorityInteractive,
+  // Content on screen, such as the first page of the feed and author avatars.
+  HPRequestPriorityVisible,
+  // Speculative work, such as the next page of the feed.
+  HPRequestPriorityPrefetch
+};
+
+/**
+ * Snapshot of the queue of one priority class.
+ */
+@interface HPRequestStatistics : NSObject
+
+/**
+ * Number of operations waiting to start: the queue depth.
+ */
+@property(nonatomic, readonly) NSUInteger pendingCount;
+
+/**
+ * Largest queue depth so far.
+ */
+@property(nonatomic, readonly) NSUInteger maxPendingCount;
+
+/**
+ * Number of operations started and not yet finished.
+ */
+@property(nonatomic, readonly) NSUInteger runningCount;
+
+/**
+ * Number of operations started so far.
+ */
+@property(nonatomic, readonly) NSUInteger startedCount;
+
+/**
+ * Number of operations that had to wait for more urgent work, rather than only for a free slot
+ * in their own class.
+ */
+@property(nonatomic, readonly) NSUInteger heldBackCount;
+
+/**
+ * Total and longest time operations spent waiting to start.
+ */
+@property(nonatomic, readonly) NSTimeInterval totalWaitTime;
+@property(nonatomic, readonly) NSTimeInterval maxWaitTime;
+
+/**
+ * @return Mean time operations spent waiting to start, or 0 if none has started.
+ */
+- (NSTimeInterval)averageWaitTime;
+
+@end
+
+/**
+ * Starts operations in order of priority class. Each class has its own concurrency limit, and
+ * visible and prefetch operations are held back while interactive work is waiting or running, so
+ * that a burst of avatar downloads or prefetches cannot delay a vote. Visible and prefetch
+ * operations run side by side within their own limits, so that avatars downloading during a
+ * scroll do not starve the next page. Operations of the same class start in the order they were
+ * added. Operations that are already running are never interrupted.
+ *
+ * Started operations run on an execution queue that does not limit concurrency itself. The
+ * scheduler can be used from any thread.
+ */
+@interface HPRequestScheduler : NSObject
+
+/**
+ * @param executionQueue Queue that runs started operations.
+ * @return Scheduler object with default limits of 4 interactive, 4 visible and 2 prefetch
+ *     operations.
+ */
+- (id)initWithExecutionQueue:(NSOperationQueue *)executionQueue;
+
+/**
+ * Optional block called with each operation right before it is handed to the execution queue, on
+ * the thread that started it. Use it to measure latency from the start of an operation rather than
+ * from when it was queued.
+ */
+@property(nonatomic, copy) void (^startHandler)(NSOperation *operation);
+
+/**
+ * Sets the concurrency limit of a class. Operations already running are not affected.
+ *
+ * @param count Maximum number of running operations of the class, at least 1.
+ * @param priority The class.
+ */
+- (void)setMaxConcurrentOperationCount:(NSUInteger)count forPriority:(HPRequestPriority)priority;
+
+/**
+ * @param priority The class.
+ * @return Maximum number of running operations of the class.
+ */
+- (NSUInteger)maxConcurrentOperationCountForPriority:(HPRequestPriority)priority;
+
+/**
+ * Queues an operation, and starts it as soon as its class allows. A cancelled operation is still
+ * started when its turn comes, so that it can finish.
+ *
+ * @param operation The operation, or nil to do nothing.
+ * @param priority Class of the operation.
+ */
+- (void)addOperation:(NSOperation *)operation priority:(HPRequestPriority)priority;
+
+/**
+ * @param priority The class.
+ * @return Snapshot of the queue of the class.
+ */
+- (HPRequestStatistics *)statisticsForPriority:(HPRequestPriority)priority;
+
+@end
@@ -0,0 +1,245 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPRequestScheduler.h"
+
+/**
+ * Number of priority classes.
+ */
+#define HP_REQUEST_PRIORITY_COUNT 3
+
+static void *HPRequestSchedulerFinishedContext = &HPRequestSchedulerFinishedContext;
+
+@interface HPRequestStatistics ()
+
+@property(nonatomic) NSUInteger pendingCount;
+@property(nonatomic) NSUInteger maxPendingCount;
+@property(nonatomic) NSUInteger runningCount;
+@property(nonatomic) NSUInteger startedCount;
+@property(nonatomic) NSUInteger heldBackCount;
+@property(nonatomic) NSTimeInterval totalWaitTime;
+@property(nonatomic) NSTimeInterval maxWaitTime;
+
+@end
+
+@implementation HPRequestStatistics
+
+- (NSTimeInterval)averageWaitTime {
+  return _startedCount ? _totalWaitTime / _startedCount : 0;
+}
+
+- (HPRequestStatistics *)snapshot {
+  HPRequestStatistics *snapshot = [[HPRequestStatistics alloc] init];
+  snapshot.pendingCount = _pendingCount;
+  snapshot.maxPendingCount = _maxPendingCount;
+  snapshot.runningCount = _runningCount;
+  snapshot.startedCount = _startedCount;
+  snapshot.heldBackCount = _heldBackCount;
+  snapshot.totalWaitTime = _totalWaitTime;
+  snapshot.maxWaitTime = _maxWaitTime;
+  return snapshot;
+}
+
+@end
+
+/**
+ * An operation waiting to start.
+ */
+@interface HPScheduledOperation : NSObject
+
+@property(nonatomic, strong) NSOperation *operation;
+@property(nonatomic) CFAbsoluteTime enqueueTime;
+@property(nonatomic) BOOL heldBack;
+
+@end
+
+@implementation HPScheduledOperation
+
+@end
+
+@implementation HPRequestScheduler {
+  NSOperationQueue *_executionQueue;
+  // Queues of HPScheduledOperation objects, and statistics, indexed by priority.
+  NSMutableArray *_pending[HP_REQUEST_PRIORITY_COUNT];
+  HPRequestStatistics *_statistics[HP_REQUEST_PRIORITY_COUNT];
+  NSUInteger _limits[HP_REQUEST_PRIORITY_COUNT];
+  // Map from running operation to its priority.
+  NSMapTable *_runningPriorities;
+}
+
+- (id)init {
+  return [self initWithExecutionQueue:[[NSOperationQueue alloc] init]];
+}
+
+- (id)initWithExecutionQueue:(NSOperationQueue *)executionQueue {
+  self = [super init];
+  if (self) {
+    _executionQueue = executionQueue;
+    for (NSUInteger i = 0; i < HP_REQUEST_PRIORITY_COUNT; i++) {
+      _pending[i] = [NSMutableArray array];
+      _statistics[i] = [[HPRequestStatistics alloc] init];
+    }
+    _limits[HPRequestPriorityInteractive] = 4;
+    _limits[HPRequestPriorityVisible] = 4;
+    _limits[HPRequestPriorityPrefetch] = 2;
+    _runningPriorities = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality
+                                               valueOptions:NSPointerFunctionsStrongMemory];
+  }
+  return self;
+}
+
+- (void)dealloc {
+  for (NSOperation *operation in _runningPriorities) {
+    [operation removeObserver:self forKeyPath:@"isFinished" context:HPRequestSchedulerFinishedContext];
+  }
+}
+
+/**
+ * @return The priority clamped to a valid class.
+ */
+static NSUInteger HPRequestPriorityIndex(HPRequestPriority priority) {
+  if (priority < 0) {
+    return 0;
+  }
+  return MIN((NSUInteger)priority, HP_REQUEST_PRIORITY_COUNT - 1);
+}
+
+- (void)setMaxConcurrentOperationCount:(NSUInteger)count forPriority:(HPRequestPriority)priority {
+  @synchronized(self) {
+    _limits[HPRequestPriorityIndex(priority)] = MAX(count, 1);
+  }
+  [self startOperations];
+}
+
+- (NSUInteger)maxConcurrentOperationCountForPriority:(HPRequestPriority)priority {
+  @synchronized(self) {
+    return _limits[HPRequestPriorityIndex(priority)];
+  }
+}
+
+- (void)addOperation:(NSOperation *)operation priority:(HPRequestPriority)priority {
+  if (!operation) {
+    return;
+  }
+  NSUInteger index = HPRequestPriorityIndex(priority);
+  // The execution queue does not limit concurrency, but it still prefers urgent operations when
+  // threads are scarce.
+  static const NSOperationQueuePriority kQueuePriorities[HP_REQUEST_PRIORITY_COUNT] = {
+    NSOperationQueuePriorityVeryHigh, NSOperationQueuePriorityNormal, NSOperationQueuePriorityLow
+  };
+  [operation setQueuePriority:kQueuePriorities[index]];
+
+  HPScheduledOperation *scheduled = [[HPScheduledOperation alloc] init];
+  scheduled.operation = operation;
+  scheduled.enqueueTime = CFAbsoluteTimeGetCurrent();
+  @synchronized(self) {
+    [_pending[index] addObject:scheduled];
+    HPRequestStatistics *statistics = _statistics[index];
+    statistics.pendingCount = [_pending[index] count];
+    statistics.maxPendingCount = MAX(statistics.maxPendingCount, statistics.pendingCount);
+  }
+  [self startOperations];
+}
+
+- (HPRequestStatistics *)statisticsForPriority:(HPRequestPriority)priority {
+  @synchronized(self) {
+    return [_statistics[HPRequestPriorityIndex(priority)] snapshot];
+  }
+}
+
+#pragma mark - Scheduling
+
+/**
+ * Starts every operation that its class and more urgent work allow.
+ */
+- (void)startOperations {
+  NSMutableArray *operations = [NSMutableArray array];
+  @synchronized(self) {
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    // Set when interactive work is outstanding, which holds back every other class.
+    BOOL hasUrgentWork = NO;
+    for (NSUInteger i = 0; i < HP_REQUEST_PRIORITY_COUNT; i++) {
+      NSMutableArray *pending = _pending[i];
+      HPRequestStatistics *statistics = _statistics[i];
+      if (hasUrgentWork) {
+        for (HPScheduledOperation *scheduled in pending) {
+          if (!scheduled.heldBack) {
+            scheduled.heldBack = YES;
+            statistics.heldBackCount++;
+          }
+        }
+        continue;
+      }
+      while ([pending count] > 0 && statistics.runningCount < _limits[i]) {
+        HPScheduledOperation *scheduled = [pending objectAtIndex:0];
+        [pending removeObjectAtIndex:0];
+        NSTimeInterval waitTime = now - scheduled.enqueueTime;
+        statistics.startedCount++;
+        statistics.totalWaitTime += waitTime;
+        statistics.maxWaitTime = MAX(statistics.maxWaitTime, waitTime);
+        if ([scheduled.operation isFinished]) {
+          continue;
+        }
+        statistics.runningCount++;
+        [_runningPriorities setObject:@(i) forKey:scheduled.operation];
+        [operations addObject:scheduled.operation];
+      }
+      statistics.pendingCount = [pending count];
+      if (i == HPRequestPriorityInteractive) {
+        hasUrgentWork = statistics.runningCount > 0 || [pending count] > 0;
+      }
+    }
+  }
+  void (^startHandler)(NSOperation *) = _startHandler;
+  for (NSOperation *operation in operations) {
+    if (startHandler) {
+      startHandler(operation);
+    }
+    [operation addObserver:self
+                forKeyPath:@"isFinished"
+                   options:NSKeyValueObservingOptionInitial
+                   context:HPRequestSchedulerFinishedContext];
+    [_executionQueue addOperation:operation];
+  }
+}
+
+- (void)observeValueForKeyPath:(NSString *)keyPath
+                      ofObject:(id)object
+                        change:(NSDictionary *)change
+                       context:(void *)context {
+  if (context != HPRequestSchedulerFinishedContext) {
+    [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
+    return;
+  }
+  NSOperation *operation = object;
+  if (![operation isFinished]) {
+    return;
+  }
+  @synchronized(self) {
+    NSNumber *index = [_runningPriorities objectForKey:operation];
+    if (!index) {
+      // Already counted, for example through both the initial and a later notification.
+      return;
+    }
+    [_runningPriorities removeObjectForKey:operation];
+    _statistics[[index unsignedIntegerValue]].runningCount--;
+  }
+  [operation removeObserver:self forKeyPath:@"isFinished" context:HPRequestSchedulerFinishedContext];
+  [self startOperations];
+}
+
+@end
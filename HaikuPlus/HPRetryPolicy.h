@@ -0,0 +1,150 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Returned by HPRetryPolicy when a failed request must not be sent again.
+ */
+extern const NSTimeInterval kHPRetryPolicyNoRetry;
+
+/**
+ * Decides whether and when a failed request is sent again. Only requests that are safe to repeat
+ * are retried: GET, HEAD, OPTIONS, PUT and DELETE requests, and requests that carry an
+ * Idempotency-Key header. Only transient failures are retried: connection errors, timeouts,
+ * 408 Request Timeout, 429 Too Many Requests and 5xx responses.
+ *
+ * The delay before a retry grows exponentially with the attempt, up to |maxBackoff|, and is
+ * randomized so that clients failing together do not retry together. A Retry-After header takes
+ * precedence over the computed delay. Every call has an overall deadline that retries must fit
+ * in.
+ *
+ * The policy is safe to use from any thread.
+ */
+@interface HPRetryPolicy : NSObject
+
+/**
+ * Largest number of times a request is sent, including the first attempt. Defaults to 4.
+ */
+@property(nonatomic) NSUInteger maxAttemptCount;
+
+/**
+ * Delay before the first retry, doubled for each further retry. Defaults to 0.5 seconds.
+ */
+@property(nonatomic) NSTimeInterval initialBackoff;
+
+/**
+ * Upper bound of the computed delay before a retry. Defaults to 8 seconds.
+ */
+@property(nonatomic) NSTimeInterval maxBackoff;
+
+/**
+ * Fraction of the delay that is randomized, from 0 for a fixed delay to 1 for a delay anywhere
+ * between 0 and the computed backoff. Defaults to 1.
+ */
+@property(nonatomic) double jitter;
+
+/**
+ * Timeout of each attempt, used instead of the 60-second default of NSURLRequest. Defaults to
+ * 15 seconds.
+ */
+@property(nonatomic) NSTimeInterval attemptTimeout;
+
+/**
+ * Time from the first attempt after which a call fails instead of being retried, and which no
+ * attempt may outlast. Defaults to 30 seconds.
+ */
+@property(nonatomic) NSTimeInterval deadline;
+
+/**
+ * Number of retries scheduled so far.
+ */
+@property(nonatomic, readonly) NSUInteger retryCount;
+
+/**
+ * Number of calls that were retried at least once.
+ */
+@property(nonatomic, readonly) NSUInteger retriedRequestCount;
+
+/**
+ * Number of calls that succeeded after being retried.
+ */
+@property(nonatomic, readonly) NSUInteger recoveredRequestCount;
+
+/**
+ * Number of calls that failed with a transient error after running out of attempts or time.
+ */
+@property(nonatomic, readonly) NSUInteger exhaustedRequestCount;
+
+/**
+ * Number of retries whose delay was set by a Retry-After header.
+ */
+@property(nonatomic, readonly) NSUInteger retryAfterCount;
+
+/**
+ * @param request A request to the Haiku+ server.
+ * @return YES if sending the request twice has the same effect as sending it once.
+ */
+- (BOOL)canRetryRequest:(NSURLRequest *)request;
+
+/**
+ * @param error Error of a failed attempt.
+ * @param response HTTP response of the attempt, or nil to take it from the error.
+ * @return YES if the failure is likely to go away, so that another attempt can succeed.
+ */
++ (BOOL)isTransientError:(NSError *)error response:(NSHTTPURLResponse *)response;
+
+/**
+ * Decides whether a failed attempt is retried, and records the decision in the statistics.
+ *
+ * @param request The failed request.
+ * @param response HTTP response of the attempt, or nil to take it from the error.
+ * @param error Error of the attempt.
+ * @param attemptCount Number of attempts made so far, starting at 1.
+ * @param timeRemaining Time left until the deadline of the call.
+ * @return Seconds to wait before the next attempt, or kHPRetryPolicyNoRetry.
+ */
+- (NSTimeInterval)delayBeforeRetryingRequest:(NSURLRequest *)request
+                                    response:(NSHTTPURLResponse *)response
+                                       error:(NSError *)error
+                                attemptCount:(NSUInteger)attemptCount
+                               timeRemaining:(NSTimeInterval)timeRemaining;
+
+/**
+ * Delay before another attempt, without a decision or statistics, for work that is retried
+ * outside of a single call.
+ *
+ * @param attemptCount Number of attempts made so far, starting at 1.
+ * @return Capped exponential delay with jitter.
+ */
+- (NSTimeInterval)backoffAfterAttemptCount:(NSUInteger)attemptCount;
+
+/**
+ * Records the success of a call.
+ *
+ * @param attemptCount Number of attempts the call took, starting at 1.
+ */
+- (void)recordSuccessAfterAttemptCount:(NSUInteger)attemptCount;
+
+/**
+ * @param response HTTP response.
+ * @return Delay requested by the Retry-After header of the response, in seconds or as an HTTP
+ *     date, or a negative value if there is none.
+ */
++ (NSTimeInterval)retryAfterDelayOfResponse:(NSHTTPURLResponse *)response;
+
+@end
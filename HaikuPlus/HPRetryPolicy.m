@@ -0,0 +1,158 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPRetryPolicy.h"
+
+#import "AFURLConnectionOperation.h"
+#import "HPConstants.h"
+
+const NSTimeInterval kHPRetryPolicyNoRetry = -1;
+
+@implementation HPRetryPolicy
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _maxAttemptCount = 4;
+    _initialBackoff = 0.5;
+    _maxBackoff = 8;
+    _jitter = 1;
+    _attemptTimeout = 15;
+    _deadline = 30;
+  }
+  return self;
+}
+
+- (BOOL)canRetryRequest:(NSURLRequest *)request {
+  static NSSet *idempotentMethods;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+      // See http://www.w3.org/Protocols/rfc2616/rfc2616-sec9.html#sec9.1.2
+      idempotentMethods = [NSSet setWithObjects:@"GET", @"HEAD", @"OPTIONS", @"PUT", @"DELETE",
+                              nil];
+  });
+  if ([idempotentMethods containsObject:[request HTTPMethod]]) {
+    return YES;
+  }
+  // The server applies a request with an idempotency key at most once.
+  return [request valueForHTTPHeaderField:kHPConstantsIdempotencyKeyHeader] != nil;
+}
+
++ (BOOL)isTransientError:(NSError *)error response:(NSHTTPURLResponse *)response {
+  if ([[error domain] isEqual:NSURLErrorDomain]) {
+    switch ([error code]) {
+      case NSURLErrorTimedOut:
+      case NSURLErrorCannotFindHost:
+      case NSURLErrorCannotConnectToHost:
+      case NSURLErrorNetworkConnectionLost:
+      case NSURLErrorDNSLookupFailed:
+      case NSURLErrorNotConnectedToInternet:
+      case NSURLErrorInternationalRoamingOff:
+      case NSURLErrorCallIsActive:
+      case NSURLErrorDataNotAllowed:
+        return YES;
+      default:
+        return NO;
+    }
+  }
+  if (!response) {
+    response = [[error userInfo] objectForKey:AFNetworkingOperationFailingURLResponseErrorKey];
+  }
+  if ([response isKindOfClass:[NSHTTPURLResponse class]]) {
+    NSInteger statusCode = [response statusCode];
+    return statusCode >= 500 || statusCode == 408 || statusCode == 429;
+  }
+  return NO;
+}
+
+- (NSTimeInterval)delayBeforeRetryingRequest:(NSURLRequest *)request
+                                    response:(NSHTTPURLResponse *)response
+                                       error:(NSError *)error
+                                attemptCount:(NSUInteger)attemptCount
+                               timeRemaining:(NSTimeInterval)timeRemaining {
+  if (![self canRetryRequest:request] || ![[self class] isTransientError:error response:response]) {
+    return kHPRetryPolicyNoRetry;
+  }
+  if (!response) {
+    response = [[error userInfo] objectForKey:AFNetworkingOperationFailingURLResponseErrorKey];
+  }
+  NSTimeInterval retryAfter = [[self class] retryAfterDelayOfResponse:response];
+  NSTimeInterval delay =
+      retryAfter >= 0 ? retryAfter : [self backoffAfterAttemptCount:attemptCount];
+  @synchronized(self) {
+    // A retry that could not finish before the deadline is not worth starting.
+    if (attemptCount >= _maxAttemptCount || delay >= timeRemaining) {
+      _exhaustedRequestCount++;
+      return kHPRetryPolicyNoRetry;
+    }
+    _retryCount++;
+    if (attemptCount == 1) {
+      _retriedRequestCount++;
+    }
+    if (retryAfter >= 0) {
+      _retryAfterCount++;
+    }
+  }
+  return delay;
+}
+
+- (NSTimeInterval)backoffAfterAttemptCount:(NSUInteger)attemptCount {
+  NSTimeInterval backoff = _initialBackoff * pow(2, MIN(attemptCount, 32) - 1);
+  backoff = MIN(backoff, _maxBackoff);
+  double jitter = MAX(MIN(_jitter, 1), 0);
+  double random = (double)arc4random() / UINT32_MAX;
+  return backoff * (1 - jitter * random);
+}
+
+- (void)recordSuccessAfterAttemptCount:(NSUInteger)attemptCount {
+  if (attemptCount > 1) {
+    @synchronized(self) {
+      _recoveredRequestCount++;
+    }
+  }
+}
+
++ (NSTimeInterval)retryAfterDelayOfResponse:(NSHTTPURLResponse *)response {
+  NSString *retryAfter = [[response allHeaderFields] objectForKey:@"Retry-After"];
+  if (![retryAfter isKindOfClass:[NSString class]]) {
+    return -1;
+  }
+  // See http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.37
+  NSScanner *scanner = [NSScanner scannerWithString:retryAfter];
+  NSInteger seconds = 0;
+  if ([scanner scanInteger:&seconds] && [scanner isAtEnd]) {
+    return MAX(seconds, 0);
+  }
+  static NSDateFormatter *formatter;
+  static dispatch_once_t onceToken;
+  dispatch_once(&onceToken, ^{
+      formatter = [[NSDateFormatter alloc] init];
+      [formatter setLocale:[[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"]];
+      [formatter setTimeZone:[NSTimeZone timeZoneWithAbbreviation:@"GMT"]];
+      [formatter setDateFormat:@"EEE, dd MMM yyyy HH:mm:ss zzz"];
+  });
+  NSDate *date = nil;
+  @synchronized(formatter) {
+    date = [formatter dateFromString:retryAfter];
+  }
+  if (!date) {
+    return -1;
+  }
+  return MAX([date timeIntervalSinceNow], 0);
+}
+
+@end
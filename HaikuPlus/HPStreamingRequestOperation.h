@@ -0,0 +1,51 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "AFHTTPRequestOperation.h"
+#import "HPTraceBuffer.h"
+
+@class HPJSONStreamParser;
+
+/**
+ * HTTP request operation that hands the body of a successful response to a JSON stream parser as
+ * each chunk arrives, instead of collecting it in |responseData|. Error responses are collected
+ * as usual, and download progress is not reported for streamed bodies.
+ */
+@interface HPStreamingRequestOperation : AFHTTPRequestOperation <HPTracedOperation>
+
+/**
+ * Parser that receives the body of a successful response.
+ */
+@property(nonatomic, strong) HPJSONStreamParser *parser;
+
+/**
+ * Serial queue on which the parser runs, or NULL to parse on the network thread. Use the queue of
+ * the success block so that the whole body has been parsed when it is called.
+ */
+@property(nonatomic, assign) dispatch_queue_t parsingQueue;
+
+/**
+ * Number of body bytes handed to the parser.
+ */
+@property(nonatomic, readonly) unsigned long long streamedByteCount;
+
+/**
+ * Optional record stamped with the connection start, first byte and last byte of the response.
+ */
+@property(nonatomic, strong) HPTraceRecord *traceRecord;
+
+@end
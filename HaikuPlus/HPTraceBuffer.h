@@ -0,0 +1,204 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Stages of a request, in the order they are reached.
+ */
+typedef NS_ENUM(NSInteger, HPTraceStage) {
+  // The HPCommunicator was asked for the data.
+  HPTraceStageEnqueued,
+  // The request carries the user's authorization, or needs none.
+  HPTraceStageAuthorized,
+  // The operation started and opened its connection.
+  HPTraceStageConnectionStarted,
+  // The first byte of the response body arrived.
+  HPTraceStageFirstByte,
+  // The last byte of the response body arrived.
+  HPTraceStageLastByte,
+  // The response body was parsed into JSON objects.
+  HPTraceStageParsed,
+  // The JSON objects were turned into model objects.
+  HPTraceStageDecoded,
+  // The completion block was called on its queue.
+  HPTraceStageDelivered
+};
+
+/**
+ * Number of stages in HPTraceStage.
+ */
+#define HP_TRACE_STAGE_COUNT 8
+
+/**
+ * Timestamps and byte counts of one HPCommunicator call. Each stage is stamped by the layer that
+ * reaches it, on whatever thread that layer runs, and a record is only read once it has been
+ * delivered. When a request is retried or hedged, a stage holds the time of the attempt that
+ * reached it last.
+ */
+@interface HPTraceRecord : NSObject
+
+/**
+ * Sequence number of the record in its buffer.
+ */
+@property(nonatomic, readonly) NSUInteger identifier;
+
+/**
+ * HTTP method and URL of the request.
+ */
+@property(nonatomic, copy, readonly) NSString *method;
+@property(nonatomic, copy, readonly) NSString *URLString;
+
+/**
+ * Number of bytes in the request and response bodies.
+ */
+@property(nonatomic) unsigned long long requestByteCount;
+@property(nonatomic) unsigned long long responseByteCount;
+
+/**
+ * HTTP status code of the response, or 0 if there was none.
+ */
+@property(nonatomic) NSInteger statusCode;
+
+/**
+ * Number of times the request was sent.
+ */
+@property(nonatomic) NSUInteger attemptCount;
+
+/**
+ * YES if the call joined an identical request in flight instead of sending its own.
+ */
+@property(nonatomic, getter=isCoalesced) BOOL coalesced;
+
+/**
+ * Error the call failed with, or nil.
+ */
+@property(nonatomic, strong) NSError *error;
+
+/**
+ * Name of the endpoint of the request, one of the endpoint names in HPConstants, or nil.
+ */
+@property(nonatomic, copy) NSString *endpoint;
+
+/**
+ * Time spent in the completion blocks of the call on the main thread. Only measured while an
+ * HPMainThreadWatchdog is installed.
+ */
+@property(nonatomic) NSTimeInterval mainThreadDuration;
+
+/**
+ * Number of completion blocks of the call that ran longer than the frame budget of the watchdog.
+ */
+@property(nonatomic) NSUInteger stallCount;
+
+/**
+ * Duration and stage name of the longest of those blocks, or 0 and nil without a stall.
+ */
+@property(nonatomic) NSTimeInterval longestStallDuration;
+@property(nonatomic, copy) NSString *longestStallStage;
+
+/**
+ * Stamps a stage with the current time.
+ */
+- (void)markStage:(HPTraceStage)stage;
+
+/**
+ * @return Time the stage was reached, or 0 if it was not.
+ */
+- (CFAbsoluteTime)timeOfStage:(HPTraceStage)stage;
+
+/**
+ * @return Seconds from being enqueued to reaching the stage, or a negative value if either stage
+ *     was not reached.
+ */
+- (NSTimeInterval)durationUntilStage:(HPTraceStage)stage;
+
+/**
+ * @return Property list form of the record, with stage times in milliseconds from enqueueing.
+ */
+- (NSDictionary *)dictionaryRepresentation;
+
+@end
+
+/**
+ * Operations that stamp the network stages of a trace record.
+ */
+@protocol HPTracedOperation <NSObject>
+
+/**
+ * Record stamped with the connection start, first byte and last byte stages, or nil.
+ */
+@property(nonatomic, strong) HPTraceRecord *traceRecord;
+
+@end
+
+/**
+ * Bounded in-memory ring buffer of trace records. Once full, each new record replaces the oldest.
+ * Tracing is off unless an HPCommunicator is given a buffer, and then costs a few messages to nil
+ * per request. The buffer is safe to use from any thread.
+ */
+@interface HPTraceBuffer : NSObject
+
+/**
+ * Largest number of records kept.
+ */
+@property(nonatomic, readonly) NSUInteger capacity;
+
+/**
+ * Number of records added, including those that have been replaced.
+ */
+@property(nonatomic, readonly) NSUInteger totalRecordCount;
+
+/**
+ * @param capacity Largest number of records kept.
+ * @return Trace buffer object.
+ */
+- (id)initWithCapacity:(NSUInteger)capacity;
+
+/**
+ * Creates a record for a request. The record is not in the buffer until it is added.
+ *
+ * @param request The request to trace.
+ * @return New record with the enqueued stage stamped.
+ */
+- (HPTraceRecord *)beginRecordWithRequest:(NSURLRequest *)request;
+
+/**
+ * Adds a finished record, replacing the oldest record if the buffer is full.
+ */
+- (void)addRecord:(HPTraceRecord *)record;
+
+/**
+ * @return The records in the buffer, oldest first.
+ */
+- (NSArray *)records;
+
+/**
+ * Removes every record.
+ */
+- (void)removeAllRecords;
+
+/**
+ * Writes the records in the buffer to a file as a JSON array of their dictionary representations.
+ *
+ * @param path Path of the file, which is replaced.
+ * @param error Set to the reason the file could not be written.
+ * @return YES if the file was written.
+ */
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)error;
+
+@end
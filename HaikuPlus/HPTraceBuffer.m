@@ -0,0 +1,180 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPTraceBuffer.h"
+
+/**
+ * Keys of the dictionary representation of a record, with stage keys in HPTraceStage order.
+ */
+static NSString *const kHPTraceStageKeys[HP_TRACE_STAGE_COUNT] = {
+  @"enqueued", @"authorized", @"connection_started", @"first_byte", @"last_byte", @"parsed",
+  @"decoded", @"delivered"
+};
+
+@interface HPTraceRecord ()
+
+@property(nonatomic) NSUInteger identifier;
+@property(nonatomic, copy) NSString *method;
+@property(nonatomic, copy) NSString *URLString;
+
+@end
+
+@implementation HPTraceRecord {
+  CFAbsoluteTime _stageTimes[HP_TRACE_STAGE_COUNT];
+}
+
+- (void)markStage:(HPTraceStage)stage {
+  if (stage >= 0 && stage < HP_TRACE_STAGE_COUNT) {
+    _stageTimes[stage] = CFAbsoluteTimeGetCurrent();
+  }
+}
+
+- (CFAbsoluteTime)timeOfStage:(HPTraceStage)stage {
+  if (stage < 0 || stage >= HP_TRACE_STAGE_COUNT) {
+    return 0;
+  }
+  return _stageTimes[stage];
+}
+
+- (NSTimeInterval)durationUntilStage:(HPTraceStage)stage {
+  CFAbsoluteTime start = _stageTimes[HPTraceStageEnqueued];
+  CFAbsoluteTime end = [self timeOfStage:stage];
+  if (start == 0 || end == 0) {
+    return -1;
+  }
+  return end - start;
+}
+
+- (NSDictionary *)dictionaryRepresentation {
+  NSMutableDictionary *stages = [NSMutableDictionary dictionary];
+  for (NSInteger i = 0; i < HP_TRACE_STAGE_COUNT; i++) {
+    NSTimeInterval duration = [self durationUntilStage:i];
+    if (duration >= 0) {
+      [stages setObject:@(duration * 1000) forKey:kHPTraceStageKeys[i]];
+    }
+  }
+  NSMutableDictionary *dictionary = [NSMutableDictionary dictionary];
+  [dictionary setObject:@(_identifier) forKey:@"id"];
+  [dictionary setObject:(_method ? _method : @"") forKey:@"method"];
+  [dictionary setObject:(_URLString ? _URLString : @"") forKey:@"url"];
+  [dictionary setObject:@(_stageTimes[HPTraceStageEnqueued]) forKey:@"start_time"];
+  [dictionary setObject:stages forKey:@"stages_ms"];
+  [dictionary setObject:@(_requestByteCount) forKey:@"request_bytes"];
+  [dictionary setObject:@(_responseByteCount) forKey:@"response_bytes"];
+  [dictionary setObject:@(_statusCode) forKey:@"status"];
+  [dictionary setObject:@(_attemptCount) forKey:@"attempts"];
+  [dictionary setObject:@(_coalesced) forKey:@"coalesced"];
+  if (_endpoint) {
+    [dictionary setObject:_endpoint forKey:@"endpoint"];
+  }
+  if (_mainThreadDuration > 0) {
+    [dictionary setObject:@(_mainThreadDuration * 1000) forKey:@"main_thread_ms"];
+  }
+  if (_stallCount > 0) {
+    [dictionary setObject:@(_stallCount) forKey:@"stalls"];
+    [dictionary setObject:@(_longestStallDuration * 1000) forKey:@"longest_stall_ms"];
+    [dictionary setObject:_longestStallStage forKey:@"longest_stall_stage"];
+  }
+  if (_error) {
+    NSString *error = [NSString stringWithFormat:@"%@ %ld", [_error domain], (long)[_error code]];
+    [dictionary setObject:error forKey:@"error"];
+  }
+  return dictionary;
+}
+
+@end
+
+@implementation HPTraceBuffer {
+  // Ring buffer of records. Slots beyond the records added so far are empty.
+  NSMutableArray *_records;
+  NSUInteger _nextRecordIndex;
+  NSUInteger _nextIdentifier;
+}
+
+- (id)init {
+  return [self initWithCapacity:256];
+}
+
+- (id)initWithCapacity:(NSUInteger)capacity {
+  self = [super init];
+  if (self) {
+    _capacity = MAX(capacity, 1);
+    _records = [NSMutableArray arrayWithCapacity:_capacity];
+  }
+  return self;
+}
+
+- (HPTraceRecord *)beginRecordWithRequest:(NSURLRequest *)request {
+  HPTraceRecord *record = [[HPTraceRecord alloc] init];
+  [record markStage:HPTraceStageEnqueued];
+  record.method = [request HTTPMethod];
+  record.URLString = [[request URL] absoluteString];
+  record.requestByteCount = [[request HTTPBody] length];
+  @synchronized(self) {
+    record.identifier = _nextIdentifier++;
+  }
+  return record;
+}
+
+- (void)addRecord:(HPTraceRecord *)record {
+  if (!record) {
+    return;
+  }
+  @synchronized(self) {
+    if ([_records count] < _capacity) {
+      [_records addObject:record];
+    } else {
+      [_records replaceObjectAtIndex:_nextRecordIndex withObject:record];
+    }
+    _nextRecordIndex = (_nextRecordIndex + 1) % _capacity;
+    _totalRecordCount++;
+  }
+}
+
+- (NSArray *)records {
+  @synchronized(self) {
+    if ([_records count] < _capacity) {
+      return [_records copy];
+    }
+    // The oldest record is the one to be replaced next.
+    NSRange newer = NSMakeRange(0, _nextRecordIndex);
+    NSRange older = NSMakeRange(_nextRecordIndex, _capacity - _nextRecordIndex);
+    return [[_records subarrayWithRange:older]
+        arrayByAddingObjectsFromArray:[_records subarrayWithRange:newer]];
+  }
+}
+
+- (void)removeAllRecords {
+  @synchronized(self) {
+    [_records removeAllObjects];
+    _nextRecordIndex = 0;
+  }
+}
+
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)error {
+  NSArray *records = [self records];
+  NSMutableArray *dictionaries = [NSMutableArray arrayWithCapacity:[records count]];
+  for (HPTraceRecord *record in records) {
+    [dictionaries addObject:[record dictionaryRepresentation]];
+  }
+  NSData *data = [NSJSONSerialization dataWithJSONObject:dictionaries
+                                                 options:NSJSONWritingPrettyPrinted
+                                                   error:error];
+  return data && [data writeToFile:path options:NSDataWritingAtomic error:error];
+}
+
+@end
@@ -17,37 +17,6 @@
 
 #import "HPUser.h"
 
-#import <objc/runtime.h>
-
-#import "HPConstants.h"
-
 @implementation HPUser
 
-- (void)setValue:(id)value forKey:(NSString *)key {
-  if ([key isEqual:@"last_updated"]) {
-    // "creation_time" is provided as a string, so we must convert it to an NSDate.
-    // The formatter works for a subset of ISO 8601.
-    NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
-    [dateFormatter setDateFormat:kHPConstantsAPIDateFormat];
-    _last_updated = [dateFormatter dateFromString:value];
-  } else {
-    [super setValue:value forKey:key];
-  }
-}
-
-/**
- * Called from - (NSDictionary *)attributesDictionary
- * through [self dictionaryWithValuesForKeys:propertyNames].
- */
-- (id)valueForKey:(NSString *)key {
-  if ([key isEqual:@"last_updated"]) {
-    NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
-    [dateFormatter setDateFormat:kHPConstantsAPIDateFormat];
-    NSString *last_updated = [dateFormatter stringFromDate:_last_updated];
-    return last_updated;
-  } else {
-    return [super valueForKey:key];
-  }
-}
-
 @end
@@ -0,0 +1,132 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Kinds of writes kept in the journal.
+ */
+typedef NS_ENUM(NSInteger, HPWriteKind) {
+  HPWriteKindVote,
+  HPWriteKindCreateHaiku
+};
+
+/**
+ * A write to the Haiku+ server that has not been confirmed yet.
+ */
+@interface HPWriteEntry : NSObject
+
+/**
+ * Unique key sent with every attempt of the write, so that the server applies a write that is
+ * sent twice only once.
+ */
+@property(nonatomic, copy, readonly) NSString *idempotencyKey;
+
+@property(nonatomic, readonly) HPWriteKind kind;
+
+/**
+ * ID of the haiku voted for, or nil for other kinds.
+ */
+@property(nonatomic, copy, readonly) NSString *haikuID;
+
+/**
+ * Attributes of the haiku to create, or nil for other kinds.
+ */
+@property(nonatomic, copy, readonly) NSDictionary *attributes;
+
+@property(nonatomic, strong, readonly) NSDate *creationDate;
+
+/**
+ * ID of the user who made the write, or nil if no user was signed in. The write is only sent on
+ * behalf of that user.
+ */
+@property(nonatomic, copy, readonly) NSString *userID;
+
+/**
+ * @param kind Kind of write.
+ * @param haikuID ID of the haiku voted for, or nil.
+ * @param attributes JSON attributes of the haiku to create, or nil.
+ * @param userID ID of the signed-in user, or nil.
+ * @return Write entry object with a new idempotency key.
+ */
+- (id)initWithKind:(HPWriteKind)kind
+           haikuID:(NSString *)haikuID
+        attributes:(NSDictionary *)attributes
+            userID:(NSString *)userID;
+
+@end
+
+/**
+ * Durable, append-only journal of writes that have not reached the Haiku+ server, such as votes
+ * made without a connection. Entries are kept in the order they were appended until they are
+ * removed.
+ *
+ * The journal is a log of JSON lines in its directory: one line per appended entry and one per
+ * removed entry. Each line is flushed to disk before the next operation, so an entry survives the
+ * app being killed right after it was appended. A line cut short by a crash is ignored. The log
+ * is rewritten without removed entries once they make up most of it.
+ *
+ * All disk access happens on a private serial queue, and completion blocks are called on the
+ * main queue.
+ */
+@interface HPWriteJournal : NSObject
+
+/**
+ * Number of entries to replay together. Defaults to 8.
+ */
+@property(nonatomic) NSUInteger batchSize;
+
+/**
+ * @return Directory for the journal inside the app's Application Support directory, which,
+ *     unlike the Caches directory, is never purged by the system.
+ */
++ (NSString *)defaultDirectory;
+
+/**
+ * @param directory Directory where the journal is stored. It is created if necessary.
+ * @return Write journal object with the entries left from earlier sessions.
+ */
+- (id)initWithDirectory:(NSString *)directory;
+
+/**
+ * Appends an entry. It is stored before any later call to the journal is handled.
+ *
+ * @param entry The entry.
+ */
+- (void)appendEntry:(HPWriteEntry *)entry;
+
+/**
+ * Reads the oldest entries in the background.
+ *
+ * @param limit Maximum number of entries.
+ * @param completion Block called on the main queue with the entries, oldest first.
+ */
+- (void)readEntriesWithLimit:(NSUInteger)limit completion:(void (^)(NSArray *entries))completion;
+
+/**
+ * Removes an entry once the server has accepted or rejected it.
+ *
+ * @param entry The entry.
+ */
+- (void)removeEntry:(HPWriteEntry *)entry;
+
+/**
+ * Removes all entries, for example when the user signs out.
+ */
+- (void)removeAllEntries;
+
+@end
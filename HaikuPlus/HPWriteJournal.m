@@ -0,0 +1,370 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "HPWriteJournal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * Default number of entries replayed together.
+ */
+static const NSUInteger kHPWriteJournalDefaultBatchSize = 8;
+
+/**
+ * Number of removed entries in the log after which it may be rewritten.
+ */
+static const NSUInteger kHPWriteJournalCompactionThreshold = 64;
+
+/**
+ * Keys of the JSON log lines.
+ */
+static NSString * const kHPWriteJournalKeyKey = @"key";
+static NSString * const kHPWriteJournalKindKey = @"kind";
+static NSString * const kHPWriteJournalHaikuIDKey = @"haiku_id";
+static NSString * const kHPWriteJournalAttributesKey = @"attributes";
+static NSString * const kHPWriteJournalCreationDateKey = @"created";
+static NSString * const kHPWriteJournalUserIDKey = @"user_id";
+static NSString * const kHPWriteJournalRemovedKey = @"removed";
+
+static NSString * const kHPWriteJournalKindVote = @"vote";
+static NSString * const kHPWriteJournalKindCreateHaiku = @"create";
+
+@implementation HPWriteEntry
+
+- (id)initWithKind:(HPWriteKind)kind
+           haikuID:(NSString *)haikuID
+        attributes:(NSDictionary *)attributes
+            userID:(NSString *)userID {
+  return [self initWithIdempotencyKey:[[NSUUID UUID] UUIDString]
+                                 kind:kind
+                              haikuID:haikuID
+                           attributes:attributes
+                         creationDate:[NSDate date]
+                               userID:userID];
+}
+
+- (id)initWithIdempotencyKey:(NSString *)idempotencyKey
+                        kind:(HPWriteKind)kind
+                     haikuID:(NSString *)haikuID
+                  attributes:(NSDictionary *)attributes
+                creationDate:(NSDate *)creationDate
+                      userID:(NSString *)userID {
+  self = [super init];
+  if (self) {
+    _idempotencyKey = [idempotencyKey copy];
+    _kind = kind;
+    _haikuID = [haikuID copy];
+    _attributes = [attributes copy];
+    _creationDate = creationDate;
+    _userID = [userID copy];
+  }
+  return self;
+}
+
+/**
+ * @param record Log line of an appended entry.
+ * @return Entry object, or nil if the record is not a valid entry.
+ */
++ (HPWriteEntry *)entryWithRecord:(NSDictionary *)record {
+  NSString *key = [record objectForKey:kHPWriteJournalKeyKey];
+  NSString *kindName = [record objectForKey:kHPWriteJournalKindKey];
+  NSString *haikuID = [record objectForKey:kHPWriteJournalHaikuIDKey];
+  NSDictionary *attributes = [record objectForKey:kHPWriteJournalAttributesKey];
+  NSNumber *creationTime = [record objectForKey:kHPWriteJournalCreationDateKey];
+  NSString *userID = [record objectForKey:kHPWriteJournalUserIDKey];
+  if (![key isKindOfClass:[NSString class]] || ![creationTime isKindOfClass:[NSNumber class]]) {
+    return nil;
+  }
+  if (![userID isKindOfClass:[NSString class]]) {
+    userID = nil;
+  }
+  HPWriteKind kind;
+  if ([kindName isEqual:kHPWriteJournalKindVote] && [haikuID isKindOfClass:[NSString class]]) {
+    kind = HPWriteKindVote;
+    attributes = nil;
+  } else if ([kindName isEqual:kHPWriteJournalKindCreateHaiku] &&
+             [attributes isKindOfClass:[NSDictionary class]]) {
+    kind = HPWriteKindCreateHaiku;
+    haikuID = nil;
+  } else {
+    return nil;
+  }
+  NSDate *creationDate = [NSDate dateWithTimeIntervalSince1970:[creationTime doubleValue]];
+  return [[HPWriteEntry alloc] initWithIdempotencyKey:key
+                                                 kind:kind
+                                              haikuID:haikuID
+                                           attributes:attributes
+                                         creationDate:creationDate
+                                               userID:userID];
+}
+
+/**
+ * @return Log line that appends the entry.
+ */
+- (NSDictionary *)record {
+  NSMutableDictionary *record = [NSMutableDictionary dictionary];
+  [record setObject:_idempotencyKey forKey:kHPWriteJournalKeyKey];
+  [record setObject:@([_creationDate timeIntervalSince1970])
+             forKey:kHPWriteJournalCreationDateKey];
+  if (_userID) {
+    [record setObject:_userID forKey:kHPWriteJournalUserIDKey];
+  }
+  switch (_kind) {
+    case HPWriteKindVote:
+      [record setObject:kHPWriteJournalKindVote forKey:kHPWriteJournalKindKey];
+      if (_haikuID) {
+        [record setObject:_haikuID forKey:kHPWriteJournalHaikuIDKey];
+      }
+      break;
+    case HPWriteKindCreateHaiku:
+      [record setObject:kHPWriteJournalKindCreateHaiku forKey:kHPWriteJournalKindKey];
+      if (_attributes) {
+        [record setObject:_attributes forKey:kHPWriteJournalAttributesKey];
+      }
+      break;
+  }
+  return record;
+}
+
+@end
+
+@implementation HPWriteJournal {
+  NSString *_directory;
+  NSString *_path;
+  dispatch_queue_t _ioQueue;
+  NSFileManager *_fileManager;
+  // Everything below is only used on |_ioQueue|.
+  // Entries in the order they were appended.
+  NSMutableArray *_entries;
+  // Number of removed entries still in the log.
+  NSUInteger _removedRecordCount;
+  // Descriptor of the log open for appending, or -1.
+  int _fileDescriptor;
+}
+
++ (NSString *)defaultDirectory {
+  NSArray *paths = NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory,
+                                                       NSUserDomainMask, YES);
+  return [[paths firstObject] stringByAppendingPathComponent:@"HPWriteJournal"];
+}
+
+- (id)init {
+  return [self initWithDirectory:[[self class] defaultDirectory]];
+}
+
+- (id)initWithDirectory:(NSString *)directory {
+  self = [super init];
+  if (self) {
+    _directory = [directory copy];
+    _path = [_directory stringByAppendingPathComponent:@"journal.log"];
+    _batchSize = kHPWriteJournalDefaultBatchSize;
+    _ioQueue = dispatch_queue_create("com.google.plus.samples.HaikuPlus.HPWriteJournal",
+                                     DISPATCH_QUEUE_SERIAL);
+    _fileManager = [[NSFileManager alloc] init];
+    _entries = [NSMutableArray array];
+    _fileDescriptor = -1;
+    dispatch_async(_ioQueue, ^{
+        [_fileManager createDirectoryAtPath:_directory
+                withIntermediateDirectories:YES
+                                 attributes:nil
+                                      error:NULL];
+        [self load];
+    });
+  }
+  return self;
+}
+
+- (void)dealloc {
+  if (_fileDescriptor >= 0) {
+    close(_fileDescriptor);
+  }
+}
+
+#pragma mark - Log
+
+/**
+ * Reads the entries left from earlier sessions. Must be called on the I/O queue.
+ */
+- (void)load {
+  NSData *data = [NSData dataWithContentsOfFile:_path options:NSDataReadingMappedIfSafe error:NULL];
+  const char *bytes = [data bytes];
+  NSUInteger length = [data length];
+  NSUInteger lineStart = 0;
+  for (NSUInteger i = 0; i < length; i++) {
+    if (bytes[i] != '\n') {
+      continue;
+    }
+    NSData *line = [data subdataWithRange:NSMakeRange(lineStart, i - lineStart)];
+    lineStart = i + 1;
+    NSDictionary *record = [NSJSONSerialization JSONObjectWithData:line options:0 error:NULL];
+    if (![record isKindOfClass:[NSDictionary class]]) {
+      continue;
+    }
+    if ([[record objectForKey:kHPWriteJournalRemovedKey] boolValue]) {
+      [self removeEntryWithKey:[record objectForKey:kHPWriteJournalKeyKey]];
+      _removedRecordCount++;
+    } else {
+      HPWriteEntry *entry = [HPWriteEntry entryWithRecord:record];
+      if (entry) {
+        [_entries addObject:entry];
+      }
+    }
+  }
+  if (lineStart < length) {
+    // The app was killed while appending the last line. Drop it, so that the next line does not
+    // start in the middle of it.
+    [self rewriteLog];
+  }
+}
+
+/**
+ * Removes the entry with a key from memory. Must be called on the I/O queue.
+ *
+ * @return YES if there was such an entry.
+ */
+- (BOOL)removeEntryWithKey:(NSString *)key {
+  NSUInteger index = [_entries indexOfObjectPassingTest:^BOOL(HPWriteEntry *entry, NSUInteger idx,
+                                                              BOOL *stop) {
+      return [entry.idempotencyKey isEqual:key];
+  }];
+  if (index == NSNotFound) {
+    return NO;
+  }
+  [_entries removeObjectAtIndex:index];
+  return YES;
+}
+
+/**
+ * Appends a line to the log and flushes it to disk. Must be called on the I/O queue.
+ *
+ * @param record JSON object of the line.
+ */
+- (void)appendRecord:(NSDictionary *)record {
+  NSMutableData *line = [[NSJSONSerialization dataWithJSONObject:record
+                                                          options:0
+                                                            error:NULL] mutableCopy];
+  if (!line) {
+    // The entry is still replayed in this session.
+    return;
+  }
+  [line appendBytes:"\n" length:1];
+  if (_fileDescriptor < 0) {
+    _fileDescriptor = open([_path fileSystemRepresentation], O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (_fileDescriptor < 0) {
+      return;
+    }
+  }
+  // With O_APPEND, the line starts at the current end of the log.
+  off_t lineOffset = lseek(_fileDescriptor, 0, SEEK_END);
+  const char *bytes = [line bytes];
+  NSUInteger remaining = [line length];
+  while (remaining > 0) {
+    ssize_t written = write(_fileDescriptor, bytes, remaining);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // Cut off the part of the line that was written, so that the next line is not glued to it
+      // and lost with it on the next launch. If that fails too, the log is written anew from the
+      // entries in memory.
+      if (lineOffset < 0 || ftruncate(_fileDescriptor, lineOffset) != 0) {
+        [self rewriteLog];
+      }
+      return;
+    }
+    bytes += written;
+    remaining -= written;
+  }
+  fsync(_fileDescriptor);
+}
+
+/**
+ * Replaces the log with one line per remaining entry. Must be called on the I/O queue.
+ */
+- (void)rewriteLog {
+  if (_fileDescriptor >= 0) {
+    close(_fileDescriptor);
+    _fileDescriptor = -1;
+  }
+  _removedRecordCount = 0;
+  if ([_entries count] == 0) {
+    [_fileManager removeItemAtPath:_path error:NULL];
+    return;
+  }
+  NSMutableData *data = [NSMutableData data];
+  for (HPWriteEntry *entry in _entries) {
+    NSData *line = [NSJSONSerialization dataWithJSONObject:[entry record] options:0 error:NULL];
+    if (line) {
+      [data appendData:line];
+      [data appendBytes:"\n" length:1];
+    }
+  }
+  [data writeToFile:_path atomically:YES];
+}
+
+#pragma mark - Entries
+
+- (void)appendEntry:(HPWriteEntry *)entry {
+  if (!entry) {
+    return;
+  }
+  dispatch_async(_ioQueue, ^{
+      [_entries addObject:entry];
+      [self appendRecord:[entry record]];
+  });
+}
+
+- (void)readEntriesWithLimit:(NSUInteger)limit completion:(void (^)(NSArray *entries))completion {
+  dispatch_async(_ioQueue, ^{
+      NSRange range = NSMakeRange(0, MIN(limit, [_entries count]));
+      NSArray *entries = [_entries subarrayWithRange:range];
+      dispatch_async(dispatch_get_main_queue(), ^{
+          completion(entries);
+      });
+  });
+}
+
+- (void)removeEntry:(HPWriteEntry *)entry {
+  NSString *key = entry.idempotencyKey;
+  if (!key) {
+    return;
+  }
+  dispatch_async(_ioQueue, ^{
+      if (![self removeEntryWithKey:key]) {
+        return;
+      }
+      _removedRecordCount++;
+      if ([_entries count] == 0 ||
+          (_removedRecordCount >= kHPWriteJournalCompactionThreshold &&
+           _removedRecordCount > [_entries count])) {
+        [self rewriteLog];
+      } else {
+        [self appendRecord:@{ kHPWriteJournalKeyKey : key, kHPWriteJournalRemovedKey : @YES }];
+      }
+  });
+}
+
+- (void)removeAllEntries {
+  dispatch_async(_ioQueue, ^{
+      [_entries removeAllObjects];
+      [self rewriteLog];
+  });
+}
+
+@end
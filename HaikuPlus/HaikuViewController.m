@@ -18,17 +18,32 @@
 #import "HaikuViewController.h"
 
 #import "HPConstants.h"
+#import "HPDateCodec.h"
 #import "HPFloatingUI.h"
 #import "HPHaiku.h"
+#import "HPImagePipeline.h"
 #import "HPUser.h"
 
 @implementation HaikuViewController {
   BOOL _sharePending;
+  // YES when a vote waits for the haiku to load.
+  BOOL _voteWhenLoaded;
+  HPImageLoadToken *_authorImageLoadToken;
+}
+
+- (void)dealloc {
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
 }
 
 - (void)viewDidLoad {
   [super viewDidLoad];
 
+  // Votes made on any screen change the count shown here.
+  [[NSNotificationCenter defaultCenter] addObserver:self
+                                           selector:@selector(haikuVotesDidChange:)
+                                               name:kHPConstantsHaikuVotesDidChangeNotification
+                                             object:nil];
+
   // Prepare haiku view when the view first loads.
   [self refreshHaikuView];
 }
@@ -152,33 +167,58 @@
 }
 
 /**
- * Vote using the Haiku+ API.
+ * Vote using the Haiku+ API. The count is updated right away, and the server's answer is
+ * reconciled in the background.
  */
 - (void)vote {
   _votePending = NO;
-
-  [_floatingUI addLoadingSpinner];
-  [_communicator voteForHaikuWithID:_haikuID completion:^(NSError *error) {
-      [_floatingUI removeLoadingSpinner];
-      [self didCompleteVote:error];
+  if (![_haiku.identifier isEqual:_haikuID]) {
+    // The haiku has not loaded yet, for example when this view opens from a deep link to vote, so
+    // there is no count to update. Vote once it has loaded.
+    _voteWhenLoaded = YES;
+    return;
+  }
+  _voteWhenLoaded = NO;
+  [_communicator voteForHaiku:_haiku
+                       status:^(HPWriteEntry *entry, HPWriteStatus status, id result,
+                                NSError *error) {
+      [self didUpdateVoteWithStatus:status error:error];
   }];
+  // The communicator posts the new count, which refreshes this view.
+  [_floatingUI showToast:@"Voted!"];
 }
 
 /**
- * Show result of vote to user and reload haiku if vote was successful.
+ * Tell the user when a vote cannot be sent for now or has been rejected. A rejected vote has
+ * already been removed from the count.
  *
- * @param error Error from the server which is nil on success.
+ * @param status New state of the vote.
+ * @param error Error that failed the vote, or that sent it back to pending.
  */
-- (void)didCompleteVote:(NSError *)error {
-  if (!error) {
-    [self reloadHaiku];
-    [_floatingUI showToast:@"Voted!"];
-  } else {
+- (void)didUpdateVoteWithStatus:(HPWriteStatus)status error:(NSError *)error {
+  if (status == HPWriteStatusPending && error) {
+    [_floatingUI showToast:@"Vote saved. It will be sent when you are back online."];
+  } else if (status == HPWriteStatusFailed) {
     NSString *message = [NSString stringWithFormat:@"Could not vote: %@", error];
     [_floatingUI showToast:message];
   }
 }
 
+/**
+ * Show a vote count change made on any screen.
+ *
+ * @param notification kHPConstantsHaikuVotesDidChangeNotification from the communicator.
+ */
+- (void)haikuVotesDidChange:(NSNotification *)notification {
+  NSDictionary *userInfo = [notification userInfo];
+  if (!_haiku || ![[userInfo objectForKey:kHPConstantsHaikuIDKey] isEqual:_haiku.identifier]) {
+    return;
+  }
+  NSInteger delta = [[userInfo objectForKey:kHPConstantsHaikuVotesDeltaKey] integerValue];
+  _haiku = [_haiku haikuByChangingVotesBy:delta];
+  _votesLabel.text = [NSString stringWithFormat:@"Votes: %d", _haiku.votes];
+}
+
 /**
  * Make network call requesting haiku.
  */
@@ -201,6 +241,9 @@
 - (void)didReceiveHaiku:(HPHaiku *)haiku error:(NSError *)error {
   if (!error) {
     _haiku = haiku;
+    if (_voteWhenLoaded) {
+      [self vote];
+    }
   } else {
     NSLog(@"Could not retrieve haiku: %@", error);
     [_floatingUI showToast:@"Could not retrieve haiku"];
@@ -217,25 +260,29 @@
   _lineThreeLabel.text = _haiku.line_three;
   _votesLabel.text = [NSString stringWithFormat:@"Votes: %d", _haiku.votes];
   _authorDisplayNameLabel.text = _haiku.author.google_display_name;
+  // Only the image for the latest haiku data may be shown.
+  [_authorImageLoadToken cancel];
+  _authorImageLoadToken = nil;
   if (_haiku) {
     [_authorDisplayImageView setImage:nil];
-    [_communicator fetchImageWithURL:[NSURL URLWithString:_haiku.author.google_photo_url]
-                          completion:^(UIImage *image, NSError *error) {
-                              if (!error) {
-                                [_authorDisplayImageView setImage:image];
-                              } else {
-                                NSLog(@"Could not retrieve author profile image: %@", error);
-                                NSLog(@"Author profile image: %@", _haiku.author.google_photo_url);
-                              }
-                          }];
+    NSURL *url = [NSURL URLWithString:_haiku.author.google_photo_url];
+    _authorImageLoadToken =
+        [_communicator fetchImageWithURL:url
+                              completion:^(UIImage *image, NSError *error) {
+                                  if (!error) {
+                                    [_authorDisplayImageView setImage:image];
+                                  } else {
+                                    NSLog(@"Could not retrieve author profile image: %@", error);
+                                    NSLog(@"Author profile image: %@",
+                                          _haiku.author.google_photo_url);
+                                  }
+                              }];
   } else {
     // If we're initializing a blank page (the haiku has not been loaded yet), do not fetch
     // an image and just set the image to nil.
     [_authorDisplayImageView setImage:nil];
   }
-  NSDateFormatter* dateFormatter = [[NSDateFormatter alloc] init];
-  [dateFormatter setDateFormat:kHPConstantsVisibleDateFormat];
-  _dateCreatedLabel.text  = [dateFormatter stringFromDate:_haiku.creation_time];
+  _dateCreatedLabel.text = [HPDateCodec visibleStringFromDate:_haiku.creation_time];
 }
 
 #pragma mark - HPCommunicatorDelegate methods
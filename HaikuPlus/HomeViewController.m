@@ -24,8 +24,13 @@
 #import "CreateHaikuViewController.h"
 #import "HaikuViewController.h"
 #import "HPConstants.h"
+#import "HPDateCodec.h"
 #import "HPFloatingUI.h"
 #import "HPHaiku.h"
+#import "HPHaikuLayoutCache.h"
+#import "HPHaikuListDiff.h"
+#import "HPHaikuPage.h"
+#import "HPImagePipeline.h"
 #import "HPUser.h"
 
 enum {
@@ -40,14 +45,27 @@ enum {
   kHaikuOptionsViewFilterControl = 108
 };
 
+// Width taken from haiku rows by the disclosure indicator.
+static const CGFloat kHomeViewAccessoryWidth = 33;
+
 @implementation HomeViewController {
   // This view controller keeps track of the sign-in state so that when the communicator
   // tells this object about sign-in updates, this view controller knows whether or not to fetch
   // haiku information.
   BOOL _isSignedIn;
-  NSDateFormatter* _dateFormatter;
   NSString *_overriddenHaikuID;
   BOOL _voteAfterNextSegue;
+  // Cursor for the next page of haikus, or nil when the last page has been received.
+  NSString *_nextCursor;
+  BOOL _isFetchingNextPage;
+  // Incremented on every reload so that pages requested for an older feed are ignored.
+  NSUInteger _feedGeneration;
+  // Map from haiku cell to the HPImageLoadToken of the avatar it is waiting for.
+  NSMapTable *_imageLoadTokens;
+  // Row layouts measured off the main thread when haikus arrive.
+  HPHaikuLayoutCache *_layoutCache;
+  // Serial queue comparing a refreshed list of haikus with the shown one.
+  dispatch_queue_t _diffQueue;
 }
 
 - (id)init {
@@ -62,12 +80,23 @@ enum {
   self = [super initWithCoder:aDecoder];
   if (self) {
     _appDelegate = (AppDelegate *)[[UIApplication sharedApplication] delegate];
-    _dateFormatter = [[NSDateFormatter alloc] init];
-    [_dateFormatter setDateFormat:kHPConstantsVisibleDateFormat];
+    _imageLoadTokens = [NSMapTable weakToStrongObjectsMapTable];
+    _layoutCache = [[HPHaikuLayoutCache alloc] init];
+    _diffQueue = dispatch_queue_create("com.google.plus.samples.HaikuPlus.HomeViewController",
+                                       NULL);
+    // Votes made on any screen change the counts shown in the list.
+    [[NSNotificationCenter defaultCenter] addObserver:self
+                                             selector:@selector(haikuVotesDidChange:)
+                                                 name:kHPConstantsHaikuVotesDidChangeNotification
+                                               object:nil];
   }
   return self;
 }
 
+- (void)dealloc {
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
 - (void)viewDidLoad {
   [super viewDidLoad];
   // Use the communicator prepared by the AppDelegate.
@@ -75,6 +104,21 @@ enum {
   // This class shows UI to the user when actions take place.
   _floatingUI = _appDelegate.floatingUI;
   _signInButton.style = kGPPSignInButtonStyleWide;
+  _layoutCache.width = CGRectGetWidth(_tableView.bounds) - kHomeViewAccessoryWidth;
+}
+
+- (void)viewDidLayoutSubviews {
+  [super viewDidLayoutSubviews];
+  CGFloat rowWidth = CGRectGetWidth(_tableView.bounds) - kHomeViewAccessoryWidth;
+  if (rowWidth != _layoutCache.width) {
+    // Layouts for the old width were discarded, so measure the loaded haikus again before the
+    // table asks for their heights.
+    _layoutCache.width = rowWidth;
+    [_layoutCache precomputeLayoutsForHaikus:_haikus completion:^(NSDictionary *layouts) {
+        [_layoutCache addLayouts:layouts];
+        [_tableView reloadData];
+    }];
+  }
 }
 
 - (void)viewWillAppear:(BOOL)animated {
@@ -201,29 +245,116 @@ enum {
   }
 }
 
-// Make network call requesting haikus.
+// Make network call requesting the first page of haikus.
 - (void)reloadHaikus {
+  NSUInteger generation = ++_feedGeneration;
+  _nextCursor = nil;
+  _isFetchingNextPage = NO;
   [_floatingUI addLoadingSpinner];
   [_communicator fetchHaikusFiltered:[self isFilteringByFriends]
-                          completion:^(NSArray *haikus, NSError *error) {
-                              [_floatingUI removeLoadingSpinner];
-                              [self didReceiveHaikus:haikus error:error];
+                            pageSize:kHPConstantsHaikusPageSize
+                              cursor:nil
+                          completion:^(HPHaikuPage *page, NSError *error) {
+                              // A cached page is followed by the page from the server, so
+                              // keep spinning until the server answers.
+                              if (error || ![page isCached]) {
+                                [_floatingUI removeLoadingSpinner];
+                              }
+                              if (generation == _feedGeneration) {
+                                [self didReceiveFirstPage:page error:error];
+                              }
+                          }];
+}
+
+/**
+ * Request the next page of haikus when the row being displayed is close to the end of the
+ * loaded haikus, so that the page arrives before the user scrolls to it.
+ *
+ * @param haikuIndex Index of the haiku being displayed.
+ */
+- (void)fetchNextPageIfNeededForHaikuIndex:(NSUInteger)haikuIndex {
+  if (!_nextCursor || _isFetchingNextPage) {
+    return;
+  }
+  if (haikuIndex + kHPConstantsHaikusPrefetchDistance < [_haikus count]) {
+    return;
+  }
+  _isFetchingNextPage = YES;
+  NSUInteger generation = _feedGeneration;
+  [_communicator fetchHaikusFiltered:[self isFilteringByFriends]
+                            pageSize:kHPConstantsHaikusPageSize
+                              cursor:_nextCursor
+                          completion:^(HPHaikuPage *page, NSError *error) {
+                              if (generation == _feedGeneration) {
+                                [self didReceiveNextPage:page error:error];
+                              }
                           }];
 }
 
 /**
- * Receive haiku from communicator. Called by this class.
+ * Receive the first page of haikus from communicator. Called by this class.
+ *
+ * @param page The page retrieved from the Haiku+ server.
+ * @param error Error from the server request which is nil on success.
+ */
+- (void)didReceiveFirstPage:(HPHaikuPage *)page error:(NSError *)error {
+  // The cursor of a cached page may be outdated, so wait for the server's page before
+  // requesting more haikus.
+  NSString *nextCursor = [page isCached] ? nil : page.nextCursor;
+  [self didReceiveHaikus:page.haikus nextCursor:nextCursor error:error];
+}
+
+/**
+ * Append a page of haikus from communicator to the list once their rows are measured. The next
+ * page is not requested before then. Called by this class.
+ *
+ * @param page The page retrieved from the Haiku+ server.
+ * @param error Error from the server request which is nil on success.
+ */
+- (void)didReceiveNextPage:(HPHaikuPage *)page error:(NSError *)error {
+  if (!error) {
+    NSUInteger generation = _feedGeneration;
+    [_layoutCache precomputeLayoutsForHaikus:page.haikus completion:^(NSDictionary *layouts) {
+        if (generation != _feedGeneration) {
+          return;
+        }
+        _isFetchingNextPage = NO;
+        _nextCursor = page.nextCursor;
+        NSRange appendedRange = NSMakeRange([_haikus count], [page.haikus count]);
+        [_layoutCache addLayouts:layouts];
+        _haikus = [_haikus arrayByAddingObjectsFromArray:page.haikus];
+        NSIndexSet *appendedIndexes = [NSIndexSet indexSetWithIndexesInRange:appendedRange];
+        [_tableView insertRowsAtIndexPaths:[self indexPathsForHaikuIndexes:appendedIndexes]
+                          withRowAnimation:UITableViewRowAnimationNone];
+    }];
+  } else {
+    // Keep the cursor so the page is requested again when the next row is displayed.
+    _isFetchingNextPage = NO;
+    NSLog(@"Could not retrieve next page of haikus: %@", error);
+  }
+}
+
+/**
+ * Receive haiku from communicator. The haikus are shown once their rows are measured, so that
+ * the table never measures text on the main thread. Called by this class.
  *
  * @param user The haiku object retrieved from the Haiku+ server.
+ * @param nextCursor Cursor of the page following the haikus, or nil.
  * @param error Error from the server request which is nil on success.
  */
-- (void)didReceiveHaikus:(NSArray *)haikus error:(NSError *)error {
+- (void)didReceiveHaikus:(NSArray *)haikus
+              nextCursor:(NSString *)nextCursor
+                   error:(NSError *)error {
   if (!error) {
     NSLog(@"Haikus received: %u", (unsigned int)[haikus count]);
-    // Store haikus.
-    _haikus = haikus;
-    // Tell tableView to reload haiku data.
-    [_tableView reloadData];
+    // No page is appended to a list that is about to be replaced.
+    _nextCursor = nil;
+    NSUInteger generation = _feedGeneration;
+    [_layoutCache precomputeLayoutsForHaikus:haikus completion:^(NSDictionary *layouts) {
+        if (generation == _feedGeneration) {
+          [self showHaikus:haikus layouts:layouts nextCursor:nextCursor];
+        }
+    }];
   } else {
     // Failed because of a bad network connection or because the user is not signed in and the app
     // is trying to filter haikus by friends.
@@ -232,6 +363,102 @@ enum {
   }
 }
 
+/**
+ * Replace the shown haikus. The new list is compared with the shown one on a background queue
+ * and only the rows that changed are updated, so that unchanged rows keep their cells and their
+ * avatar loads. The layouts of the new list are added to the cache when it is shown, so that
+ * rows still showing old text keep their old height until then.
+ *
+ * @param haikus HPHaiku objects to show.
+ * @param layouts Layouts precomputed for |haikus|.
+ * @param nextCursor Cursor of the page following the haikus, or nil.
+ */
+- (void)showHaikus:(NSArray *)haikus
+           layouts:(NSDictionary *)layouts
+        nextCursor:(NSString *)nextCursor {
+  NSArray *shownHaikus = _haikus;
+  if ([shownHaikus count] == 0) {
+    _nextCursor = nextCursor;
+    [_layoutCache addLayouts:layouts];
+    _haikus = haikus;
+    [_tableView reloadData];
+    return;
+  }
+  NSUInteger generation = _feedGeneration;
+  dispatch_async(_diffQueue, ^{
+      HPHaikuListDiff *diff = [HPHaikuListDiff diffFromHaikus:shownHaikus toHaikus:haikus];
+      dispatch_async(dispatch_get_main_queue(), ^{
+          if (generation != _feedGeneration) {
+            return;
+          }
+          _nextCursor = nextCursor;
+          [_layoutCache addLayouts:layouts];
+          if (_haikus != shownHaikus || diff.changeCount > kHPConstantsHaikusMaxRowUpdates) {
+            // Another list was shown while this one was compared, or too many rows changed
+            // for row updates to be cheaper than a reload.
+            _haikus = haikus;
+            [_tableView reloadData];
+          } else {
+            [self updateRowsToHaikus:haikus withDiff:diff];
+          }
+      });
+  });
+}
+
+/**
+ * Apply the difference between the shown haikus and a new list as one batch of row updates.
+ *
+ * @param haikus HPHaiku objects to show.
+ * @param diff Diff from the shown haikus to |haikus|.
+ */
+- (void)updateRowsToHaikus:(NSArray *)haikus withDiff:(HPHaikuListDiff *)diff {
+  if (diff.changeCount == 0) {
+    _haikus = haikus;
+    return;
+  }
+  NSUInteger firstRow = _isSignedIn ? 1 : 0;
+  [_tableView beginUpdates];
+  [_tableView deleteRowsAtIndexPaths:[self indexPathsForHaikuIndexes:diff.deletedIndexes]
+                    withRowAnimation:UITableViewRowAnimationFade];
+  [_tableView insertRowsAtIndexPaths:[self indexPathsForHaikuIndexes:diff.insertedIndexes]
+                    withRowAnimation:UITableViewRowAnimationFade];
+  [_tableView reloadRowsAtIndexPaths:[self indexPathsForHaikuIndexes:diff.updatedIndexes]
+                    withRowAnimation:UITableViewRowAnimationNone];
+  [diff enumerateMovesUsingBlock:^(NSUInteger fromIndex, NSUInteger toIndex) {
+      [_tableView moveRowAtIndexPath:[NSIndexPath indexPathForRow:fromIndex + firstRow inSection:0]
+                         toIndexPath:[NSIndexPath indexPathForRow:toIndex + firstRow inSection:0]];
+  }];
+  _haikus = haikus;
+  [_tableView endUpdates];
+}
+
+/**
+ * Show a vote count change made on any screen in the rows of the same haiku.
+ *
+ * @param notification kHPConstantsHaikuVotesDidChangeNotification from the communicator.
+ */
+- (void)haikuVotesDidChange:(NSNotification *)notification {
+  NSDictionary *userInfo = [notification userInfo];
+  NSString *haikuID = [userInfo objectForKey:kHPConstantsHaikuIDKey];
+  NSInteger delta = [[userInfo objectForKey:kHPConstantsHaikuVotesDeltaKey] integerValue];
+  NSUInteger firstRow = _isSignedIn ? 1 : 0;
+  NSMutableArray *indexPaths = [NSMutableArray array];
+  // The shown haikus may still be read on the diff queue, so the list is replaced rather than
+  // changed.
+  NSMutableArray *haikus = [_haikus mutableCopy];
+  [_haikus enumerateObjectsUsingBlock:^(HPHaiku *haiku, NSUInteger index, BOOL *stop) {
+      if (![haiku.identifier isEqual:haikuID]) {
+        return;
+      }
+      [haikus replaceObjectAtIndex:index withObject:[haiku haikuByChangingVotesBy:delta]];
+      [indexPaths addObject:[NSIndexPath indexPathForRow:index + firstRow inSection:0]];
+  }];
+  if ([indexPaths count] > 0) {
+    _haikus = haikus;
+    [_tableView reloadRowsAtIndexPaths:indexPaths withRowAnimation:UITableViewRowAnimationNone];
+  }
+}
+
 #pragma mark - Table View
 
 /**
@@ -242,16 +469,45 @@ enum {
  * @return HPHaiku or nil if the row contains a different UI element.
  */
 - (HPHaiku *)haikuForIndexPath:(NSIndexPath *)indexPath {
+  NSUInteger haikuIndex = [self haikuIndexForIndexPath:indexPath];
+  if (haikuIndex == NSNotFound) {
+    // This row contains options for creating and filtering haikus.
+    return nil;
+  }
+  return [_haikus objectAtIndex:haikuIndex];
+}
+
+/**
+ * Index of the haiku shown at an index path.
+ *
+ * @param indexPath the index path that might contain a haiku.
+ * @return Index in |haikus| or NSNotFound if the row contains a different UI element.
+ */
+- (NSUInteger)haikuIndexForIndexPath:(NSIndexPath *)indexPath {
   NSUInteger haikuIndex = indexPath.row;
   if (_isSignedIn) {
     if (haikuIndex == 0) {
-      // This row contains options for creating and filtering haikus.
-      return nil;
+      return NSNotFound;
     } else {
       haikuIndex--;
     }
   }
-  return [_haikus objectAtIndex:haikuIndex];;
+  return haikuIndex;
+}
+
+/**
+ * Index paths of the rows showing haikus.
+ *
+ * @param indexes Indexes in |haikus|.
+ * @return NSIndexPath objects in section 0.
+ */
+- (NSArray *)indexPathsForHaikuIndexes:(NSIndexSet *)indexes {
+  NSUInteger firstRow = _isSignedIn ? 1 : 0;
+  NSMutableArray *indexPaths = [NSMutableArray arrayWithCapacity:[indexes count]];
+  [indexes enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+      [indexPaths addObject:[NSIndexPath indexPathForRow:index + firstRow inSection:0]];
+  }];
+  return indexPaths;
 }
 
 /**
@@ -270,11 +526,18 @@ enum {
   }
 }
 
+/**
+ * Return row height for UITableView delegate. Haiku rows are as tall as their measured layout.
+ *
+ * @param tableView Haiku table view.
+ * @param indexPath Index path of the options row or of a haiku.
+ * @return Height of the row.
+ */
 - (CGFloat)tableView:(UITableView *)tableView heightForRowAtIndexPath:(NSIndexPath *)indexPath {
   if (_isSignedIn && indexPath.row == 0) {
     return 140;
   } else {
-    return 220;
+    return [_layoutCache layoutForHaiku:[self haikuForIndexPath:indexPath]].height;
   }
 }
 
@@ -292,6 +555,7 @@ enum {
   if (_isSignedIn && indexPath.row == 0) {
     return [self haikuOptionsCellForTableView:tableView];
   } else {
+    [self fetchNextPageIfNeededForHaikuIndex:[self haikuIndexForIndexPath:indexPath]];
     HPHaiku *haiku = [self haikuForIndexPath:indexPath];
     return [self tableView:tableView cellForHaiku:haiku];
   }
@@ -360,24 +624,64 @@ enum {
   haikuVotes.text = [NSString stringWithFormat:@"Votes: %d", haiku.votes];
   authorName.text = [NSString stringWithFormat:@"By %@", haiku.author.google_display_name];
 
-  NSString *dateString = [_dateFormatter stringFromDate:haiku.creation_time];
-  haikuCreationDate.text = dateString;
-
-  // Asynchronously fetch author image for each haiku.
+  haikuCreationDate.text = [HPDateCodec visibleStringFromDate:haiku.creation_time];
+
+  // Long titles, lines and names wrap to the frames measured for this haiku.
+  HPHaikuRowLayout *layout = [_layoutCache layoutForHaiku:haiku];
+  haikuTitleView.numberOfLines = 0;
+  haikuTitleView.frame = layout.titleFrame;
+  haikuLineOne.numberOfLines = 0;
+  haikuLineOne.frame = layout.lineOneFrame;
+  haikuLineTwo.numberOfLines = 0;
+  haikuLineTwo.frame = layout.lineTwoFrame;
+  haikuLineThree.numberOfLines = 0;
+  haikuLineThree.frame = layout.lineThreeFrame;
+  authorImageView.frame = layout.imageFrame;
+  authorName.numberOfLines = 0;
+  authorName.frame = layout.authorFrame;
+  haikuCreationDate.frame = layout.dateFrame;
+  haikuVotes.frame = layout.votesFrame;
+
+  // Asynchronously fetch author image for each haiku. A reused cell first cancels the fetch for
+  // the haiku it showed before, so that a late image never replaces the current one.
+  [self cancelImageLoadForCell:cell];
   NSURL *url = [NSURL URLWithString:haiku.author.google_photo_url];
   [authorImageView setImage:nil];
-  [_communicator fetchImageWithURL:url
-                        completion:^(UIImage *image, NSError *error) {
-                            if (!error) {
-                              [authorImageView setImage:image];
-                            } else {
-                              NSLog(@"Could not retrieve author profile image: %@", error);
-                            }
-                        }];
+  HPImageLoadToken *token =
+      [_communicator fetchImageWithURL:url
+                            completion:^(UIImage *image, NSError *error) {
+                                if (!error) {
+                                  [authorImageView setImage:image];
+                                } else {
+                                  NSLog(@"Could not retrieve author profile image: %@", error);
+                                }
+                            }];
+  if (token) {
+    [_imageLoadTokens setObject:token forKey:cell];
+  }
 
   return cell;
 }
 
+/**
+ * Cancels the avatar fetch of a cell that no longer shows its haiku.
+ *
+ * @param cell Haiku cell.
+ */
+- (void)cancelImageLoadForCell:(UITableViewCell *)cell {
+  [[_imageLoadTokens objectForKey:cell] cancel];
+  [_imageLoadTokens removeObjectForKey:cell];
+}
+
+/**
+ * Stop fetching avatars for rows that scrolled off screen so that visible rows get the bandwidth.
+ */
+- (void)tableView:(UITableView *)tableView
+    didEndDisplayingCell:(UITableViewCell *)cell
+       forRowAtIndexPath:(NSIndexPath *)indexPath {
+  [self cancelImageLoadForCell:cell];
+}
+
 #pragma mark - Navigation
 
 - (void)prepareForSegue:(UIStoryboardSegue *)segue sender:(id)sender {
@@ -17,6 +17,7 @@
 
 #import "AFHTTPRequestOperation.h"
 
+@class HPJSONStreamParser;
 @class SimulatedNSMutableURLRequest;
 
 /**
@@ -29,4 +30,15 @@
 @property(nonatomic, copy) void (^successBlock)(AFHTTPRequestOperation *op, id object);
 @property(nonatomic, copy) void (^failureBlock)(AFHTTPRequestOperation *op, NSError *error);
 
+/**
+ * The simulated HTTP response and body, returned by |response| and |responseData|.
+ */
+@property(nonatomic, strong) NSHTTPURLResponse *simulatedResponse;
+@property(nonatomic, strong) NSData *simulatedResponseData;
+
+/**
+ * Parser that receives the body of a successful response in chunks, or nil.
+ */
+@property(nonatomic, strong) HPJSONStreamParser *streamParser;
+
 @end
@@ -19,4 +19,12 @@
 
 @implementation SimulatedAFHTTPRequestOperation
 
+- (NSHTTPURLResponse *)response {
+  return _simulatedResponse;
+}
+
+- (NSData *)responseData {
+  return _simulatedResponseData;
+}
+
 @end
@@ -17,6 +17,9 @@
 
 #import "HPNetworkClient.h"
 
+@class SimulatedHaikuDataset;
+@class SimulatedLatencyDistribution;
+
 /*
  * This fake network simulates a simple Haiku+ API server. This class can replace HPNetworkClient
  * if you have not implemented a Haiku+ API server and want to try the app locally.
@@ -29,6 +32,134 @@
 typedef void (^AFSuccessBlock)(AFHTTPRequestOperation *, id);
 typedef void (^AFFailureBlock)(AFHTTPRequestOperation *, NSError *);
 
+/**
+ * Number of generated haikus served after the fixed haikus. Set this to a large value to measure
+ * how the app behaves with a large feed. Defaults to 0.
+ */
+@property(nonatomic) NSUInteger syntheticHaikuCount;
+
+/**
+ * Source of the generated haikus. Replace it with a dataset of another seed or payload shape to
+ * load-test with other data. Defaults to a dataset with the default seed and 100 authors.
+ */
+@property(nonatomic, strong) SimulatedHaikuDataset *dataset;
+
+/**
+ * Whether GET responses carry an ETag and matching If-None-Match requests are answered with
+ * 304 Not Modified. Defaults to YES.
+ */
+@property(nonatomic) BOOL simulatesValidators;
+
+/**
+ * Size of the chunks in which streamed response bodies are handed to the parser. Defaults to
+ * 1460 bytes, the payload of a typical TCP segment.
+ */
+@property(nonatomic) NSUInteger streamChunkLength;
+
+/**
+ * Number of response body bytes the simulated server has sent.
+ */
+@property(nonatomic, readonly) unsigned long long sentByteCount;
+
+#pragma mark - Network conditions
+
+/**
+ * Whether operations complete later, on the queues AFNetworking would use, instead of before
+ * |enqueueHTTPRequestOperation:| returns. Latency, bandwidth and timeouts are only simulated when
+ * this is YES. Streamed bodies reach the parser on a private serial queue standing in for the
+ * network thread, and completion blocks are called on the success or failure callback queue of
+ * the operation, or the main queue. Cancelled operations fail with NSURLErrorCancelled. Defaults
+ * to NO, so that tests can rely on synchronous completion.
+ */
+@property(nonatomic) BOOL deliversAsynchronously;
+
+/**
+ * Latency of requests to endpoints without a distribution of their own. Defaults to nil, which
+ * answers at once.
+ */
+@property(nonatomic, strong) SimulatedLatencyDistribution *defaultLatencyDistribution;
+
+/**
+ * Largest number of response body bytes sent per second, or 0 for no limit. Defaults to 0.
+ */
+@property(nonatomic) double bandwidth;
+
+/**
+ * Fraction of requests, from 0 to 1, answered with 503 Service Unavailable. Defaults to 0.
+ */
+@property(nonatomic) double serverErrorRate;
+
+/**
+ * Fraction of requests, from 0 to 1, answered with 429 Too Many Requests and a Retry-After header
+ * of |throttleRetryAfter|. Defaults to 0.
+ */
+@property(nonatomic) double throttleRate;
+
+/**
+ * Value of the Retry-After header of throttled responses, or nil for none. Defaults to @"1".
+ */
+@property(nonatomic, copy) NSString *throttleRetryAfter;
+
+/**
+ * Number of requests that failed because their simulated response took longer than the timeout
+ * interval of the request.
+ */
+@property(nonatomic, readonly) NSUInteger timedOutRequestCount;
+
+/**
+ * Restarts the random source of latencies and error rates, so a run can be repeated.
+ *
+ * @param seed Seed of the random source.
+ */
+- (void)setRandomSeed:(uint64_t)seed;
+
+/**
+ * @param distribution Latency of requests to the endpoint, or nil to use the default.
+ * @param endpoint One of the endpoint names in HPConstants, such as kHPConstantsHaikusEndpoint.
+ */
+- (void)setLatencyDistribution:(SimulatedLatencyDistribution *)distribution
+                   forEndpoint:(NSString *)endpoint;
+
+/**
+ * @param endpoint One of the endpoint names in HPConstants.
+ * @return The latency distribution of the endpoint, or nil if it uses the default.
+ */
+- (SimulatedLatencyDistribution *)latencyDistributionForEndpoint:(NSString *)endpoint;
+
+#pragma mark - Injected failures
+
+/**
+ * Number of injected failures that have not been used yet.
+ */
+@property(nonatomic, readonly) NSUInteger injectedFailureCount;
+
+/**
+ * Makes a later request fail with an HTTP error. Injected failures are used one per enqueued
+ * request, in the order they were injected, and requests are answered normally once they have
+ * all been used. A sequence of injected failures simulates a flaky server.
+ *
+ * @param statusCode HTTP status code of the failed response, such as 503.
+ * @param retryAfter Value of the Retry-After header of the response, or nil.
+ */
+- (void)injectFailureWithStatusCode:(NSInteger)statusCode retryAfter:(NSString *)retryAfter;
+
+/**
+ * Makes a later request fail without a response, as when the connection is lost or times out.
+ *
+ * @param error Error of the failed request, such as NSURLErrorTimedOut in NSURLErrorDomain.
+ */
+- (void)injectFailureWithError:(NSError *)error;
+
+/**
+ * Makes a later request fail after part of a successful response has arrived, as when the
+ * connection drops in the middle of a large page. A streamed body reaches the parser up to the
+ * byte count before the operation fails.
+ *
+ * @param byteCount Number of response body bytes sent before the failure.
+ * @param error Error of the failed request, such as NSURLErrorNetworkConnectionLost.
+ */
+- (void)injectFailureAfterByteCount:(NSUInteger)byteCount error:(NSError *)error;
+
 @end
 
 /**
@@ -17,10 +17,21 @@
 
 #import "SimulatedHPNetworkClient.h"
 
+#import "AFURLConnectionOperation.h"
 #import "HPConstants.h"
+#import "HPJSONStreamParser.h"
 #import "SimulatedAFHTTPRequestOperation.h"
+#import "SimulatedHaikuDataset.h"
+#import "SimulatedLatencyDistribution.h"
 #import "SimulatedNSMutableURLRequest.h"
 
+#include <math.h>
+
+/**
+ * Fails one operation. Used for injected failures and simulated error rates.
+ */
+typedef void (^SimulatedFailure)(SimulatedAFHTTPRequestOperation *op);
+
 @implementation SimulatedHPNetworkClient {
   NSString *_userAgentHeader;
   NSError *_error;
@@ -29,6 +40,15 @@
   NSDictionary *_haikuAttributes;
   NSDictionary *_haikuAttributes2;
   NSArray *_haikuAttributesArray;
+  // Blocks that each fail one operation, used in order.
+  NSMutableArray *_injectedFailures;
+  // Latency distributions by endpoint name.
+  NSMutableDictionary *_latencyDistributions;
+  // State of the random source of latencies and error rates. Guarded by @synchronized(self).
+  uint64_t _randomState;
+  // Serial queue standing in for the network link. Response bodies are sent on it one at a time,
+  // so the bandwidth is shared by concurrent requests as on a real connection.
+  dispatch_queue_t _networkQueue;
 }
 
 /**
@@ -80,6 +100,16 @@ NSString *SimulatedHPNetworkClientErrorDomain = @"SimulatedHPNetworkClientErrorD
     _haikuAttributes,
     _haikuAttributes2,
   ];
+  _dataset = [[SimulatedHaikuDataset alloc] init];
+  _syntheticHaikuCount = 0;
+  _simulatesValidators = YES;
+  _streamChunkLength = 1460;
+  _injectedFailures = [NSMutableArray array];
+  _latencyDistributions = [NSMutableDictionary dictionary];
+  _throttleRetryAfter = @"1";
+  _randomState = 0;
+  _networkQueue = dispatch_queue_create(
+      "com.google.plus.samples.HaikuPlus.SimulatedHPNetworkClient", DISPATCH_QUEUE_SERIAL);
   return self;
 }
 
@@ -101,6 +131,10 @@ NSString *SimulatedHPNetworkClientErrorDomain = @"SimulatedHPNetworkClientErrorD
                                       path:(NSString *)path
                                 parameters:(NSDictionary *)parameters {
   SimulatedNSMutableURLRequest *request = [[SimulatedNSMutableURLRequest alloc] init];
+  // Use the real URL so that responses can be told apart by URL, as with the real server.
+  NSURLRequest *realRequest = [super requestWithMethod:method path:path parameters:parameters];
+  [request setURL:[realRequest URL]];
+  [request setHTTPMethod:method];
   NSString *filterPath = [NSString stringWithFormat:@"%@?filter=circles", kHPConstantsHaikusPath];
   NSString *haikuPath1 = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @"TestHaikuID"];
   NSString *haikuPath2 = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @"haikuid2"];
@@ -115,13 +149,18 @@ NSString *SimulatedHPNetworkClientErrorDomain = @"SimulatedHPNetworkClientErrorD
     } else if ([path isEqual:kHPConstantsUserPath]) {
       id object = [_userAttributes copy];
       [request setResponse:object withError:nil];
+    } else if ([path isEqual:kHPConstantsHaikusPath] &&
+               [parameters objectForKey:kHPConstantsPageSizeParameter]) {
+      // Get one page of haikus. Filtered and unfiltered feeds are the same in this simulation.
+      id object = [self pageAttributesWithParameters:parameters];
+      [request setResponse:object withError:nil];
     } else if ([path isEqual:kHPConstantsHaikusPath]) {
-      // Get unfiltered haikus.
-      id object = [_haikuAttributesArray copy];
+      // Get all haikus. Filtered and unfiltered feeds are the same in this simulation.
+      id object = [self allHaikuAttributes];
       [request setResponse:object withError:nil];
     } else if ([path isEqual:filterPath]) {
       // Get filtered haikus.
-      id object = [_haikuAttributesArray copy];
+      id object = [self allHaikuAttributes];
       [request setResponse:object withError:nil];
     } else if ([path isEqual:haikuPath1]) {
       // Get a haiku with ID "TestHaikuID".
@@ -131,6 +170,11 @@ NSString *SimulatedHPNetworkClientErrorDomain = @"SimulatedHPNetworkClientErrorD
       // Get a haiku with ID "haikuid2".
       id object = [_haikuAttributes2 copy];
       [request setResponse:object withError:nil];
+    } else if ([self syntheticHaikuIndexForPath:path] != NSNotFound) {
+      // Get a generated haiku.
+      NSUInteger index = [self syntheticHaikuIndexForPath:path];
+      id object = [_dataset haikuAttributesAtIndex:index];
+      [request setResponse:object withError:nil];
     } else {
       NSLog(@"Request to haiku server not recognized");
       [request setResponse:nil withError:_error];
@@ -155,6 +199,11 @@ NSString *SimulatedHPNetworkClientErrorDomain = @"SimulatedHPNetworkClientErrorD
       [newAttributes setValue:newVotesValue forKey:@"votes"];
       _haikuAttributes = newAttributes;
       [request setResponse:nil withError:nil];
+    } else if ([path hasSuffix:@"/vote"] &&
+               [self syntheticHaikuIndexForPath:[path stringByDeletingLastPathComponent]] !=
+                   NSNotFound) {
+      // Vote for a generated haiku. Generated haikus do not keep vote counts.
+      [request setResponse:nil withError:nil];
     } else if ([path isEqual:kHPConstantsHaikusPath]) {
       // Create haiku.
       NSMutableDictionary *newHaiku = [NSMutableDictionary dictionaryWithDictionary:parameters];
@@ -170,6 +219,223 @@ NSString *SimulatedHPNetworkClientErrorDomain = @"SimulatedHPNetworkClientErrorD
   return request;
 }
 
+#pragma mark - Simulated feed
+
+/**
+ * @return Number of haikus in the simulated feed, including fixed, created and generated haikus.
+ */
+- (NSUInteger)feedCount {
+  return [_haikuAttributesArray count] + _syntheticHaikuCount;
+}
+
+/**
+ * @param index Position in the simulated feed.
+ * @return Attributes of the fixed or created haiku at the index, or of a generated haiku.
+ */
+- (NSDictionary *)haikuAttributesAtFeedIndex:(NSUInteger)index {
+  NSUInteger fixedCount = [_haikuAttributesArray count];
+  if (index < fixedCount) {
+    return [_haikuAttributesArray objectAtIndex:index];
+  }
+  return [_dataset haikuAttributesAtIndex:index - fixedCount];
+}
+
+/**
+ * @return Attributes of every haiku in the simulated feed, as returned by a server that does not
+ *     paginate.
+ */
+- (NSArray *)allHaikuAttributes {
+  NSUInteger count = [self feedCount];
+  NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+  for (NSUInteger i = 0; i < count; i++) {
+    [array addObject:[self haikuAttributesAtFeedIndex:i]];
+  }
+  return array;
+}
+
+/**
+ * Builds a paged response. The cursor is the feed offset of the first haiku in the page, which
+ * the client treats as an opaque string.
+ *
+ * @param parameters Request parameters with a page size and an optional cursor.
+ * @return Dictionary with the page items and the cursor of the next page, if any.
+ */
+- (NSDictionary *)pageAttributesWithParameters:(NSDictionary *)parameters {
+  NSUInteger pageSize = [[parameters objectForKey:kHPConstantsPageSizeParameter] integerValue];
+  NSUInteger offset = 0;
+  NSString *cursor = [parameters objectForKey:kHPConstantsPageCursorParameter];
+  if (cursor) {
+    offset = (NSUInteger)MAX([cursor longLongValue], 0);
+  }
+  NSUInteger count = [self feedCount];
+  NSUInteger end = MIN(offset + MAX(pageSize, 1), count);
+  NSMutableArray *items = [NSMutableArray arrayWithCapacity:end > offset ? end - offset : 0];
+  for (NSUInteger i = offset; i < end; i++) {
+    [items addObject:[self haikuAttributesAtFeedIndex:i]];
+  }
+  NSMutableDictionary *page = [NSMutableDictionary dictionary];
+  [page setObject:items forKey:kHPConstantsPageItemsKey];
+  if (end < count) {
+    NSString *nextCursor = [NSString stringWithFormat:@"%lu", (unsigned long)end];
+    [page setObject:nextCursor forKey:kHPConstantsPageNextCursorKey];
+  }
+  return page;
+}
+
+/**
+ * @param path Request path.
+ * @return Index of the generated haiku that the path refers to, or NSNotFound.
+ */
+- (NSUInteger)syntheticHaikuIndexForPath:(NSString *)path {
+  NSString *prefix = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @""];
+  if (![path hasPrefix:prefix]) {
+    return NSNotFound;
+  }
+  NSString *haikuID = [path substringFromIndex:[prefix length]];
+  NSUInteger index = [_dataset indexForHaikuID:haikuID];
+  if (index == NSNotFound || index >= _syntheticHaikuCount) {
+    return NSNotFound;
+  }
+  return index;
+}
+
+#pragma mark - Network conditions
+
+- (void)setRandomSeed:(uint64_t)seed {
+  @synchronized(self) {
+    _randomState = seed;
+  }
+}
+
+- (void)setLatencyDistribution:(SimulatedLatencyDistribution *)distribution
+                   forEndpoint:(NSString *)endpoint {
+  if (distribution) {
+    [_latencyDistributions setObject:distribution forKey:endpoint];
+  } else {
+    [_latencyDistributions removeObjectForKey:endpoint];
+  }
+}
+
+- (SimulatedLatencyDistribution *)latencyDistributionForEndpoint:(NSString *)endpoint {
+  return endpoint ? [_latencyDistributions objectForKey:endpoint] : nil;
+}
+
+/**
+ * @return Uniform random value in [0, 1) from a SplitMix64 generator.
+ */
+- (double)randomValue {
+  uint64_t z;
+  @synchronized(self) {
+    _randomState += 0x9e3779b97f4a7c15ULL;
+    z = _randomState;
+  }
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z ^= z >> 31;
+  return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @return Latency of a request, drawn from the distribution of its endpoint.
+ */
+- (NSTimeInterval)latencyForRequest:(NSURLRequest *)request {
+  SimulatedLatencyDistribution *distribution =
+      [self latencyDistributionForEndpoint:[self endpointForPath:[[request URL] path]]];
+  if (!distribution) {
+    distribution = _defaultLatencyDistribution;
+  }
+  if (!distribution) {
+    return 0;
+  }
+  // Box-Muller transform of two uniform values into a standard normal value.
+  double u1 = MAX([self randomValue], DBL_MIN);
+  double u2 = [self randomValue];
+  double normal = sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+  return [distribution latencyForStandardNormalValue:normal];
+}
+
+/**
+ * Takes the failure of the next request: an injected failure if there is one, otherwise a 503 or
+ * 429 response at the configured rates.
+ *
+ * @return Block that fails the operation, or nil if the request should be answered normally.
+ */
+- (SimulatedFailure)nextFailure {
+  if ([_injectedFailures count] > 0) {
+    SimulatedFailure fail = [_injectedFailures firstObject];
+    [_injectedFailures removeObjectAtIndex:0];
+    return fail;
+  }
+  if (_serverErrorRate > 0 && [self randomValue] < _serverErrorRate) {
+    return [self failureWithStatusCode:503 retryAfter:nil];
+  }
+  if (_throttleRate > 0 && [self randomValue] < _throttleRate) {
+    return [self failureWithStatusCode:429 retryAfter:_throttleRetryAfter];
+  }
+  return nil;
+}
+
+#pragma mark - Injected failures
+
+- (NSUInteger)injectedFailureCount {
+  return [_injectedFailures count];
+}
+
+- (void)injectFailureWithStatusCode:(NSInteger)statusCode retryAfter:(NSString *)retryAfter {
+  [_injectedFailures addObject:[self failureWithStatusCode:statusCode retryAfter:retryAfter]];
+}
+
+/**
+ * @param statusCode HTTP status code of the failed response.
+ * @param retryAfter Value of the Retry-After header of the response, or nil.
+ * @return Block that fails an operation with the response.
+ */
+- (SimulatedFailure)failureWithStatusCode:(NSInteger)statusCode retryAfter:(NSString *)retryAfter {
+  SimulatedFailure fail = ^(SimulatedAFHTTPRequestOperation *op) {
+      NSMutableDictionary *headers = [NSMutableDictionary dictionary];
+      if (retryAfter) {
+        [headers setObject:retryAfter forKey:@"Retry-After"];
+      }
+      NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:[op.request URL]
+                                                                statusCode:statusCode
+                                                               HTTPVersion:@"HTTP/1.1"
+                                                              headerFields:headers];
+      op.simulatedResponse = response;
+      // The error AFHTTPRequestOperation reports for an unacceptable status code.
+      NSDictionary *userInfo = @{
+        NSURLErrorFailingURLErrorKey : [op.request URL],
+        AFNetworkingOperationFailingURLRequestErrorKey : op.request,
+        AFNetworkingOperationFailingURLResponseErrorKey : response
+      };
+      op.failureBlock(op, [NSError errorWithDomain:AFNetworkingErrorDomain
+                                              code:NSURLErrorBadServerResponse
+                                          userInfo:userInfo]);
+  };
+  return [fail copy];
+}
+
+- (void)injectFailureWithError:(NSError *)error {
+  SimulatedFailure fail = ^(SimulatedAFHTTPRequestOperation *op) {
+      op.failureBlock(op, error);
+  };
+  [_injectedFailures addObject:[fail copy]];
+}
+
+- (void)injectFailureAfterByteCount:(NSUInteger)byteCount error:(NSError *)error {
+  // Injected failures are kept by the client, so they must not keep it alive.
+  __weak SimulatedHPNetworkClient *weakSelf = self;
+  SimulatedFailure fail = ^(SimulatedAFHTTPRequestOperation *op) {
+      SimulatedNSMutableURLRequest *request = op.request;
+      op.simulatedResponse = [weakSelf responseForRequest:request statusCode:200 entityTag:nil];
+      NSUInteger length = MIN(byteCount, [request.body length]);
+      [weakSelf sendBody:request.body length:length toParser:op.streamParser deadline:0];
+      op.failureBlock(op, error);
+  };
+  [_injectedFailures addObject:[fail copy]];
+}
+
+#pragma mark - Simulated operations
+
 /**
  * Prepares a simulated operation.
  *
@@ -189,19 +455,202 @@ NSString *SimulatedHPNetworkClientErrorDomain = @"SimulatedHPNetworkClientErrorD
   return op;
 }
 
+/**
+ * Prepares a simulated operation whose response body is handed to a parser in chunks.
+ */
+- (AFHTTPRequestOperation *)HTTPRequestOperationWithRequest:(NSURLRequest *)urlRequest
+                                               streamParser:(HPJSONStreamParser *)parser
+                                                    success:(AFSuccessBlock)success
+                                                    failure:(AFFailureBlock)failure {
+  SimulatedAFHTTPRequestOperation *op =
+      (SimulatedAFHTTPRequestOperation *)[self HTTPRequestOperationWithRequest:urlRequest
+                                                                        success:success
+                                                                        failure:failure];
+  op.streamParser = parser;
+  return op;
+}
+
+/**
+ * Simulated operations are not scheduled by priority; they start as soon as they are enqueued.
+ */
+- (void)enqueueHTTPRequestOperation:(AFHTTPRequestOperation *)operation
+                           priority:(HPRequestPriority)priority {
+  [self enqueueHTTPRequestOperation:operation];
+}
+
 /**
  * Use the simulated operation to call the success or failure block with the correct object.
+ * A request whose If-None-Match header matches the entity tag of the response is answered with
+ * 304 Not Modified and no body. Injected failures take precedence over the simulated server.
+ * Unless |deliversAsynchronously| is set, the operation completes before this method returns.
  *
  * @param operation Simulated operation with a request and completion blocks.
  */
 - (void)enqueueHTTPRequestOperation:(AFHTTPRequestOperation *)operation {
+  if (!operation) {
+    return;
+  }
   SimulatedAFHTTPRequestOperation *op = (SimulatedAFHTTPRequestOperation *)operation;
+  SimulatedFailure fail = [self nextFailure];
+  if (!_deliversAsynchronously) {
+    [self respondToOperation:op failure:fail deadline:0];
+    return;
+  }
+  [self moveCallbacksOfOperationToQueues:op];
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  NSTimeInterval latency = [self latencyForRequest:op.request];
+  NSTimeInterval timeout = [op.request timeoutInterval];
+  if (timeout > 0 && latency >= timeout) {
+    // No byte arrives before the timeout.
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)),
+                   _networkQueue, ^{
+        [self failOperationWithTimeout:op];
+    });
+    return;
+  }
+  dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(latency * NSEC_PER_SEC)),
+                 _networkQueue, ^{
+      [self respondToOperation:op failure:fail deadline:(timeout > 0 ? start + timeout : 0)];
+  });
+}
+
+/**
+ * Answers a request as the simulated server would.
+ *
+ * @param op Simulated operation with a request and completion blocks.
+ * @param fail Failure to answer with, or nil.
+ * @param deadline Time at which the request times out while its body is sent, or 0 for none.
+ */
+- (void)respondToOperation:(SimulatedAFHTTPRequestOperation *)op
+                   failure:(SimulatedFailure)fail
+                  deadline:(CFAbsoluteTime)deadline {
   SimulatedNSMutableURLRequest *request = op.request;
+  if (fail) {
+    fail(op);
+    return;
+  }
   if (request.error) {
-    op.failureBlock(nil, request.error);
-  } else {
-    op.successBlock(nil, request.object);
+    op.failureBlock(op, request.error);
+    return;
+  }
+  NSString *entityTag = _simulatesValidators ? request.entityTag : nil;
+  NSString *ifNoneMatch = [request valueForHTTPHeaderField:@"If-None-Match"];
+  if (entityTag && [ifNoneMatch isEqual:entityTag]) {
+    op.simulatedResponse = [self responseForRequest:request statusCode:304 entityTag:entityTag];
+    NSError *error = [NSError errorWithDomain:AFNetworkingErrorDomain
+                                         code:NSURLErrorBadServerResponse
+                                     userInfo:nil];
+    op.failureBlock(op, error);
+    return;
+  }
+  op.simulatedResponse = [self responseForRequest:request statusCode:200 entityTag:entityTag];
+  NSData *body = request.body;
+  if (![self sendBody:body length:[body length] toParser:op.streamParser deadline:deadline]) {
+    [self failOperationWithTimeout:op];
+    return;
+  }
+  if (op.streamParser) {
+    op.successBlock(op, nil);
+    return;
+  }
+  op.simulatedResponseData = body;
+  op.successBlock(op, request.object);
+}
+
+/**
+ * Sends the start of a response body over the simulated link in chunks of |streamChunkLength|.
+ * When operations complete asynchronously and the bandwidth is limited, each chunk holds the
+ * link for as long as it takes to send.
+ *
+ * @param body Response body.
+ * @param length Number of bytes to send.
+ * @param parser Parser that receives the chunks, or nil.
+ * @param deadline Time at which sending stops, or 0 for none.
+ * @return NO if the deadline passed before every byte was sent.
+ */
+- (BOOL)sendBody:(NSData *)body
+          length:(NSUInteger)length
+        toParser:(HPJSONStreamParser *)parser
+        deadline:(CFAbsoluteTime)deadline {
+  BOOL paced = _deliversAsynchronously && _bandwidth > 0;
+  NSUInteger chunkLength = MAX(_streamChunkLength, 1);
+  for (NSUInteger offset = 0; offset < length; offset += chunkLength) {
+    NSUInteger count = MIN(chunkLength, length - offset);
+    if (paced) {
+      NSTimeInterval chunkTime = count / _bandwidth;
+      if (deadline > 0 && CFAbsoluteTimeGetCurrent() + chunkTime > deadline) {
+        // The link stays busy until the client gives up.
+        [NSThread sleepForTimeInterval:deadline - CFAbsoluteTimeGetCurrent()];
+        return NO;
+      }
+      [NSThread sleepForTimeInterval:chunkTime];
+    }
+    _sentByteCount += count;
+    [parser appendBytes:(const uint8_t *)[body bytes] + offset length:count];
+  }
+  return YES;
+}
+
+/**
+ * Fails an operation the way NSURLConnection reports a request that timed out.
+ */
+- (void)failOperationWithTimeout:(SimulatedAFHTTPRequestOperation *)op {
+  _timedOutRequestCount++;
+  NSDictionary *userInfo = @{ NSURLErrorFailingURLErrorKey : [op.request URL] };
+  op.failureBlock(op, [NSError errorWithDomain:NSURLErrorDomain
+                                          code:NSURLErrorTimedOut
+                                      userInfo:userInfo]);
+}
+
+/**
+ * Makes the completion blocks of an operation run on its callback queues, or the main queue, as
+ * AFNetworking does. An operation cancelled before it completes fails with NSURLErrorCancelled.
+ */
+- (void)moveCallbacksOfOperationToQueues:(SimulatedAFHTTPRequestOperation *)op {
+  AFSuccessBlock success = op.successBlock;
+  AFFailureBlock failure = op.failureBlock;
+  dispatch_queue_t successQueue =
+      op.successCallbackQueue ? op.successCallbackQueue : dispatch_get_main_queue();
+  dispatch_queue_t failureQueue =
+      op.failureCallbackQueue ? op.failureCallbackQueue : dispatch_get_main_queue();
+  AFFailureBlock queuedFailure = ^(AFHTTPRequestOperation *operation, NSError *error) {
+      if ([operation isCancelled]) {
+        error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+      }
+      dispatch_async(failureQueue, ^{
+          failure(operation, error);
+      });
+  };
+  op.failureBlock = queuedFailure;
+  op.successBlock = ^(AFHTTPRequestOperation *operation, id object) {
+      if ([operation isCancelled]) {
+        queuedFailure(operation, nil);
+        return;
+      }
+      dispatch_async(successQueue, ^{
+          success(operation, object);
+      });
+  };
+}
+
+/**
+ * @param request The simulated request.
+ * @param statusCode HTTP status code of the response.
+ * @param entityTag Entity tag to send in the ETag header, or nil.
+ * @return Simulated HTTP response.
+ */
+- (NSHTTPURLResponse *)responseForRequest:(NSURLRequest *)request
+                               statusCode:(NSInteger)statusCode
+                                entityTag:(NSString *)entityTag {
+  NSMutableDictionary *headers = [NSMutableDictionary dictionary];
+  [headers setObject:@"application/json" forKey:@"Content-Type"];
+  if (entityTag) {
+    [headers setObject:entityTag forKey:@"ETag"];
   }
+  return [[NSHTTPURLResponse alloc] initWithURL:[request URL]
+                                     statusCode:statusCode
+                                    HTTPVersion:@"HTTP/1.1"
+                                   headerFields:headers];
 }
 
 @end
@@ -0,0 +1,99 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Deterministic source of haiku and user attributes for the simulated server. Attributes are built
+ * on demand from the index, so the simulated feed can be arbitrarily large without holding every
+ * haiku in memory. Authors repeat across haikus the way they do on a real feed.
+ */
+@interface SimulatedHaikuDataset : NSObject
+
+/**
+ * Number of distinct authors that generated haikus are spread across.
+ */
+@property(nonatomic, readonly) NSUInteger authorCount;
+
+/**
+ * Seed that the generated words, votes and payload shapes depend on. Datasets with the same seed
+ * and settings produce the same attributes.
+ */
+@property(nonatomic, readonly) uint64_t seed;
+
+/**
+ * Fraction of haikus and authors, from 0 to 1, whose text is drawn from non-ASCII words: Japanese,
+ * accented Latin, Arabic, combining marks and emoji outside the Basic Multilingual Plane.
+ * Defaults to 0.
+ */
+@property(nonatomic) double unicodeFraction;
+
+/**
+ * Fraction of haikus, from 0 to 1, whose second line is |longLineLength| characters long instead
+ * of a few words. Defaults to 0.
+ */
+@property(nonatomic) double longLineFraction;
+
+/**
+ * Length in characters of a long line. Defaults to 2000.
+ */
+@property(nonatomic) NSUInteger longLineLength;
+
+/**
+ * @param authorCount Number of distinct authors, at least one.
+ * @return Dataset object.
+ */
+- (id)initWithAuthorCount:(NSUInteger)authorCount;
+
+/**
+ * @param authorCount Number of distinct authors, at least one.
+ * @param seed Seed of the generated attributes. A seed of 0 produces the default dataset.
+ * @return Dataset object.
+ */
+- (id)initWithAuthorCount:(NSUInteger)authorCount seed:(uint64_t)seed;
+
+/**
+ * @param identifier A haiku ID.
+ * @return YES if the ID was produced by this dataset.
+ */
+- (BOOL)isGeneratedHaikuID:(NSString *)identifier;
+
+/**
+ * @param identifier A haiku ID produced by this dataset.
+ * @return The index of the haiku, or NSNotFound.
+ */
+- (NSUInteger)indexForHaikuID:(NSString *)identifier;
+
+/**
+ * @param index Index of the author.
+ * @return Dictionary of user attributes in the format returned by the Haiku+ API.
+ */
+- (NSDictionary *)userAttributesAtIndex:(NSUInteger)index;
+
+/**
+ * @param index Index of the haiku.
+ * @return Dictionary of haiku attributes in the format returned by the Haiku+ API.
+ */
+- (NSDictionary *)haikuAttributesAtIndex:(NSUInteger)index;
+
+/**
+ * @param range Indexes of the haikus.
+ * @return Array of haiku attribute dictionaries, as in a page of the Haiku+ API.
+ */
+- (NSArray *)haikuAttributesInRange:(NSRange)range;
+
+@end
@@ -0,0 +1,215 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "SimulatedHaikuDataset.h"
+
+#include <time.h>
+
+/**
+ * Prefix for the IDs of generated haikus.
+ */
+static NSString *const kSimulatedHaikuIDPrefix = @"synthetic-";
+
+/**
+ * Generated haikus are one minute apart, starting from this Unix time and going back.
+ */
+static const time_t kSimulatedNewestHaikuTime = 1391628278;
+
+/**
+ * Salts of the hashes that decide the shape of a payload, apart from those of the haiku lines.
+ */
+static const uint32_t kSimulatedUnicodeSalt = 101;
+static const uint32_t kSimulatedLongLineSalt = 102;
+
+@implementation SimulatedHaikuDataset {
+  NSArray *_words;
+  NSArray *_unicodeWords;
+}
+
+- (id)init {
+  return [self initWithAuthorCount:100];
+}
+
+- (id)initWithAuthorCount:(NSUInteger)authorCount {
+  return [self initWithAuthorCount:authorCount seed:0];
+}
+
+- (id)initWithAuthorCount:(NSUInteger)authorCount seed:(uint64_t)seed {
+  self = [super init];
+  if (self) {
+    _authorCount = MAX(authorCount, 1);
+    _seed = seed;
+    _longLineLength = 2000;
+    _words = @[
+      @"autumn", @"moonlight", @"silent", @"pond", @"frog", @"leaps", @"cherry", @"blossom",
+      @"falls", @"winter", @"river", @"cold", @"mountain", @"mist", @"morning", @"dew",
+      @"crow", @"branch", @"evening", @"bell", @"temple", @"summer", @"grass", @"wind",
+      @"snow", @"lantern", @"old", @"quiet", @"sparrow", @"stone", @"rain", @"petal"
+    ];
+    _unicodeWords = @[
+      @"\u53e4\u6c60\u3084", @"\u86d9\u98db\u3073\u8fbc\u3080", @"\u6c34\u306e\u97f3",
+      @"\u685c", @"\u96ea", @"caf\u00e9", @"na\u00efve", @"\u00e9t\u00e9", @"Stra\u00dfe",
+      @"\u0642\u0645\u0631", @"\u0645\u0637\u0631", @"e\u0301te\u0301", @"n\u0303",
+      @"\U0001F338", @"\U0001F311", @"\U0001F438", @"\U0001F468\u200D\U0001F469\u200D\U0001F467"
+    ];
+  }
+  return self;
+}
+
+- (BOOL)isGeneratedHaikuID:(NSString *)identifier {
+  return [identifier hasPrefix:kSimulatedHaikuIDPrefix];
+}
+
+- (NSUInteger)indexForHaikuID:(NSString *)identifier {
+  if (![self isGeneratedHaikuID:identifier]) {
+    return NSNotFound;
+  }
+  NSString *indexString = [identifier substringFromIndex:[kSimulatedHaikuIDPrefix length]];
+  long long index = [indexString longLongValue];
+  return index >= 0 ? (NSUInteger)index : NSNotFound;
+}
+
+- (NSDictionary *)userAttributesAtIndex:(NSUInteger)index {
+  NSUInteger authorIndex = index % _authorCount;
+  // Avatar URLs repeat per author, so the same image is requested for all of an author's haikus.
+  NSUInteger photoSize = 100 + authorIndex % 100;
+  NSString *displayName = [NSString stringWithFormat:@"Poet %lu", (unsigned long)authorIndex];
+  if ([self chooseWithFraction:_unicodeFraction index:authorIndex salt:kSimulatedUnicodeSalt]) {
+    displayName = [NSString stringWithFormat:@"%@ %@", displayName,
+                      [self phraseForIndex:authorIndex salt:5 length:2 words:_unicodeWords]];
+  }
+  return @{
+    @"id" : [NSString stringWithFormat:@"synthetic-user-%lu", (unsigned long)authorIndex],
+    @"google_plus_id" : [NSString stringWithFormat:@"%lu", (unsigned long)(1000 + authorIndex)],
+    @"google_display_name" : displayName,
+    @"google_photo_url" : [NSString stringWithFormat:@"http://placekitten.com/%lu/%lu",
+                              (unsigned long)photoSize, (unsigned long)photoSize],
+    @"google_profile_url" : [NSString stringWithFormat:@"https://plus.google.com/%lu",
+                                (unsigned long)(1000 + authorIndex)],
+    @"last_updated" : [self timestampForOffset:authorIndex]
+  };
+}
+
+- (NSDictionary *)haikuAttributesAtIndex:(NSUInteger)index {
+  NSString *identifier = [NSString stringWithFormat:@"%@%lu", kSimulatedHaikuIDPrefix,
+                             (unsigned long)index];
+  // Authors are spread with a stride so neighbouring haikus rarely share an author.
+  NSUInteger authorIndex = (index * 7) % _authorCount;
+  NSArray *words =
+      [self chooseWithFraction:_unicodeFraction index:index salt:kSimulatedUnicodeSalt] ?
+          _unicodeWords : _words;
+  NSString *lineTwo = [self phraseForIndex:index salt:3 length:4 words:words];
+  if ([self chooseWithFraction:_longLineFraction index:index salt:kSimulatedLongLineSalt]) {
+    lineTwo = [self lineForIndex:index salt:3 characterCount:_longLineLength words:words];
+  }
+  // Votes are spread with a seeded stride so different seeds sort differently.
+  NSUInteger votes = (index * 31 + (NSUInteger)(_seed % 500)) % 500;
+  return @{
+    @"id" : identifier,
+    @"author" : [self userAttributesAtIndex:authorIndex],
+    @"title" : [self phraseForIndex:index salt:1 length:2 words:words],
+    @"line_one" : [self phraseForIndex:index salt:2 length:3 words:words],
+    @"line_two" : lineTwo,
+    @"line_three" : [self phraseForIndex:index salt:4 length:3 words:words],
+    @"votes" : [NSString stringWithFormat:@"%lu", (unsigned long)votes],
+    @"creation_time" : [self timestampForOffset:index]
+  };
+}
+
+- (NSArray *)haikuAttributesInRange:(NSRange)range {
+  NSMutableArray *array = [NSMutableArray arrayWithCapacity:range.length];
+  for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+    [array addObject:[self haikuAttributesAtIndex:i]];
+  }
+  return array;
+}
+
+#pragma mark - Helpers
+
+/**
+ * @return Initial state of the word generator for a field of an item.
+ */
+- (uint32_t)stateForIndex:(NSUInteger)index salt:(uint32_t)salt {
+  uint32_t seed = (uint32_t)(_seed ^ (_seed >> 32));
+  return (uint32_t)index * 2654435761u + salt * 40503u + seed * 2246822519u;
+}
+
+/**
+ * Decides whether an item takes an optional shape, such as Unicode text or a long line.
+ *
+ * @return YES for about |fraction| of the indexes.
+ */
+- (BOOL)chooseWithFraction:(double)fraction index:(NSUInteger)index salt:(uint32_t)salt {
+  if (fraction <= 0) {
+    return NO;
+  }
+  uint32_t state = [self stateForIndex:index salt:salt];
+  // Finish with a multiply-xorshift so that neighbouring indexes are not correlated.
+  state ^= state >> 16;
+  state *= 0x85ebca6bu;
+  state ^= state >> 13;
+  return state < fraction * UINT32_MAX;
+}
+
+/**
+ * Builds a phrase of words chosen by a small linear congruential generator seeded by the index.
+ */
+- (NSString *)phraseForIndex:(NSUInteger)index
+                        salt:(uint32_t)salt
+                      length:(NSUInteger)length
+                       words:(NSArray *)wordList {
+  uint32_t state = [self stateForIndex:index salt:salt];
+  NSMutableArray *words = [NSMutableArray arrayWithCapacity:length];
+  for (NSUInteger i = 0; i < length; i++) {
+    state = state * 1664525u + 1013904223u;
+    [words addObject:[wordList objectAtIndex:(state >> 16) % [wordList count]]];
+  }
+  return [words componentsJoinedByString:@" "];
+}
+
+/**
+ * Builds a line of words of about |characterCount| UTF-16 characters.
+ */
+- (NSString *)lineForIndex:(NSUInteger)index
+                      salt:(uint32_t)salt
+            characterCount:(NSUInteger)characterCount
+                     words:(NSArray *)wordList {
+  uint32_t state = [self stateForIndex:index salt:salt];
+  NSMutableString *line = [NSMutableString stringWithCapacity:characterCount + 16];
+  while ([line length] < characterCount) {
+    state = state * 1664525u + 1013904223u;
+    if ([line length] > 0) {
+      [line appendString:@" "];
+    }
+    [line appendString:[wordList objectAtIndex:(state >> 16) % [wordList count]]];
+  }
+  return line;
+}
+
+/**
+ * @return API timestamp |offset| minutes before the newest generated haiku.
+ */
+- (NSString *)timestampForOffset:(NSUInteger)offset {
+  time_t time = kSimulatedNewestHaikuTime - (time_t)offset * 60;
+  struct tm components;
+  gmtime_r(&time, &components);
+  char buffer[32];
+  strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &components);
+  return [NSString stringWithUTF8String:buffer];
+}
+
+@end
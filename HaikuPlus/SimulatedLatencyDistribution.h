@@ -0,0 +1,77 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Distribution of the time from sending a request to receiving the first byte of its response,
+ * for the simulated network. Latencies follow a log-normal distribution, which has the long tail
+ * of real mobile networks, shifted by a fixed minimum such as the round-trip time.
+ */
+@interface SimulatedLatencyDistribution : NSObject
+
+/**
+ * Latency below which no request is answered.
+ */
+@property(nonatomic, readonly) NSTimeInterval minimum;
+
+/**
+ * Median latency, including the minimum.
+ */
+@property(nonatomic, readonly) NSTimeInterval median;
+
+/**
+ * 99th percentile latency, including the minimum.
+ */
+@property(nonatomic, readonly) NSTimeInterval percentile99;
+
+/**
+ * @param latency Latency of every request.
+ * @return Distribution without variation.
+ */
++ (instancetype)distributionWithConstantLatency:(NSTimeInterval)latency;
+
+/**
+ * @param minimum Latency below which no request is answered.
+ * @param median Median latency, at least |minimum|.
+ * @param percentile99 99th percentile latency, at least |median|.
+ * @return Log-normal distribution with that shape.
+ */
++ (instancetype)distributionWithMinimum:(NSTimeInterval)minimum
+                                 median:(NSTimeInterval)median
+                           percentile99:(NSTimeInterval)percentile99;
+
+/**
+ * @param minimum Latency below which no request is answered.
+ * @param median Median latency, at least |minimum|.
+ * @param percentile99 99th percentile latency, at least |median|.
+ * @return Distribution object.
+ */
+- (id)initWithMinimum:(NSTimeInterval)minimum
+               median:(NSTimeInterval)median
+         percentile99:(NSTimeInterval)percentile99;
+
+/**
+ * Maps a draw from the standard normal distribution to a latency, so the caller controls the
+ * random source and can seed it.
+ *
+ * @param value Sample of the standard normal distribution.
+ * @return Latency of one request.
+ */
+- (NSTimeInterval)latencyForStandardNormalValue:(double)value;
+
+@end
@@ -0,0 +1,68 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "SimulatedLatencyDistribution.h"
+
+#include <math.h>
+
+/**
+ * Value of the standard normal distribution at its 99th percentile.
+ */
+static const double kSimulatedNormalPercentile99 = 2.326348;
+
+@implementation SimulatedLatencyDistribution {
+  // Parameters of the log-normal part, which is added to the minimum.
+  double _mu;
+  double _sigma;
+}
+
++ (instancetype)distributionWithConstantLatency:(NSTimeInterval)latency {
+  return [[self alloc] initWithMinimum:latency median:latency percentile99:latency];
+}
+
++ (instancetype)distributionWithMinimum:(NSTimeInterval)minimum
+                                 median:(NSTimeInterval)median
+                           percentile99:(NSTimeInterval)percentile99 {
+  return [[self alloc] initWithMinimum:minimum median:median percentile99:percentile99];
+}
+
+- (id)initWithMinimum:(NSTimeInterval)minimum
+               median:(NSTimeInterval)median
+         percentile99:(NSTimeInterval)percentile99 {
+  self = [super init];
+  if (self) {
+    _minimum = MAX(minimum, 0);
+    _median = MAX(median, _minimum);
+    _percentile99 = MAX(percentile99, _median);
+    double medianPart = _median - _minimum;
+    double percentile99Part = _percentile99 - _minimum;
+    if (medianPart > 0) {
+      _mu = log(medianPart);
+      _sigma = log(percentile99Part / medianPart) / kSimulatedNormalPercentile99;
+    }
+  }
+  return self;
+}
+
+- (NSTimeInterval)latencyForStandardNormalValue:(double)value {
+  if (_median <= _minimum) {
+    return _minimum;
+  }
+  return _minimum + exp(_mu + _sigma * value);
+}
+
+@end
@@ -22,6 +22,12 @@
 @property(nonatomic, strong) id object;
 @property(nonatomic, strong) NSError *error;
 
+/**
+ * JSON body of the simulated response and its entity tag, or nil for requests without a body.
+ */
+@property(nonatomic, strong) NSData *body;
+@property(nonatomic, copy) NSString *entityTag;
+
 /**
  * The simulated request is told how the request should be fulfilled. If an error is not nil,
  * then the error will be returned. Otherwise, the object will be returned.
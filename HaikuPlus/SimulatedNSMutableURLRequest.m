@@ -22,6 +22,27 @@
 - (void)setResponse:(id)object withError:(NSError *)error {
   self.object = object;
   self.error = error;
+  self.body = nil;
+  self.entityTag = nil;
+  if (object && !error && [NSJSONSerialization isValidJSONObject:object]) {
+    self.body = [NSJSONSerialization dataWithJSONObject:object options:0 error:NULL];
+    self.entityTag = [[self class] entityTagForData:self.body];
+  }
+}
+
+/**
+ * @param data Response body.
+ * @return Strong entity tag derived from a 64-bit FNV-1a hash of the body.
+ */
++ (NSString *)entityTagForData:(NSData *)data {
+  const uint8_t *bytes = [data bytes];
+  NSUInteger length = [data length];
+  uint64_t hash = 14695981039346656037ULL;
+  for (NSUInteger i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return [NSString stringWithFormat:@"\"%016llx\"", (unsigned long long)hash];
 }
 
 @end
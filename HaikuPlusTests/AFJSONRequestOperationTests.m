@@ -0,0 +1,132 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "AFJSONRequestOperation.h"
+
+/**
+ * Number of haikus in the benchmark response.
+ */
+static const NSUInteger kAFJSONBenchmarkHaikuCount = 50000;
+
+@interface AFJSONRequestOperationTests : XCTestCase
+
+@end
+
+@implementation AFJSONRequestOperationTests
+
+- (id)parseData:(NSData *)data encoding:(NSStringEncoding)encoding error:(NSError **)error {
+  return [AFJSONRequestOperation JSONObjectWithResponseData:data
+                                             stringEncoding:encoding
+                                                    options:0
+                                                      error:error];
+}
+
+- (void)testParsesUTF8InPlace {
+  NSData *data = [@"[{\"title\": \"古池や\", \"votes\": 3}]" dataUsingEncoding:NSUTF8StringEncoding];
+  NSError *error = nil;
+  id JSON = [self parseData:data encoding:NSUTF8StringEncoding error:&error];
+  XCTAssertEqualObjects(JSON, (@[ @{ @"title" : @"古池や", @"votes" : @3 } ]), @"%@", error);
+}
+
+- (void)testSkipsByteOrderMark {
+  NSMutableData *data = [NSMutableData dataWithBytes:"\xEF\xBB\xBF" length:3];
+  [data appendData:[@"{\"id\": \"a\"}" dataUsingEncoding:NSUTF8StringEncoding]];
+  id JSON = [self parseData:data encoding:NSUTF8StringEncoding error:NULL];
+  XCTAssertEqualObjects(JSON, @{ @"id" : @"a" }, @"The byte order mark should be skipped");
+}
+
+- (void)testTranscodesOtherEncodings {
+  NSData *data = [@"[\"café\"]" dataUsingEncoding:NSISOLatin1StringEncoding];
+  id JSON = [self parseData:data encoding:NSISOLatin1StringEncoding error:NULL];
+  XCTAssertEqualObjects(JSON, @[ @"café" ], @"Latin-1 responses should be transcoded");
+}
+
+- (void)testParsesUnicodeEscapes {
+  NSData *data = [@"[\"caf\\u00e9 \\ud83c\\udf38\"]" dataUsingEncoding:NSUTF8StringEncoding];
+  id JSON = [self parseData:data encoding:NSUTF8StringEncoding error:NULL];
+  XCTAssertEqualObjects(JSON, @[ @"café \U0001F338" ], @"Escapes should be decoded");
+}
+
+- (void)testSingleSpaceIsNoContent {
+  NSError *error = nil;
+  id JSON = [self parseData:[NSData dataWithBytes:" " length:1]
+                   encoding:NSUTF8StringEncoding
+                      error:&error];
+  XCTAssertNil(JSON, @"A single space should not be parsed");
+  XCTAssertNil(error, @"A single space should not be an error");
+}
+
+- (void)testInvalidJSONSetsError {
+  NSError *error = nil;
+  id JSON = [self parseData:[@"[1," dataUsingEncoding:NSUTF8StringEncoding]
+                   encoding:NSUTF8StringEncoding
+                      error:&error];
+  XCTAssertNil(JSON, @"Invalid JSON should not be parsed");
+  XCTAssertNotNil(error, @"Invalid JSON should set an error");
+}
+
+#pragma mark - Benchmark
+
+/**
+ * Compares parsing a large haiku feed in place with the earlier path through responseString. The
+ * earlier path builds a string and a second UTF-8 copy of the response before parsing; their
+ * sizes are logged as the extra bytes it holds at its peak. The test fails only if the two paths
+ * disagree.
+ */
+- (void)testBenchmarkInPlaceAgainstStringRoundTrip {
+  NSMutableArray *haikus = [NSMutableArray arrayWithCapacity:kAFJSONBenchmarkHaikuCount];
+  for (NSUInteger i = 0; i < kAFJSONBenchmarkHaikuCount; i++) {
+    [haikus addObject:@{
+      @"id" : [NSString stringWithFormat:@"haiku%lu", (unsigned long)i],
+      @"title" : @"Furu ike ya 古池や",
+      @"line_one" : @"An old silent pond",
+      @"line_two" : @"A frog jumps into the pond",
+      @"line_three" : @"Splash! Silence again.",
+      @"votes" : @(i % 1000),
+      @"creation_time" : @"2014-02-05T19:24:38+0000"
+    }];
+  }
+  NSData *data = [NSJSONSerialization dataWithJSONObject:haikus options:0 error:NULL];
+
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  NSUInteger copiedBytes = 0;
+  id roundTripJSON;
+  @autoreleasepool {
+    NSString *string = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    NSData *UTF8Data = [string dataUsingEncoding:NSUTF8StringEncoding];
+    copiedBytes = [string length] * sizeof(unichar) + [UTF8Data length];
+    roundTripJSON = [NSJSONSerialization JSONObjectWithData:UTF8Data options:0 error:NULL];
+  }
+  CFAbsoluteTime roundTripTime = CFAbsoluteTimeGetCurrent() - start;
+
+  start = CFAbsoluteTimeGetCurrent();
+  id inPlaceJSON;
+  @autoreleasepool {
+    inPlaceJSON = [self parseData:data encoding:NSUTF8StringEncoding error:NULL];
+  }
+  CFAbsoluteTime inPlaceTime = CFAbsoluteTimeGetCurrent() - start;
+
+  NSLog(@"Parsed %lu bytes: string round trip %.0f ms with up to %lu extra bytes, "
+        @"in place %.0f ms with none",
+        (unsigned long)[data length], roundTripTime * 1000, (unsigned long)copiedBytes,
+        inPlaceTime * 1000);
+  XCTAssertEqualObjects(inPlaceJSON, roundTripJSON, @"Both paths should parse the same JSON");
+}
+
+@end
@@ -37,6 +37,9 @@ enum {
 @property BOOL haikuCreationToSucceed;
 @property (nonatomic, copy) void (^success)(AFHTTPRequestOperation *, id);
 @property (nonatomic, copy) void (^failure)(AFHTTPRequestOperation *, id);
+@property (nonatomic, strong) NSURLRequest *request;
+// Priority class of the last enqueued operation.
+@property (nonatomic) HPRequestPriority priority;
 
 - (BOOL)didSetUserAgentIOS;
 
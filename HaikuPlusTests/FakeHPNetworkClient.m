@@ -64,11 +64,18 @@ NSString *FakeHPNetworkClientErrorDomain = @"FakeHPNetworkClientErrorDomain";
 - (AFHTTPRequestOperation *)HTTPRequestOperationWithRequest:(NSURLRequest *)urlRequest
     success:(void (^)(AFHTTPRequestOperation *, id))success
     failure:(void (^)(AFHTTPRequestOperation *, NSError *))failure {
+  self.request = urlRequest;
   self.success = success;
   self.failure = failure;
   return nil;
 }
 
+- (void)enqueueHTTPRequestOperation:(AFHTTPRequestOperation *)operation
+                           priority:(HPRequestPriority)priority {
+  self.priority = priority;
+  [super enqueueHTTPRequestOperation:operation priority:priority];
+}
+
 - (void)getPath:(NSString *)path
      parameters:(NSDictionary *)parameters
         success:(void (^)(AFHTTPRequestOperation *, id))success
@@ -0,0 +1,192 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPCircuitBreaker.h"
+#import "HPConstants.h"
+#import "SimulatedHPNetworkClient.h"
+
+@interface HPCircuitBreakerTests : XCTestCase
+
+@end
+
+@implementation HPCircuitBreakerTests {
+  HPCircuitBreaker *_breaker;
+}
+
+- (void)setUp {
+  [super setUp];
+  _breaker = [[HPCircuitBreaker alloc] init];
+  _breaker.windowSize = 4;
+  _breaker.minimumRequestCount = 4;
+  _breaker.openDuration = 0.05;
+}
+
+- (void)recordFailures:(NSUInteger)count {
+  for (NSUInteger i = 0; i < count; i++) {
+    XCTAssertTrue([_breaker allowRequest], @"Closed circuit should allow requests");
+    [_breaker recordFailureWithLatency:0.1];
+  }
+}
+
+- (void)testCircuitOpensAtFailureRate {
+  [_breaker recordSuccessWithLatency:0.1];
+  [_breaker recordSuccessWithLatency:0.1];
+  [self recordFailures:1];
+  XCTAssertEqual(_breaker.state, HPCircuitStateClosed, @"Too few requests to open");
+  [self recordFailures:1];
+  XCTAssertEqual(_breaker.state, HPCircuitStateOpen, @"Half the requests failed");
+  XCTAssertFalse([_breaker allowRequest], @"Open circuit should fail fast");
+  XCTAssertEqual(_breaker.rejectedCount, (NSUInteger)1, @"Rejection should be counted");
+  XCTAssertEqual(_breaker.openCount, (NSUInteger)1, @"Opening should be counted");
+}
+
+- (void)testCircuitOpensAtSlowRate {
+  _breaker.slowRequestDuration = 1;
+  for (NSUInteger i = 0; i < 4; i++) {
+    [_breaker recordSuccessWithLatency:2];
+  }
+  XCTAssertEqual(_breaker.state, HPCircuitStateOpen, @"Slow requests should open the circuit");
+}
+
+- (void)testSuccessfulProbeClosesCircuit {
+  [self recordFailures:4];
+  [NSThread sleepForTimeInterval:0.06];
+  XCTAssertTrue([_breaker allowRequest], @"One probe should be allowed after the open duration");
+  XCTAssertEqual(_breaker.state, HPCircuitStateHalfOpen, @"Circuit should be half-open");
+  XCTAssertFalse([_breaker allowRequest], @"Only one probe should run at a time");
+  [_breaker recordSuccessWithLatency:0.1];
+  XCTAssertEqual(_breaker.state, HPCircuitStateClosed, @"Successful probe should close");
+}
+
+- (void)testFailedProbeOpensCircuitAgain {
+  [self recordFailures:4];
+  [NSThread sleepForTimeInterval:0.06];
+  XCTAssertTrue([_breaker allowRequest], @"One probe should be allowed after the open duration");
+  [_breaker recordFailureWithLatency:0.1];
+  XCTAssertEqual(_breaker.state, HPCircuitStateOpen, @"Failed probe should open again");
+  XCTAssertFalse([_breaker allowRequest], @"Circuit should stay open for the open duration");
+  XCTAssertEqual(_breaker.openCount, (NSUInteger)2, @"Both openings should be counted");
+}
+
+- (void)testCancelledProbeLetsAnotherProbeThrough {
+  [self recordFailures:4];
+  [NSThread sleepForTimeInterval:0.06];
+  XCTAssertTrue([_breaker allowRequest], @"One probe should be allowed after the open duration");
+  [_breaker recordCancellation];
+  XCTAssertTrue([_breaker allowRequest], @"Another probe should be allowed");
+}
+
+- (void)testTimeoutFollowsLatencyPercentile {
+  _breaker.minimumRequestCount = 10;
+  _breaker.timeoutPercentile = 0.9;
+  _breaker.timeoutMultiplier = 2;
+  _breaker.minimumTimeout = 0.5;
+  _breaker.maximumTimeout = 10;
+  _breaker.windowSize = 100;
+  XCTAssertEqual([_breaker timeoutInterval], (NSTimeInterval)10,
+                 @"Without latencies the timeout should be the maximum");
+  for (NSUInteger i = 1; i <= 10; i++) {
+    [_breaker recordSuccessWithLatency:i * 0.1];
+  }
+  XCTAssertEqualWithAccuracy([_breaker timeoutInterval], 1.8, 0.0001,
+                             @"Timeout should be twice the 90th percentile");
+  for (NSUInteger i = 0; i < 128; i++) {
+    [_breaker recordSuccessWithLatency:0.01];
+  }
+  XCTAssertEqual([_breaker timeoutInterval], (NSTimeInterval)0.5,
+                 @"Timeout should not go below the minimum");
+}
+
+#pragma mark - Network client
+
+- (void)testNetworkClientServesPreviousResponseWhileOpen {
+  NSURL *baseURL = [NSURL URLWithString:kHPConstantsAppBaseURLString];
+  SimulatedHPNetworkClient *network = [[SimulatedHPNetworkClient alloc] initWithBaseURL:baseURL];
+  [network setDefaultHeader:@"User-Agent" value:kHPConstantsUserAgent];
+  HPCircuitBreaker *breaker = [network circuitBreakerForEndpoint:kHPConstantsHaikuEndpoint];
+  breaker.windowSize = 2;
+  breaker.minimumRequestCount = 2;
+  NSString *path = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @"TestHaikuID"];
+
+  id first = [self resultOfRequestWithMethod:@"GET" path:path network:network];
+  XCTAssertNotNil(first, @"The first request should succeed");
+  [network injectFailureWithStatusCode:503 retryAfter:nil];
+  [network injectFailureWithStatusCode:503 retryAfter:nil];
+  XCTAssertTrue([[self resultOfRequestWithMethod:@"GET" path:path network:network]
+                    isKindOfClass:[NSError class]], @"The server should fail");
+  XCTAssertEqual(breaker.state, HPCircuitStateOpen, @"Half the requests failed");
+
+  id stale = [self resultOfRequestWithMethod:@"GET" path:path network:network];
+  XCTAssertEqualObjects(stale, first, @"The previous response should be served");
+  XCTAssertEqual(network.staleResponseCount, (NSUInteger)1, @"Stale response should be counted");
+  XCTAssertEqual(network.injectedFailureCount, (NSUInteger)1, @"No request should be sent");
+
+  NSString *votePath = [path stringByAppendingString:@"/vote"];
+  id vote = [self resultOfRequestWithMethod:@"POST" path:votePath network:network];
+  XCTAssertFalse([vote isKindOfClass:[NSError class]],
+                 @"Other endpoints should have their own circuit");
+}
+
+- (void)testNetworkClientFailsFastWithoutPreviousResponse {
+  NSURL *baseURL = [NSURL URLWithString:kHPConstantsAppBaseURLString];
+  SimulatedHPNetworkClient *network = [[SimulatedHPNetworkClient alloc] initWithBaseURL:baseURL];
+  [network setDefaultHeader:@"User-Agent" value:kHPConstantsUserAgent];
+  HPCircuitBreaker *breaker = [network circuitBreakerForEndpoint:kHPConstantsHaikuVoteEndpoint];
+  breaker.windowSize = 1;
+  breaker.minimumRequestCount = 1;
+  NSString *path = [NSString stringWithFormat:kHPConstantsHaikuVoteFormatPath, @"TestHaikuID"];
+  [network injectFailureWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                      code:NSURLErrorTimedOut
+                                                  userInfo:nil]];
+  [self resultOfRequestWithMethod:@"POST" path:path network:network];
+  NSError *error = [self resultOfRequestWithMethod:@"POST" path:path network:network];
+  XCTAssertEqualObjects([error domain], kHPErrorDomain, @"Request should fail fast");
+  XCTAssertEqual([error code], (NSInteger)kHPErrorDomainServiceUnavailable,
+                 @"Error should say the service is unavailable");
+}
+
+/**
+ * Sends a request and waits for its result, which arrives on the processing queue when the
+ * circuit is open.
+ *
+ * @return The decoded object, NSNull for an empty success, or the error.
+ */
+- (id)resultOfRequestWithMethod:(NSString *)method
+                           path:(NSString *)path
+                        network:(SimulatedHPNetworkClient *)network {
+  NSMutableURLRequest *request = [network requestWithMethod:method path:path parameters:nil];
+  __block id result = nil;
+  dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+  AFHTTPRequestOperation *op = [network HTTPRequestOperationWithRequest:request
+      decoder:nil
+      completionQueue:NULL
+      success:^(AFHTTPRequestOperation *operation, id decodedObject) {
+          result = decodedObject ? decodedObject : [NSNull null];
+          dispatch_semaphore_signal(semaphore);
+      }
+      failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+          result = error;
+          dispatch_semaphore_signal(semaphore);
+      }];
+  [network enqueueHTTPRequestOperation:op];
+  dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC));
+  return result;
+}
+
+@end
@@ -22,6 +22,11 @@
 #import "FakeHPNetworkClient.h"
 #import "HPCommunicator.h"
 #import "HPConstants.h"
+#import "HPFeedCache.h"
+#import "HPHaikuPage.h"
+#import "HPRetryPolicy.h"
+#import "HPWriteJournal.h"
+#import "SimulatedAFHTTPRequestOperation.h"
 
 @interface HPCommunicatorTests : XCTestCase
 
@@ -99,6 +104,7 @@
       XCTAssertNil(error, @"Communicator should not return error when data is retrieved");
   }];
   _fakeNetwork.success(nil, _haikusAttributesArray);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -109,6 +115,7 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.failure(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -126,6 +133,7 @@
       XCTAssertNil(error, @"Communicator should not return error when data is retrieved");
   }];
   _fakeNetwork.success(nil, _haikusAttributesArray);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -138,6 +146,81 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.failure(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
+  XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
+}
+
+- (void)testCommunicatorReturnsHaikuPage {
+  NSDictionary *pageAttributes = @{
+    kHPConstantsPageItemsKey : _haikusAttributesArray,
+    kHPConstantsPageNextCursorKey : @"testcursor"
+  };
+  [_communicator fetchHaikusFiltered:NO
+                            pageSize:kHPConstantsHaikusPageSize
+                              cursor:nil
+                          completion:^(HPHaikuPage *page, NSError *error) {
+      HPHaiku *firstHaiku = [page.haikus firstObject];
+      XCTAssertEqualObjects(firstHaiku.identifier, @"TestHaikuID",
+          @"Communicator should return data from network");
+      XCTAssertEqualObjects(page.nextCursor, @"testcursor", @"Cursor should match");
+      XCTAssertTrue([page hasMorePages], @"Page with a cursor should have more pages");
+      XCTAssertNil(error, @"Communicator should not return error when data is retrieved");
+      _hasCompletedTest = YES;
+  }];
+  _fakeNetwork.success(nil, pageAttributes);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
+  XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
+}
+
+- (void)testCommunicatorTreatsUnpagedHaikusAsLastPage {
+  [_communicator fetchHaikusFiltered:NO
+                            pageSize:kHPConstantsHaikusPageSize
+                              cursor:@"testcursor"
+                          completion:^(HPHaikuPage *page, NSError *error) {
+      XCTAssertEqual([page.haikus count], [_haikusAttributesArray count],
+          @"All haikus should be in the page");
+      XCTAssertNil(page.nextCursor, @"Unpaged response should not have a cursor");
+      XCTAssertFalse([page hasMorePages], @"Unpaged response should be the last page");
+      _hasCompletedTest = YES;
+  }];
+  _fakeNetwork.success(nil, _haikusAttributesArray);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
+  XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
+}
+
+- (void)testCommunicatorReturnsCachedPageBeforeServerPage {
+  NSString *name = [[NSProcessInfo processInfo] globallyUniqueString];
+  NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  HPFeedCache *feedCache = [[HPFeedCache alloc] initWithDirectory:directory];
+  [feedCache storeSnapshot:_haikusAttributesArray forKey:@"haikus-everyone"];
+  _communicator.feedCache = feedCache;
+  NSMutableArray *pages = [NSMutableArray array];
+  [_communicator fetchHaikusFiltered:NO
+                            pageSize:kHPConstantsHaikusPageSize
+                              cursor:nil
+                          completion:^(HPHaikuPage *page, NSError *error) {
+      XCTAssertNil(error, @"Communicator should not return error when data is retrieved");
+      [pages addObject:page];
+  }];
+  [self waitForCondition:^BOOL { return [pages count] > 0; }];
+  _fakeNetwork.success(nil, _haikusAttributesArray);
+  [self waitForCondition:^BOOL { return [pages count] > 1; }];
+  XCTAssertEqual([pages count], (NSUInteger)2, @"Cached and server pages should be returned");
+  XCTAssertTrue([[pages firstObject] isCached], @"First page should come from the cache");
+  XCTAssertFalse([[pages lastObject] isCached], @"Last page should come from the server");
+  [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+- (void)testCommunicatorReturnsErrorWhenFilteredPageIsNotAuthorized {
+  [_communicator fetchHaikusFiltered:YES
+                            pageSize:kHPConstantsHaikusPageSize
+                              cursor:nil
+                          completion:^(HPHaikuPage *page, NSError *error) {
+      XCTAssertNil(page, @"Communicator should not succeed without authorization");
+      XCTAssertEqual(error.code, (NSInteger)kHPErrorDomainUnauthorized, @"Error should be unauthorized");
+      _hasCompletedTest = YES;
+  }];
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -149,6 +232,7 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.success(nil, nil);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -163,6 +247,7 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.failure(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -176,6 +261,7 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.success(nil, nil);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -187,6 +273,7 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.failure(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -202,6 +289,7 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.success(nil, _haikuAttributes);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -215,7 +303,57 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.failure(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
+  XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
+}
+
+- (void)testCommunicatorCoalescesIdenticalHaikuRequests {
+  __block NSUInteger completionCount = 0;
+  HPHaikuCompletion completion = ^(HPHaiku *haiku, NSError *error) {
+      XCTAssertEqualObjects(haiku.identifier, @"TestHaikuID",
+          @"Every caller should receive the haiku");
+      completionCount++;
+  };
+  [_communicator fetchHaikuWithID:@"TestHaikuID" completion:completion];
+  _fakeNetwork.success = nil;
+  [_communicator fetchHaikuWithID:@"TestHaikuID" completion:completion];
+  XCTAssertNil(_fakeNetwork.success, @"The second request should not be sent");
+  XCTAssertEqual(_communicator.coalescedRequestCount, (NSUInteger)1,
+                 @"The saved request should be counted");
+  [_communicator fetchHaikuWithID:@"haikuid2" completion:^(HPHaiku *haiku, NSError *error) {}];
+  XCTAssertNotNil(_fakeNetwork.success, @"A request for another haiku should be sent");
+  XCTAssertEqual(completionCount, (NSUInteger)0, @"No request should have finished yet");
+}
+
+- (void)testCommunicatorDeliversCoalescedResultToEveryCaller {
+  __block NSUInteger completionCount = 0;
+  HPHaikuCompletion completion = ^(HPHaiku *haiku, NSError *error) {
+      XCTAssertEqual(_errorToReturn, error, @"Every caller should receive the error");
+      completionCount++;
+  };
+  [_communicator fetchHaikuWithID:@"TestHaikuID" completion:completion];
+  [_communicator fetchHaikuWithID:@"TestHaikuID" completion:completion];
+  _fakeNetwork.failure(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return completionCount == 2; }];
+  XCTAssertEqual(completionCount, (NSUInteger)2, @"Both callers should be completed");
+  _fakeNetwork.success = nil;
+  [_communicator fetchHaikuWithID:@"TestHaikuID" completion:completion];
+  XCTAssertNotNil(_fakeNetwork.success, @"A finished request should not be joined");
+}
+
+- (void)testCommunicatorCallsCompletionOnRequestedQueue {
+  dispatch_queue_t queue = dispatch_queue_create("HPCommunicatorTests", DISPATCH_QUEUE_SERIAL);
+  __block BOOL isMainThread = YES;
+  [_communicator fetchHaikuWithID:@"TestHaikuID"
+                  completionQueue:queue
+                       completion:^(HPHaiku *haiku, NSError *error) {
+      isMainThread = [NSThread isMainThread];
+      _hasCompletedTest = YES;
+  }];
+  _fakeNetwork.success(nil, _haikuAttributes);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
+  XCTAssertFalse(isMainThread, @"Completion should be called on the requested queue");
 }
 
 - (void)testCommunicatorReturnsOnSuccessfulVote {
@@ -229,6 +367,7 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.success(nil, _haikuAttributes);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -243,6 +382,7 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.failure(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
@@ -266,9 +406,404 @@
       _hasCompletedTest = YES;
   }];
   _fakeNetwork.success(nil, [haikuToUpload attributesDictionary]);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
   XCTAssertTrue(_hasCompletedTest, @"Communicator must return something");
 }
 
+- (void)testCommunicatorSendsJournaledVoteWithIdempotencyKey {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  NSString *name = [[NSProcessInfo processInfo] globallyUniqueString];
+  NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  HPWriteJournal *journal = [[HPWriteJournal alloc] initWithDirectory:directory];
+  _communicator.writeJournal = journal;
+  NSMutableArray *statuses = [NSMutableArray array];
+  HPWriteEntry *entry = [_communicator voteForHaikuWithID:@"TestHaikuID"
+      status:^(HPWriteEntry *entry, HPWriteStatus status, id result, NSError *error) {
+          XCTAssertNil(error, @"Vote should not fail");
+          [statuses addObject:@(status)];
+      }];
+  [self waitForCondition:^BOOL { return _fakeNetwork.success != nil; }];
+  XCTAssertEqualObjects([_fakeNetwork.request valueForHTTPHeaderField:@"Idempotency-Key"],
+      entry.idempotencyKey, @"Vote should carry its idempotency key");
+  XCTAssertEqual(_fakeNetwork.priority, HPRequestPriorityInteractive,
+      @"New vote should be interactive");
+  _fakeNetwork.success(nil, nil);
+  [self waitForCondition:^BOOL {
+      return [[statuses lastObject] integerValue] == HPWriteStatusSucceeded;
+  }];
+  NSArray *expected = @[ @(HPWriteStatusPending), @(HPWriteStatusSending),
+                         @(HPWriteStatusSucceeded) ];
+  XCTAssertEqualObjects(statuses, expected, @"Vote should be stored, sent and accepted");
+
+  __block NSArray *remaining = nil;
+  [journal readEntriesWithLimit:10 completion:^(NSArray *entries) {
+      remaining = entries;
+  }];
+  [self waitForCondition:^BOOL { return remaining != nil; }];
+  XCTAssertEqual([remaining count], (NSUInteger)0, @"Accepted vote should leave the journal");
+  [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+- (void)testCommunicatorKeepsJournaledVoteWithoutConnection {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  NSString *name = [[NSProcessInfo processInfo] globallyUniqueString];
+  NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  HPWriteJournal *journal = [[HPWriteJournal alloc] initWithDirectory:directory];
+  _communicator.writeJournal = journal;
+  __block HPWriteStatus lastStatus = HPWriteStatusSending;
+  __block NSError *lastError = nil;
+  HPWriteEntry *entry = [_communicator voteForHaikuWithID:@"TestHaikuID"
+      status:^(HPWriteEntry *entry, HPWriteStatus status, id result, NSError *error) {
+          lastStatus = status;
+          lastError = error;
+      }];
+  [self waitForCondition:^BOOL { return _fakeNetwork.failure != nil; }];
+  NSError *offline = [NSError errorWithDomain:NSURLErrorDomain
+                                         code:NSURLErrorNotConnectedToInternet
+                                     userInfo:nil];
+  _fakeNetwork.failure(nil, offline);
+  [self waitForCondition:^BOOL { return lastError != nil; }];
+  XCTAssertEqual(lastStatus, HPWriteStatusPending, @"Vote should wait for the network");
+  XCTAssertEqualObjects(lastError, offline, @"Status should carry the network error");
+
+  __block NSArray *remaining = nil;
+  [journal readEntriesWithLimit:10 completion:^(NSArray *entries) {
+      remaining = entries;
+  }];
+  [self waitForCondition:^BOOL { return remaining != nil; }];
+  XCTAssertEqual([remaining count], (NSUInteger)1, @"Vote should stay in the journal");
+  XCTAssertEqualObjects([[remaining firstObject] idempotencyKey], entry.idempotencyKey,
+      @"Journal should keep the vote");
+  [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+- (void)testCommunicatorDropsRejectedJournaledVote {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  NSString *name = [[NSProcessInfo processInfo] globallyUniqueString];
+  NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  HPWriteJournal *journal = [[HPWriteJournal alloc] initWithDirectory:directory];
+  _communicator.writeJournal = journal;
+  __block HPWriteStatus lastStatus = HPWriteStatusSending;
+  [_communicator voteForHaikuWithID:@"TestHaikuID"
+      status:^(HPWriteEntry *entry, HPWriteStatus status, id result, NSError *error) {
+          lastStatus = status;
+          if (status == HPWriteStatusFailed) {
+            XCTAssertEqualObjects(error, _errorToReturn, @"Communicator error should match");
+            _hasCompletedTest = YES;
+          }
+      }];
+  [self waitForCondition:^BOOL { return _fakeNetwork.failure != nil; }];
+  _fakeNetwork.failure(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
+  XCTAssertEqual(lastStatus, HPWriteStatusFailed, @"Rejected vote should fail");
+
+  __block NSArray *remaining = nil;
+  [journal readEntriesWithLimit:10 completion:^(NSArray *entries) {
+      remaining = entries;
+  }];
+  [self waitForCondition:^BOOL { return remaining != nil; }];
+  XCTAssertEqual([remaining count], (NSUInteger)0, @"Rejected vote should not be sent again");
+  [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+- (void)testCommunicatorReplaysJournaledWritesOneAfterAnother {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  NSString *name = [[NSProcessInfo processInfo] globallyUniqueString];
+  NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  HPWriteJournal *journal = [[HPWriteJournal alloc] initWithDirectory:directory];
+  HPWriteEntry *first = [[HPWriteEntry alloc] initWithKind:HPWriteKindVote
+                                                   haikuID:@"FirstHaikuID"
+                                                attributes:nil
+                                                    userID:nil];
+  HPWriteEntry *second = [[HPWriteEntry alloc] initWithKind:HPWriteKindVote
+                                                    haikuID:@"SecondHaikuID"
+                                                 attributes:nil
+                                                     userID:nil];
+  [journal appendEntry:first];
+  [journal appendEntry:second];
+  _communicator.writeJournal = journal;
+
+  [self waitForCondition:^BOOL { return _fakeNetwork.success != nil; }];
+  void (^firstSuccess)(AFHTTPRequestOperation *, id) = _fakeNetwork.success;
+  [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+  XCTAssertEqualObjects([_fakeNetwork.request valueForHTTPHeaderField:@"Idempotency-Key"],
+      first.idempotencyKey, @"Second write should wait for the first");
+  XCTAssertEqual(_fakeNetwork.priority, HPRequestPriorityVisible,
+      @"Replayed write should not hold back the feed");
+  firstSuccess(nil, nil);
+  [self waitForCondition:^BOOL { return _fakeNetwork.success != firstSuccess; }];
+  XCTAssertEqualObjects([_fakeNetwork.request valueForHTTPHeaderField:@"Idempotency-Key"],
+      second.idempotencyKey, @"Second write should follow the first");
+  [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+- (void)testCommunicatorDropsJournaledVoteOfAnotherUser {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  _communicator.currentUser = _fakeUser;
+  NSString *name = [[NSProcessInfo processInfo] globallyUniqueString];
+  NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  HPWriteJournal *journal = [[HPWriteJournal alloc] initWithDirectory:directory];
+  _communicator.writeJournal = journal;
+  __block HPWriteStatus lastStatus = HPWriteStatusSending;
+  __block NSError *lastError = nil;
+  HPWriteEntry *entry = [_communicator voteForHaikuWithID:@"TestHaikuID"
+      status:^(HPWriteEntry *entry, HPWriteStatus status, id result, NSError *error) {
+          lastStatus = status;
+          lastError = error;
+      }];
+  XCTAssertEqualObjects(entry.userID, @"testid", @"Vote should belong to the signed-in user");
+  [self waitForCondition:^BOOL { return _fakeNetwork.failure != nil; }];
+  void (^firstFailure)(AFHTTPRequestOperation *, id) = _fakeNetwork.failure;
+  NSError *offline = [NSError errorWithDomain:NSURLErrorDomain
+                                         code:NSURLErrorNotConnectedToInternet
+                                     userInfo:nil];
+  firstFailure(nil, offline);
+  [self waitForCondition:^BOOL { return lastError != nil; }];
+  XCTAssertEqual(lastStatus, HPWriteStatusPending, @"Vote should wait for the network");
+
+  // Another account signs in on the device before the vote could be sent.
+  NSMutableDictionary *otherAttributes = [_userAttributes mutableCopy];
+  [otherAttributes setObject:@"otherid" forKey:@"id"];
+  _communicator.currentUser = [[HPUser alloc] initWithAttributes:otherAttributes];
+  _communicator.writeJournal = journal;
+  [self waitForCondition:^BOOL { return lastStatus == HPWriteStatusFailed; }];
+  XCTAssertEqual(lastStatus, HPWriteStatusFailed, @"Vote of another user should be dropped");
+  XCTAssertTrue(_fakeNetwork.failure == firstFailure, @"Vote should not be sent again");
+
+  __block NSArray *remaining = nil;
+  [journal readEntriesWithLimit:10 completion:^(NSArray *entries) {
+      remaining = entries;
+  }];
+  [self waitForCondition:^BOOL { return remaining != nil; }];
+  XCTAssertEqual([remaining count], (NSUInteger)0, @"Vote should leave the journal");
+  [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+- (void)testCommunicatorRetriesJournalReplayAfterTransientFailure {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  HPRetryPolicy *retryPolicy = [[HPRetryPolicy alloc] init];
+  retryPolicy.maxAttemptCount = 1;
+  retryPolicy.initialBackoff = 0.05;
+  retryPolicy.jitter = 0;
+  _communicator.retryPolicy = retryPolicy;
+  NSString *name = [[NSProcessInfo processInfo] globallyUniqueString];
+  NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  _communicator.writeJournal = [[HPWriteJournal alloc] initWithDirectory:directory];
+  __block HPWriteStatus lastStatus = HPWriteStatusPending;
+  [_communicator voteForHaikuWithID:@"TestHaikuID"
+      status:^(HPWriteEntry *entry, HPWriteStatus status, id result, NSError *error) {
+          lastStatus = status;
+      }];
+  [self waitForCondition:^BOOL { return _fakeNetwork.failure != nil; }];
+  void (^firstFailure)(AFHTTPRequestOperation *, id) = _fakeNetwork.failure;
+  NSHTTPURLResponse *unavailable =
+      [[NSHTTPURLResponse alloc] initWithURL:[_fakeNetwork.request URL]
+                                  statusCode:503
+                                 HTTPVersion:@"HTTP/1.1"
+                                headerFields:nil];
+  NSError *error = [NSError errorWithDomain:AFNetworkingErrorDomain
+                                       code:NSURLErrorBadServerResponse
+                                   userInfo:@{
+    AFNetworkingOperationFailingURLResponseErrorKey : unavailable
+  }];
+  firstFailure(nil, error);
+  // The device is still online, so only the replay timer can send the vote again.
+  [self waitForCondition:^BOOL { return _fakeNetwork.failure != firstFailure; }];
+  XCTAssertTrue(_fakeNetwork.failure != firstFailure, @"Vote should be sent again");
+  _fakeNetwork.success(nil, nil);
+  [self waitForCondition:^BOOL { return lastStatus == HPWriteStatusSucceeded; }];
+  XCTAssertEqual(lastStatus, HPWriteStatusSucceeded, @"Retried vote should be accepted");
+  [[NSFileManager defaultManager] removeItemAtPath:directory error:NULL];
+}
+
+- (void)testCommunicatorAppliesVoteBeforeServerAnswers {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  HPHaiku *haiku = [[HPHaiku alloc] initWithAttributes:_haikuAttributes];
+  __block NSInteger postedDelta = 0;
+  id observer = [[NSNotificationCenter defaultCenter]
+      addObserverForName:kHPConstantsHaikuVotesDidChangeNotification
+                  object:_communicator
+                   queue:nil
+              usingBlock:^(NSNotification *notification) {
+                  NSDictionary *userInfo = [notification userInfo];
+                  XCTAssertEqualObjects([userInfo objectForKey:kHPConstantsHaikuIDKey],
+                      @"TestHaikuID", @"Notification should carry the haiku ID");
+                  postedDelta += [[userInfo objectForKey:kHPConstantsHaikuVotesDeltaKey]
+                      integerValue];
+              }];
+  __block HPWriteStatus lastStatus = HPWriteStatusPending;
+  [_communicator voteForHaiku:haiku
+                       status:^(HPWriteEntry *entry, HPWriteStatus status, id result,
+                                NSError *error) {
+      lastStatus = status;
+  }];
+  XCTAssertEqual(postedDelta, 1, @"Change should be posted right away");
+  XCTAssertEqual(haiku.votes, 67, @"Delivered haiku should not be changed");
+
+  _fakeNetwork.success(nil, nil);
+  [self waitForCondition:^BOOL { return lastStatus == HPWriteStatusSucceeded; }];
+  XCTAssertEqual(postedDelta, 1, @"Confirmation should not change the count");
+  [[NSNotificationCenter defaultCenter] removeObserver:observer];
+}
+
+- (void)testCommunicatorRollsBackRejectedVote {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  HPHaiku *haiku = [[HPHaiku alloc] initWithAttributes:_haikuAttributes];
+  __block NSInteger postedDelta = 0;
+  id observer = [[NSNotificationCenter defaultCenter]
+      addObserverForName:kHPConstantsHaikuVotesDidChangeNotification
+                  object:_communicator
+                   queue:nil
+              usingBlock:^(NSNotification *notification) {
+                  postedDelta += [[[notification userInfo]
+                      objectForKey:kHPConstantsHaikuVotesDeltaKey] integerValue];
+              }];
+  [_communicator voteForHaiku:haiku
+                       status:^(HPWriteEntry *entry, HPWriteStatus status, id result,
+                                NSError *error) {
+      if (status == HPWriteStatusFailed) {
+        _hasCompletedTest = YES;
+      }
+  }];
+  _fakeNetwork.failure(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return _hasCompletedTest; }];
+  XCTAssertEqual(postedDelta, 0, @"Rollback should be posted");
+  [[NSNotificationCenter defaultCenter] removeObserver:observer];
+}
+
+- (void)testCommunicatorCountsUnconfirmedVoteInFetchedHaiku {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  HPHaiku *votedHaiku = [[HPHaiku alloc] initWithAttributes:_haikuAttributes];
+  [_communicator voteForHaiku:votedHaiku status:nil];
+  __block HPHaiku *fetchedHaiku = nil;
+  [_communicator fetchHaikuWithID:@"TestHaikuID"
+                       completion:^(HPHaiku *haiku, NSError *error) {
+      fetchedHaiku = haiku;
+  }];
+  // The server has not applied the vote yet.
+  _fakeNetwork.success(nil, _haikuAttributes);
+  [self waitForCondition:^BOOL { return fetchedHaiku != nil; }];
+  XCTAssertEqual(fetchedHaiku.votes, 68, @"Unconfirmed vote should be counted");
+}
+
+/**
+ * @param statusCode HTTP status code of the response.
+ * @return Operation whose response to the last captured request carries an entity tag.
+ */
+- (AFHTTPRequestOperation *)operationWithStatusCode:(NSInteger)statusCode {
+  SimulatedAFHTTPRequestOperation *op = [[SimulatedAFHTTPRequestOperation alloc] init];
+  op.simulatedResponse = [[NSHTTPURLResponse alloc] initWithURL:[_fakeNetwork.request URL]
+                                                     statusCode:statusCode
+                                                    HTTPVersion:@"HTTP/1.1"
+                                                   headerFields:@{ @"ETag" : @"\"1\"" }];
+  return op;
+}
+
+- (void)testCommunicatorDoesNotKeepUnconfirmedVoteInReusedHaiku {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  HPHaiku *votedHaiku = [[HPHaiku alloc] initWithAttributes:_haikuAttributes];
+  __block BOOL hasFailed = NO;
+  [_communicator voteForHaiku:votedHaiku
+                       status:^(HPWriteEntry *entry, HPWriteStatus status, id result,
+                                NSError *error) {
+      hasFailed = status == HPWriteStatusFailed;
+  }];
+  void (^failVote)(AFHTTPRequestOperation *, NSError *) = _fakeNetwork.failure;
+  __block HPHaiku *fetchedHaiku = nil;
+  [_communicator fetchHaikuWithID:@"TestHaikuID"
+                       completion:^(HPHaiku *haiku, NSError *error) {
+      fetchedHaiku = haiku;
+  }];
+  _fakeNetwork.success([self operationWithStatusCode:200], _haikuAttributes);
+  [self waitForCondition:^BOOL { return fetchedHaiku != nil; }];
+  XCTAssertEqual(fetchedHaiku.votes, 68, @"Unconfirmed vote should be counted");
+
+  failVote(nil, _errorToReturn);
+  [self waitForCondition:^BOOL { return hasFailed; }];
+  fetchedHaiku = nil;
+  [_communicator fetchHaikuWithID:@"TestHaikuID"
+                       completion:^(HPHaiku *haiku, NSError *error) {
+      fetchedHaiku = haiku;
+  }];
+  XCTAssertEqualObjects([_fakeNetwork.request valueForHTTPHeaderField:@"If-None-Match"], @"\"1\"",
+                        @"The haiku should be requested conditionally");
+  // Not Modified: the network client hands over the haiku it decoded before.
+  _fakeNetwork.failure([self operationWithStatusCode:304], _errorToReturn);
+  [self waitForCondition:^BOOL { return fetchedHaiku != nil; }];
+  XCTAssertEqual(fetchedHaiku.votes, 67, @"Rejected vote should not be counted again");
+}
+
+- (void)testCommunicatorCountsVoteOnceInHaikuReusedAfterNotModified {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  __block HPHaiku *fetchedHaiku = nil;
+  [_communicator fetchHaikuWithID:@"TestHaikuID"
+                       completion:^(HPHaiku *haiku, NSError *error) {
+      fetchedHaiku = haiku;
+  }];
+  _fakeNetwork.success([self operationWithStatusCode:200], _haikuAttributes);
+  [self waitForCondition:^BOOL { return fetchedHaiku != nil; }];
+  HPHaiku *shownHaiku = fetchedHaiku;
+  [_communicator voteForHaiku:shownHaiku status:nil];
+
+  fetchedHaiku = nil;
+  [_communicator fetchHaikuWithID:@"TestHaikuID"
+                       completion:^(HPHaiku *haiku, NSError *error) {
+      fetchedHaiku = haiku;
+  }];
+  // Not Modified while the vote is unconfirmed: the network client hands over the shown haiku.
+  _fakeNetwork.failure([self operationWithStatusCode:304], _errorToReturn);
+  [self waitForCondition:^BOOL { return fetchedHaiku != nil; }];
+  XCTAssertEqual(fetchedHaiku.votes, 68, @"Unconfirmed vote should be counted once");
+  XCTAssertEqual(shownHaiku.votes, 67, @"Delivered haiku should not be changed");
+}
+
+- (void)testCommunicatorAppliesValidTokenSynchronously {
+  _fakeAuth.accessToken = @"testtoken";
+  _fakeAuth.expirationDate = [NSDate dateWithTimeIntervalSinceNow:3600];
+  _communicator.auth = _fakeAuth;
+  __block BOOL waitedSynchronously = NO;
+  _communicator.authorizationWaitHandler = ^(NSURLRequest *request, NSTimeInterval waitTime,
+                                             BOOL isSynchronous) {
+      waitedSynchronously = isSynchronous;
+  };
+  [_communicator fetchHaikusFiltered:YES completion:^(NSArray *haikus, NSError *error) {}];
+  XCTAssertEqual(_communicator.synchronousAuthorizationCount, (NSUInteger)1,
+      @"A valid token should be applied right away");
+  XCTAssertEqual(_communicator.deferredAuthorizationCount, (NSUInteger)0,
+      @"A valid token should not be refreshed first");
+  XCTAssertTrue(waitedSynchronously, @"Wait handler should be told the request did not wait");
+  XCTAssertEqualObjects([_fakeNetwork.request valueForHTTPHeaderField:@"Authorization"],
+      @"Bearer testtoken", @"Request should carry the token");
+}
+
+- (void)testCommunicatorDefersAuthorizationWithoutValidToken {
+  _fakeAuth.errorToReturn = nil;
+  _communicator.auth = _fakeAuth;
+  __block NSUInteger waitCount = 0;
+  __block BOOL waitedSynchronously = YES;
+  _communicator.authorizationWaitHandler = ^(NSURLRequest *request, NSTimeInterval waitTime,
+                                             BOOL isSynchronous) {
+      waitCount++;
+      waitedSynchronously = isSynchronous;
+  };
+  [_communicator fetchHaikusFiltered:YES completion:^(NSArray *haikus, NSError *error) {}];
+  XCTAssertEqual(_communicator.deferredAuthorizationCount, (NSUInteger)1,
+      @"Request without a token should wait for authorization");
+  XCTAssertEqual(waitCount, (NSUInteger)1, @"Wait handler should be called once");
+  XCTAssertFalse(waitedSynchronously, @"Wait handler should be told the request waited");
+}
+
 - (void)testFinishedWithAuthFetchesUserOnSuccess {
   GTMOAuth2Authentication *auth = [[GTMOAuth2Authentication alloc] init];
   auth.accessToken = @"testtoken";
@@ -277,6 +812,18 @@
       @"Communicator should have auth set");
 }
 
+/**
+ * Completion blocks are called asynchronously on the main queue, so run the main run loop until
+ * the condition holds or a timeout passes.
+ */
+- (void)waitForCondition:(BOOL (^)(void))condition {
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!condition() && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+}
+
 - (BOOL)sessionCookieExists {
   NSHTTPCookieStorage *cookieStorage = [NSHTTPCookieStorage sharedHTTPCookieStorage];
   NSURL *url = [NSURL URLWithString:kHPConstantsAppBaseURLString];
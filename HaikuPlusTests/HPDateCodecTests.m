@@ -0,0 +1,193 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPConstants.h"
+#import "HPDateCodec.h"
+
+/**
+ * Number of timestamps decoded by each benchmark.
+ */
+static const NSUInteger kHPDateCodecBenchmarkCount = 10000;
+
+@interface HPDateCodecTests : XCTestCase
+
+@end
+
+@implementation HPDateCodecTests {
+  NSDateFormatter *_dateFormatter;
+}
+
+- (void)setUp {
+  [super setUp];
+  _dateFormatter = [[NSDateFormatter alloc] init];
+  [_dateFormatter setDateFormat:kHPConstantsAPIDateFormat];
+}
+
+- (void)testParsesSameDatesAsDateFormatter {
+  NSArray *strings = @[
+    @"2014-02-05T19:24:38+0000",
+    @"2013-09-30T00:25:45-0700",
+    @"2000-02-29T23:59:59+0530",
+    @"1969-12-31T23:59:59+0000"
+  ];
+  for (NSString *string in strings) {
+    XCTAssertEqualObjects([HPDateCodec dateFromAPIString:string],
+                          [_dateFormatter dateFromString:string],
+                          @"%@ should parse like NSDateFormatter", string);
+  }
+}
+
+- (void)testParsesZoneVariants {
+  NSDate *expected = [NSDate dateWithTimeIntervalSince1970:1380500745];
+  XCTAssertEqualObjects([HPDateCodec dateFromAPIString:@"2013-09-30T00:25:45Z"], expected,
+                        @"Z zone should be UTC");
+  XCTAssertEqualObjects([HPDateCodec dateFromAPIString:@"2013-09-30T02:25:45+02:00"], expected,
+                        @"Zone with a colon should be accepted");
+  XCTAssertEqualObjects([HPDateCodec dateFromAPIString:@"2013-09-30T02:25:45+02"], expected,
+                        @"Zone without minutes should be accepted");
+}
+
+- (void)testRejectsInvalidTimestamps {
+  NSArray *strings = @[
+    @"",
+    @"2013-09-30",
+    @"2013-09-30T00:25:45",
+    @"2013-02-29T00:00:00Z",
+    @"2013-13-01T00:00:00Z",
+    @"2013-09-30T24:00:00Z",
+    @"2013-09-30 00:25:45Z",
+    @"2013-09-30T00:25:45+2",
+    @"2013-09-30T00:25:45+0000 trailing"
+  ];
+  for (NSString *string in strings) {
+    XCTAssertNil([HPDateCodec dateFromAPIString:string], @"%@ should be rejected", string);
+  }
+  XCTAssertNil([HPDateCodec dateFromAPIString:(NSString *)[NSNull null]],
+               @"Non-strings should be rejected");
+}
+
+- (void)testFormatsUTCTimestamp {
+  NSDate *date = [NSDate dateWithTimeIntervalSince1970:1391628278];
+  XCTAssertEqualObjects([HPDateCodec APIStringFromDate:date], @"2014-02-05T19:24:38+0000",
+                        @"Timestamp should be written in UTC");
+  XCTAssertEqualObjects([_dateFormatter dateFromString:[HPDateCodec APIStringFromDate:date]],
+                        date, @"NSDateFormatter should read the timestamp back");
+  XCTAssertNil([HPDateCodec APIStringFromDate:nil], @"Nil date should give nil");
+}
+
+- (void)testFormatsVisibleDateInDefaultTimeZone {
+  NSTimeZone *defaultTimeZone = [NSTimeZone defaultTimeZone];
+  [NSTimeZone setDefaultTimeZone:[NSTimeZone timeZoneForSecondsFromGMT:-8 * 60 * 60]];
+  // 2014-01-01T04:00:00Z is still the last day of 2013 eight hours west of UTC.
+  NSDate *date = [NSDate dateWithTimeIntervalSince1970:1388548800];
+  XCTAssertEqualObjects([HPDateCodec visibleStringFromDate:date], @"2013-12-31",
+                        @"Visible date should use the default time zone");
+  [NSTimeZone setDefaultTimeZone:defaultTimeZone];
+}
+
+#pragma mark - Benchmark
+
+/**
+ * @return Distinct timestamps spread over several years.
+ */
+- (NSArray *)benchmarkTimestamps {
+  NSMutableArray *strings = [NSMutableArray arrayWithCapacity:kHPDateCodecBenchmarkCount];
+  for (NSUInteger i = 0; i < kHPDateCodecBenchmarkCount; i++) {
+    NSDate *date = [NSDate dateWithTimeIntervalSince1970:1300000000 + i * 7919];
+    [strings addObject:[HPDateCodec APIStringFromDate:date]];
+  }
+  return strings;
+}
+
+/**
+ * Compares the codec with the formatter path it replaced, which configured a new NSDateFormatter
+ * for every field. Timings are logged; the test fails only if results differ.
+ */
+- (void)testBenchmarkParsingAgainstDateFormatter {
+  NSArray *strings = [self benchmarkTimestamps];
+
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  NSMutableArray *formatterDates = [NSMutableArray arrayWithCapacity:[strings count]];
+  for (NSString *string in strings) {
+    NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
+    [dateFormatter setDateFormat:kHPConstantsAPIDateFormat];
+    [formatterDates addObject:[dateFormatter dateFromString:string]];
+  }
+  CFAbsoluteTime formatterTime = CFAbsoluteTimeGetCurrent() - start;
+
+  start = CFAbsoluteTimeGetCurrent();
+  NSMutableArray *sharedFormatterDates = [NSMutableArray arrayWithCapacity:[strings count]];
+  for (NSString *string in strings) {
+    [sharedFormatterDates addObject:[_dateFormatter dateFromString:string]];
+  }
+  CFAbsoluteTime sharedFormatterTime = CFAbsoluteTimeGetCurrent() - start;
+
+  start = CFAbsoluteTimeGetCurrent();
+  NSMutableArray *codecDates = [NSMutableArray arrayWithCapacity:[strings count]];
+  for (NSString *string in strings) {
+    [codecDates addObject:[HPDateCodec dateFromAPIString:string]];
+  }
+  CFAbsoluteTime codecTime = CFAbsoluteTimeGetCurrent() - start;
+
+  NSLog(@"Parsed %lu timestamps: new formatter %.1f ms, shared formatter %.1f ms, "
+        @"HPDateCodec %.1f ms",
+        (unsigned long)[strings count], formatterTime * 1000, sharedFormatterTime * 1000,
+        codecTime * 1000);
+  XCTAssertEqualObjects(codecDates, formatterDates, @"Codec should match NSDateFormatter");
+}
+
+- (void)testBenchmarkFormattingAgainstDateFormatter {
+  NSArray *strings = [self benchmarkTimestamps];
+  NSMutableArray *dates = [NSMutableArray arrayWithCapacity:[strings count]];
+  for (NSString *string in strings) {
+    [dates addObject:[HPDateCodec dateFromAPIString:string]];
+  }
+
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  for (NSDate *date in dates) {
+    NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
+    [dateFormatter setDateFormat:kHPConstantsVisibleDateFormat];
+    [dateFormatter stringFromDate:date];
+  }
+  CFAbsoluteTime formatterTime = CFAbsoluteTimeGetCurrent() - start;
+
+  start = CFAbsoluteTimeGetCurrent();
+  NSDateFormatter *visibleFormatter = [[NSDateFormatter alloc] init];
+  [visibleFormatter setDateFormat:kHPConstantsVisibleDateFormat];
+  NSMutableArray *formatterStrings = [NSMutableArray arrayWithCapacity:[dates count]];
+  for (NSDate *date in dates) {
+    [formatterStrings addObject:[visibleFormatter stringFromDate:date]];
+  }
+  CFAbsoluteTime sharedFormatterTime = CFAbsoluteTimeGetCurrent() - start;
+
+  start = CFAbsoluteTimeGetCurrent();
+  NSMutableArray *codecStrings = [NSMutableArray arrayWithCapacity:[dates count]];
+  for (NSDate *date in dates) {
+    [codecStrings addObject:[HPDateCodec visibleStringFromDate:date]];
+  }
+  CFAbsoluteTime codecTime = CFAbsoluteTimeGetCurrent() - start;
+
+  NSLog(@"Formatted %lu visible dates: new formatter %.1f ms, shared formatter %.1f ms, "
+        @"HPDateCodec %.1f ms",
+        (unsigned long)[dates count], formatterTime * 1000, sharedFormatterTime * 1000,
+        codecTime * 1000);
+  XCTAssertEqualObjects(codecStrings, formatterStrings, @"Codec should match NSDateFormatter");
+}
+
+@end
@@ -0,0 +1,98 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPFeedCache.h"
+
+@interface HPFeedCacheTests : XCTestCase
+
+@end
+
+@implementation HPFeedCacheTests {
+  HPFeedCache *_feedCache;
+  NSString *_directory;
+  NSArray *_snapshot;
+}
+
+- (void)setUp {
+  [super setUp];
+  NSString *name = [NSString stringWithFormat:@"HPFeedCacheTests-%@",
+                       [[NSProcessInfo processInfo] globallyUniqueString]];
+  _directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  _feedCache = [[HPFeedCache alloc] initWithDirectory:_directory];
+  _snapshot = @[ @{ @"id" : @"TestHaikuID", @"title" : @"testtitle", @"votes" : @"67" } ];
+}
+
+- (void)tearDown {
+  [[NSFileManager defaultManager] removeItemAtPath:_directory error:NULL];
+  [super tearDown];
+}
+
+/**
+ * Reads a snapshot and waits for the completion block on the main queue.
+ */
+- (id)readSnapshotForKey:(NSString *)key {
+  __block BOOL hasCompleted = NO;
+  __block id snapshot = nil;
+  [_feedCache readSnapshotForKey:key completion:^(id responseObject) {
+      snapshot = responseObject;
+      hasCompleted = YES;
+  }];
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!hasCompleted && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+  XCTAssertTrue(hasCompleted, @"Feed cache must call the completion block");
+  return snapshot;
+}
+
+- (void)testStoredSnapshotIsReadBack {
+  [_feedCache storeSnapshot:_snapshot forKey:@"haikus-everyone"];
+  id snapshot = [self readSnapshotForKey:@"haikus-everyone"];
+  XCTAssertEqualObjects(snapshot, _snapshot, @"Snapshot should match the stored response");
+  XCTAssertEqual(_feedCache.hitCount, (NSUInteger)1, @"Read should count as a hit");
+  XCTAssertEqual(_feedCache.missCount, (NSUInteger)0, @"Read should not count as a miss");
+}
+
+- (void)testSnapshotsAreKeptSeparatelyForEachKey {
+  [_feedCache storeSnapshot:_snapshot forKey:@"haikus-everyone"];
+  XCTAssertNil([self readSnapshotForKey:@"haikus-circles"], @"Other key should miss");
+  XCTAssertEqual(_feedCache.missCount, (NSUInteger)1, @"Read should count as a miss");
+}
+
+- (void)testExpiredSnapshotIsMiss {
+  _feedCache.maxAge = -1;
+  [_feedCache storeSnapshot:_snapshot forKey:@"haikus-everyone"];
+  XCTAssertNil([self readSnapshotForKey:@"haikus-everyone"], @"Expired snapshot should miss");
+  XCTAssertEqual(_feedCache.missCount, (NSUInteger)1, @"Read should count as a miss");
+}
+
+- (void)testSnapshotLargerThanBudgetIsNotStored {
+  _feedCache.maxBytes = 10;
+  [_feedCache storeSnapshot:_snapshot forKey:@"haikus-everyone"];
+  XCTAssertNil([self readSnapshotForKey:@"haikus-everyone"], @"Snapshot should not be stored");
+}
+
+- (void)testRemovedSnapshotIsMiss {
+  [_feedCache storeSnapshot:_snapshot forKey:@"haikus-circles"];
+  [_feedCache removeSnapshotForKey:@"haikus-circles"];
+  XCTAssertNil([self readSnapshotForKey:@"haikus-circles"], @"Removed snapshot should miss");
+}
+
+@end
@@ -0,0 +1,177 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPHaiku.h"
+#import "HPHaikuLayoutCache.h"
+#import "HPUser.h"
+
+@interface HPHaikuLayoutCacheTests : XCTestCase
+
+@end
+
+@implementation HPHaikuLayoutCacheTests {
+  HPHaikuLayoutCache *_cache;
+}
+
+- (void)setUp {
+  [super setUp];
+  _cache = [[HPHaikuLayoutCache alloc] init];
+  _cache.width = 267;
+}
+
+- (HPHaiku *)haikuWithIdentifier:(NSString *)identifier title:(NSString *)title {
+  HPHaiku *haiku = [[HPHaiku alloc] init];
+  haiku.identifier = identifier;
+  haiku.title = title;
+  haiku.line_one = @"An old silent pond";
+  haiku.line_two = @"A frog jumps into the pond";
+  haiku.line_three = @"Splash! Silence again.";
+  haiku.author = [[HPUser alloc] init];
+  haiku.author.google_display_name = @"Basho";
+  haiku.creation_time = [NSDate dateWithTimeIntervalSince1970:1380500745];
+  return haiku;
+}
+
+/**
+ * Precomputes layouts and adds them to the cache, as when the haikus are shown.
+ */
+- (void)precomputeLayoutsForHaikus:(NSArray *)haikus {
+  __block BOOL hasCompleted = NO;
+  [_cache precomputeLayoutsForHaikus:haikus completion:^(NSDictionary *layouts) {
+      XCTAssertTrue([NSThread isMainThread], @"Completion should run on the main queue");
+      [_cache addLayouts:layouts];
+      hasCompleted = YES;
+  }];
+  [self waitForCondition:&hasCompleted];
+  XCTAssertTrue(hasCompleted, @"Precomputation should complete");
+}
+
+- (void)waitForCondition:(BOOL *)condition {
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!*condition && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+}
+
+- (void)testPrecomputedLayoutIsLookedUp {
+  HPHaiku *haiku = [self haikuWithIdentifier:@"1" title:@"Pond"];
+  [self precomputeLayoutsForHaikus:@[ haiku ]];
+  XCTAssertEqual(_cache.backgroundMeasurementCount, (NSUInteger)1, @"Row should be measured");
+  XCTAssertEqual(_cache.layoutCount, (NSUInteger)1, @"Layout should be kept");
+
+  HPHaikuRowLayout *layout = [_cache layoutForHaiku:haiku];
+  XCTAssertTrue(layout.height > 0, @"Row should have a height");
+  XCTAssertEqual(_cache.mainThreadMeasurementCount, (NSUInteger)0,
+                 @"Precomputed row should not be measured on the main thread");
+}
+
+- (void)testLayoutIsMeasuredOnceForUnchangedText {
+  HPHaiku *haiku = [self haikuWithIdentifier:@"1" title:@"Pond"];
+  [self precomputeLayoutsForHaikus:@[ haiku ]];
+  // A vote does not change the layout.
+  haiku.votes++;
+  [self precomputeLayoutsForHaikus:@[ haiku ]];
+  XCTAssertEqual(_cache.backgroundMeasurementCount, (NSUInteger)1,
+                 @"Unchanged row should not be measured again");
+}
+
+- (void)testLongTitleMakesRowTaller {
+  HPHaiku *shortHaiku = [self haikuWithIdentifier:@"1" title:@"Pond"];
+  NSString *longTitle = [@"" stringByPaddingToLength:400 withString:@"Frog " startingAtIndex:0];
+  HPHaiku *longHaiku = [self haikuWithIdentifier:@"2" title:longTitle];
+  [self precomputeLayoutsForHaikus:@[ shortHaiku, longHaiku ]];
+
+  HPHaikuRowLayout *shortLayout = [_cache layoutForHaiku:shortHaiku];
+  HPHaikuRowLayout *longLayout = [_cache layoutForHaiku:longHaiku];
+  XCTAssertTrue(longLayout.height > shortLayout.height, @"Long title should wrap");
+  XCTAssertTrue(CGRectGetMinY(longLayout.lineOneFrame) >= CGRectGetMaxY(longLayout.titleFrame),
+                @"Lines should be below the wrapped title");
+  XCTAssertTrue(longLayout.height >= CGRectGetMaxY(longLayout.votesFrame),
+                @"Row should fit the last label");
+}
+
+- (void)testChangedTextIsMeasuredAgain {
+  HPHaiku *haiku = [self haikuWithIdentifier:@"1" title:@"Pond"];
+  [self precomputeLayoutsForHaikus:@[ haiku ]];
+  CGFloat shortHeight = [_cache layoutForHaiku:haiku].height;
+  // A change in the middle of a long line must still be noticed.
+  HPHaiku *changedHaiku = [self haikuWithIdentifier:@"1" title:@"Pond"];
+  changedHaiku.line_two = [@"" stringByPaddingToLength:500 withString:@"Splash " startingAtIndex:0];
+  [self precomputeLayoutsForHaikus:@[ changedHaiku ]];
+  CGFloat longHeight = [_cache layoutForHaiku:changedHaiku].height;
+  XCTAssertTrue(longHeight > shortHeight, @"Row should grow with its text");
+  XCTAssertEqual(_cache.backgroundMeasurementCount, (NSUInteger)2,
+                 @"Changed row should be measured again");
+  XCTAssertEqual(_cache.mainThreadMeasurementCount, (NSUInteger)0,
+                 @"Rows should only be measured in the background");
+  XCTAssertEqual(_cache.layoutCount, (NSUInteger)1, @"Identifier should have one layout");
+}
+
+- (void)testPrecomputedLayoutWaitsUntilAdded {
+  HPHaiku *haiku = [self haikuWithIdentifier:@"1" title:@"Pond"];
+  [self precomputeLayoutsForHaikus:@[ haiku ]];
+  HPHaikuRowLayout *shownLayout = [_cache layoutForHaiku:haiku];
+  HPHaiku *changedHaiku = [self haikuWithIdentifier:@"1" title:@"Pond"];
+  changedHaiku.line_two = [@"" stringByPaddingToLength:500 withString:@"Splash " startingAtIndex:0];
+  __block NSDictionary *measuredLayouts = nil;
+  __block BOOL hasCompleted = NO;
+  [_cache precomputeLayoutsForHaikus:@[ changedHaiku ] completion:^(NSDictionary *layouts) {
+      measuredLayouts = layouts;
+      hasCompleted = YES;
+  }];
+  [self waitForCondition:&hasCompleted];
+  // The row still shows the old text until the changed haiku is shown.
+  XCTAssertEqual([_cache layoutForHaiku:haiku], shownLayout, @"Old layout should be kept");
+  [_cache addLayouts:measuredLayouts];
+  XCTAssertTrue([_cache layoutForHaiku:changedHaiku].height > shownLayout.height,
+                @"Added layout should be used");
+  XCTAssertEqual(_cache.mainThreadMeasurementCount, (NSUInteger)0,
+                 @"Rows should only be measured in the background");
+}
+
+- (void)testNarrowerWidthDiscardsLayouts {
+  NSString *title = @"Autumn moonlight, a worm digs silently into the chestnut";
+  HPHaiku *haiku = [self haikuWithIdentifier:@"1" title:title];
+  [self precomputeLayoutsForHaikus:@[ haiku ]];
+  CGFloat wideHeight = [_cache layoutForHaiku:haiku].height;
+
+  _cache.width = 160;
+  XCTAssertEqual(_cache.layoutCount, (NSUInteger)0, @"Layouts should be discarded");
+  [self precomputeLayoutsForHaikus:@[ haiku ]];
+  XCTAssertTrue([_cache layoutForHaiku:haiku].height > wideHeight,
+                @"Narrower row should be taller");
+  XCTAssertEqual(_cache.mainThreadMeasurementCount, (NSUInteger)0,
+                 @"Rows should only be measured in the background");
+}
+
+- (void)testLayoutsForOldWidthAreDropped {
+  HPHaiku *haiku = [self haikuWithIdentifier:@"1" title:@"Pond"];
+  __block BOOL hasCompleted = NO;
+  [_cache precomputeLayoutsForHaikus:@[ haiku ] completion:^(NSDictionary *layouts) {
+      [_cache addLayouts:layouts];
+      hasCompleted = YES;
+  }];
+  _cache.width = 160;
+  [self waitForCondition:&hasCompleted];
+  XCTAssertTrue(hasCompleted, @"Dropped precomputation should still complete");
+  XCTAssertEqual(_cache.layoutCount, (NSUInteger)0, @"Layout for the old width should be dropped");
+}
+
+@end
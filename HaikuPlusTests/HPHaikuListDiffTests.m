@@ -0,0 +1,194 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPHaiku.h"
+#import "HPHaikuListDiff.h"
+
+@interface HPHaikuListDiffTests : XCTestCase
+
+@end
+
+@implementation HPHaikuListDiffTests
+
+- (HPHaiku *)haikuWithIdentifier:(NSString *)identifier {
+  HPHaiku *haiku = [[HPHaiku alloc] init];
+  haiku.identifier = identifier;
+  haiku.title = [@"Haiku " stringByAppendingString:identifier];
+  return haiku;
+}
+
+- (NSArray *)haikusWithIdentifiers:(NSArray *)identifiers {
+  NSMutableArray *haikus = [NSMutableArray arrayWithCapacity:[identifiers count]];
+  for (NSString *identifier in identifiers) {
+    [haikus addObject:[self haikuWithIdentifier:identifier]];
+  }
+  return haikus;
+}
+
+/**
+ * Applies a diff the way a table does: haikus that are neither deleted nor moved keep their
+ * order and fill the rows left free by insertions and moves.
+ *
+ * @return Identifiers of the rows after the update.
+ */
+- (NSArray *)identifiersAfterApplyingDiff:(HPHaikuListDiff *)diff
+                               fromHaikus:(NSArray *)oldHaikus
+                                 toHaikus:(NSArray *)newHaikus {
+  NSMutableIndexSet *leavingIndexes = [diff.deletedIndexes mutableCopy];
+  NSMutableIndexSet *arrivingIndexes = [diff.insertedIndexes mutableCopy];
+  NSMutableDictionary *rows = [NSMutableDictionary dictionary];
+  [diff.insertedIndexes enumerateIndexesUsingBlock:^(NSUInteger index, BOOL *stop) {
+      [rows setObject:[[newHaikus objectAtIndex:index] identifier] forKey:@(index)];
+  }];
+  [diff enumerateMovesUsingBlock:^(NSUInteger fromIndex, NSUInteger toIndex) {
+      [leavingIndexes addIndex:fromIndex];
+      [arrivingIndexes addIndex:toIndex];
+      [rows setObject:[[oldHaikus objectAtIndex:fromIndex] identifier] forKey:@(toIndex)];
+  }];
+  NSMutableArray *identifiers = [NSMutableArray arrayWithCapacity:[newHaikus count]];
+  NSUInteger oldIndex = 0;
+  for (NSUInteger newIndex = 0; newIndex < [newHaikus count]; newIndex++) {
+    if ([arrivingIndexes containsIndex:newIndex]) {
+      [identifiers addObject:[rows objectForKey:@(newIndex)]];
+      continue;
+    }
+    while ([leavingIndexes containsIndex:oldIndex]) {
+      oldIndex++;
+    }
+    if (oldIndex >= [oldHaikus count]) {
+      return nil;
+    }
+    [identifiers addObject:[[oldHaikus objectAtIndex:oldIndex++] identifier]];
+  }
+  return identifiers;
+}
+
+- (void)testEqualListsHaveNoChanges {
+  NSArray *oldHaikus = [self haikusWithIdentifiers:@[ @"a", @"b", @"c" ]];
+  NSArray *newHaikus = [self haikusWithIdentifiers:@[ @"a", @"b", @"c" ]];
+  HPHaikuListDiff *diff = [HPHaikuListDiff diffFromHaikus:oldHaikus toHaikus:newHaikus];
+  XCTAssertEqual(diff.changeCount, (NSUInteger)0, @"Equal haikus should not change rows");
+}
+
+- (void)testVoteChangeIsUpdate {
+  NSArray *oldHaikus = [self haikusWithIdentifiers:@[ @"a", @"b", @"c" ]];
+  NSArray *newHaikus = [self haikusWithIdentifiers:@[ @"a", @"b", @"c" ]];
+  [[newHaikus objectAtIndex:1] setVotes:1];
+  HPHaikuListDiff *diff = [HPHaikuListDiff diffFromHaikus:oldHaikus toHaikus:newHaikus];
+  XCTAssertEqualObjects(diff.updatedIndexes, [NSIndexSet indexSetWithIndex:1],
+                        @"Only the voted haiku should be updated");
+  XCTAssertEqual(diff.changeCount, (NSUInteger)1, @"Nothing else should change");
+}
+
+- (void)testInsertionsAndDeletions {
+  NSArray *oldHaikus = [self haikusWithIdentifiers:@[ @"a", @"b", @"c", @"d" ]];
+  NSArray *newHaikus = [self haikusWithIdentifiers:@[ @"new", @"a", @"c", @"d", @"e" ]];
+  HPHaikuListDiff *diff = [HPHaikuListDiff diffFromHaikus:oldHaikus toHaikus:newHaikus];
+  XCTAssertEqualObjects(diff.deletedIndexes, [NSIndexSet indexSetWithIndex:1],
+                        @"b should be deleted");
+  NSMutableIndexSet *insertedIndexes = [NSMutableIndexSet indexSetWithIndex:0];
+  [insertedIndexes addIndex:4];
+  XCTAssertEqualObjects(diff.insertedIndexes, insertedIndexes, @"new and e should be inserted");
+  XCTAssertEqual(diff.moveCount, (NSUInteger)0, @"Shifted haikus should not move");
+}
+
+- (void)testMovingOneHaikuIsOneMove {
+  NSArray *oldHaikus = [self haikusWithIdentifiers:@[ @"a", @"b", @"c", @"d", @"e" ]];
+  NSArray *newHaikus = [self haikusWithIdentifiers:@[ @"e", @"a", @"b", @"c", @"d" ]];
+  HPHaikuListDiff *diff = [HPHaikuListDiff diffFromHaikus:oldHaikus toHaikus:newHaikus];
+  XCTAssertEqual(diff.changeCount, (NSUInteger)1, @"Only one haiku should move");
+  __block NSUInteger movedFrom = NSNotFound;
+  __block NSUInteger movedTo = NSNotFound;
+  [diff enumerateMovesUsingBlock:^(NSUInteger fromIndex, NSUInteger toIndex) {
+      movedFrom = fromIndex;
+      movedTo = toIndex;
+  }];
+  XCTAssertEqual(movedFrom, (NSUInteger)4, @"e should move from the end");
+  XCTAssertEqual(movedTo, (NSUInteger)0, @"e should move to the front");
+}
+
+- (void)testMovedAndChangedHaikuIsReplaced {
+  NSArray *oldHaikus = [self haikusWithIdentifiers:@[ @"a", @"b", @"c" ]];
+  NSArray *newHaikus = [self haikusWithIdentifiers:@[ @"c", @"a", @"b" ]];
+  [[newHaikus objectAtIndex:0] setTitle:@"Edited"];
+  HPHaikuListDiff *diff = [HPHaikuListDiff diffFromHaikus:oldHaikus toHaikus:newHaikus];
+  XCTAssertEqual(diff.moveCount, (NSUInteger)0, @"A changed row cannot be moved");
+  XCTAssertEqualObjects(diff.deletedIndexes, [NSIndexSet indexSetWithIndex:2],
+                        @"Old row should be deleted");
+  XCTAssertEqualObjects(diff.insertedIndexes, [NSIndexSet indexSetWithIndex:0],
+                        @"New row should be inserted");
+}
+
+- (void)testRepeatedAndMissingIdentifiersAreNotMatched {
+  NSMutableArray *oldHaikus = [[self haikusWithIdentifiers:@[ @"a", @"a" ]] mutableCopy];
+  [oldHaikus addObject:[[HPHaiku alloc] init]];
+  NSArray *newHaikus = [self haikusWithIdentifiers:@[ @"a", @"a", @"a" ]];
+  HPHaikuListDiff *diff = [HPHaikuListDiff diffFromHaikus:oldHaikus toHaikus:newHaikus];
+  XCTAssertEqual([diff.deletedIndexes count], (NSUInteger)2, @"Repeat and nil should be deleted");
+  XCTAssertEqual([diff.insertedIndexes count], (NSUInteger)2, @"Repeats should be inserted");
+  XCTAssertEqualObjects([self identifiersAfterApplyingDiff:diff
+                                                fromHaikus:oldHaikus
+                                                  toHaikus:newHaikus],
+                        [newHaikus valueForKey:@"identifier"], @"Diff should give the new list");
+}
+
+- (void)testBenchmarkShuffledFeed {
+  NSUInteger count = 50000;
+  NSMutableArray *oldHaikus = [NSMutableArray arrayWithCapacity:count];
+  for (NSUInteger i = 0; i < count; i++) {
+    [oldHaikus addObject:[self haikuWithIdentifier:[NSString stringWithFormat:@"%lu",
+                                                       (unsigned long)i]]];
+  }
+  // Drop, add, vote on and move a few percent of the haikus, with a fixed seed.
+  srand48(7);
+  NSMutableArray *newHaikus = [NSMutableArray arrayWithCapacity:count];
+  for (HPHaiku *haiku in oldHaikus) {
+    double choice = drand48();
+    if (choice < 0.02) {
+      continue;
+    }
+    HPHaiku *copy = [self haikuWithIdentifier:haiku.identifier];
+    copy.votes = choice < 0.04 ? 1 : 0;
+    [newHaikus addObject:copy];
+    if (choice > 0.98) {
+      NSString *identifier = [@"new" stringByAppendingString:haiku.identifier];
+      [newHaikus addObject:[self haikuWithIdentifier:identifier]];
+    }
+  }
+  for (NSUInteger i = 0; i < count / 50; i++) {
+    [newHaikus exchangeObjectAtIndex:(NSUInteger)(drand48() * [newHaikus count])
+                   withObjectAtIndex:(NSUInteger)(drand48() * [newHaikus count])];
+  }
+
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  HPHaikuListDiff *diff = [HPHaikuListDiff diffFromHaikus:oldHaikus toHaikus:newHaikus];
+  CFAbsoluteTime diffTime = CFAbsoluteTimeGetCurrent() - start;
+  NSLog(@"%lu haikus: diff %.0f ms, %lu deleted, %lu inserted, %lu updated, %lu moved",
+        (unsigned long)count, diffTime * 1000, (unsigned long)[diff.deletedIndexes count],
+        (unsigned long)[diff.insertedIndexes count], (unsigned long)[diff.updatedIndexes count],
+        (unsigned long)diff.moveCount);
+
+  XCTAssertTrue(diff.changeCount < count / 5, @"Most haikus should stay in place");
+  XCTAssertEqualObjects([self identifiersAfterApplyingDiff:diff
+                                                fromHaikus:oldHaikus
+                                                  toHaikus:newHaikus],
+                        [newHaikus valueForKey:@"identifier"], @"Diff should give the new list");
+}
+
+@end
@@ -0,0 +1,157 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "FakeHPNetworkClient.h"
+#import "HPCircuitBreaker.h"
+#import "HPCommunicator.h"
+#import "HPConstants.h"
+#import "HPHedgePolicy.h"
+
+@interface HPHedgePolicyTests : XCTestCase
+
+@end
+
+@implementation HPHedgePolicyTests {
+  HPHedgePolicy *_policy;
+}
+
+- (void)setUp {
+  [super setUp];
+  _policy = [[HPHedgePolicy alloc] init];
+  _policy.minimumDelay = 0;
+}
+
+- (void)testNoHedgeWithoutEnoughSamples {
+  _policy.minimumSampleCount = 3;
+  [_policy recordLatency:0.1 hedgeWin:NO];
+  [_policy recordLatency:0.1 hedgeWin:NO];
+  XCTAssertTrue([_policy hedgeDelayForNewRequest] < 0, @"Two samples should not be enough");
+  [_policy recordLatency:0.1 hedgeWin:NO];
+  XCTAssertEqualWithAccuracy([_policy hedgeDelayForNewRequest], 0.1, 0.0001,
+                             @"Three samples should be enough");
+}
+
+- (void)testHedgeDelayFollowsPercentile {
+  _policy.minimumSampleCount = 1;
+  _policy.percentile = 0.9;
+  for (NSUInteger i = 1; i <= 100; i++) {
+    [_policy recordLatency:i / 100.0 hedgeWin:NO];
+  }
+  XCTAssertEqualWithAccuracy([_policy hedgeDelayForNewRequest], 0.9, 0.0001,
+                             @"Delay should be the 90th percentile");
+  // Slower requests move the percentile.
+  for (NSUInteger i = 0; i < 128; i++) {
+    [_policy recordLatency:2 hedgeWin:NO];
+  }
+  XCTAssertEqualWithAccuracy([_policy hedgeDelayForNewRequest], 2, 0.0001,
+                             @"Delay should adapt to recent latencies");
+}
+
+- (void)testHedgeRateIsCapped {
+  _policy.maxHedgeRate = 0.1;
+  NSUInteger hedgeCount = 0;
+  for (NSUInteger i = 0; i < 100; i++) {
+    [_policy hedgeDelayForNewRequest];
+    if ([_policy shouldSendHedge]) {
+      hedgeCount++;
+    }
+  }
+  XCTAssertEqual(hedgeCount, (NSUInteger)10, @"One request in ten should be hedged");
+  XCTAssertEqual(_policy.hedgeCount, (NSUInteger)10, @"Hedges should be counted");
+  XCTAssertEqual(_policy.throttledHedgeCount, (NSUInteger)90, @"Refusals should be counted");
+}
+
+- (void)testCommunicatorUsesFirstResponseOfHedgedRequest {
+  NSURL *baseURL = [NSURL URLWithString:kHPConstantsAppBaseURLString];
+  FakeHPNetworkClient *network = [[FakeHPNetworkClient alloc] initWithBaseURL:baseURL];
+  HPCommunicator *communicator = [[HPCommunicator alloc] init];
+  communicator.networkClient = network;
+  communicator.hedgePolicy = _policy;
+  _policy.minimumSampleCount = 1;
+  _policy.maxHedgeRate = 1;
+  [_policy recordLatency:0.01 hedgeWin:NO];
+  __block NSUInteger completionCount = 0;
+  [communicator fetchHaikuWithID:@"TestHaikuID" completion:^(HPHaiku *haiku, NSError *error) {
+      completionCount++;
+  }];
+  void (^firstAttempt)(AFHTTPRequestOperation *, id) = network.success;
+  [self waitForCondition:^BOOL { return _policy.hedgeCount == 1; }];
+  XCTAssertEqual(_policy.hedgeCount, (NSUInteger)1, @"A slow request should be hedged");
+  XCTAssertTrue(network.success != firstAttempt, @"The hedge should be a new request");
+
+  NSDictionary *attributes = @{ @"id" : @"TestHaikuID", @"title" : @"testtitle" };
+  network.success(nil, attributes);
+  firstAttempt(nil, attributes);
+  [self waitForCondition:^BOOL { return completionCount > 0; }];
+  [self waitForCondition:^BOOL { return NO; } timeout:0.1];
+  XCTAssertEqual(completionCount, (NSUInteger)1, @"Only the first response should be delivered");
+  XCTAssertEqual(_policy.hedgeWinCount, (NSUInteger)1, @"The hedge should win");
+}
+
+- (void)testCommunicatorFailsHedgedRequestRefusedByCircuitBreaker {
+  NSURL *baseURL = [NSURL URLWithString:kHPConstantsAppBaseURLString];
+  HPNetworkClient *network = [[HPNetworkClient alloc] initWithBaseURL:baseURL];
+  HPCircuitBreaker *breaker = [network circuitBreakerForEndpoint:kHPConstantsHaikuEndpoint];
+  breaker.minimumRequestCount = 1;
+  breaker.openDuration = 60;
+  [breaker allowRequest];
+  [breaker recordFailureWithLatency:0.1];
+  XCTAssertEqual(breaker.state, HPCircuitStateOpen, @"One failure should open the circuit");
+
+  HPCommunicator *communicator = [[HPCommunicator alloc] init];
+  communicator.networkClient = network;
+  communicator.retryPolicy = nil;
+  communicator.hedgePolicy = _policy;
+  _policy.minimumSampleCount = 1;
+  _policy.maxHedgeRate = 1;
+  [_policy recordLatency:0.01 hedgeWin:NO];
+  // The refused request fails on the processing queue, racing the start of the hedged call.
+  // A second fetch joins the first and must be completed with it.
+  __block NSUInteger completionCount = 0;
+  __block NSError *fetchError = nil;
+  for (NSUInteger i = 0; i < 2; i++) {
+    [communicator fetchHaikuWithID:@"TestHaikuID" completion:^(HPHaiku *haiku, NSError *error) {
+        completionCount++;
+        fetchError = error;
+    }];
+  }
+  [self waitForCondition:^BOOL { return completionCount == 2; }];
+  XCTAssertEqual(completionCount, (NSUInteger)2, @"Both callers should be completed");
+  XCTAssertNotNil(fetchError, @"Refused request should fail");
+  [self waitForCondition:^BOOL { return NO; } timeout:0.1];
+  XCTAssertEqual(_policy.hedgeCount, (NSUInteger)0, @"No hedge should be sent to an open circuit");
+}
+
+- (void)waitForCondition:(BOOL (^)(void))condition {
+  [self waitForCondition:condition timeout:5];
+}
+
+/**
+ * Hedges are sent from the main queue, so run the main run loop until the condition holds or
+ * the timeout passes.
+ */
+- (void)waitForCondition:(BOOL (^)(void))condition timeout:(NSTimeInterval)timeout {
+  NSDate *timeoutDate = [NSDate dateWithTimeIntervalSinceNow:timeout];
+  while (!condition() && [timeoutDate timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+}
+
+@end
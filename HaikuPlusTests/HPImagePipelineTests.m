@@ -0,0 +1,176 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPImagePipeline.h"
+
+@interface HPImagePipelineTests : XCTestCase
+
+@end
+
+@implementation HPImagePipelineTests {
+  HPImagePipeline *_pipeline;
+  NSString *_directory;
+  NSURL *_imageURL;
+}
+
+- (void)setUp {
+  [super setUp];
+  NSString *name = [NSString stringWithFormat:@"HPImagePipelineTests-%@",
+                       [[NSProcessInfo processInfo] globallyUniqueString]];
+  _directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  [[NSFileManager defaultManager] createDirectoryAtPath:_directory
+                            withIntermediateDirectories:YES
+                                             attributes:nil
+                                                  error:NULL];
+  // Image requests for file URLs go through the same operations as downloads.
+  UIGraphicsBeginImageContext(CGSizeMake(4, 4));
+  [[UIColor redColor] setFill];
+  UIRectFill(CGRectMake(0, 0, 4, 4));
+  UIImage *image = UIGraphicsGetImageFromCurrentImageContext();
+  UIGraphicsEndImageContext();
+  NSString *imagePath = [_directory stringByAppendingPathComponent:@"avatar.png"];
+  [UIImagePNGRepresentation(image) writeToFile:imagePath atomically:YES];
+  _imageURL = [NSURL fileURLWithPath:imagePath];
+  _pipeline = [self pipeline];
+}
+
+- (void)tearDown {
+  [[NSFileManager defaultManager] removeItemAtPath:_directory error:NULL];
+  [super tearDown];
+}
+
+- (HPImagePipeline *)pipeline {
+  NSString *cacheDirectory = [_directory stringByAppendingPathComponent:@"cache"];
+  return [[HPImagePipeline alloc] initWithDirectory:cacheDirectory];
+}
+
+/**
+ * Loads an image and waits for the completion block on the main queue.
+ */
+- (UIImage *)loadImageWithPipeline:(HPImagePipeline *)pipeline {
+  __block BOOL hasCompleted = NO;
+  __block UIImage *loadedImage = nil;
+  [pipeline loadImageWithURL:_imageURL completion:^(UIImage *image, NSError *error) {
+      loadedImage = image;
+      hasCompleted = YES;
+  }];
+  [self waitForCondition:&hasCompleted];
+  return loadedImage;
+}
+
+- (void)waitForCondition:(BOOL *)condition {
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!*condition && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+}
+
+- (void)testDownloadedImageIsDecoded {
+  UIImage *image = [self loadImageWithPipeline:_pipeline];
+  XCTAssertEqual(_pipeline.downloadCount, (NSUInteger)1, @"The image should be downloaded");
+  CGBitmapInfo bitmapInfo = CGImageGetBitmapInfo([image CGImage]);
+  XCTAssertEqual(bitmapInfo, (CGBitmapInfo)(kCGBitmapByteOrder32Host |
+                                            kCGImageAlphaPremultipliedFirst),
+                 @"The downloaded image should be a decoded bitmap");
+}
+
+- (void)testSecondLoadIsMemoryHit {
+  XCTAssertNotNil([self loadImageWithPipeline:_pipeline], @"The image should be downloaded");
+  __block UIImage *cachedImage = nil;
+  [_pipeline loadImageWithURL:_imageURL completion:^(UIImage *image, NSError *error) {
+      cachedImage = image;
+  }];
+  XCTAssertNotNil(cachedImage, @"A memory hit should complete right away");
+  XCTAssertEqual(_pipeline.downloadCount, (NSUInteger)1, @"The image should be downloaded once");
+  XCTAssertEqual(_pipeline.memoryHitCount, (NSUInteger)1, @"The second load should hit memory");
+  XCTAssertEqualWithAccuracy(_pipeline.hitRate, 0.5, 0.001, @"Half of the lookups should hit");
+}
+
+- (void)testImageIsReadFromDiskAfterMemoryIsEmptied {
+  [self loadImageWithPipeline:_pipeline];
+  // Wait for the downloaded data to be linked on disk.
+  NSString *urlsDirectory = [_directory stringByAppendingPathComponent:@"cache/urls"];
+  BOOL hasStored = NO;
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!hasStored && [timeout timeIntervalSinceNow] > 0) {
+    NSArray *links = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:urlsDirectory
+                                                                          error:NULL];
+    hasStored = [links count] > 0;
+    [NSThread sleepForTimeInterval:0.01];
+  }
+  // A new pipeline has an empty memory cache.
+  HPImagePipeline *pipeline = [self pipeline];
+  XCTAssertNotNil([self loadImageWithPipeline:pipeline], @"The image should be read from disk");
+  XCTAssertEqual(pipeline.diskHitCount, (NSUInteger)1, @"The load should hit the disk");
+  XCTAssertEqual(pipeline.downloadCount, (NSUInteger)0, @"The image should not be downloaded");
+}
+
+- (void)testConcurrentLoadsShareOneDownload {
+  __block NSUInteger completionCount = 0;
+  __block BOOL hasCompleted = NO;
+  for (int i = 0; i < 3; i++) {
+    [_pipeline loadImageWithURL:_imageURL completion:^(UIImage *image, NSError *error) {
+        XCTAssertNotNil(image, @"Every caller should receive the image");
+        completionCount++;
+        hasCompleted = completionCount == 3;
+    }];
+  }
+  [self waitForCondition:&hasCompleted];
+  XCTAssertEqual(completionCount, (NSUInteger)3, @"Every caller should be completed");
+  XCTAssertEqual(_pipeline.coalescedLoadCount, (NSUInteger)2, @"Two loads should be joined");
+}
+
+- (void)testCancelledLoadIsNotCompleted {
+  __block BOOL hasCancelledCompleted = NO;
+  __block BOOL hasCompleted = NO;
+  HPImageLoadToken *token = [_pipeline loadImageWithURL:_imageURL
+                                             completion:^(UIImage *image, NSError *error) {
+      hasCancelledCompleted = YES;
+  }];
+  [_pipeline loadImageWithURL:_imageURL completion:^(UIImage *image, NSError *error) {
+      hasCompleted = YES;
+  }];
+  [token cancel];
+  [self waitForCondition:&hasCompleted];
+  XCTAssertTrue([token isCancelled], @"The token should be cancelled");
+  XCTAssertFalse(hasCancelledCompleted, @"A cancelled load should not be completed");
+  XCTAssertEqual(_pipeline.cancelledLoadCount, (NSUInteger)1, @"The cancel should be counted");
+  XCTAssertEqual(_pipeline.cancelledDownloadCount, (NSUInteger)0,
+                 @"A download that is still needed should not be cancelled");
+}
+
+- (void)testCancellingFinishedLoadDoesNothing {
+  [self loadImageWithPipeline:_pipeline];
+  HPImageLoadToken *token = [_pipeline loadImageWithURL:_imageURL
+                                             completion:^(UIImage *image, NSError *error) {}];
+  [token cancel];
+  XCTAssertFalse([token isCancelled], @"A finished load cannot be cancelled");
+  XCTAssertEqual(_pipeline.cancelledLoadCount, (NSUInteger)0, @"Nothing should be cancelled");
+}
+
+- (void)testInvalidURLFails {
+  __block NSError *loadError = nil;
+  [_pipeline loadImageWithURL:nil completion:^(UIImage *image, NSError *error) {
+      loadError = error;
+  }];
+  XCTAssertNotNil(loadError, @"A nil URL should fail right away");
+}
+
+@end
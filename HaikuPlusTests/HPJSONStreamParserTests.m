@@ -0,0 +1,148 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPJSONStreamParser.h"
+
+@interface HPJSONStreamParserTests : XCTestCase
+
+@end
+
+@implementation HPJSONStreamParserTests {
+  NSMutableArray *_elements;
+}
+
+- (void)setUp {
+  [super setUp];
+  _elements = [NSMutableArray array];
+}
+
+/**
+ * @return Parser that collects its elements in |_elements|.
+ */
+- (HPJSONStreamParser *)parserWithItemsKey:(NSString *)itemsKey {
+  HPJSONStreamParser *parser = [[HPJSONStreamParser alloc] initWithItemsKey:itemsKey];
+  NSMutableArray *elements = _elements;
+  parser.elementHandler = ^(id element) {
+      [elements addObject:element];
+  };
+  return parser;
+}
+
+/**
+ * Appends a JSON string in chunks of the given length and finishes the parser.
+ *
+ * @return YES if the parser accepted the whole string.
+ */
+- (BOOL)parse:(NSString *)string
+   withParser:(HPJSONStreamParser *)parser
+  chunkLength:(NSUInteger)chunkLength {
+  NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+  for (NSUInteger offset = 0; offset < [data length]; offset += chunkLength) {
+    NSUInteger length = MIN(chunkLength, [data length] - offset);
+    if (![parser appendBytes:(const uint8_t *)[data bytes] + offset length:length]) {
+      return NO;
+    }
+  }
+  return [parser finish];
+}
+
+- (void)testStreamsTopLevelArrayOneByteAtATime {
+  NSString *json = @"[ {\"id\": \"a\", \"lines\": [\"x]\", \"y}\"]},\n"
+                   @"{\"id\": \"b\\\"}\", \"votes\": 3}, \"café [\", 42, true, null ]";
+  HPJSONStreamParser *parser = [self parserWithItemsKey:nil];
+  XCTAssertTrue([self parse:json withParser:parser chunkLength:1], @"%@", parser.error);
+  NSArray *expected = @[
+    @{ @"id" : @"a", @"lines" : @[ @"x]", @"y}" ] },
+    @{ @"id" : @"b\"}", @"votes" : @3 },
+    @"café [",
+    @42,
+    @YES,
+    [NSNull null]
+  ];
+  XCTAssertEqualObjects(_elements, expected, @"Every element should be handed over in order");
+  XCTAssertEqual(parser.elementCount, (NSUInteger)6, @"Every element should be counted");
+  XCTAssertEqualObjects(parser.envelope, @[], @"The envelope of an array should be empty");
+}
+
+- (void)testHandsOverElementBeforeResponseEnds {
+  HPJSONStreamParser *parser = [self parserWithItemsKey:nil];
+  NSData *data = [@"[{\"id\": \"a\"}, {\"id\"" dataUsingEncoding:NSUTF8StringEncoding];
+  XCTAssertTrue([parser appendData:data], @"A partial response should be accepted");
+  XCTAssertEqualObjects(_elements, @[ @{ @"id" : @"a" } ],
+                        @"A complete element should be handed over right away");
+}
+
+- (void)testStreamsItemsOfTopLevelObject {
+  NSString *json = @"{\"before\": {\"items\": [1]}, \"items\": [{\"id\": \"a\"}, {\"id\": \"b\"}], "
+                   @"\"next_cursor\": \"abc\"}";
+  HPJSONStreamParser *parser = [self parserWithItemsKey:@"items"];
+  XCTAssertTrue([self parse:json withParser:parser chunkLength:3], @"%@", parser.error);
+  XCTAssertEqualObjects(_elements, (@[ @{ @"id" : @"a" }, @{ @"id" : @"b" } ]),
+                        @"Only the top-level items should be streamed");
+  NSDictionary *expected = @{
+    @"before" : @{ @"items" : @[ @1 ] },
+    @"items" : @[],
+    @"next_cursor" : @"abc"
+  };
+  XCTAssertEqualObjects(parser.envelope, expected, @"The envelope should keep other members");
+}
+
+- (void)testObjectWithoutItemsIsEnvelope {
+  HPJSONStreamParser *parser = [self parserWithItemsKey:@"items"];
+  XCTAssertTrue([self parse:@"{\"error\": [\"a\"]}" withParser:parser chunkLength:2],
+                @"%@", parser.error);
+  XCTAssertEqual([_elements count], (NSUInteger)0, @"Nothing should be streamed");
+  XCTAssertEqualObjects(parser.envelope, @{ @"error" : @[ @"a" ] },
+                        @"The whole object should be the envelope");
+}
+
+- (void)testRejectsInvalidJSON {
+  NSArray *strings = @[
+    @"[1 2]",
+    @"[1,,2]",
+    @"[1,]",
+    @"[{\"id\": }]",
+    @"[] []",
+    @"\"feed\"",
+    @"[{\"id\": \"a\"}"
+  ];
+  for (NSString *string in strings) {
+    HPJSONStreamParser *parser = [self parserWithItemsKey:nil];
+    XCTAssertFalse([self parse:string withParser:parser chunkLength:1],
+                   @"%@ should be rejected", string);
+    XCTAssertNotNil(parser.error, @"%@ should set an error", string);
+  }
+}
+
+- (void)testBufferDoesNotGrowWithFeed {
+  NSMutableString *json = [NSMutableString stringWithString:@"["];
+  for (NSUInteger i = 0; i < 10000; i++) {
+    [json appendFormat:@"%@{\"id\": \"haiku%05lu\", \"title\": \"An old silent pond\"}",
+                       i ? @"," : @"", (unsigned long)i];
+  }
+  [json appendString:@"]"];
+  HPJSONStreamParser *parser = [[HPJSONStreamParser alloc] initWithItemsKey:nil];
+  XCTAssertTrue([self parse:json withParser:parser chunkLength:1460], @"%@", parser.error);
+  XCTAssertEqual(parser.elementCount, (NSUInteger)10000, @"Every element should be parsed");
+  XCTAssertTrue(parser.maxElementLength < 64,
+                @"Only one element should be buffered, not %lu bytes",
+                (unsigned long)parser.maxElementLength);
+}
+
+@end
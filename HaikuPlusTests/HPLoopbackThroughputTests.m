@@ -0,0 +1,339 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import <mach/mach.h>
+#import <UIKit/UIKit.h>
+
+#import "HPConstants.h"
+#import "HPDateCodec.h"
+#import "HPHaiku.h"
+#import "HPNetworkClient.h"
+#import "HPUser.h"
+#import "LoopbackHaikuServer.h"
+
+/**
+ * Environment variables that configure a run:
+ * - HP_LOOPBACK_HAIKU_COUNT: number of haikus the server holds. Defaults to 10000.
+ * - HP_LOOPBACK_REQUEST_COUNT: number of haiku requests in the throughput test. Defaults to 500.
+ * - HP_LOOPBACK_OUTPUT: path of the JSON results file. Defaults to HPLoopbackThroughput.json in
+ *   the temporary directory.
+ */
+static const char *kHPLoopbackHaikuCountVariable = "HP_LOOPBACK_HAIKU_COUNT";
+static const char *kHPLoopbackRequestCountVariable = "HP_LOOPBACK_REQUEST_COUNT";
+static const char *kHPLoopbackOutputVariable = "HP_LOOPBACK_OUTPUT";
+
+static const NSUInteger kHPLoopbackDefaultHaikuCount = 10000;
+static const NSUInteger kHPLoopbackDefaultRequestCount = 500;
+
+/**
+ * Largest number of feed pages fetched by the paging test.
+ */
+static const NSUInteger kHPLoopbackMaxPageCount = 200;
+
+/**
+ * @return Resident memory of the process in bytes, and its peak so far in |peak|.
+ */
+static unsigned long long HPLoopbackResidentSize(unsigned long long *peak) {
+  struct mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) !=
+      KERN_SUCCESS) {
+    *peak = 0;
+    return 0;
+  }
+  *peak = info.resident_size_max;
+  return info.resident_size;
+}
+
+/**
+ * Drives the unmodified HPNetworkClient, and through it AFNetworking and NSURLConnection, against
+ * a LoopbackHaikuServer on 127.0.0.1. Measures requests per second, latency percentiles from
+ * enqueueing to delivery on the main queue, and resident memory, and appends the results to a
+ * JSON file. No outside network is used.
+ */
+@interface HPLoopbackThroughputTests : XCTestCase
+
+@end
+
+/**
+ * Results of every measurement in this run, in the order they finished.
+ */
+static NSMutableArray *gHPLoopbackResults;
+
+@implementation HPLoopbackThroughputTests {
+  LoopbackHaikuServer *_server;
+  HPNetworkClient *_network;
+}
+
+- (void)setUp {
+  [super setUp];
+  const char *haikuCount = getenv(kHPLoopbackHaikuCountVariable);
+  _server = [[LoopbackHaikuServer alloc] init];
+  _server.haikuCount =
+      haikuCount ? (NSUInteger)strtoul(haikuCount, NULL, 10) : kHPLoopbackDefaultHaikuCount;
+  NSError *error = nil;
+  XCTAssertTrue([_server start:&error], @"Server should start: %@", error);
+  _network = [[HPNetworkClient alloc] initWithBaseURL:_server.baseURL];
+  [_network setDefaultHeader:@"User-Agent" value:kHPConstantsUserAgent];
+  if (!gHPLoopbackResults) {
+    gHPLoopbackResults = [NSMutableArray array];
+  }
+}
+
+- (void)tearDown {
+  [_network.operationQueue cancelAllOperations];
+  [_server stop];
+  [super tearDown];
+}
+
+/**
+ * Sends a GET request through the client.
+ *
+ * @param path Path of the request.
+ * @param parameters Query parameters, or nil.
+ * @param decoder Turns the parsed JSON into model objects, or nil.
+ * @param completion Called on the main queue with the decoded object or the error.
+ */
+- (void)getPath:(NSString *)path
+     parameters:(NSDictionary *)parameters
+        decoder:(HPResponseDecoder)decoder
+     completion:(void (^)(id decodedObject, NSError *error))completion {
+  NSMutableURLRequest *request = [_network requestWithMethod:@"GET"
+                                                        path:path
+                                                  parameters:parameters];
+  AFHTTPRequestOperation *op = [_network HTTPRequestOperationWithRequest:request
+      decoder:decoder
+      completionQueue:dispatch_get_main_queue()
+      success:^(AFHTTPRequestOperation *operation, id decodedObject) {
+          completion(decodedObject, nil);
+      }
+      failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+          completion(nil, error);
+      }];
+  [_network enqueueHTTPRequestOperation:op priority:HPRequestPriorityVisible];
+}
+
+#pragma mark - Tests
+
+- (void)testServerAnswersLikeTheAPI {
+  __block HPUser *user = nil;
+  [self getPath:kHPConstantsUserPath
+     parameters:nil
+        decoder:^id(id responseObject) {
+            return [[HPUser alloc] initWithAttributes:responseObject];
+        }
+     completion:^(id decodedObject, NSError *error) {
+         user = decodedObject;
+     }];
+  [self waitForCondition:^BOOL { return user != nil; }];
+  XCTAssertNotNil(user.identifier, @"The current user should be returned");
+
+  __block NSError *missingError = nil;
+  NSString *missingPath = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @"missing"];
+  [self getPath:missingPath parameters:nil decoder:nil completion:^(id object, NSError *error) {
+      missingError = error;
+  }];
+  [self waitForCondition:^BOOL { return missingError != nil; }];
+  XCTAssertNotNil(missingError, @"An unknown haiku should not be found");
+
+  __block NSUInteger voteCount = 0;
+  NSString *votePath = [NSString stringWithFormat:kHPConstantsHaikuVoteFormatPath, @"synthetic-1"];
+  [_network postPath:votePath parameters:nil success:^(AFHTTPRequestOperation *operation, id o) {
+      voteCount++;
+  } failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+      XCTFail(@"Vote should succeed: %@", error);
+      voteCount++;
+  }];
+  [self waitForCondition:^BOOL { return voteCount > 0; }];
+
+  // Asking for the same haiku twice should revalidate it with its entity tag.
+  NSString *haikuPath = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @"synthetic-1"];
+  __block NSUInteger haikuCount = 0;
+  for (NSUInteger i = 0; i < 2; i++) {
+    __block BOOL done = NO;
+    [self getPath:haikuPath parameters:nil decoder:nil completion:^(id object, NSError *error) {
+        XCTAssertNotNil(object, @"The haiku should be returned: %@", error);
+        haikuCount++;
+        done = YES;
+    }];
+    [self waitForCondition:^BOOL { return done; }];
+  }
+  XCTAssertEqual(haikuCount, (NSUInteger)2, @"Both requests should be answered");
+  XCTAssertEqual(_network.notModifiedCount, (NSUInteger)1,
+                 @"The second request should be answered with 304 Not Modified");
+}
+
+- (void)testThroughputOfHaikuRequests {
+  const char *requestCount = getenv(kHPLoopbackRequestCountVariable);
+  NSUInteger count =
+      requestCount ? (NSUInteger)strtoul(requestCount, NULL, 10) : kHPLoopbackDefaultRequestCount;
+  NSMutableArray *latencies = [NSMutableArray arrayWithCapacity:count];
+  __block NSUInteger failureCount = 0;
+  unsigned long long peakBefore = 0;
+  unsigned long long residentBefore = HPLoopbackResidentSize(&peakBefore);
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  for (NSUInteger i = 0; i < count; i++) {
+    // A stride through the feed, so that no haiku is requested twice in a small run.
+    NSString *identifier = [NSString stringWithFormat:@"synthetic-%lu",
+                               (unsigned long)((i * 7919) % _server.haikuCount)];
+    NSString *path = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, identifier];
+    CFAbsoluteTime requestStart = CFAbsoluteTimeGetCurrent();
+    [self getPath:path
+       parameters:nil
+          decoder:^id(id responseObject) {
+              return [[HPHaiku alloc] initWithAttributes:responseObject];
+          }
+       completion:^(id decodedObject, NSError *error) {
+           if (!decodedObject) {
+             failureCount++;
+           }
+           [latencies addObject:@(CFAbsoluteTimeGetCurrent() - requestStart)];
+       }];
+  }
+  [self waitForCondition:^BOOL { return [latencies count] == count; }];
+  CFAbsoluteTime time = CFAbsoluteTimeGetCurrent() - start;
+  XCTAssertEqual([latencies count], count, @"Every request should complete");
+  XCTAssertEqual(failureCount, (NSUInteger)0, @"No request should fail");
+  [self recordResultWithName:@"haiku_requests"
+                       count:count
+                        time:time
+                   latencies:latencies
+              residentBefore:residentBefore];
+}
+
+- (void)testThroughputOfFeedPages {
+  NSMutableArray *latencies = [NSMutableArray array];
+  __block NSUInteger haikuCount = 0;
+  unsigned long long peakBefore = 0;
+  unsigned long long residentBefore = HPLoopbackResidentSize(&peakBefore);
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  NSString *cursor = nil;
+  do {
+    NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+    [parameters setObject:@(kHPConstantsHaikusPageSize) forKey:kHPConstantsPageSizeParameter];
+    if (cursor) {
+      [parameters setObject:cursor forKey:kHPConstantsPageCursorParameter];
+    }
+    __block NSDictionary *page = nil;
+    __block BOOL done = NO;
+    CFAbsoluteTime requestStart = CFAbsoluteTimeGetCurrent();
+    [self getPath:kHPConstantsHaikusPath
+       parameters:parameters
+          decoder:^id(id responseObject) {
+              NSArray *haikus = [HPHaiku haikuObjectsWithAttributes:
+                                    [responseObject objectForKey:kHPConstantsPageItemsKey]];
+              NSMutableDictionary *decodedPage = [responseObject mutableCopy];
+              [decodedPage setObject:haikus forKey:kHPConstantsPageItemsKey];
+              return decodedPage;
+          }
+       completion:^(id decodedObject, NSError *error) {
+           XCTAssertNotNil(decodedObject, @"Page should be returned: %@", error);
+           page = decodedObject;
+           done = YES;
+       }];
+    [self waitForCondition:^BOOL { return done; }];
+    [latencies addObject:@(CFAbsoluteTimeGetCurrent() - requestStart)];
+    haikuCount += [[page objectForKey:kHPConstantsPageItemsKey] count];
+    cursor = [page objectForKey:kHPConstantsPageNextCursorKey];
+  } while (cursor && [latencies count] < kHPLoopbackMaxPageCount);
+  CFAbsoluteTime time = CFAbsoluteTimeGetCurrent() - start;
+  NSUInteger expectedCount =
+      MIN(_server.haikuCount, kHPLoopbackMaxPageCount * kHPConstantsHaikusPageSize);
+  XCTAssertEqual(haikuCount, expectedCount, @"Every haiku should be paged through once");
+  [self recordResultWithName:@"feed_pages"
+                       count:[latencies count]
+                        time:time
+                   latencies:latencies
+              residentBefore:residentBefore];
+}
+
+#pragma mark - Results
+
+/**
+ * @param sortedValues Values in ascending order.
+ * @return The value at the percentile, from 0 to 1, by the nearest-rank method.
+ */
+- (double)percentile:(double)percentile ofSortedValues:(NSArray *)sortedValues {
+  if ([sortedValues count] == 0) {
+    return 0;
+  }
+  NSUInteger rank = (NSUInteger)ceil(percentile * [sortedValues count]);
+  return [[sortedValues objectAtIndex:MAX(rank, 1) - 1] doubleValue];
+}
+
+/**
+ * Logs a measurement and writes every measurement so far to the results file.
+ */
+- (void)recordResultWithName:(NSString *)name
+                       count:(NSUInteger)count
+                        time:(CFAbsoluteTime)time
+                   latencies:(NSArray *)latencies
+              residentBefore:(unsigned long long)residentBefore {
+  unsigned long long peak = 0;
+  unsigned long long residentAfter = HPLoopbackResidentSize(&peak);
+  NSArray *sorted = [latencies sortedArrayUsingSelector:@selector(compare:)];
+  NSDictionary *result = @{
+    @"name" : name,
+    @"requests" : @(count),
+    @"seconds" : @(time),
+    @"requests_per_second" : @(count / MAX(time, 1e-9)),
+    @"latency_p50_ms" : @([self percentile:0.5 ofSortedValues:sorted] * 1000),
+    @"latency_p90_ms" : @([self percentile:0.9 ofSortedValues:sorted] * 1000),
+    @"latency_p99_ms" : @([self percentile:0.99 ofSortedValues:sorted] * 1000),
+    @"latency_max_ms" : @([[sorted lastObject] doubleValue] * 1000),
+    @"resident_bytes_before" : @(residentBefore),
+    @"resident_bytes_after" : @(residentAfter),
+    @"resident_bytes_peak" : @(peak),
+    @"server_haiku_count" : @(_server.haikuCount),
+    @"server_sent_bytes" : @(_server.sentByteCount)
+  };
+  NSLog(@"%@: %lu requests, %.0f requests/s, p50 %.1f ms, p99 %.1f ms", name,
+        (unsigned long)count, [result[@"requests_per_second"] doubleValue],
+        [result[@"latency_p50_ms"] doubleValue], [result[@"latency_p99_ms"] doubleValue]);
+  [gHPLoopbackResults addObject:result];
+
+  const char *outputPath = getenv(kHPLoopbackOutputVariable);
+  NSString *path = outputPath ? [NSString stringWithUTF8String:outputPath] :
+      [NSTemporaryDirectory() stringByAppendingPathComponent:@"HPLoopbackThroughput.json"];
+  UIDevice *device = [UIDevice currentDevice];
+  NSDictionary *report = @{
+    @"date" : [HPDateCodec APIStringFromDate:[NSDate date]],
+    @"device" : [device model],
+    @"system_version" : [device systemVersion],
+    @"results" : gHPLoopbackResults
+  };
+  NSData *data = [NSJSONSerialization dataWithJSONObject:report
+                                                 options:NSJSONWritingPrettyPrinted
+                                                   error:NULL];
+  XCTAssertTrue([data writeToFile:path atomically:YES], @"Results should be written to %@", path);
+}
+
+/**
+ * Responses are delivered on the main queue, so run the main run loop until the condition holds
+ * or a timeout passes.
+ */
+- (void)waitForCondition:(BOOL (^)(void))condition {
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:60];
+  while (!condition() && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+}
+
+@end
@@ -0,0 +1,114 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPCommunicator.h"
+#import "HPConstants.h"
+#import "HPHaiku.h"
+#import "HPMainThreadWatchdog.h"
+#import "HPTraceBuffer.h"
+#import "SimulatedHPNetworkClient.h"
+
+@interface HPMainThreadWatchdogTests : XCTestCase
+
+@end
+
+@implementation HPMainThreadWatchdogTests {
+  HPMainThreadWatchdog *_watchdog;
+}
+
+- (void)setUp {
+  [super setUp];
+  _watchdog = [[HPMainThreadWatchdog alloc] init];
+  _watchdog.frameBudget = 0.01;
+}
+
+- (void)testFastBlockIsNotAStall {
+  HPTraceRecord *record = [[HPTraceRecord alloc] init];
+  __block BOOL ran = NO;
+  [_watchdog runBlock:^{ ran = YES; }
+                stage:HPWatchdogStageDelivery
+             endpoint:kHPConstantsHaikuEndpoint
+          traceRecord:record];
+  XCTAssertTrue(ran, @"Block should run");
+  XCTAssertEqual(_watchdog.blockCount, (NSUInteger)1, @"Block should be timed");
+  XCTAssertEqual(_watchdog.stallCount, (NSUInteger)0, @"Block should not be a stall");
+  XCTAssertEqual(record.stallCount, (NSUInteger)0, @"Record should have no stall");
+}
+
+- (void)testSlowBlockIsReported {
+  HPTraceRecord *record = [[HPTraceRecord alloc] init];
+  __block NSString *stalledEndpoint = nil;
+  __block HPWatchdogStage stalledStage = HPWatchdogStageDelivery;
+  _watchdog.stallHandler = ^(NSString *endpoint, HPWatchdogStage stage, NSTimeInterval duration) {
+      stalledEndpoint = endpoint;
+      stalledStage = stage;
+  };
+  [_watchdog runBlock:^{ [NSThread sleepForTimeInterval:0.03]; }
+                stage:HPWatchdogStageStreamElement
+             endpoint:kHPConstantsHaikusEndpoint
+          traceRecord:record];
+  XCTAssertEqual(_watchdog.stallCount, (NSUInteger)1, @"Block should be a stall");
+  XCTAssertTrue(_watchdog.longestStallDuration >= 0.03, @"Stall should be measured");
+  XCTAssertEqualObjects(stalledEndpoint, kHPConstantsHaikusEndpoint, @"Endpoint should be told");
+  XCTAssertEqual(stalledStage, HPWatchdogStageStreamElement, @"Stage should be told");
+  XCTAssertEqual(record.stallCount, (NSUInteger)1, @"Record should have the stall");
+  XCTAssertEqualObjects(record.longestStallStage, @"stream_element",
+                        @"Record should name the stage");
+}
+
+- (void)testBlockOffMainThreadIsNotTimed {
+  __block BOOL ran = NO;
+  dispatch_sync(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+      [_watchdog runBlock:^{ ran = YES; }
+                    stage:HPWatchdogStageDelivery
+                 endpoint:nil
+              traceRecord:nil];
+  });
+  XCTAssertTrue(ran, @"Block should run");
+  XCTAssertEqual(_watchdog.blockCount, (NSUInteger)0, @"Block should not be timed");
+}
+
+- (void)testCommunicatorReportsStallToTraceBuffer {
+  NSURL *baseURL = [NSURL URLWithString:kHPConstantsAppBaseURLString];
+  HPCommunicator *communicator = [[HPCommunicator alloc] init];
+  communicator.networkClient = [[SimulatedHPNetworkClient alloc] initWithBaseURL:baseURL];
+  communicator.traceBuffer = [[HPTraceBuffer alloc] init];
+  communicator.mainThreadWatchdog = _watchdog;
+  __block BOOL done = NO;
+  [communicator fetchHaikuWithID:@"TestHaikuID" completion:^(HPHaiku *haiku, NSError *error) {
+      // Stands in for expensive work such as reloading a table view.
+      [NSThread sleepForTimeInterval:0.03];
+      done = YES;
+  }];
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (![[communicator.traceBuffer records] count] && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+  XCTAssertTrue(done, @"Completion should run");
+  HPTraceRecord *record = [[communicator.traceBuffer records] firstObject];
+  XCTAssertEqualObjects(record.endpoint, kHPConstantsHaikuEndpoint, @"Endpoint should be traced");
+  XCTAssertEqual(record.stallCount, (NSUInteger)1, @"Stall should be traced");
+  XCTAssertEqualObjects(record.longestStallStage, @"delivery", @"Stage should be traced");
+  XCTAssertTrue(record.mainThreadDuration >= 0.03, @"Main thread time should be traced");
+  XCTAssertNotNil([[record dictionaryRepresentation] objectForKey:@"longest_stall_ms"],
+                  @"Stall should be exported");
+}
+
+@end
@@ -0,0 +1,463 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import <libkern/OSAtomic.h>
+#import <pthread.h>
+#import <UIKit/UIKit.h>
+
+#import "HPDateCodec.h"
+#import "HPHaiku.h"
+#import "HPUser.h"
+#import "SimulatedHaikuDataset.h"
+
+/**
+ * Environment variables that configure a benchmark run:
+ * - HP_BENCHMARK_MAX_COUNT: largest payload size, a power of ten up to 1000000. Defaults to 10000
+ *   so that the suite stays quick in ordinary test runs.
+ * - HP_BENCHMARK_SEED: seed of the generated payloads. Defaults to kHPBenchmarkDefaultSeed.
+ * - HP_BENCHMARK_OUTPUT: path of the JSON results file. Defaults to HPModelBenchmarks.json in the
+ *   temporary directory.
+ * - HP_BENCHMARK_BASELINE: path of a results file from an earlier run. When set, a benchmark fails
+ *   if its throughput or allocations regressed beyond the tolerances below.
+ */
+static const char *kHPBenchmarkMaxCountVariable = "HP_BENCHMARK_MAX_COUNT";
+static const char *kHPBenchmarkSeedVariable = "HP_BENCHMARK_SEED";
+static const char *kHPBenchmarkOutputVariable = "HP_BENCHMARK_OUTPUT";
+static const char *kHPBenchmarkBaselineVariable = "HP_BENCHMARK_BASELINE";
+
+static const NSUInteger kHPBenchmarkDefaultMaxCount = 10000;
+static const uint64_t kHPBenchmarkDefaultSeed = 2014;
+
+/**
+ * Payloads are generated and decoded in chunks of this many items, so a million items never have
+ * to be in memory at once. Generating a chunk is not timed.
+ */
+static const NSUInteger kHPBenchmarkChunkSize = 10000;
+
+/**
+ * Small payloads are measured repeatedly until at least this many items have been processed.
+ */
+static const NSUInteger kHPBenchmarkMinimumItemCount = 10000;
+
+/**
+ * Largest fraction of throughput lost, and of allocations per item gained, against the baseline
+ * before a benchmark fails.
+ */
+static const double kHPBenchmarkThroughputTolerance = 0.2;
+static const double kHPBenchmarkAllocationTolerance = 0.1;
+
+#pragma mark - Allocation counting
+
+/**
+ * Hook that libmalloc calls after every allocation and deallocation when it is set. It is the
+ * same hook that malloc stack logging uses.
+ */
+typedef void (HPMallocLogger)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3,
+                              uintptr_t result, uint32_t frameCount);
+extern HPMallocLogger *malloc_logger;
+
+// Flags of the |type| argument of the hook.
+#define HP_MALLOC_LOG_TYPE_ALLOCATE 2
+#define HP_MALLOC_LOG_TYPE_DEALLOCATE 4
+
+// Only allocations made on this thread are counted, so other tests and threads add no noise.
+static pthread_t gHPBenchmarkThread;
+static volatile int64_t gHPBenchmarkAllocationCount;
+static volatile int64_t gHPBenchmarkAllocatedByteCount;
+
+static void HPBenchmarkMallocLogger(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3,
+                                    uintptr_t result, uint32_t frameCount) {
+  if (!(type & HP_MALLOC_LOG_TYPE_ALLOCATE) || !pthread_equal(pthread_self(), gHPBenchmarkThread)) {
+    return;
+  }
+  // A reallocation reports the old pointer in |arg2| and the new size in |arg3|.
+  uintptr_t size = (type & HP_MALLOC_LOG_TYPE_DEALLOCATE) ? arg3 : arg2;
+  OSAtomicIncrement64(&gHPBenchmarkAllocationCount);
+  OSAtomicAdd64((int64_t)size, &gHPBenchmarkAllocatedByteCount);
+}
+
+/**
+ * Time and allocations of the measured parts of one benchmark.
+ */
+typedef struct {
+  CFAbsoluteTime time;
+  int64_t allocationCount;
+  int64_t allocatedByteCount;
+} HPBenchmarkSample;
+
+static void HPBenchmarkBegin(HPBenchmarkSample *sample, CFAbsoluteTime *start) {
+  gHPBenchmarkThread = pthread_self();
+  sample->allocationCount -= gHPBenchmarkAllocationCount;
+  sample->allocatedByteCount -= gHPBenchmarkAllocatedByteCount;
+  malloc_logger = HPBenchmarkMallocLogger;
+  *start = CFAbsoluteTimeGetCurrent();
+}
+
+static void HPBenchmarkEnd(HPBenchmarkSample *sample, CFAbsoluteTime start) {
+  CFAbsoluteTime end = CFAbsoluteTimeGetCurrent();
+  malloc_logger = NULL;
+  sample->time += end - start;
+  sample->allocationCount += gHPBenchmarkAllocationCount;
+  sample->allocatedByteCount += gHPBenchmarkAllocatedByteCount;
+}
+
+/**
+ * Measures the statements that follow, up to the matching HP_BENCHMARK_END.
+ */
+#define HP_BENCHMARK_BEGIN(sample) \
+  { CFAbsoluteTime hpBenchmarkStart; HPBenchmarkBegin(&(sample), &hpBenchmarkStart);
+#define HP_BENCHMARK_END(sample) HPBenchmarkEnd(&(sample), hpBenchmarkStart); }
+
+#pragma mark -
+
+/**
+ * Measures throughput and allocations of the model layer on generated payloads of 10 items up to
+ * HP_BENCHMARK_MAX_COUNT, in three shapes: ASCII text, Unicode text and long lines. Results are
+ * appended to a JSON file after each benchmark; see the environment variables above. Apart from
+ * baseline regressions, a benchmark fails only if the code under test returns wrong results.
+ */
+@interface HPModelBenchmarks : XCTestCase
+
+@end
+
+/**
+ * Results of every benchmark in this run, in the order they finished.
+ */
+static NSMutableArray *gHPBenchmarkResults;
+
+@implementation HPModelBenchmarks {
+  uint64_t _seed;
+  NSUInteger _maxCount;
+}
+
+- (void)setUp {
+  [super setUp];
+  const char *seed = getenv(kHPBenchmarkSeedVariable);
+  _seed = seed ? strtoull(seed, NULL, 10) : kHPBenchmarkDefaultSeed;
+  const char *maxCount = getenv(kHPBenchmarkMaxCountVariable);
+  _maxCount = maxCount ? (NSUInteger)strtoul(maxCount, NULL, 10) : kHPBenchmarkDefaultMaxCount;
+  if (!gHPBenchmarkResults) {
+    gHPBenchmarkResults = [NSMutableArray array];
+  }
+}
+
+#pragma mark - Payloads
+
+/**
+ * @return Names of the payload shapes.
+ */
+- (NSArray *)profiles {
+  return @[ @"ascii", @"unicode", @"long_lines" ];
+}
+
+/**
+ * @param profile Name of a payload shape.
+ * @param authorCount Number of distinct authors.
+ * @return Dataset that generates payloads of that shape.
+ */
+- (SimulatedHaikuDataset *)datasetWithProfile:(NSString *)profile
+                                  authorCount:(NSUInteger)authorCount {
+  SimulatedHaikuDataset *dataset =
+      [[SimulatedHaikuDataset alloc] initWithAuthorCount:authorCount seed:_seed];
+  if ([profile isEqual:@"unicode"]) {
+    dataset.unicodeFraction = 1;
+  } else if ([profile isEqual:@"long_lines"]) {
+    // Mostly short lines with some very long ones, as in a feed with a few pasted paragraphs.
+    dataset.unicodeFraction = 0.2;
+    dataset.longLineFraction = 0.1;
+    dataset.longLineLength = 4000;
+  }
+  return dataset;
+}
+
+/**
+ * @return Payload sizes from 10 up to the largest configured size, by powers of ten.
+ */
+- (NSArray *)counts {
+  NSMutableArray *counts = [NSMutableArray array];
+  for (NSUInteger count = 10; count <= MIN(_maxCount, 1000000); count *= 10) {
+    [counts addObject:@(count)];
+  }
+  return counts;
+}
+
+/**
+ * Calls |block| with consecutive chunks of the items, repeating small payloads until
+ * kHPBenchmarkMinimumItemCount items have been passed.
+ *
+ * @param count Number of items in the payload.
+ * @param block Called with the range of item indexes in each chunk.
+ * @return Number of items passed to |block|.
+ */
+- (NSUInteger)enumerateChunksOfCount:(NSUInteger)count usingBlock:(void (^)(NSRange range))block {
+  NSUInteger repeatCount = MAX(kHPBenchmarkMinimumItemCount / count, 1);
+  for (NSUInteger repeat = 0; repeat < repeatCount; repeat++) {
+    for (NSUInteger location = 0; location < count; location += kHPBenchmarkChunkSize) {
+      @autoreleasepool {
+        block(NSMakeRange(location, MIN(kHPBenchmarkChunkSize, count - location)));
+      }
+    }
+  }
+  return repeatCount * count;
+}
+
+- (void)testGeneratedPayloadsDependOnlyOnSeed {
+  SimulatedHaikuDataset *dataset = [self datasetWithProfile:@"long_lines" authorCount:100];
+  SimulatedHaikuDataset *sameSeed = [self datasetWithProfile:@"long_lines" authorCount:100];
+  XCTAssertEqualObjects([dataset haikuAttributesInRange:NSMakeRange(0, 100)],
+                        [sameSeed haikuAttributesInRange:NSMakeRange(0, 100)],
+                        @"The same seed should generate the same payloads");
+  _seed++;
+  SimulatedHaikuDataset *otherSeed = [self datasetWithProfile:@"long_lines" authorCount:100];
+  XCTAssertNotEqualObjects([dataset haikuAttributesInRange:NSMakeRange(0, 100)],
+                           [otherSeed haikuAttributesInRange:NSMakeRange(0, 100)],
+                           @"Another seed should generate other payloads");
+
+  NSUInteger longLineCount = 0;
+  for (NSDictionary *attributes in [dataset haikuAttributesInRange:NSMakeRange(0, 1000)]) {
+    if ([attributes[@"line_two"] length] >= dataset.longLineLength) {
+      longLineCount++;
+    }
+  }
+  XCTAssertTrue(longLineCount > 50 && longLineCount < 150, @"About a tenth should be long");
+
+  SimulatedHaikuDataset *unicode = [self datasetWithProfile:@"unicode" authorCount:100];
+  NSString *line = [unicode haikuAttributesAtIndex:0][@"line_one"];
+  XCTAssertFalse([line canBeConvertedToEncoding:NSASCIIStringEncoding],
+                 @"Unicode payloads should not be ASCII");
+}
+
+#pragma mark - Benchmarks
+
+- (void)testBenchmarkHaikuObjectsWithAttributes {
+  [self runBenchmark:@"HPHaiku.haikuObjectsWithAttributes"
+            profiles:[self profiles]
+           withBlock:^(SimulatedHaikuDataset *dataset, NSRange range, HPBenchmarkSample *sample) {
+      NSArray *attributesArray = [dataset haikuAttributesInRange:range];
+      NSArray *haikus;
+      HP_BENCHMARK_BEGIN(*sample)
+      haikus = [HPHaiku haikuObjectsWithAttributes:attributesArray];
+      HP_BENCHMARK_END(*sample)
+      XCTAssertEqual([haikus count], range.length, @"Every haiku should be decoded");
+  }];
+}
+
+- (void)testBenchmarkHaikuInitWithAttributes {
+  [self runBenchmark:@"HPHaiku.initWithAttributes"
+            profiles:[self profiles]
+           withBlock:^(SimulatedHaikuDataset *dataset, NSRange range, HPBenchmarkSample *sample) {
+      NSArray *attributesArray = [dataset haikuAttributesInRange:range];
+      NSMutableArray *haikus = [NSMutableArray arrayWithCapacity:range.length];
+      HP_BENCHMARK_BEGIN(*sample)
+      for (NSDictionary *attributes in attributesArray) {
+        [haikus addObject:[[HPHaiku alloc] initWithAttributes:attributes]];
+      }
+      HP_BENCHMARK_END(*sample)
+      HPHaiku *haiku = [haikus lastObject];
+      XCTAssertEqualObjects(haiku.line_two, [[attributesArray lastObject] objectForKey:@"line_two"],
+                            @"Lines should be decoded unchanged");
+  }];
+}
+
+- (void)testBenchmarkUserInitWithAttributes {
+  [self runBenchmark:@"HPUser.initWithAttributes"
+            profiles:[self profiles]
+           withBlock:^(SimulatedHaikuDataset *dataset, NSRange range, HPBenchmarkSample *sample) {
+      NSMutableArray *attributesArray = [NSMutableArray arrayWithCapacity:range.length];
+      for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+        [attributesArray addObject:[dataset userAttributesAtIndex:i]];
+      }
+      NSMutableArray *users = [NSMutableArray arrayWithCapacity:range.length];
+      HP_BENCHMARK_BEGIN(*sample)
+      for (NSDictionary *attributes in attributesArray) {
+        [users addObject:[[HPUser alloc] initWithAttributes:attributes]];
+      }
+      HP_BENCHMARK_END(*sample)
+      HPUser *user = [users lastObject];
+      XCTAssertNotNil(user.last_updated, @"Dates should be decoded");
+  }];
+}
+
+- (void)testBenchmarkAttributesDictionary {
+  [self runBenchmark:@"HPHaiku.attributesDictionary"
+            profiles:[self profiles]
+           withBlock:^(SimulatedHaikuDataset *dataset, NSRange range, HPBenchmarkSample *sample) {
+      NSArray *haikus = [HPHaiku haikuObjectsWithAttributes:[dataset haikuAttributesInRange:range]];
+      NSMutableArray *attributesArray = [NSMutableArray arrayWithCapacity:range.length];
+      HP_BENCHMARK_BEGIN(*sample)
+      for (HPHaiku *haiku in haikus) {
+        [attributesArray addObject:[haiku attributesDictionary]];
+      }
+      HP_BENCHMARK_END(*sample)
+      XCTAssertEqual([attributesArray count], range.length, @"Every haiku should be encoded");
+  }];
+}
+
+- (void)testBenchmarkDateParsing {
+  [self runBenchmark:@"HPDateCodec.dateFromAPIString"
+            profiles:@[ @"ascii" ]
+           withBlock:^(SimulatedHaikuDataset *dataset, NSRange range, HPBenchmarkSample *sample) {
+      NSMutableArray *strings = [NSMutableArray arrayWithCapacity:range.length];
+      for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+        [strings addObject:[[dataset haikuAttributesAtIndex:i] objectForKey:@"creation_time"]];
+      }
+      NSMutableArray *dates = [NSMutableArray arrayWithCapacity:range.length];
+      HP_BENCHMARK_BEGIN(*sample)
+      for (NSString *string in strings) {
+        [dates addObject:[HPDateCodec dateFromAPIString:string]];
+      }
+      HP_BENCHMARK_END(*sample)
+      XCTAssertEqual([dates count], range.length, @"Every timestamp should be parsed");
+  }];
+}
+
+- (void)testBenchmarkDateFormatting {
+  [self runBenchmark:@"HPDateCodec.APIStringFromDate"
+            profiles:@[ @"ascii" ]
+           withBlock:^(SimulatedHaikuDataset *dataset, NSRange range, HPBenchmarkSample *sample) {
+      NSMutableArray *dates = [NSMutableArray arrayWithCapacity:range.length];
+      for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+        [dates addObject:[NSDate dateWithTimeIntervalSince1970:1300000000 + i * 7919]];
+      }
+      NSMutableArray *strings = [NSMutableArray arrayWithCapacity:range.length];
+      HP_BENCHMARK_BEGIN(*sample)
+      for (NSDate *date in dates) {
+        [strings addObject:[HPDateCodec APIStringFromDate:date]];
+      }
+      HP_BENCHMARK_END(*sample)
+      NSDate *parsedDate = [HPDateCodec dateFromAPIString:[strings lastObject]];
+      XCTAssertEqualObjects(parsedDate, [dates lastObject], @"Timestamps should parse back");
+  }];
+}
+
+#pragma mark - Harness
+
+/**
+ * Runs a benchmark for every payload size in each shape, then records and checks the results.
+ *
+ * @param name Name of the measured method.
+ * @param profiles Names of the payload shapes to measure. Timestamps have the same shape in all.
+ * @param block Generates the payload of a chunk and measures the method on it.
+ */
+- (void)runBenchmark:(NSString *)name
+            profiles:(NSArray *)profiles
+           withBlock:(void (^)(SimulatedHaikuDataset *dataset, NSRange range,
+                               HPBenchmarkSample *sample))block {
+  for (NSString *profile in profiles) {
+    for (NSNumber *countNumber in [self counts]) {
+      NSUInteger count = [countNumber unsignedIntegerValue];
+      // As many authors as haikus, so user payloads do not repeat either.
+      SimulatedHaikuDataset *dataset = [self datasetWithProfile:profile authorCount:count];
+      __block HPBenchmarkSample sample = { 0, 0, 0 };
+      NSUInteger itemCount = [self enumerateChunksOfCount:count usingBlock:^(NSRange range) {
+          block(dataset, range, &sample);
+      }];
+      NSDictionary *result = [self resultWithName:name
+                                          profile:profile
+                                            count:count
+                                        itemCount:itemCount
+                                           sample:sample];
+      NSLog(@"%@ %@ x%lu: %.0f items/s, %.2f allocations/item", name, profile,
+            (unsigned long)count, [result[@"items_per_second"] doubleValue],
+            [result[@"allocations_per_item"] doubleValue]);
+      [self checkResultAgainstBaseline:result];
+      [gHPBenchmarkResults addObject:result];
+    }
+  }
+  [self writeResults];
+}
+
+- (NSDictionary *)resultWithName:(NSString *)name
+                         profile:(NSString *)profile
+                           count:(NSUInteger)count
+                       itemCount:(NSUInteger)itemCount
+                          sample:(HPBenchmarkSample)sample {
+  CFAbsoluteTime time = MAX(sample.time, 1e-9);
+  return @{
+    @"name" : name,
+    @"profile" : profile,
+    @"count" : @(count),
+    @"items" : @(itemCount),
+    @"seconds" : @(sample.time),
+    @"items_per_second" : @(itemCount / time),
+    @"ns_per_item" : @(sample.time * 1e9 / itemCount),
+    @"allocations" : @(sample.allocationCount),
+    @"allocated_bytes" : @(sample.allocatedByteCount),
+    @"allocations_per_item" : @((double)sample.allocationCount / itemCount),
+    @"bytes_per_item" : @((double)sample.allocatedByteCount / itemCount)
+  };
+}
+
+/**
+ * Fails if the result is slower, or allocates more per item, than the same benchmark in the
+ * baseline file beyond the tolerances.
+ */
+- (void)checkResultAgainstBaseline:(NSDictionary *)result {
+  const char *path = getenv(kHPBenchmarkBaselineVariable);
+  if (!path) {
+    return;
+  }
+  NSData *data = [NSData dataWithContentsOfFile:[NSString stringWithUTF8String:path]];
+  NSDictionary *baseline = data ? [NSJSONSerialization JSONObjectWithData:data
+                                                                  options:0
+                                                                    error:NULL] : nil;
+  for (NSDictionary *previous in baseline[@"results"]) {
+    if (![previous[@"name"] isEqual:result[@"name"]] ||
+        ![previous[@"profile"] isEqual:result[@"profile"]] ||
+        ![previous[@"count"] isEqual:result[@"count"]]) {
+      continue;
+    }
+    double throughput = [result[@"items_per_second"] doubleValue];
+    double previousThroughput = [previous[@"items_per_second"] doubleValue];
+    XCTAssertTrue(throughput >= previousThroughput * (1 - kHPBenchmarkThroughputTolerance),
+                  @"%@ %@ x%@ throughput fell from %.0f to %.0f items/s", result[@"name"],
+                  result[@"profile"], result[@"count"], previousThroughput, throughput);
+    double allocations = [result[@"allocations_per_item"] doubleValue];
+    double previousAllocations = [previous[@"allocations_per_item"] doubleValue];
+    XCTAssertTrue(allocations <= previousAllocations * (1 + kHPBenchmarkAllocationTolerance),
+                  @"%@ %@ x%@ allocations rose from %.2f to %.2f per item", result[@"name"],
+                  result[@"profile"], result[@"count"], previousAllocations, allocations);
+  }
+}
+
+/**
+ * Writes every result so far, with what is needed to compare runs, to the results file.
+ */
+- (void)writeResults {
+  const char *outputPath = getenv(kHPBenchmarkOutputVariable);
+  NSString *path = outputPath ? [NSString stringWithUTF8String:outputPath] :
+      [NSTemporaryDirectory() stringByAppendingPathComponent:@"HPModelBenchmarks.json"];
+  UIDevice *device = [UIDevice currentDevice];
+  NSDictionary *report = @{
+    @"seed" : @(_seed),
+    @"max_count" : @(_maxCount),
+    @"date" : [HPDateCodec APIStringFromDate:[NSDate date]],
+    @"device" : [device model],
+    @"system_version" : [device systemVersion],
+    @"results" : gHPBenchmarkResults
+  };
+  NSError *error = nil;
+  NSData *data = [NSJSONSerialization dataWithJSONObject:report
+                                                 options:NSJSONWritingPrettyPrinted
+                                                   error:&error];
+  XCTAssertTrue([data writeToFile:path options:NSDataWritingAtomic error:&error],
+                @"Results should be written to %@: %@", path, error);
+}
+
+@end
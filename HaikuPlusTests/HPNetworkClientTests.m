@@ -0,0 +1,325 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "AFURLConnectionOperation.h"
+#import "HPConstants.h"
+#import "SimulatedHPNetworkClient.h"
+#import "SimulatedLatencyDistribution.h"
+#import "SimulatedNSMutableURLRequest.h"
+
+@interface HPNetworkClientTests : XCTestCase
+
+@end
+
+@implementation HPNetworkClientTests {
+  SimulatedHPNetworkClient *_network;
+  NSUInteger _decodeCount;
+}
+
+- (void)setUp {
+  [super setUp];
+  NSURL *baseURL = [NSURL URLWithString:kHPConstantsAppBaseURLString];
+  _network = [[SimulatedHPNetworkClient alloc] initWithBaseURL:baseURL];
+  [_network setDefaultHeader:@"User-Agent" value:kHPConstantsUserAgent];
+  _decodeCount = 0;
+}
+
+/**
+ * Sends a request through the simulated server, which completes synchronously. Without a
+ * completion queue, the success block is called right after decoding.
+ *
+ * @return The decoded object passed to the success block, or nil on failure.
+ */
+- (id)sendRequestWithMethod:(NSString *)method path:(NSString *)path {
+  NSMutableURLRequest *request = [_network requestWithMethod:method path:path parameters:nil];
+  __block id result = nil;
+  AFHTTPRequestOperation *op = [_network HTTPRequestOperationWithRequest:request
+      decoder:^id(id responseObject) {
+          _decodeCount++;
+          return responseObject ? [NSArray arrayWithObject:responseObject] : nil;
+      }
+      completionQueue:NULL
+      success:^(AFHTTPRequestOperation *operation, id decodedObject) {
+          result = decodedObject;
+      }
+      failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+          XCTFail(@"Request should not fail: %@", error);
+      }];
+  [_network enqueueHTTPRequestOperation:op];
+  return result;
+}
+
+- (void)testNotModifiedResponseReusesDecodedObject {
+  id first = [self sendRequestWithMethod:@"GET" path:kHPConstantsHaikusPath];
+  id second = [self sendRequestWithMethod:@"GET" path:kHPConstantsHaikusPath];
+  XCTAssertNotNil(first, @"The feed should be returned");
+  XCTAssertTrue(first == second, @"The decoded feed should be reused after 304 Not Modified");
+  XCTAssertEqual(_decodeCount, (NSUInteger)1, @"The feed should be decoded once");
+  XCTAssertEqual(_network.conditionalRequestCount, (NSUInteger)1,
+                 @"The second request should be conditional");
+  XCTAssertEqual(_network.notModifiedCount, (NSUInteger)1,
+                 @"The second request should be answered with 304 Not Modified");
+  XCTAssertTrue(_network.notModifiedBytes > 0, @"The saved bytes should be counted");
+}
+
+- (void)testChangedResourceIsDecodedAgain {
+  NSString *path = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @"TestHaikuID"];
+  NSString *votePath = [NSString stringWithFormat:kHPConstantsHaikuVoteFormatPath, @"TestHaikuID"];
+  id first = [self sendRequestWithMethod:@"GET" path:path];
+  [self sendRequestWithMethod:@"POST" path:votePath];
+  id second = [self sendRequestWithMethod:@"GET" path:path];
+  XCTAssertFalse(first == second, @"A changed haiku should be decoded again");
+  XCTAssertEqual(_network.notModifiedCount, (NSUInteger)0,
+                 @"A changed haiku should not be answered with 304 Not Modified");
+}
+
+- (void)testDifferentURLsHaveSeparateValidators {
+  NSString *path1 = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @"TestHaikuID"];
+  NSString *path2 = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @"haikuid2"];
+  [self sendRequestWithMethod:@"GET" path:path1];
+  [self sendRequestWithMethod:@"GET" path:path2];
+  XCTAssertEqual(_network.conditionalRequestCount, (NSUInteger)0,
+                 @"First requests for each URL should not be conditional");
+  XCTAssertEqual(_decodeCount, (NSUInteger)2, @"Each haiku should be decoded");
+}
+
+- (void)testDisabledConditionalRequestsAlwaysDecode {
+  _network.conditionalRequestsEnabled = NO;
+  [self sendRequestWithMethod:@"GET" path:kHPConstantsHaikusPath];
+  [self sendRequestWithMethod:@"GET" path:kHPConstantsHaikusPath];
+  XCTAssertEqual(_decodeCount, (NSUInteger)2, @"The feed should be decoded every time");
+  XCTAssertEqual(_network.notModifiedCount, (NSUInteger)0,
+                 @"No request should be answered with 304 Not Modified");
+}
+
+- (void)testRemovedValidatorsAreNotSent {
+  [self sendRequestWithMethod:@"GET" path:kHPConstantsHaikusPath];
+  [_network removeAllValidators];
+  [self sendRequestWithMethod:@"GET" path:kHPConstantsHaikusPath];
+  XCTAssertEqual(_network.conditionalRequestCount, (NSUInteger)0,
+                 @"Requests should not be conditional after validators are removed");
+}
+
+#pragma mark - Streaming
+
+/**
+ * Streams the feed through the simulated server, which completes synchronously.
+ *
+ * @param parameters Request parameters, or nil.
+ * @param elements Array that receives the streamed elements.
+ * @return The envelope passed to the success block, or nil on failure.
+ */
+- (id)streamFeedWithParameters:(NSDictionary *)parameters elements:(NSMutableArray *)elements {
+  NSMutableURLRequest *request = [_network requestWithMethod:@"GET"
+                                                        path:kHPConstantsHaikusPath
+                                                  parameters:parameters];
+  __block id result = nil;
+  AFHTTPRequestOperation *op = [_network streamingRequestOperationWithRequest:request
+      itemsKey:kHPConstantsPageItemsKey
+      elementDecoder:nil
+      completionQueue:NULL
+      element:^(id element) {
+          XCTAssertNil(result, @"Elements should be handed over before the success block");
+          [elements addObject:element];
+      }
+      success:^(AFHTTPRequestOperation *operation, id envelope) {
+          result = envelope;
+      }
+      failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+          XCTFail(@"Request should not fail: %@", error);
+      }];
+  [_network enqueueHTTPRequestOperation:op];
+  return result;
+}
+
+- (void)testStreamedFeedMatchesDecodedFeed {
+  _network.syntheticHaikuCount = 500;
+  _network.streamChunkLength = 100;
+  NSArray *feed = [[self sendRequestWithMethod:@"GET" path:kHPConstantsHaikusPath] firstObject];
+  NSMutableArray *elements = [NSMutableArray array];
+  id envelope = [self streamFeedWithParameters:nil elements:elements];
+  XCTAssertEqualObjects(envelope, @[], @"The envelope of an array feed should be empty");
+  XCTAssertEqualObjects(elements, feed, @"Every haiku should be streamed in order");
+  XCTAssertEqual(_network.conditionalRequestCount, (NSUInteger)0,
+                 @"Streamed requests should not be conditional");
+}
+
+- (void)testStreamedPageKeepsCursor {
+  _network.syntheticHaikuCount = 100;
+  NSMutableArray *elements = [NSMutableArray array];
+  NSDictionary *parameters = @{ kHPConstantsPageSizeParameter : @10 };
+  NSDictionary *envelope = [self streamFeedWithParameters:parameters elements:elements];
+  XCTAssertEqual([elements count], (NSUInteger)10, @"The page should be streamed");
+  XCTAssertEqualObjects([envelope objectForKey:kHPConstantsPageItemsKey], @[],
+                        @"The envelope should not keep the haikus");
+  XCTAssertNotNil([envelope objectForKey:kHPConstantsPageNextCursorKey],
+                  @"The envelope should keep the cursor");
+}
+
+#pragma mark - Simulated network conditions
+
+/**
+ * Sends a GET request that may complete later.
+ *
+ * @param request The request.
+ * @param completion Called on the main queue with the operation and the error, if any.
+ */
+- (void)sendRequest:(NSMutableURLRequest *)request
+         completion:(void (^)(AFHTTPRequestOperation *operation, NSError *error))completion {
+  AFHTTPRequestOperation *op = [_network HTTPRequestOperationWithRequest:request
+      decoder:nil
+      completionQueue:dispatch_get_main_queue()
+      success:^(AFHTTPRequestOperation *operation, id decodedObject) {
+          completion(operation, nil);
+      }
+      failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+          completion(operation, error);
+      }];
+  [_network enqueueHTTPRequestOperation:op];
+}
+
+- (void)testAsynchronousDeliveryWaitsForLatency {
+  _network.deliversAsynchronously = YES;
+  SimulatedLatencyDistribution *latency =
+      [SimulatedLatencyDistribution distributionWithConstantLatency:0.1];
+  [_network setLatencyDistribution:latency forEndpoint:kHPConstantsHaikusEndpoint];
+  NSMutableURLRequest *request = [_network requestWithMethod:@"GET"
+                                                        path:kHPConstantsHaikusPath
+                                                  parameters:nil];
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  __block CFAbsoluteTime end = 0;
+  [self sendRequest:request completion:^(AFHTTPRequestOperation *operation, NSError *error) {
+      XCTAssertNil(error, @"Request should not fail");
+      XCTAssertTrue([NSThread isMainThread], @"Completion should be on its queue");
+      end = CFAbsoluteTimeGetCurrent();
+  }];
+  XCTAssertEqual(end, (CFAbsoluteTime)0, @"Request should not complete before it returns");
+  [self waitForCondition:^BOOL { return end > 0; }];
+  XCTAssertTrue(end - start >= 0.1, @"Response should wait for the latency");
+}
+
+- (void)testSlowResponseTimesOut {
+  _network.deliversAsynchronously = YES;
+  _network.defaultLatencyDistribution =
+      [SimulatedLatencyDistribution distributionWithConstantLatency:1];
+  NSMutableURLRequest *request = [_network requestWithMethod:@"GET"
+                                                        path:kHPConstantsHaikusPath
+                                                  parameters:nil];
+  [request setTimeoutInterval:0.1];
+  __block NSError *requestError = nil;
+  [self sendRequest:request completion:^(AFHTTPRequestOperation *operation, NSError *error) {
+      requestError = error;
+  }];
+  [self waitForCondition:^BOOL { return requestError != nil; }];
+  XCTAssertEqualObjects([requestError domain], NSURLErrorDomain, @"Request should time out");
+  XCTAssertEqual([requestError code], (NSInteger)NSURLErrorTimedOut, @"Request should time out");
+  XCTAssertEqual(_network.timedOutRequestCount, (NSUInteger)1, @"Timeout should be counted");
+}
+
+- (void)testBandwidthLimitsTransferTime {
+  _network.deliversAsynchronously = YES;
+  _network.syntheticHaikuCount = 200;
+  NSMutableURLRequest *request = [_network requestWithMethod:@"GET"
+                                                        path:kHPConstantsHaikusPath
+                                                  parameters:nil];
+  // The body should take about 0.2 seconds to send.
+  _network.bandwidth = [((SimulatedNSMutableURLRequest *)request).body length] / 0.2;
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  __block CFAbsoluteTime end = 0;
+  [self sendRequest:request completion:^(AFHTTPRequestOperation *operation, NSError *error) {
+      XCTAssertNil(error, @"Request should not fail");
+      end = CFAbsoluteTimeGetCurrent();
+  }];
+  [self waitForCondition:^BOOL { return end > 0; }];
+  XCTAssertTrue(end - start >= 0.15, @"Body should be sent at the bandwidth limit");
+}
+
+- (void)testThrottledResponseCarriesRetryAfter {
+  _network.throttleRate = 1;
+  _network.throttleRetryAfter = @"3";
+  NSMutableURLRequest *request = [_network requestWithMethod:@"GET"
+                                                        path:kHPConstantsHaikusPath
+                                                  parameters:nil];
+  __block NSHTTPURLResponse *response = nil;
+  [self sendRequest:request completion:^(AFHTTPRequestOperation *operation, NSError *error) {
+      XCTAssertNotNil(error, @"Request should fail");
+      response = [operation response];
+  }];
+  [self waitForCondition:^BOOL { return response != nil; }];
+  XCTAssertEqual([response statusCode], (NSInteger)429, @"Request should be throttled");
+  XCTAssertEqualObjects([[response allHeaderFields] objectForKey:@"Retry-After"], @"3",
+                        @"Response should say when to retry");
+}
+
+- (void)testMidStreamFailureDeliversPartialFeed {
+  _network.syntheticHaikuCount = 100;
+  _network.streamChunkLength = 100;
+  NSMutableURLRequest *request = [_network requestWithMethod:@"GET"
+                                                        path:kHPConstantsHaikusPath
+                                                  parameters:nil];
+  NSUInteger bodyLength = [((SimulatedNSMutableURLRequest *)request).body length];
+  NSError *lostError = [NSError errorWithDomain:NSURLErrorDomain
+                                           code:NSURLErrorNetworkConnectionLost
+                                       userInfo:nil];
+  [_network injectFailureAfterByteCount:bodyLength / 2 error:lostError];
+  NSMutableArray *elements = [NSMutableArray array];
+  __block NSError *streamError = nil;
+  AFHTTPRequestOperation *op = [_network streamingRequestOperationWithRequest:request
+      itemsKey:kHPConstantsPageItemsKey
+      elementDecoder:nil
+      completionQueue:NULL
+      element:^(id element) {
+          [elements addObject:element];
+      }
+      success:^(AFHTTPRequestOperation *operation, id envelope) {
+          XCTFail(@"Request should not succeed");
+      }
+      failure:^(AFHTTPRequestOperation *operation, NSError *error) {
+          streamError = error;
+      }];
+  [_network enqueueHTTPRequestOperation:op];
+  XCTAssertEqualObjects(streamError, lostError, @"Request should fail with the injected error");
+  XCTAssertTrue([elements count] > 0 && [elements count] < 102,
+                @"Only the haikus before the failure should be streamed");
+}
+
+- (void)testLatencyDistributionMatchesPercentiles {
+  SimulatedLatencyDistribution *distribution =
+      [SimulatedLatencyDistribution distributionWithMinimum:0.02 median:0.1 percentile99:1];
+  XCTAssertEqualWithAccuracy([distribution latencyForStandardNormalValue:0], 0.1, 0.0001,
+                             @"The middle of the distribution should be the median");
+  XCTAssertEqualWithAccuracy([distribution latencyForStandardNormalValue:2.326348], 1, 0.0001,
+                             @"The tail should reach the 99th percentile");
+  XCTAssertTrue([distribution latencyForStandardNormalValue:-10] >= 0.02,
+                @"No latency should be below the minimum");
+}
+
+/**
+ * Asynchronous responses are delivered on the main queue, so run the main run loop until the
+ * condition holds or a timeout passes.
+ */
+- (void)waitForCondition:(BOOL (^)(void))condition {
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!condition() && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+}
+
+@end
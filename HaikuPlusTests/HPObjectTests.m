@@ -0,0 +1,389 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+#import <objc/runtime.h>
+
+#import "HPDateCodec.h"
+#import "HPHaiku.h"
+#import "HPObject.h"
+#import "HPUser.h"
+
+/**
+ * Number of haikus decoded and encoded by the benchmark.
+ */
+static const NSUInteger kHPObjectBenchmarkCount = 100000;
+
+/**
+ * Model with one property of each supported kind.
+ */
+@interface HPTestObject : HPObject
+
+@property(nonatomic, strong) NSString *name;
+@property(nonatomic, strong) NSNumber *score;
+@property(nonatomic, strong) NSDate *date;
+@property(nonatomic, strong) HPUser *user;
+@property(nonatomic, strong) NSArray *tags;
+@property(nonatomic) NSInteger total;
+@property(nonatomic) double ratio;
+@property(nonatomic, getter=isEnabled) BOOL enabled;
+@property(nonatomic, readonly) NSString *summary;
+
+@end
+
+@implementation HPTestObject
+
+- (NSString *)summary {
+  return [NSString stringWithFormat:@"%@ %ld", _name, (long)_total];
+}
+
+@end
+
+/**
+ * Subclass that adds a property to an inherited schema.
+ */
+@interface HPTestSubobject : HPTestObject
+
+@property(nonatomic, strong) NSString *extra;
+
+@end
+
+@implementation HPTestSubobject
+
+@end
+
+#pragma mark - Reflection baseline
+
+/**
+ * The HPObject implementation before schemas, kept as a baseline for the benchmark. It decodes
+ * with key-value coding and encodes by copying the property list on every call.
+ */
+@interface HPReflectionObject : NSObject
+
+@property(nonatomic, strong) NSString *identifier;
+
+- (id)initWithAttributes:(NSDictionary *)attributes;
+- (NSDictionary *)attributesDictionary;
+
+@end
+
+@implementation HPReflectionObject
+
+- (id)initWithAttributes:(NSDictionary *)attributes {
+  self = [super init];
+  if (!self) {
+    return nil;
+  }
+  if (!attributes) {
+    return nil;
+  }
+  [self setValuesForKeysWithDictionary:attributes];
+  return self;
+}
+
+- (NSDictionary *)attributesDictionary {
+  NSMutableArray *propertyNames = [NSMutableArray array];
+  unsigned int outCount, i;
+  objc_property_t *properties = class_copyPropertyList([self class], &outCount);
+  for (i = 0; i < outCount; i++) {
+    NSString *propertyName = [NSString stringWithUTF8String:property_getName(properties[i])];
+    if ([propertyName isEqual:@"identifier"]) {
+      [propertyNames addObject:@"id"];
+    } else {
+      [propertyNames addObject:propertyName];
+    }
+  }
+  free(properties);
+  return [self dictionaryWithValuesForKeys:propertyNames];
+}
+
+- (void)setValue:(id)value forUndefinedKey:(NSString *)key {
+  if ([key isEqual:@"id"]) {
+    _identifier = value;
+  } else {
+    [super setValue:value forUndefinedKey:key];
+  }
+}
+
+- (id)valueForUndefinedKey:(NSString *)key {
+  if ([key isEqual:@"id"]) {
+    return _identifier;
+  } else {
+    return [super valueForUndefinedKey:key];
+  }
+}
+
+@end
+
+@interface HPReflectionUser : HPReflectionObject
+
+@property(nonatomic, strong) NSString *identifier;
+@property(nonatomic, strong) NSString *google_plus_id;
+@property(nonatomic, strong) NSString *google_display_name;
+@property(nonatomic, strong) NSString *google_photo_url;
+@property(nonatomic, strong) NSString *google_profile_url;
+@property(nonatomic, strong) NSDate *last_updated;
+
+@end
+
+@implementation HPReflectionUser
+
+- (void)setValue:(id)value forKey:(NSString *)key {
+  if ([key isEqual:@"last_updated"]) {
+    _last_updated = [HPDateCodec dateFromAPIString:value];
+  } else {
+    [super setValue:value forKey:key];
+  }
+}
+
+- (id)valueForKey:(NSString *)key {
+  if ([key isEqual:@"last_updated"]) {
+    return [HPDateCodec APIStringFromDate:_last_updated];
+  } else {
+    return [super valueForKey:key];
+  }
+}
+
+@end
+
+@interface HPReflectionHaiku : HPReflectionObject
+
+@property(nonatomic, strong) NSString *identifier;
+@property(nonatomic, strong) HPReflectionUser *author;
+@property(nonatomic, strong) NSString *title;
+@property(nonatomic, strong) NSString *line_one;
+@property(nonatomic, strong) NSString *line_two;
+@property(nonatomic, strong) NSString *line_three;
+@property(nonatomic, strong) NSString *content_url;
+@property(nonatomic, strong) NSString *content_deep_link_id;
+@property(nonatomic, strong) NSString *call_to_action_url;
+@property(nonatomic, strong) NSString *call_to_action_deep_link_id;
+@property(nonatomic) NSInteger votes;
+@property(nonatomic, strong) NSDate *creation_time;
+
+@end
+
+@implementation HPReflectionHaiku
+
+- (void)setValue:(id)value forKey:(NSString *)key {
+  if ([key isEqual:@"creation_time"]) {
+    _creation_time = [HPDateCodec dateFromAPIString:value];
+  } else if ([key isEqual:@"author"]) {
+    _author = [[HPReflectionUser alloc] initWithAttributes:value];
+  } else {
+    [super setValue:value forKey:key];
+  }
+}
+
+- (id)valueForKey:(NSString *)key {
+  if ([key isEqual:@"creation_time"]) {
+    return [HPDateCodec APIStringFromDate:_creation_time];
+  } else if ([key isEqual:@"author"]) {
+    return [_author attributesDictionary];
+  } else {
+    return [super valueForKey:key];
+  }
+}
+
+@end
+
+#pragma mark - Tests
+
+@interface HPObjectTests : XCTestCase
+
+@end
+
+@implementation HPObjectTests
+
+- (void)testCoercesValuesToPropertyTypes {
+  NSDictionary *attributes = @{
+    @"id" : @42,
+    @"name" : @"name",
+    @"score" : @"2.5",
+    @"date" : @"2014-02-05T19:24:38+0000",
+    @"user" : @{ @"id" : @"userid", @"google_display_name" : @"display" },
+    @"tags" : @[ @"a", @"b" ],
+    @"total" : @"67",
+    @"ratio" : @"0.25",
+    @"enabled" : @"true"
+  };
+  HPTestObject *object = [[HPTestObject alloc] initWithAttributes:attributes];
+  XCTAssertEqualObjects(object.identifier, @"42", @"Numeric ID should become a string");
+  XCTAssertEqualObjects(object.name, @"name", @"Name must match");
+  XCTAssertEqualObjects(object.score, @2.5, @"Numeric string should become a number");
+  XCTAssertEqualObjects(object.date, [NSDate dateWithTimeIntervalSince1970:1391628278],
+                        @"Timestamp should become a date");
+  XCTAssertEqualObjects(object.user.identifier, @"userid", @"Nested model should be decoded");
+  XCTAssertEqualObjects(object.user.google_display_name, @"display",
+                        @"Nested model should be decoded");
+  XCTAssertEqualObjects(object.tags, (@[ @"a", @"b" ]), @"Other objects should pass through");
+  XCTAssertEqual(object.total, (NSInteger)67, @"Numeric string should become an integer");
+  XCTAssertEqualWithAccuracy(object.ratio, 0.25, 1e-9, @"Numeric string should become a double");
+  XCTAssertTrue(object.enabled, @"String should become a BOOL");
+}
+
+- (void)testNullAndMismatchedValuesClearProperties {
+  NSDictionary *attributes = @{
+    @"name" : [NSNull null],
+    @"date" : @"yesterday",
+    @"user" : @"userid",
+    @"tags" : [NSNull null],
+    @"total" : [NSNull null],
+    @"unknown" : @"ignored"
+  };
+  HPTestObject *object = [[HPTestObject alloc] initWithAttributes:attributes];
+  XCTAssertNotNil(object, @"Unknown keys should be ignored");
+  XCTAssertNil(object.name, @"NSNull should clear a string");
+  XCTAssertNil(object.date, @"Invalid timestamp should clear a date");
+  XCTAssertNil(object.user, @"String should not become a model");
+  XCTAssertNil(object.tags, @"NSNull should clear an object");
+  XCTAssertEqual(object.total, (NSInteger)0, @"NSNull should clear an integer");
+}
+
+- (void)testNonDictionaryAttributesGiveNil {
+  XCTAssertNil([[HPTestObject alloc] initWithAttributes:(NSDictionary *)@[]],
+               @"Arrays should not be decoded");
+}
+
+- (void)testAttributesDictionaryEncodesEveryProperty {
+  HPTestObject *object = [[HPTestObject alloc] initWithAttributes:@{
+    @"id" : @"objectid",
+    @"name" : @"name",
+    @"date" : @"2014-02-05T19:24:38+0000",
+    @"user" : @{ @"id" : @"userid" },
+    @"total" : @67,
+    @"enabled" : @YES
+  }];
+  NSDictionary *attributes = [object attributesDictionary];
+  XCTAssertEqualObjects(attributes[@"id"], @"objectid", @"Identifier should be encoded as id");
+  XCTAssertNil(attributes[@"identifier"], @"Identifier should not be encoded by name");
+  XCTAssertEqualObjects(attributes[@"name"], @"name", @"Name must match");
+  XCTAssertEqualObjects(attributes[@"date"], @"2014-02-05T19:24:38+0000",
+                        @"Date should be encoded as a timestamp");
+  XCTAssertEqualObjects(attributes[@"user"][@"id"], @"userid", @"Model should be encoded");
+  XCTAssertEqualObjects(attributes[@"total"], @67, @"Integer should be encoded as a number");
+  XCTAssertEqualObjects(attributes[@"enabled"], @YES, @"BOOL should be encoded as a number");
+  XCTAssertEqualObjects(attributes[@"score"], [NSNull null], @"Missing values should be NSNull");
+  XCTAssertEqualObjects(attributes[@"summary"], @"name 67",
+                        @"Readonly properties should be encoded");
+}
+
+- (void)testSubclassInheritsSchema {
+  HPTestSubobject *object = [[HPTestSubobject alloc] initWithAttributes:@{
+    @"id" : @"objectid",
+    @"name" : @"name",
+    @"extra" : @"extra"
+  }];
+  XCTAssertEqualObjects(object.identifier, @"objectid", @"Inherited ID must match");
+  XCTAssertEqualObjects(object.name, @"name", @"Inherited property must match");
+  XCTAssertEqualObjects(object.extra, @"extra", @"Subclass property must match");
+  XCTAssertEqualObjects([object attributesDictionary][@"name"], @"name",
+                        @"Inherited property should be encoded");
+}
+
+- (void)testIdentifierIsAvailableThroughKeyValueCoding {
+  HPTestObject *object = [[HPTestObject alloc] initWithAttributes:@{}];
+  [object setValue:@"objectid" forKey:@"id"];
+  XCTAssertEqualObjects([object valueForKey:@"id"], @"objectid", @"ID should map to identifier");
+}
+
+#pragma mark - Benchmark
+
+/**
+ * @return Attributes of distinct haikus shaped like server responses.
+ */
+- (NSArray *)benchmarkAttributes {
+  NSMutableArray *array = [NSMutableArray arrayWithCapacity:kHPObjectBenchmarkCount];
+  for (NSUInteger i = 0; i < kHPObjectBenchmarkCount; i++) {
+    NSDate *date = [NSDate dateWithTimeIntervalSince1970:1380000000 + i * 61];
+    NSString *timestamp = [HPDateCodec APIStringFromDate:date];
+    [array addObject:@{
+      @"id" : [NSString stringWithFormat:@"haiku%lu", (unsigned long)i],
+      @"author" : @{
+        @"id" : [NSString stringWithFormat:@"user%lu", (unsigned long)(i % 100)],
+        @"google_plus_id" : @"112233445566778899000",
+        @"google_display_name" : @"Haiku Author",
+        @"google_photo_url" : @"https://example.com/photo.jpg",
+        @"google_profile_url" : @"https://plus.google.com/112233445566778899000",
+        @"last_updated" : timestamp
+      },
+      @"title" : [NSString stringWithFormat:@"Haiku %lu", (unsigned long)i],
+      @"line_one" : @"An old silent pond",
+      @"line_two" : @"A frog jumps into the pond",
+      @"line_three" : @"Splash! Silence again.",
+      @"content_url" : @"https://example.com/haikus/1",
+      @"content_deep_link_id" : @"/haikus/1",
+      @"call_to_action_url" : @"https://example.com/haikus/1?action=vote",
+      @"call_to_action_deep_link_id" : @"/haikus/1?action=vote",
+      @"votes" : [NSString stringWithFormat:@"%lu", (unsigned long)(i % 1000)],
+      @"creation_time" : timestamp
+    }];
+  }
+  return array;
+}
+
+/**
+ * Decodes and encodes the same haikus through the schema and through the reflection baseline.
+ * Timings are logged; the test fails only if the two paths disagree.
+ */
+- (void)testBenchmarkSchemaAgainstReflection {
+  NSArray *attributesArray = [self benchmarkAttributes];
+
+  NSArray *haikus;
+  NSMutableArray *schemaAttributes = [NSMutableArray arrayWithCapacity:[attributesArray count]];
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  @autoreleasepool {
+    haikus = [HPHaiku haikuObjectsWithAttributes:attributesArray];
+  }
+  CFAbsoluteTime schemaDecodeTime = CFAbsoluteTimeGetCurrent() - start;
+  start = CFAbsoluteTimeGetCurrent();
+  @autoreleasepool {
+    for (HPHaiku *haiku in haikus) {
+      [schemaAttributes addObject:[haiku attributesDictionary]];
+    }
+  }
+  CFAbsoluteTime schemaEncodeTime = CFAbsoluteTimeGetCurrent() - start;
+
+  NSMutableArray *reflectionHaikus = [NSMutableArray arrayWithCapacity:[attributesArray count]];
+  NSMutableArray *reflectionAttributes =
+      [NSMutableArray arrayWithCapacity:[attributesArray count]];
+  start = CFAbsoluteTimeGetCurrent();
+  @autoreleasepool {
+    for (NSDictionary *attributes in attributesArray) {
+      [reflectionHaikus addObject:[[HPReflectionHaiku alloc] initWithAttributes:attributes]];
+    }
+  }
+  CFAbsoluteTime reflectionDecodeTime = CFAbsoluteTimeGetCurrent() - start;
+  start = CFAbsoluteTimeGetCurrent();
+  @autoreleasepool {
+    for (HPReflectionHaiku *haiku in reflectionHaikus) {
+      [reflectionAttributes addObject:[haiku attributesDictionary]];
+    }
+  }
+  CFAbsoluteTime reflectionEncodeTime = CFAbsoluteTimeGetCurrent() - start;
+
+  NSLog(@"%lu haikus: schema decode %.0f ms, encode %.0f ms; "
+        @"reflection decode %.0f ms, encode %.0f ms",
+        (unsigned long)[attributesArray count], schemaDecodeTime * 1000,
+        schemaEncodeTime * 1000, reflectionDecodeTime * 1000, reflectionEncodeTime * 1000);
+
+  XCTAssertEqual([haikus count], [reflectionHaikus count], @"Both paths should decode every haiku");
+  XCTAssertEqualObjects(schemaAttributes, reflectionAttributes,
+                        @"Both paths should encode the same attributes");
+}
+
+@end
@@ -0,0 +1,235 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPRequestScheduler.h"
+
+@interface HPRequestSchedulerTests : XCTestCase
+
+@end
+
+@implementation HPRequestSchedulerTests {
+  NSOperationQueue *_queue;
+  HPRequestScheduler *_scheduler;
+}
+
+- (void)setUp {
+  [super setUp];
+  _queue = [[NSOperationQueue alloc] init];
+  _scheduler = [[HPRequestScheduler alloc] initWithExecutionQueue:_queue];
+}
+
+/**
+ * @return Operation that runs until the semaphore is signaled.
+ */
+- (NSOperation *)operationWaitingForSemaphore:(dispatch_semaphore_t)semaphore {
+  return [NSBlockOperation blockOperationWithBlock:^{
+      dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+  }];
+}
+
+/**
+ * Waits up to 5 seconds for a condition to hold.
+ */
+- (BOOL)waitForCondition:(BOOL (^)(void))condition {
+  NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!condition()) {
+    if ([deadline timeIntervalSinceNow] < 0) {
+      return NO;
+    }
+    [NSThread sleepForTimeInterval:0.005];
+  }
+  return YES;
+}
+
+- (BOOL)waitUntilIdle {
+  return [self waitForCondition:^BOOL{
+      for (HPRequestPriority priority = HPRequestPriorityInteractive;
+           priority <= HPRequestPriorityPrefetch; priority++) {
+        HPRequestStatistics *statistics = [_scheduler statisticsForPriority:priority];
+        if (statistics.pendingCount > 0 || statistics.runningCount > 0) {
+          return NO;
+        }
+      }
+      return YES;
+  }];
+}
+
+- (void)testDefaultLimits {
+  XCTAssertEqual([_scheduler maxConcurrentOperationCountForPriority:HPRequestPriorityInteractive],
+                 (NSUInteger)4);
+  XCTAssertEqual([_scheduler maxConcurrentOperationCountForPriority:HPRequestPriorityVisible],
+                 (NSUInteger)4);
+  XCTAssertEqual([_scheduler maxConcurrentOperationCountForPriority:HPRequestPriorityPrefetch],
+                 (NSUInteger)2);
+}
+
+- (void)testNilOperationDoesNothing {
+  [_scheduler addOperation:nil priority:HPRequestPriorityInteractive];
+  HPRequestStatistics *statistics = [_scheduler statisticsForPriority:HPRequestPriorityInteractive];
+  XCTAssertEqual(statistics.pendingCount, (NSUInteger)0);
+  XCTAssertEqual(statistics.startedCount, (NSUInteger)0);
+}
+
+- (void)testClassLimitCapsRunningOperations {
+  dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+  for (int i = 0; i < 5; i++) {
+    [_scheduler addOperation:[self operationWaitingForSemaphore:semaphore]
+                    priority:HPRequestPriorityPrefetch];
+  }
+  HPRequestStatistics *statistics = [_scheduler statisticsForPriority:HPRequestPriorityPrefetch];
+  XCTAssertEqual(statistics.runningCount, (NSUInteger)2);
+  XCTAssertEqual(statistics.pendingCount, (NSUInteger)3);
+  XCTAssertEqual(statistics.maxPendingCount, (NSUInteger)3);
+  XCTAssertEqual(statistics.heldBackCount, (NSUInteger)0);
+
+  for (int i = 0; i < 5; i++) {
+    dispatch_semaphore_signal(semaphore);
+  }
+  XCTAssertTrue([self waitUntilIdle]);
+  statistics = [_scheduler statisticsForPriority:HPRequestPriorityPrefetch];
+  XCTAssertEqual(statistics.startedCount, (NSUInteger)5);
+}
+
+- (void)testLowerClassesWaitForInteractiveWork {
+  dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+  NSMutableArray *order = [NSMutableArray array];
+  NSOperation *vote = [NSBlockOperation blockOperationWithBlock:^{
+      dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+      @synchronized(order) {
+        [order addObject:@"vote"];
+      }
+  }];
+  NSOperation *avatar = [NSBlockOperation blockOperationWithBlock:^{
+      @synchronized(order) {
+        [order addObject:@"avatar"];
+      }
+  }];
+  NSOperation *nextPage = [NSBlockOperation blockOperationWithBlock:^{
+      @synchronized(order) {
+        [order addObject:@"nextPage"];
+      }
+  }];
+  [_scheduler addOperation:vote priority:HPRequestPriorityInteractive];
+  [_scheduler addOperation:nextPage priority:HPRequestPriorityPrefetch];
+  [_scheduler addOperation:avatar priority:HPRequestPriorityVisible];
+
+  // Nothing else starts while the vote is running.
+  [NSThread sleepForTimeInterval:0.05];
+  XCTAssertFalse([avatar isExecuting] || [avatar isFinished]);
+  XCTAssertFalse([nextPage isExecuting] || [nextPage isFinished]);
+  XCTAssertEqual([_scheduler statisticsForPriority:HPRequestPriorityVisible].heldBackCount,
+                 (NSUInteger)1);
+  XCTAssertEqual([_scheduler statisticsForPriority:HPRequestPriorityPrefetch].heldBackCount,
+                 (NSUInteger)1);
+
+  dispatch_semaphore_signal(semaphore);
+  XCTAssertTrue([self waitUntilIdle]);
+  XCTAssertEqual([order count], (NSUInteger)3);
+  XCTAssertEqualObjects([order firstObject], @"vote");
+}
+
+- (void)testPrefetchRunsAlongsideVisibleWork {
+  dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+  NSOperation *avatar = [self operationWaitingForSemaphore:semaphore];
+  NSOperation *nextPage = [self operationWaitingForSemaphore:semaphore];
+  [_scheduler addOperation:avatar priority:HPRequestPriorityVisible];
+  [_scheduler addOperation:nextPage priority:HPRequestPriorityPrefetch];
+
+  // Avatars downloading during a scroll must not starve the next page.
+  XCTAssertTrue([self waitForCondition:^BOOL {
+      return [avatar isExecuting] && [nextPage isExecuting];
+  }]);
+  XCTAssertEqual([_scheduler statisticsForPriority:HPRequestPriorityVisible].runningCount,
+                 (NSUInteger)1);
+  XCTAssertEqual([_scheduler statisticsForPriority:HPRequestPriorityPrefetch].runningCount,
+                 (NSUInteger)1);
+  XCTAssertEqual([_scheduler statisticsForPriority:HPRequestPriorityPrefetch].heldBackCount,
+                 (NSUInteger)0);
+
+  dispatch_semaphore_signal(semaphore);
+  dispatch_semaphore_signal(semaphore);
+  XCTAssertTrue([self waitUntilIdle]);
+}
+
+- (void)testOperationsOfOneClassStartInOrder {
+  [_scheduler setMaxConcurrentOperationCount:1 forPriority:HPRequestPriorityVisible];
+  dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+  [_scheduler addOperation:[self operationWaitingForSemaphore:semaphore]
+                  priority:HPRequestPriorityVisible];
+  NSMutableArray *order = [NSMutableArray array];
+  for (NSUInteger i = 0; i < 10; i++) {
+    [_scheduler addOperation:[NSBlockOperation blockOperationWithBlock:^{
+        @synchronized(order) {
+          [order addObject:@(i)];
+        }
+    }] priority:HPRequestPriorityVisible];
+  }
+  dispatch_semaphore_signal(semaphore);
+  XCTAssertTrue([self waitUntilIdle]);
+  NSArray *expected = @[ @0, @1, @2, @3, @4, @5, @6, @7, @8, @9 ];
+  XCTAssertEqualObjects(order, expected);
+}
+
+- (void)testRaisingLimitStartsWaitingOperations {
+  [_scheduler setMaxConcurrentOperationCount:1 forPriority:HPRequestPriorityPrefetch];
+  dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+  for (int i = 0; i < 3; i++) {
+    [_scheduler addOperation:[self operationWaitingForSemaphore:semaphore]
+                    priority:HPRequestPriorityPrefetch];
+  }
+  XCTAssertEqual([_scheduler statisticsForPriority:HPRequestPriorityPrefetch].runningCount,
+                 (NSUInteger)1);
+  [_scheduler setMaxConcurrentOperationCount:3 forPriority:HPRequestPriorityPrefetch];
+  XCTAssertEqual([_scheduler statisticsForPriority:HPRequestPriorityPrefetch].runningCount,
+                 (NSUInteger)3);
+  for (int i = 0; i < 3; i++) {
+    dispatch_semaphore_signal(semaphore);
+  }
+  XCTAssertTrue([self waitUntilIdle]);
+}
+
+- (void)testWaitTimeIsRecorded {
+  dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+  [_scheduler addOperation:[self operationWaitingForSemaphore:semaphore]
+                  priority:HPRequestPriorityInteractive];
+  [_scheduler addOperation:[NSBlockOperation blockOperationWithBlock:^{}]
+                  priority:HPRequestPriorityVisible];
+  [NSThread sleepForTimeInterval:0.05];
+  dispatch_semaphore_signal(semaphore);
+  XCTAssertTrue([self waitUntilIdle]);
+
+  HPRequestStatistics *interactive =
+      [_scheduler statisticsForPriority:HPRequestPriorityInteractive];
+  HPRequestStatistics *visible = [_scheduler statisticsForPriority:HPRequestPriorityVisible];
+  XCTAssertEqual(interactive.startedCount, (NSUInteger)1);
+  XCTAssertEqual(visible.startedCount, (NSUInteger)1);
+  XCTAssertTrue(interactive.maxWaitTime < 0.05);
+  XCTAssertTrue(visible.maxWaitTime >= 0.05);
+  XCTAssertEqualWithAccuracy(visible.averageWaitTime, visible.maxWaitTime, 0.0001);
+}
+
+- (void)testCancelledOperationStillFinishes {
+  NSOperation *operation = [NSBlockOperation blockOperationWithBlock:^{}];
+  [operation cancel];
+  [_scheduler addOperation:operation priority:HPRequestPriorityInteractive];
+  XCTAssertTrue([self waitUntilIdle]);
+  XCTAssertTrue([operation isFinished]);
+}
+
+@end
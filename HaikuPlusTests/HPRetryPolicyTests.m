@@ -0,0 +1,231 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "AFURLConnectionOperation.h"
+#import "HPCommunicator.h"
+#import "HPConstants.h"
+#import "HPHaiku.h"
+#import "HPRetryPolicy.h"
+#import "SimulatedHPNetworkClient.h"
+
+@interface HPRetryPolicyTests : XCTestCase
+
+@end
+
+@implementation HPRetryPolicyTests {
+  HPRetryPolicy *_policy;
+  NSURL *_baseURL;
+}
+
+- (void)setUp {
+  [super setUp];
+  _policy = [[HPRetryPolicy alloc] init];
+  // Without jitter the delays are predictable.
+  _policy.jitter = 0;
+  _policy.initialBackoff = 0.01;
+  _policy.maxBackoff = 0.04;
+  _baseURL = [NSURL URLWithString:kHPConstantsAppBaseURLString];
+}
+
+- (NSMutableURLRequest *)requestWithMethod:(NSString *)method {
+  NSURL *url = [NSURL URLWithString:kHPConstantsHaikusPath relativeToURL:_baseURL];
+  NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url];
+  [request setHTTPMethod:method];
+  return request;
+}
+
+- (NSError *)errorWithStatusCode:(NSInteger)statusCode headers:(NSDictionary *)headers {
+  NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:_baseURL
+                                                            statusCode:statusCode
+                                                           HTTPVersion:@"HTTP/1.1"
+                                                          headerFields:headers];
+  return [NSError errorWithDomain:AFNetworkingErrorDomain
+                             code:NSURLErrorBadServerResponse
+                         userInfo:@{ AFNetworkingOperationFailingURLResponseErrorKey : response }];
+}
+
+- (NSTimeInterval)delayAfterError:(NSError *)error
+                         request:(NSURLRequest *)request
+                    attemptCount:(NSUInteger)attemptCount {
+  return [_policy delayBeforeRetryingRequest:request
+                                    response:nil
+                                       error:error
+                                attemptCount:attemptCount
+                               timeRemaining:_policy.deadline];
+}
+
+- (void)testOnlyIdempotentRequestsAreRetried {
+  XCTAssertTrue([_policy canRetryRequest:[self requestWithMethod:@"GET"]],
+                @"GET should be retried");
+  XCTAssertFalse([_policy canRetryRequest:[self requestWithMethod:@"POST"]],
+                 @"POST should not be retried");
+  NSMutableURLRequest *keyedPost = [self requestWithMethod:@"POST"];
+  [keyedPost setValue:@"key" forHTTPHeaderField:kHPConstantsIdempotencyKeyHeader];
+  XCTAssertTrue([_policy canRetryRequest:keyedPost],
+                @"POST with an idempotency key should be retried");
+}
+
+- (void)testOnlyTransientErrorsAreRetried {
+  NSURLRequest *request = [self requestWithMethod:@"GET"];
+  NSError *timeout = [NSError errorWithDomain:NSURLErrorDomain
+                                         code:NSURLErrorTimedOut
+                                     userInfo:nil];
+  XCTAssertTrue([self delayAfterError:timeout request:request attemptCount:1] >= 0,
+                @"Timeouts should be retried");
+  NSError *unavailable = [self errorWithStatusCode:503 headers:nil];
+  XCTAssertTrue([self delayAfterError:unavailable request:request attemptCount:1] >= 0,
+                @"503 should be retried");
+  NSError *notFound = [self errorWithStatusCode:404 headers:nil];
+  XCTAssertEqual([self delayAfterError:notFound request:request attemptCount:1],
+                 kHPRetryPolicyNoRetry, @"404 should not be retried");
+  NSError *cancelled = [NSError errorWithDomain:NSURLErrorDomain
+                                           code:NSURLErrorCancelled
+                                       userInfo:nil];
+  XCTAssertEqual([self delayAfterError:cancelled request:request attemptCount:1],
+                 kHPRetryPolicyNoRetry, @"Cancelled requests should not be retried");
+}
+
+- (void)testBackoffDoublesUpToCap {
+  NSURLRequest *request = [self requestWithMethod:@"GET"];
+  NSError *error = [self errorWithStatusCode:500 headers:nil];
+  _policy.maxAttemptCount = 10;
+  XCTAssertEqualWithAccuracy([self delayAfterError:error request:request attemptCount:1], 0.01,
+                             0.0001, @"First retry should wait the initial backoff");
+  XCTAssertEqualWithAccuracy([self delayAfterError:error request:request attemptCount:2], 0.02,
+                             0.0001, @"Backoff should double");
+  XCTAssertEqualWithAccuracy([self delayAfterError:error request:request attemptCount:5], 0.04,
+                             0.0001, @"Backoff should be capped");
+}
+
+- (void)testJitterStaysWithinBackoff {
+  NSURLRequest *request = [self requestWithMethod:@"GET"];
+  NSError *error = [self errorWithStatusCode:500 headers:nil];
+  _policy.jitter = 1;
+  for (NSUInteger i = 0; i < 100; i++) {
+    NSTimeInterval delay = [self delayAfterError:error request:request attemptCount:2];
+    XCTAssertTrue(delay >= 0 && delay <= 0.02, @"Jittered delay should not exceed the backoff");
+  }
+}
+
+- (void)testRetryAfterOverridesBackoff {
+  NSURLRequest *request = [self requestWithMethod:@"GET"];
+  NSError *error = [self errorWithStatusCode:429 headers:@{ @"Retry-After" : @"3" }];
+  XCTAssertEqualWithAccuracy([self delayAfterError:error request:request attemptCount:1], 3,
+                             0.0001, @"Retry-After should set the delay");
+  XCTAssertEqual(_policy.retryAfterCount, (NSUInteger)1, @"Retry-After should be counted");
+}
+
+- (void)testRetryAfterDate {
+  NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc]
+      initWithURL:_baseURL
+       statusCode:503
+      HTTPVersion:@"HTTP/1.1"
+     headerFields:@{ @"Retry-After" : @"Fri, 31 Dec 1999 23:59:59 GMT" }];
+  XCTAssertEqual([HPRetryPolicy retryAfterDelayOfResponse:response], (NSTimeInterval)0,
+                 @"A date in the past should allow an immediate retry");
+}
+
+- (void)testRetriesStopAtMaxAttemptsAndDeadline {
+  NSURLRequest *request = [self requestWithMethod:@"GET"];
+  NSError *error = [self errorWithStatusCode:502 headers:nil];
+  _policy.maxAttemptCount = 2;
+  XCTAssertTrue([self delayAfterError:error request:request attemptCount:1] >= 0,
+                @"Second attempt should be allowed");
+  XCTAssertEqual([self delayAfterError:error request:request attemptCount:2],
+                 kHPRetryPolicyNoRetry, @"Third attempt should not be allowed");
+  NSError *throttled = [self errorWithStatusCode:429 headers:@{ @"Retry-After" : @"60" }];
+  XCTAssertEqual([self delayAfterError:throttled request:request attemptCount:1],
+                 kHPRetryPolicyNoRetry, @"A retry past the deadline should not be scheduled");
+  XCTAssertEqual(_policy.exhaustedRequestCount, (NSUInteger)2, @"Give-ups should be counted");
+}
+
+#pragma mark - Failure sequences
+
+- (HPCommunicator *)communicatorWithNetwork:(SimulatedHPNetworkClient *)network {
+  HPCommunicator *communicator = [[HPCommunicator alloc] init];
+  communicator.networkClient = network;
+  communicator.retryPolicy = _policy;
+  return communicator;
+}
+
+- (void)testCommunicatorRecoversFromFailureSequence {
+  SimulatedHPNetworkClient *network = [[SimulatedHPNetworkClient alloc] initWithBaseURL:_baseURL];
+  [network injectFailureWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                      code:NSURLErrorNetworkConnectionLost
+                                                  userInfo:nil]];
+  [network injectFailureWithStatusCode:503 retryAfter:@"0"];
+  [network injectFailureWithStatusCode:500 retryAfter:nil];
+  HPCommunicator *communicator = [self communicatorWithNetwork:network];
+  __block HPHaiku *fetchedHaiku = nil;
+  [communicator fetchHaikuWithID:@"TestHaikuID" completion:^(HPHaiku *haiku, NSError *error) {
+      XCTAssertNil(error, @"The fourth attempt should succeed");
+      fetchedHaiku = haiku;
+  }];
+  [self waitForCondition:^BOOL { return fetchedHaiku != nil; }];
+  XCTAssertEqualObjects(fetchedHaiku.identifier, @"TestHaikuID", @"Haiku should be delivered");
+  XCTAssertEqual(network.injectedFailureCount, (NSUInteger)0, @"Every failure should be used");
+  XCTAssertEqual(_policy.retryCount, (NSUInteger)3, @"Every failure should be retried");
+  XCTAssertEqual(_policy.retriedRequestCount, (NSUInteger)1, @"One call should be retried");
+  XCTAssertEqual(_policy.recoveredRequestCount, (NSUInteger)1, @"The call should recover");
+  XCTAssertEqual(_policy.retryAfterCount, (NSUInteger)1, @"Retry-After should be honored");
+}
+
+- (void)testCommunicatorGivesUpAfterMaxAttempts {
+  SimulatedHPNetworkClient *network = [[SimulatedHPNetworkClient alloc] initWithBaseURL:_baseURL];
+  _policy.maxAttemptCount = 2;
+  for (NSUInteger i = 0; i < 3; i++) {
+    [network injectFailureWithStatusCode:503 retryAfter:nil];
+  }
+  HPCommunicator *communicator = [self communicatorWithNetwork:network];
+  __block NSError *fetchError = nil;
+  [communicator fetchHaikuWithID:@"TestHaikuID" completion:^(HPHaiku *haiku, NSError *error) {
+      fetchError = error;
+  }];
+  [self waitForCondition:^BOOL { return fetchError != nil; }];
+  XCTAssertNotNil(fetchError, @"The call should fail");
+  XCTAssertEqual(network.injectedFailureCount, (NSUInteger)1, @"Only two attempts should be made");
+  XCTAssertEqual(_policy.exhaustedRequestCount, (NSUInteger)1, @"The give-up should be counted");
+}
+
+- (void)testCommunicatorDoesNotRetryPlainPost {
+  SimulatedHPNetworkClient *network = [[SimulatedHPNetworkClient alloc] initWithBaseURL:_baseURL];
+  [network injectFailureWithStatusCode:503 retryAfter:nil];
+  HPCommunicator *communicator = [self communicatorWithNetwork:network];
+  __block NSError *signOutError = nil;
+  [communicator signOutWithCompletion:^(NSError *error) {
+      signOutError = error;
+  }];
+  [self waitForCondition:^BOOL { return signOutError != nil; }];
+  XCTAssertNotNil(signOutError, @"A POST without an idempotency key should fail at once");
+  XCTAssertEqual(_policy.retryCount, (NSUInteger)0, @"The POST should not be retried");
+}
+
+/**
+ * Retries are scheduled on the main queue, so run the main run loop until the condition holds or
+ * a timeout passes.
+ */
+- (void)waitForCondition:(BOOL (^)(void))condition {
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!condition() && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+}
+
+@end
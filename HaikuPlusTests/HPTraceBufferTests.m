@@ -0,0 +1,137 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPCommunicator.h"
+#import "HPConstants.h"
+#import "HPHaiku.h"
+#import "HPTraceBuffer.h"
+#import "SimulatedHPNetworkClient.h"
+
+@interface HPTraceBufferTests : XCTestCase
+
+@end
+
+@implementation HPTraceBufferTests {
+  NSURL *_baseURL;
+}
+
+- (void)setUp {
+  [super setUp];
+  _baseURL = [NSURL URLWithString:kHPConstantsAppBaseURLString];
+}
+
+- (NSURLRequest *)requestWithPath:(NSString *)path {
+  return [NSURLRequest requestWithURL:[NSURL URLWithString:path relativeToURL:_baseURL]];
+}
+
+- (void)testBufferKeepsNewestRecordsInOrder {
+  HPTraceBuffer *buffer = [[HPTraceBuffer alloc] initWithCapacity:3];
+  for (NSUInteger i = 0; i < 5; i++) {
+    NSString *path = [NSString stringWithFormat:kHPConstantsHaikuFormatPath,
+                         [NSString stringWithFormat:@"%lu", (unsigned long)i]];
+    [buffer addRecord:[buffer beginRecordWithRequest:[self requestWithPath:path]]];
+  }
+  NSArray *records = [buffer records];
+  XCTAssertEqual([records count], (NSUInteger)3, @"Only the newest records should be kept");
+  XCTAssertEqual(buffer.totalRecordCount, (NSUInteger)5, @"Every record should be counted");
+  XCTAssertTrue([[records[0] URLString] hasSuffix:@"2"], @"The oldest kept record should be first");
+  XCTAssertTrue([[records[2] URLString] hasSuffix:@"4"], @"The newest record should be last");
+  [buffer removeAllRecords];
+  XCTAssertEqual([[buffer records] count], (NSUInteger)0, @"Buffer should be empty");
+}
+
+- (void)testRecordMeasuresStagesFromEnqueueing {
+  HPTraceBuffer *buffer = [[HPTraceBuffer alloc] init];
+  HPTraceRecord *record = [buffer beginRecordWithRequest:[self requestWithPath:@"/"]];
+  XCTAssertTrue([record timeOfStage:HPTraceStageEnqueued] > 0, @"Enqueueing should be stamped");
+  XCTAssertTrue([record durationUntilStage:HPTraceStageDelivered] < 0,
+                @"A stage not reached should have no duration");
+  [record markStage:HPTraceStageDelivered];
+  XCTAssertTrue([record durationUntilStage:HPTraceStageDelivered] >= 0,
+                @"A reached stage should have a duration");
+}
+
+- (void)testBufferWritesJSONFile {
+  HPTraceBuffer *buffer = [[HPTraceBuffer alloc] init];
+  HPTraceRecord *record = [buffer beginRecordWithRequest:[self requestWithPath:@"/"]];
+  record.statusCode = 200;
+  [record markStage:HPTraceStageDelivered];
+  [buffer addRecord:record];
+  NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"trace.json"];
+  NSError *error = nil;
+  XCTAssertTrue([buffer writeToFile:path error:&error], @"File should be written: %@", error);
+  NSData *data = [NSData dataWithContentsOfFile:path];
+  NSArray *entries = [NSJSONSerialization JSONObjectWithData:data options:0 error:NULL];
+  XCTAssertEqual([entries count], (NSUInteger)1, @"File should hold one record");
+  XCTAssertEqualObjects(entries[0][@"status"], @200, @"File should hold the status");
+  XCTAssertNotNil(entries[0][@"stages_ms"][@"delivered"], @"File should hold the stages");
+  [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+}
+
+- (void)testCommunicatorTracesRequestStages {
+  HPCommunicator *communicator = [[HPCommunicator alloc] init];
+  communicator.networkClient = [[SimulatedHPNetworkClient alloc] initWithBaseURL:_baseURL];
+  communicator.traceBuffer = [[HPTraceBuffer alloc] init];
+  __block BOOL done = NO;
+  [communicator fetchHaikuWithID:@"TestHaikuID" completion:^(HPHaiku *haiku, NSError *error) {
+      done = YES;
+  }];
+  [self waitForCondition:^BOOL { return done && [[communicator.traceBuffer records] count]; }];
+  NSArray *records = [communicator.traceBuffer records];
+  XCTAssertEqual([records count], (NSUInteger)1, @"The call should be traced");
+  HPTraceRecord *record = [records firstObject];
+  XCTAssertEqualObjects(record.method, @"GET", @"Method should be recorded");
+  XCTAssertEqual(record.attemptCount, (NSUInteger)1, @"One attempt should be recorded");
+  XCTAssertEqual(record.statusCode, (NSInteger)200, @"Status should be recorded");
+  XCTAssertTrue(record.responseByteCount > 0, @"Response size should be recorded");
+  HPTraceStage stages[] = { HPTraceStageAuthorized, HPTraceStageParsed, HPTraceStageDecoded,
+                            HPTraceStageDelivered };
+  NSTimeInterval previous = 0;
+  for (NSUInteger i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+    NSTimeInterval duration = [record durationUntilStage:stages[i]];
+    XCTAssertTrue(duration >= previous, @"Stage %ld should follow the previous one",
+                  (long)stages[i]);
+    previous = duration;
+  }
+}
+
+- (void)testCommunicatorDoesNotTraceWithoutBuffer {
+  HPCommunicator *communicator = [[HPCommunicator alloc] init];
+  communicator.networkClient = [[SimulatedHPNetworkClient alloc] initWithBaseURL:_baseURL];
+  __block BOOL done = NO;
+  [communicator fetchHaikuWithID:@"TestHaikuID" completion:^(HPHaiku *haiku, NSError *error) {
+      done = YES;
+  }];
+  [self waitForCondition:^BOOL { return done; }];
+  XCTAssertNil(communicator.traceBuffer, @"Tracing should be off by default");
+}
+
+/**
+ * Completion blocks are delivered on the main queue, so run the main run loop until the condition
+ * holds or a timeout passes.
+ */
+- (void)waitForCondition:(BOOL (^)(void))condition {
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!condition() && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+}
+
+@end
@@ -0,0 +1,190 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "HPWriteJournal.h"
+
+@interface HPWriteJournalTests : XCTestCase
+
+@end
+
+@implementation HPWriteJournalTests {
+  HPWriteJournal *_journal;
+  NSString *_directory;
+}
+
+- (void)setUp {
+  [super setUp];
+  NSString *name = [NSString stringWithFormat:@"HPWriteJournalTests-%@",
+                       [[NSProcessInfo processInfo] globallyUniqueString]];
+  _directory = [NSTemporaryDirectory() stringByAppendingPathComponent:name];
+  _journal = [[HPWriteJournal alloc] initWithDirectory:_directory];
+}
+
+- (void)tearDown {
+  [[NSFileManager defaultManager] removeItemAtPath:_directory error:NULL];
+  [super tearDown];
+}
+
+/**
+ * Reads entries and waits for the completion block on the main queue.
+ */
+- (NSArray *)readEntriesFromJournal:(HPWriteJournal *)journal limit:(NSUInteger)limit {
+  __block NSArray *result = nil;
+  [journal readEntriesWithLimit:limit completion:^(NSArray *entries) {
+      result = entries;
+  }];
+  NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+  while (!result && [timeout timeIntervalSinceNow] > 0) {
+    [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode
+                             beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+  }
+  XCTAssertNotNil(result, @"Journal must call the completion block");
+  return result;
+}
+
+- (HPWriteEntry *)voteEntryForHaikuID:(NSString *)haikuID {
+  return [[HPWriteEntry alloc] initWithKind:HPWriteKindVote
+                                    haikuID:haikuID
+                                 attributes:nil
+                                     userID:@"testid"];
+}
+
+- (void)testEntriesAreReadInOrder {
+  HPWriteEntry *vote = [self voteEntryForHaikuID:@"TestHaikuID"];
+  HPWriteEntry *creation = [[HPWriteEntry alloc] initWithKind:HPWriteKindCreateHaiku
+                                                      haikuID:nil
+                                                   attributes:@{ @"title" : @"testtitle" }
+                                                       userID:nil];
+  [_journal appendEntry:vote];
+  [_journal appendEntry:creation];
+  NSArray *entries = [self readEntriesFromJournal:_journal limit:10];
+  XCTAssertEqual([entries count], (NSUInteger)2, @"Both entries should be pending");
+  XCTAssertEqualObjects([entries[0] idempotencyKey], vote.idempotencyKey, @"Vote comes first");
+  XCTAssertEqualObjects([entries[1] idempotencyKey], creation.idempotencyKey,
+      @"Creation comes second");
+  XCTAssertEqual([[self readEntriesFromJournal:_journal limit:1] count], (NSUInteger)1,
+      @"Read should respect the limit");
+}
+
+- (void)testIdempotencyKeysAreUnique {
+  HPWriteEntry *first = [self voteEntryForHaikuID:@"TestHaikuID"];
+  HPWriteEntry *second = [self voteEntryForHaikuID:@"TestHaikuID"];
+  XCTAssertNotNil(first.idempotencyKey, @"Entry should have a key");
+  XCTAssertNotEqualObjects(first.idempotencyKey, second.idempotencyKey,
+      @"Two votes for the same haiku are two writes");
+}
+
+- (void)testEntriesSurviveRelaunch {
+  HPWriteEntry *vote = [self voteEntryForHaikuID:@"TestHaikuID"];
+  HPWriteEntry *creation = [[HPWriteEntry alloc] initWithKind:HPWriteKindCreateHaiku
+                                                      haikuID:nil
+                                                   attributes:@{ @"title" : @"testtitle" }
+                                                       userID:nil];
+  [_journal appendEntry:vote];
+  [_journal appendEntry:creation];
+  [self readEntriesFromJournal:_journal limit:10];
+
+  HPWriteJournal *relaunched = [[HPWriteJournal alloc] initWithDirectory:_directory];
+  NSArray *entries = [self readEntriesFromJournal:relaunched limit:10];
+  XCTAssertEqual([entries count], (NSUInteger)2, @"Entries should be stored on disk");
+  HPWriteEntry *storedVote = entries[0];
+  HPWriteEntry *storedCreation = entries[1];
+  XCTAssertEqualObjects(storedVote.idempotencyKey, vote.idempotencyKey, @"Key should be kept");
+  XCTAssertEqual(storedVote.kind, HPWriteKindVote, @"Kind should be kept");
+  XCTAssertEqualObjects(storedVote.haikuID, @"TestHaikuID", @"Haiku ID should be kept");
+  XCTAssertEqualObjects(storedVote.userID, @"testid", @"User ID should be kept");
+  XCTAssertNil(storedCreation.userID, @"Missing user ID should stay missing");
+  XCTAssertEqual(storedCreation.kind, HPWriteKindCreateHaiku, @"Kind should be kept");
+  XCTAssertEqualObjects(storedCreation.attributes, creation.attributes,
+      @"Attributes should be kept");
+  XCTAssertEqualWithAccuracy([storedVote.creationDate timeIntervalSinceDate:vote.creationDate],
+      0, 0.001, @"Creation date should be kept");
+}
+
+- (void)testRemovedEntriesDoNotComeBack {
+  HPWriteEntry *first = [self voteEntryForHaikuID:@"FirstHaikuID"];
+  HPWriteEntry *second = [self voteEntryForHaikuID:@"SecondHaikuID"];
+  [_journal appendEntry:first];
+  [_journal appendEntry:second];
+  [_journal removeEntry:first];
+  NSArray *entries = [self readEntriesFromJournal:_journal limit:10];
+  XCTAssertEqual([entries count], (NSUInteger)1, @"Removed entry should be gone");
+
+  HPWriteJournal *relaunched = [[HPWriteJournal alloc] initWithDirectory:_directory];
+  entries = [self readEntriesFromJournal:relaunched limit:10];
+  XCTAssertEqual([entries count], (NSUInteger)1, @"Removal should be stored on disk");
+  XCTAssertEqualObjects([entries[0] idempotencyKey], second.idempotencyKey,
+      @"Remaining entry should be kept");
+}
+
+- (void)testLogIsCompacted {
+  HPWriteEntry *kept = [self voteEntryForHaikuID:@"KeptHaikuID"];
+  [_journal appendEntry:kept];
+  for (int i = 0; i < 200; i++) {
+    HPWriteEntry *entry = [self voteEntryForHaikuID:@"TestHaikuID"];
+    [_journal appendEntry:entry];
+    [_journal removeEntry:entry];
+  }
+  [self readEntriesFromJournal:_journal limit:10];
+  NSString *path = [_directory stringByAppendingPathComponent:@"journal.log"];
+  NSString *log = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:NULL];
+  NSUInteger lineCount = [[log componentsSeparatedByString:@"\n"] count] - 1;
+  XCTAssertTrue(lineCount < 200, @"Removed entries should not pile up in the log");
+
+  HPWriteJournal *relaunched = [[HPWriteJournal alloc] initWithDirectory:_directory];
+  NSArray *entries = [self readEntriesFromJournal:relaunched limit:10];
+  XCTAssertEqual([entries count], (NSUInteger)1, @"Only the kept entry should remain");
+  XCTAssertEqualObjects([entries[0] idempotencyKey], kept.idempotencyKey,
+      @"Kept entry should survive compaction");
+}
+
+- (void)testTornLastLineIsIgnored {
+  HPWriteEntry *vote = [self voteEntryForHaikuID:@"TestHaikuID"];
+  [_journal appendEntry:vote];
+  [self readEntriesFromJournal:_journal limit:10];
+  NSString *path = [_directory stringByAppendingPathComponent:@"journal.log"];
+  NSFileHandle *handle = [NSFileHandle fileHandleForWritingAtPath:path];
+  [handle seekToEndOfFile];
+  [handle writeData:[@"{\"key\":\"torn" dataUsingEncoding:NSUTF8StringEncoding]];
+  [handle closeFile];
+
+  HPWriteJournal *relaunched = [[HPWriteJournal alloc] initWithDirectory:_directory];
+  HPWriteEntry *next = [self voteEntryForHaikuID:@"NextHaikuID"];
+  [relaunched appendEntry:next];
+  NSArray *entries = [self readEntriesFromJournal:relaunched limit:10];
+  XCTAssertEqual([entries count], (NSUInteger)2, @"Torn line should be skipped");
+
+  HPWriteJournal *again = [[HPWriteJournal alloc] initWithDirectory:_directory];
+  entries = [self readEntriesFromJournal:again limit:10];
+  XCTAssertEqual([entries count], (NSUInteger)2, @"Entry after a torn line should be readable");
+  XCTAssertEqualObjects([entries[1] idempotencyKey], next.idempotencyKey,
+      @"Entry after a torn line should be kept");
+}
+
+- (void)testRemoveAllEntries {
+  [_journal appendEntry:[self voteEntryForHaikuID:@"TestHaikuID"]];
+  [_journal removeAllEntries];
+  XCTAssertEqual([[self readEntriesFromJournal:_journal limit:10] count], (NSUInteger)0,
+      @"Journal should be empty");
+  HPWriteJournal *relaunched = [[HPWriteJournal alloc] initWithDirectory:_directory];
+  XCTAssertEqual([[self readEntriesFromJournal:relaunched limit:10] count], (NSUInteger)0,
+      @"Journal should be empty on disk");
+}
+
+@end
@@ -0,0 +1,66 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class SimulatedHaikuDataset;
+
+/**
+ * Small HTTP/1.1 server on 127.0.0.1 that stands in for the Haiku+ API in end-to-end tests. It
+ * answers GET /api/users/me, GET /api/haikus (whole or paged), GET /api/haikus/{id} and
+ * POST /api/haikus/{id}/vote with generated data, so the real AFNetworking stack can be measured
+ * without any outside network. Connections are kept alive, and GET responses carry an ETag that
+ * is honored with 304 Not Modified. Each connection is served on its own thread.
+ */
+@interface LoopbackHaikuServer : NSObject
+
+/**
+ * Source of the generated haikus and users. Set it before starting the server. Defaults to a
+ * dataset with the default seed and 100 authors.
+ */
+@property(nonatomic, strong) SimulatedHaikuDataset *dataset;
+
+/**
+ * Number of haikus in the feed. Set it before starting the server. Defaults to 1000.
+ */
+@property(nonatomic) NSUInteger haikuCount;
+
+/**
+ * Base URL of the server once it has started, such as http://127.0.0.1:50123/, or nil.
+ */
+@property(nonatomic, readonly) NSURL *baseURL;
+
+/**
+ * Number of requests answered, and of response body bytes sent.
+ */
+@property(nonatomic, readonly) NSUInteger requestCount;
+@property(nonatomic, readonly) unsigned long long sentByteCount;
+
+/**
+ * Starts listening on a free port of the loopback interface.
+ *
+ * @param error Set to the reason the server could not start.
+ * @return YES if the server is listening.
+ */
+- (BOOL)start:(NSError **)error;
+
+/**
+ * Stops listening and closes every open connection.
+ */
+- (void)stop;
+
+@end
@@ -0,0 +1,426 @@
+/*
+ *
+ * Copyright 2014 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import "LoopbackHaikuServer.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#import "HPConstants.h"
+#import "SimulatedHaikuDataset.h"
+
+/**
+ * Size of the buffer that socket reads go through.
+ */
+static const size_t kLoopbackReadLength = 16384;
+
+/**
+ * Largest request header accepted, which is far more than the client sends.
+ */
+static const NSUInteger kLoopbackMaxHeaderLength = 65536;
+
+/**
+ * Seconds an idle keep-alive connection is kept open.
+ */
+static const int kLoopbackIdleTimeout = 5;
+
+/**
+ * One parsed HTTP request.
+ */
+@interface LoopbackHTTPRequest : NSObject
+
+@property(nonatomic, copy) NSString *method;
+@property(nonatomic, copy) NSString *path;
+@property(nonatomic, strong) NSDictionary *queryParameters;
+// Header names are lowercase.
+@property(nonatomic, strong) NSDictionary *headers;
+@property(nonatomic, strong) NSData *body;
+@property(nonatomic) BOOL keepAlive;
+
+@end
+
+@implementation LoopbackHTTPRequest
+
+@end
+
+@implementation LoopbackHaikuServer {
+  int _listenSocket;
+  dispatch_source_t _acceptSource;
+  // Sockets of open connections, as NSNumbers. Guarded by @synchronized(self).
+  NSMutableSet *_connectionSockets;
+  // Feed response bodies by page size and cursor, which are all they depend on.
+  NSCache *_bodies;
+}
+
+- (id)init {
+  self = [super init];
+  if (self) {
+    _dataset = [[SimulatedHaikuDataset alloc] init];
+    _haikuCount = 1000;
+    _listenSocket = -1;
+    _connectionSockets = [NSMutableSet set];
+    _bodies = [[NSCache alloc] init];
+  }
+  return self;
+}
+
+- (void)dealloc {
+  [self stop];
+}
+
+#pragma mark - Listening
+
+- (BOOL)start:(NSError **)error {
+  int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenSocket < 0) {
+    return [self failWithErrno:error];
+  }
+  int yes = 1;
+  setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_len = sizeof(address);
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  // Port 0 lets the system choose a free port.
+  address.sin_port = 0;
+  socklen_t length = sizeof(address);
+  if (bind(listenSocket, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(listenSocket, SOMAXCONN) < 0 ||
+      getsockname(listenSocket, (struct sockaddr *)&address, &length) < 0) {
+    close(listenSocket);
+    return [self failWithErrno:error];
+  }
+  fcntl(listenSocket, F_SETFL, fcntl(listenSocket, F_GETFL) | O_NONBLOCK);
+  _listenSocket = listenSocket;
+  _baseURL = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%u/",
+                                      (unsigned)ntohs(address.sin_port)]];
+
+  dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+  _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, listenSocket, 0, queue);
+  __weak LoopbackHaikuServer *weakSelf = self;
+  dispatch_source_set_event_handler(_acceptSource, ^{
+      [weakSelf acceptConnectionsOnSocket:listenSocket];
+  });
+  dispatch_source_set_cancel_handler(_acceptSource, ^{
+      close(listenSocket);
+  });
+  dispatch_resume(_acceptSource);
+  return YES;
+}
+
+- (void)stop {
+  if (_acceptSource) {
+    dispatch_source_cancel(_acceptSource);
+    _acceptSource = nil;
+  }
+  _listenSocket = -1;
+  _baseURL = nil;
+  @synchronized(self) {
+    // The connection threads see the shutdown as the end of the stream and close the sockets.
+    for (NSNumber *connectionSocket in _connectionSockets) {
+      shutdown([connectionSocket intValue], SHUT_RDWR);
+    }
+  }
+}
+
+- (BOOL)failWithErrno:(NSError **)error {
+  if (error) {
+    *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+  }
+  return NO;
+}
+
+/**
+ * Accepts every pending connection and serves each on its own thread.
+ */
+- (void)acceptConnectionsOnSocket:(int)listenSocket {
+  while (YES) {
+    int connectionSocket = accept(listenSocket, NULL, NULL);
+    if (connectionSocket < 0) {
+      return;
+    }
+    int yes = 1;
+    setsockopt(connectionSocket, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+    setsockopt(connectionSocket, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    struct timeval timeout = { kLoopbackIdleTimeout, 0 };
+    setsockopt(connectionSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    @synchronized(self) {
+      [_connectionSockets addObject:@(connectionSocket)];
+    }
+    [NSThread detachNewThreadSelector:@selector(serveConnection:)
+                             toTarget:self
+                           withObject:@(connectionSocket)];
+  }
+}
+
+#pragma mark - Connections
+
+/**
+ * Answers requests on a connection until the client closes it or asks for it to be closed.
+ *
+ * @param socketNumber The socket of the connection.
+ */
+- (void)serveConnection:(NSNumber *)socketNumber {
+  int connectionSocket = [socketNumber intValue];
+  NSMutableData *buffer = [NSMutableData data];
+  BOOL isOpen = YES;
+  while (isOpen) {
+    @autoreleasepool {
+      LoopbackHTTPRequest *request = [self readRequestFromSocket:connectionSocket buffer:buffer];
+      isOpen = request && [self writeResponseToRequest:request socket:connectionSocket] &&
+               request.keepAlive;
+    }
+  }
+  @synchronized(self) {
+    [_connectionSockets removeObject:socketNumber];
+  }
+  close(connectionSocket);
+}
+
+/**
+ * Reads one request. Bytes after it stay in the buffer for the next request on the connection.
+ *
+ * @return The request, or nil if the connection was closed or the request is malformed.
+ */
+- (LoopbackHTTPRequest *)readRequestFromSocket:(int)connectionSocket
+                                        buffer:(NSMutableData *)buffer {
+  NSData *separator = [NSData dataWithBytes:"\r\n\r\n" length:4];
+  NSRange end;
+  while ((end = [buffer rangeOfData:separator
+                            options:0
+                              range:NSMakeRange(0, [buffer length])]).location == NSNotFound) {
+    if ([buffer length] > kLoopbackMaxHeaderLength ||
+        ![self readFromSocket:connectionSocket intoBuffer:buffer]) {
+      return nil;
+    }
+  }
+  NSString *header = [[NSString alloc] initWithBytes:[buffer bytes]
+                                              length:end.location
+                                            encoding:NSISOLatin1StringEncoding];
+  NSArray *lines = [header componentsSeparatedByString:@"\r\n"];
+  NSArray *requestLine = [[lines firstObject] componentsSeparatedByString:@" "];
+  if ([requestLine count] != 3) {
+    return nil;
+  }
+  NSMutableDictionary *headers = [NSMutableDictionary dictionary];
+  for (NSString *line in [lines subarrayWithRange:NSMakeRange(1, [lines count] - 1)]) {
+    NSRange colon = [line rangeOfString:@":"];
+    if (colon.location != NSNotFound) {
+      NSString *name = [[line substringToIndex:colon.location] lowercaseString];
+      NSString *value = [line substringFromIndex:NSMaxRange(colon)];
+      [headers setObject:[value stringByTrimmingCharactersInSet:
+                             [NSCharacterSet whitespaceCharacterSet]]
+                  forKey:name];
+    }
+  }
+  NSUInteger bodyStart = NSMaxRange(end);
+  NSUInteger bodyLength = (NSUInteger)MAX([[headers objectForKey:@"content-length"] integerValue],
+                                          0);
+  while ([buffer length] < bodyStart + bodyLength) {
+    if (![self readFromSocket:connectionSocket intoBuffer:buffer]) {
+      return nil;
+    }
+  }
+
+  LoopbackHTTPRequest *request = [[LoopbackHTTPRequest alloc] init];
+  request.method = [requestLine objectAtIndex:0];
+  request.headers = headers;
+  request.body = [buffer subdataWithRange:NSMakeRange(bodyStart, bodyLength)];
+  NSString *connection = [[headers objectForKey:@"connection"] lowercaseString];
+  request.keepAlive = [[requestLine objectAtIndex:2] isEqual:@"HTTP/1.1"] ?
+      ![connection isEqual:@"close"] : [connection isEqual:@"keep-alive"];
+  NSString *target = [requestLine objectAtIndex:1];
+  NSRange question = [target rangeOfString:@"?"];
+  if (question.location == NSNotFound) {
+    request.path = target;
+  } else {
+    request.path = [target substringToIndex:question.location];
+    request.queryParameters =
+        [self parametersFromQuery:[target substringFromIndex:NSMaxRange(question)]];
+  }
+  [buffer replaceBytesInRange:NSMakeRange(0, bodyStart + bodyLength) withBytes:NULL length:0];
+  return request;
+}
+
+/**
+ * @return NO if the connection was closed, timed out or failed.
+ */
+- (BOOL)readFromSocket:(int)connectionSocket intoBuffer:(NSMutableData *)buffer {
+  uint8_t bytes[kLoopbackReadLength];
+  ssize_t count = recv(connectionSocket, bytes, sizeof(bytes), 0);
+  if (count <= 0) {
+    return NO;
+  }
+  [buffer appendBytes:bytes length:(NSUInteger)count];
+  return YES;
+}
+
+- (NSDictionary *)parametersFromQuery:(NSString *)query {
+  NSMutableDictionary *parameters = [NSMutableDictionary dictionary];
+  for (NSString *pair in [query componentsSeparatedByString:@"&"]) {
+    NSArray *parts = [pair componentsSeparatedByString:@"="];
+    NSString *name = [[parts firstObject] stringByReplacingPercentEscapesUsingEncoding:
+                         NSUTF8StringEncoding];
+    NSString *value = [parts count] > 1 ?
+        [[parts objectAtIndex:1] stringByReplacingPercentEscapesUsingEncoding:
+            NSUTF8StringEncoding] : @"";
+    if (name) {
+      [parameters setObject:(value ? value : @"") forKey:name];
+    }
+  }
+  return parameters;
+}
+
+/**
+ * Sends the response to a request.
+ *
+ * @return NO if the connection failed.
+ */
+- (BOOL)writeResponseToRequest:(LoopbackHTTPRequest *)request socket:(int)connectionSocket {
+  NSInteger statusCode = 200;
+  NSData *body = [self bodyForRequest:request statusCode:&statusCode];
+  NSString *entityTag = nil;
+  if (statusCode == 200 && [request.method isEqual:@"GET"]) {
+    entityTag = [self entityTagOfBody:body];
+    if ([[request.headers objectForKey:@"if-none-match"] isEqual:entityTag]) {
+      statusCode = 304;
+      body = nil;
+    }
+  }
+  NSMutableString *header =
+      [NSMutableString stringWithFormat:@"HTTP/1.1 %ld %@\r\n", (long)statusCode,
+                          [NSHTTPURLResponse localizedStringForStatusCode:statusCode]];
+  [header appendString:@"Content-Type: application/json\r\n"];
+  [header appendFormat:@"Content-Length: %lu\r\n", (unsigned long)[body length]];
+  if (entityTag) {
+    [header appendFormat:@"ETag: %@\r\n", entityTag];
+  }
+  [header appendString:request.keepAlive ? @"Connection: keep-alive\r\n\r\n" :
+                                           @"Connection: close\r\n\r\n"];
+  @synchronized(self) {
+    _requestCount++;
+    _sentByteCount += [body length];
+  }
+  NSMutableData *response = [[header dataUsingEncoding:NSISOLatin1StringEncoding] mutableCopy];
+  if (body) {
+    [response appendData:body];
+  }
+  const uint8_t *bytes = [response bytes];
+  NSUInteger remaining = [response length];
+  while (remaining > 0) {
+    ssize_t count = send(connectionSocket, bytes, remaining, 0);
+    if (count <= 0) {
+      return NO;
+    }
+    bytes += count;
+    remaining -= (NSUInteger)count;
+  }
+  return YES;
+}
+
+/**
+ * @return Strong entity tag derived from the FNV-1a hash of the body.
+ */
+- (NSString *)entityTagOfBody:(NSData *)body {
+  uint64_t hash = 14695981039346656037ULL;
+  const uint8_t *bytes = [body bytes];
+  for (NSUInteger i = 0; i < [body length]; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return [NSString stringWithFormat:@"\"%016llx\"", hash];
+}
+
+#pragma mark - API
+
+/**
+ * Routes a request to the simulated API.
+ *
+ * @param request The request.
+ * @param statusCode Set to the status code of the response.
+ * @return JSON body of the response, or nil for none.
+ */
+- (NSData *)bodyForRequest:(LoopbackHTTPRequest *)request statusCode:(NSInteger *)statusCode {
+  NSString *haikuPrefix = [NSString stringWithFormat:kHPConstantsHaikuFormatPath, @""];
+  NSString *path = request.path;
+  BOOL isGET = [request.method isEqual:@"GET"];
+  if (isGET && [path isEqual:kHPConstantsUserPath]) {
+    return [self JSONDataWithObject:[_dataset userAttributesAtIndex:0]];
+  }
+  if (isGET && [path isEqual:kHPConstantsHaikusPath]) {
+    NSDictionary *parameters = request.queryParameters;
+    NSString *key = [NSString stringWithFormat:@"%@ %@",
+                        [parameters objectForKey:kHPConstantsPageSizeParameter],
+                        [parameters objectForKey:kHPConstantsPageCursorParameter]];
+    NSData *body = [_bodies objectForKey:key];
+    if (!body) {
+      body = [self JSONDataWithObject:[self feedWithParameters:parameters]];
+      [_bodies setObject:body forKey:key];
+    }
+    return body;
+  }
+  if ([path hasPrefix:haikuPrefix]) {
+    NSArray *components = [[path substringFromIndex:[haikuPrefix length]] pathComponents];
+    NSUInteger index = [_dataset indexForHaikuID:[components firstObject]];
+    if (index != NSNotFound && index < _haikuCount) {
+      if (isGET && [components count] == 1) {
+        return [self JSONDataWithObject:[_dataset haikuAttributesAtIndex:index]];
+      }
+      if ([request.method isEqual:@"POST"] && [components count] == 2 &&
+          [[components lastObject] isEqual:@"vote"]) {
+        // Generated haikus do not keep vote counts.
+        return nil;
+      }
+    }
+  }
+  *statusCode = 404;
+  return nil;
+}
+
+/**
+ * @param parameters Query parameters with an optional page size and cursor.
+ * @return The whole feed as an array, or one page of it if a page size is given.
+ */
+- (id)feedWithParameters:(NSDictionary *)parameters {
+  NSString *pageSize = [parameters objectForKey:kHPConstantsPageSizeParameter];
+  if (!pageSize) {
+    return [_dataset haikuAttributesInRange:NSMakeRange(0, _haikuCount)];
+  }
+  NSUInteger offset = (NSUInteger)MAX(
+      [[parameters objectForKey:kHPConstantsPageCursorParameter] longLongValue], 0);
+  offset = MIN(offset, _haikuCount);
+  NSUInteger end = MIN(offset + (NSUInteger)MAX([pageSize integerValue], 1), _haikuCount);
+  NSMutableDictionary *page = [NSMutableDictionary dictionary];
+  [page setObject:[_dataset haikuAttributesInRange:NSMakeRange(offset, end - offset)]
+           forKey:kHPConstantsPageItemsKey];
+  if (end < _haikuCount) {
+    [page setObject:[NSString stringWithFormat:@"%lu", (unsigned long)end]
+             forKey:kHPConstantsPageNextCursorKey];
+  }
+  return page;
+}
+
+- (NSData *)JSONDataWithObject:(id)object {
+  return [NSJSONSerialization dataWithJSONObject:object options:0 error:NULL];
+}
+
+@end
@@ -38,14 +38,28 @@
   completion(nil, nil);
 }
 
+- (void)fetchHaikusFiltered:(BOOL)filterByFriends
+                   pageSize:(NSUInteger)pageSize
+                     cursor:(NSString *)cursor
+                 completion:(void (^)(HPHaikuPage *, NSError *))completion {
+  if (filterByFriends) {
+    _fetchHaikuFilteredCount++;
+  } else {
+    _fetchHaikuNotFilteredCount++;
+  }
+  completion(nil, nil);
+}
+
 - (void)fetchCurrentUserWithCompletion:(void (^)(HPUser *, NSError *))completion {
   _fetchUserCount++;
   completion(nil, nil);
 }
 
-- (void)fetchImageWithURL:(NSURL *)url completion:(void (^)(UIImage *, NSError *))completion {
+- (HPImageLoadToken *)fetchImageWithURL:(NSURL *)url
+                             completion:(void (^)(UIImage *, NSError *))completion {
   _fetchImageCount++;
   completion(nil, nil);
+  return nil;
 }
 
 - (void)signOutWithCompletion:(void (^)(NSError *))completion {